@@ -0,0 +1,138 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/core-adjust-bench/main.cpp
+ * @brief Measure the cost of updating the sensors on simulated cpus.
+ */
+// STL
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+// App
+#include "CpuActivity.hpp"
+
+namespace {
+
+  /** @brief A CpuActivity that parses generated /proc/stat texts instead of the real file.
+    *
+    * The texts are generated up front (with counters that grow by a
+    * pseudo-random amount each frame), so a step() only measures the
+    * parsing and the calculation, not the read() of /proc/stat.
+    * The parsed samples of each frame are kept as well, so calculate_next()
+    * measures the calculation of the deltas of a new sample without parsing. */
+  class SimulatedActivity : public xxx::CpuActivity {
+    public:
+      explicit SimulatedActivity(size_t cpus, size_t frames = 32) : cpus_(cpus) {
+        uint32_t random = 12345;
+        std::vector<uint64_t> counters((cpus + 1) * 10, 0);
+        for (size_t f = 0; f < frames; ++f) {
+          std::string text;
+          for (size_t c = 1; c <= cpus; ++c) {
+            for (size_t i = 0; i < 10; ++i) {
+              random = random * 1103515245u + 12345u;
+              /* (the guest time is part of the user time) */
+              uint64_t increment = (i == 8 || i == 9) ? 0 : (random >> 16) % 100;
+              counters[c * 10 + i] += increment;
+              counters[i] += increment;
+            }
+          }
+          for (size_t c = 0; c <= cpus; ++c) {
+            text += (c == 0) ? std::string("cpu ") : "cpu" + std::to_string(c - 1);
+            for (size_t i = 0; i < 10; ++i) text += " " + std::to_string(counters[c * 10 + i]);
+            text += "\n";
+          }
+          text += "intr 0\n";
+          parse(text);
+          samples_.push_back(cpu_stats_.sample);
+          texts_.push_back(std::move(text));
+        }
+        step();
+      }
+
+      /** @brief Parse the next text and calculate the activity. */
+      inline void step() {
+        calculate(parse(texts_[next_]));
+        if (++next_ == texts_.size()) next_ = 0;
+      }
+
+      /** @brief Calculate the activity of the next (already parsed) sample.
+        * (The samples are swapped in and out, that does not copy the arrays.) */
+      inline void calculate_next() {
+        std::swap(cpu_stats_.sample, samples_[next_]);
+        calculate(cpus_ + 1);
+        std::swap(cpu_stats_.sample, samples_[next_]);
+        if (++next_ == samples_.size()) next_ = 0;
+      }
+
+    private:
+      size_t cpus_;
+      std::vector<std::string> texts_;
+      std::vector<Statistics::Fields<uint64_t>> samples_;
+      size_t next_ { 0 };
+  };
+
+  /** @brief The mean time of a call (in microseconds), repeated for at least 200 ms. */
+  template<typename F>
+  double measure(F f) {
+    using clock = std::chrono::steady_clock;
+    for (int i = 0; i < 100; ++i) f();
+    unsigned long calls = 0;
+    auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+    do {
+      for (int i = 0; i < 100; ++i) f();
+      calls += 100;
+      elapsed = clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(200));
+    return std::chrono::duration<double, std::micro>(elapsed).count() / static_cast<double>(calls);
+  }
+
+} // ends anonymous namespace
+
+int main(int argc, char** argv) {
+  std::vector<size_t> counts;
+  for (int i = 1; i < argc; ++i) {
+    char* end = nullptr;
+    unsigned long cpus = std::strtoul(argv[i], &end, 10);
+    if (*argv[i] == '\0' || *end != '\0' || cpus == 0) {
+      std::fprintf(stderr, "Usage: core-adjust-bench [CPUS]...\n"
+          "Measure the cost of CpuActivity::update() on simulated cpus (default 64 256 1024).\n");
+      return EXIT_FAILURE;
+    }
+    counts.push_back(cpus);
+  }
+  if (counts.empty()) counts = { 64, 256, 1024 };
+
+  std::printf("%8s %14s %14s\n", "cpus", "update (us)", "calculate (us)");
+  volatile unsigned int sink = 0;
+  for (size_t cpus : counts) {
+    SimulatedActivity activity(cpus);
+    double update = measure([&]() { activity.step(); sink = activity[0].total; });
+    double calculate = measure([&]() { activity.calculate_next(); sink = activity[0].total; });
+    std::printf("%8zu %14.2f %14.2f\n", cpus, update, calculate);
+  }
+  return EXIT_SUCCESS;
+}
@@ -108,7 +108,10 @@ CoreAdjust::CoreAdjust(
   left_vbox->addLayout(buttons_hbox);
 
   monitorLayout_ = new QVBoxLayout();
-  monitor_ = new Monitor();
+  monitor_ = new Monitor(
+      tabSettings().monitorSampleInterval(),
+      tabSettings().monitorSampleIntervalMax(),
+      tabSettings().monitorRefreshInterval());
   monitorLayout_->addWidget(monitor_);
 
   auto* layout = new QHBoxLayout(this);
@@ -350,18 +353,15 @@ void CoreAdjust::applyAfterShowEvent() {
       rv = QMessageBox::question(this, "Adjust settings?", ss.str().c_str(),
           QMessageBox::Apply | QMessageBox::Discard, QMessageBox::Discard);
       if (rv == QMessageBox::Apply) {
-        /* Apply */
-        monitor_tab_->setMonitor(nullptr);
+        /* Apply (the monitor follows cpus going on/offline by itself) */
         shell_.run({ TabSettings::ScriptPath, "--verbose", "--force", "--boot" });
         cpuId().refresh();
         cpuInfo().refresh();
         tabValues().rescan(cpuInfo());
-        monitorLayout_->removeWidget(monitor_);
-        monitor_->setParent(nullptr);
-        delete monitor_;
-        monitor_ = new Monitor();
-        monitorLayout_->addWidget(monitor_);
-        monitor_tab_->setMonitor(monitor_);
+        monitor_->setIntervals(
+            tabSettings().monitorSampleInterval(),
+            tabSettings().monitorSampleIntervalMax(),
+            tabSettings().monitorRefreshInterval());
         rv = 1;
       }
       else {
@@ -515,14 +515,12 @@ void CoreAdjust::apply() {
   }
   ss << "</ul>";
 
-  /* Recreate the monitor_(tab_) widgets, the number of cpus may have changed */
-  monitor_tab_->setMonitor(nullptr);
-  monitorLayout_->removeWidget(monitor_);
-  monitor_->setParent(nullptr);
-  delete monitor_;
-  monitor_ = new Monitor();
-  monitorLayout_->addWidget(monitor_);
-  monitor_tab_->setMonitor(monitor_);
+  /* The monitor_(tab_) widgets follow cpus going on/offline by themselves
+   * (see xxx::CpuHotplug), only the intervals may have changed. */
+  monitor_->setIntervals(
+      tabSettings().monitorSampleInterval(),
+      tabSettings().monitorSampleIntervalMax(),
+      tabSettings().monitorRefreshInterval());
 
   /* If the newly read values differ from the desired settings
    * then notify the user and re-enable the apply button.
@@ -18,18 +18,30 @@
  * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 #include <sstream>
 #include <iomanip>
 #include <QVBoxLayout>
 #include <QGroupBox>
 #include <QScrollArea>
 #include <QFrame>
+#include <QGridLayout>
 #include <QString>
-#include <QTimer>
+#include <QDateTime>
+#include <QFileDialog>
+#include <QMessageBox>
 #include "Dbg.hpp"
 #include "Monitor.hpp"
 
+#ifndef ENERGY_FILE
+#define ENERGY_FILE "/var/lib/core-adjust/energy"
+#endif
+
 /*
  * Monitor::CpuActivity
  */
@@ -52,7 +64,8 @@ Monitor::CpuActivity::CpuActivity(QWidget* parent)
   previous_value_ = 0;
 }
 
-void Monitor::CpuActivity::refresh(const xxx::CpuActivity& cpu_activity) {
+void Monitor::CpuActivity::refresh(const std::vector<xxx::CpuActivityEntry>& cpu_activity) {
+  if (cpu_activity.empty()) return;
   auto total = cpu_activity[0].total;
   auto delta = (total > previous_value_) ?
       (total - previous_value_) : (previous_value_ - total);
@@ -66,16 +79,17 @@ void Monitor::CpuActivity::refresh(const xxx::CpuActivity& cpu_activity) {
  */
 
 Monitor::CpuTemperature::CpuTemperature(
-  const xxx::CpuTemperature& temp,
+  const std::vector<xxx::CpuSensors::Channel>& channels,
   QWidget *parent)
   : QWidget(parent) {
   auto* wrapper = new QVBoxLayout(this);
   auto* group_box = new QGroupBox();
   auto* layout = new QVBoxLayout();
-  for (const auto& entry : temp) {
+  for (const auto& channel : channels) {
+    if (channel.type != xxx::CpuSensors::Channel::Type::Temperature) continue;
     auto* box = new QHBoxLayout();
-    auto* name = new QLabel(std::move(QString::fromStdString(entry.label)));
-    v_.push_back(std::move(new QLabel(std::move(QString::number(entry.value)))));
+    auto* name = new QLabel(std::move(QString::fromStdString(channel.name)));
+    v_.push_back(std::move(new QLabel("0")));
     auto* degrees = new QLabel("°C   ");
     box->addWidget(name);
     box->addStretch(1);
@@ -90,52 +104,68 @@ Monitor::CpuTemperature::CpuTemperature(
 }
 
 
-void Monitor::CpuTemperature::refresh(const xxx::CpuTemperature& temp) {
+void Monitor::CpuTemperature::refresh(const std::vector<int>& temp) {
   auto itemp = temp.begin();
   auto iv = v_.begin();
   for(; itemp != temp.end() && iv != v_.end(); ++itemp, ++iv) {
-    (*iv)->setText(QString::number(itemp->value));
+    (*iv)->setText(QString::number(*itemp));
   }
 }
 
+QWidget* Monitor::CpuTemperature::channelWidget(size_t index) const {
+  return (index < v_.size()) ? v_[index] : nullptr;
+}
+
 /*
  * Monitor::CpuPower
  */
 
 Monitor::CpuPower::CpuPower(
-  const xxx::PowerCap::IntelRAPL& cpu_power,
+  const std::vector<xxx::CpuSensors::Channel>& channels,
+  bool energy,
   QWidget *parent)
   : QWidget(parent) {
   auto* wrapper = new QVBoxLayout(this);
   auto* group_box = new QGroupBox();
   auto* layout = new QVBoxLayout();
-  for (const auto& power_zone : cpu_power) {
-    Entry e;
+  reset_ = new QPushButton(tr("Reset energy"), this);
+  reset_->setToolTip(tr("Restart the energy of the power zones"));
+  /* each power zone is followed by its sub zones ('zone/sub zone') */
+  for (const auto& channel : channels) {
+    if (channel.type != xxx::CpuSensors::Channel::Type::Power) continue;
+    auto slash = channel.name.find('/');
     auto* box = new QHBoxLayout();
-    auto* name = new QLabel(std::move(QString::fromStdString(power_zone.name())));
     auto* value = new QLabel("0");
     auto* watt = new QLabel("Watt");
-    box->addWidget(name);
-    box->addStretch(1);
-    box->addWidget(value, 0, Qt::AlignRight);
-    box->addWidget(watt);
-    layout->addLayout(box);
-    e.value = value;
-    for (const auto& sub_zone : power_zone) {
-      auto* box = new QHBoxLayout();
-      auto* name = new QLabel(std::move(QString::fromStdString(sub_zone.name())));
-      auto* value = new QLabel("0");
-      auto* watt = new QLabel("Watt");
+    if (slash == std::string::npos || v_.empty()) {
+      auto* name = new QLabel(std::move(QString::fromStdString(channel.name)));
+      box->addWidget(name);
+      box->addStretch(1);
+      box->addWidget(value, 0, Qt::AlignRight);
+      box->addWidget(watt);
+      v_.push_back({ value, {} });
+    }
+    else {
+      auto* name = new QLabel(std::move(QString::fromStdString(channel.name.substr(slash + 1))));
       box->addSpacing(8);
       box->addWidget(name, 0, Qt::AlignRight);
       box->addStretch(1);
       box->addWidget(value, 0, Qt::AlignRight);
       box->addWidget(watt);
-      layout->addLayout(box);
-      e.sub_zones.push_back(value);
+      v_.back().sub_zones.push_back(value);
+    }
+    if (energy) {
+      auto* joule = new QLabel("0");
+      joule->setMinimumWidth(80);
+      joule->setAlignment(Qt::AlignRight);
+      box->addWidget(joule);
+      box->addWidget(new QLabel("J"));
+      energy_.push_back(joule);
     }
-    v_.push_back(std::move(e));
+    layout->addLayout(box);
   }
+  if (!energy_.empty()) layout->addWidget(reset_, 0, Qt::AlignRight);
+  else reset_->hide();
   group_box->setLayout(layout);
   group_box->setFlat(true);
   wrapper->addWidget(group_box);
@@ -143,50 +173,66 @@ Monitor::CpuPower::CpuPower(
 }
 
 
-void Monitor::CpuPower::refresh(const xxx::PowerCap::IntelRAPL& cpu_power) {
-  /* loop over the power zones */
+void Monitor::CpuPower::refresh(const std::vector<double>& cpu_power) {
+  /* loop over the power zones, each zone is followed by its sub zones */
   auto icpu = cpu_power.begin();
   auto iv = v_.begin();
-  for(; icpu != cpu_power.end() && iv != v_.end(); ++icpu, ++iv) {
+  for(; icpu != cpu_power.end() && iv != v_.end(); ++iv) {
     std::stringstream ss;
     ss << std::setw(7) << std::setprecision(3) << std::fixed << std::noshowpos
-       << icpu->average_power();
+       << *icpu++;
     (*iv).value->setText(QString::fromStdString(ss.str()));
     /* loop over the sub zones for this power zone */
-    auto icpusub = (*icpu).begin();
     auto ivsub = (*iv).sub_zones.begin();
-    for (; icpusub != (*icpu).end() && ivsub != (*iv).sub_zones.end();
-        ++icpusub, ++ivsub) {
+    for (; icpu != cpu_power.end() && ivsub != (*iv).sub_zones.end();
+        ++icpu, ++ivsub) {
       std::stringstream ss;
       ss << std::setw(7) << std::setprecision(3) << std::fixed
-         << std::noshowpos << icpusub->average_power();
+         << std::noshowpos << *icpu;
       (*ivsub)->setText(QString::fromStdString(ss.str()));
     }
   }
 }
 
+void Monitor::CpuPower::refreshEnergy(const std::vector<xxx::EnergyLedger::Zone>& zones) {
+  for (size_t i = 0; i < energy_.size() && i < zones.size(); ++i) {
+    energy_[i]->setText(QString::number(zones[i].reset, 'f', 1));
+    energy_[i]->setToolTip(QString("Since start: %1 J\nLifetime: %2 kWh")
+        .arg(zones[i].start, 0, 'f', 1)
+        .arg(zones[i].lifetime / 3.6e6, 0, 'f', 3));
+  }
+}
+
+QWidget* Monitor::CpuPower::channelWidget(size_t index) const {
+  for (const auto& entry : v_) {
+    if (index == 0) return entry.value;
+    --index;
+    if (index < entry.sub_zones.size()) return entry.sub_zones[index];
+    index -= entry.sub_zones.size();
+  }
+  return nullptr;
+}
+
 /*
  * Monitor::CpuFrequency
  */
 
 Monitor::CpuFrequency::CpuFrequency(
-  const xxx::CpuFrequency& cpu_frequency, QWidget* parent)
+  const std::vector<xxx::CpuSensors::Channel>& channels, QWidget* parent)
   : QWidget(parent) {
   auto* wrapper = new QVBoxLayout(this);
   auto* group_box = new QGroupBox();
   auto* layout = new QVBoxLayout();
-  size_t i = 0;
-  for (auto freq : cpu_frequency) {
-    std::stringstream ss;
-    ss << "cpu" << cpu_frequency.logical(i);
-    ++i;
+  using Type = xxx::CpuSensors::Channel::Type;
+  for (const auto& channel : channels) {
+    if (channel.type != Type::Frequency) continue;
     auto* box = new QHBoxLayout();
-    auto* cpu_label = new QLabel(std::move(QString::fromStdString(ss.str())));
+    auto* cpu_label = new QLabel(std::move(QString::fromStdString(channel.name)));
     vload_.push_back(std::move(new QLabel(std::move(QString::number(0)))));
     vload_.back()->setMinimumSize(40,0);
     vload_.back()->setAlignment(Qt::AlignRight);
     auto* load_label = new QLabel("%");
-    vfreq_.push_back(std::move(new QLabel(std::move(QString::number(freq)))));
+    vfreq_.push_back(std::move(new QLabel(std::move(QString::number(0)))));
     vfreq_.back()->setMinimumSize(40,0);
     vfreq_.back()->setAlignment(Qt::AlignRight);
     auto* freq_label = new QLabel("MHz");
@@ -194,6 +240,19 @@ Monitor::CpuFrequency::CpuFrequency(
     box->addStretch(1);
     box->addWidget(vload_.back());
     box->addWidget(load_label, 0);
+    /* the run-queue delay channel of the same cpu */
+    size_t delay = xxx::CpuSensors::find(channels, { Type::RunDelay, 0, channel.name, "" });
+    if (delay != SIZE_MAX) {
+      size_t index = channels[delay].index;
+      if (vdelay_.size() <= index) vdelay_.resize(index + 1, nullptr);
+      vdelay_[index] = new QLabel(QString::number(0));
+      vdelay_[index]->setMinimumSize(40,0);
+      vdelay_[index]->setAlignment(Qt::AlignRight);
+      auto* delay_label = new QLabel("% wait");
+      delay_label->setToolTip(tr("Time that tasks waited on the run queue of the cpu"));
+      box->addWidget(vdelay_[index]);
+      box->addWidget(delay_label, 0);
+    }
     box->addStretch(1);
     box->addWidget(vfreq_.back(), 0, Qt::AlignRight);
     box->addWidget(freq_label, 0);
@@ -206,7 +265,10 @@ Monitor::CpuFrequency::CpuFrequency(
 }
 
 
-void Monitor::CpuFrequency::refresh(const xxx::CpuFrequency& cpu_frequency, const xxx::CpuActivity& cpu_activity) {
+void Monitor::CpuFrequency::refresh(const std::vector<unsigned long>& cpu_frequency, const std::vector<xxx::CpuActivityEntry>& cpu_activity, const std::vector<double>& run_delay) {
+  for (size_t i = 0; i < vdelay_.size() && i < run_delay.size(); ++i)
+    if (vdelay_[i]) vdelay_[i]->setText(QString::number(run_delay[i], 'f', 1));
+  if (cpu_activity.empty()) return;
   auto iv = vfreq_.begin();
   auto il = vload_.begin();
   auto ifreq = cpu_frequency.begin();
@@ -220,46 +282,882 @@ void Monitor::CpuFrequency::refresh(const xxx::CpuFrequency& cpu_frequency, cons
   }
 }
 
+QWidget* Monitor::CpuFrequency::channelWidget(size_t index, bool load) const {
+  const auto& v = load ? vload_ : vfreq_;
+  return (index < v.size()) ? v[index] : nullptr;
+}
+
+QWidget* Monitor::CpuFrequency::delayWidget(size_t index) const {
+  return (index < vdelay_.size()) ? vdelay_[index] : nullptr;
+}
+
 /*
- * Monitor
+ * Monitor::CpuIdle
+ */
+
+Monitor::CpuIdle::CpuIdle(
+  const std::vector<xxx::CpuSensors::Channel>& channels, QWidget* parent)
+  : QWidget(parent) {
+  using Type = xxx::CpuSensors::Channel::Type;
+  auto* wrapper = new QVBoxLayout(this);
+  auto* group_box = new QGroupBox();
+  auto* grid = new QGridLayout();
+  /* a row for each cpu and a column for each state ('cpuN/STATE') */
+  std::vector<std::string> cpus, states;
+  auto position = [](std::vector<std::string>& v, const std::string& name) {
+    auto it = std::find(v.begin(), v.end(), name);
+    if (it != v.end()) return static_cast<int>(it - v.begin());
+    v.push_back(name);
+    return static_cast<int>(v.size() - 1);
+  };
+  auto value_label = [grid](int row, int column) {
+    auto* label = new QLabel("0.0");
+    label->setAlignment(Qt::AlignRight);
+    grid->addWidget(label, row + 1, column + 1);
+    return label;
+  };
+  for (const auto& channel : channels) {
+    if (channel.type != Type::Idle) continue;
+    auto slash = channel.name.find('/');
+    int row = position(cpus, channel.name.substr(0, slash));
+    int column = position(states, (slash == std::string::npos) ? std::string() : channel.name.substr(slash + 1));
+    if (residency_.size() <= channel.index) residency_.resize(channel.index + 1, nullptr);
+    residency_[channel.index] = value_label(row, column);
+  }
+  int above_column = static_cast<int>(states.size());
+  for (const auto& channel : channels) {
+    if (channel.type != Type::IdleAbove && channel.type != Type::IdleBelow) continue;
+    int row = position(cpus, channel.name);
+    auto& v = (channel.type == Type::IdleAbove) ? above_ : below_;
+    if (v.size() <= channel.index) v.resize(channel.index + 1, nullptr);
+    v[channel.index] = value_label(row, above_column + (channel.type == Type::IdleBelow));
+  }
+  /* the headers */
+  for (size_t i = 0; i < states.size(); ++i)
+    grid->addWidget(new QLabel(QString("%1 %").arg(QString::fromStdString(states[i]))), 0, static_cast<int>(i) + 1, Qt::AlignRight);
+  if (!above_.empty() || !below_.empty()) {
+    auto* above = new QLabel(tr("Above %"));
+    above->setToolTip(tr("Entries where the idle time was too short for the state (too deep)"));
+    grid->addWidget(above, 0, above_column + 1, Qt::AlignRight);
+    auto* below = new QLabel(tr("Below %"));
+    below->setToolTip(tr("Entries where a deeper state would have matched the idle time (too shallow)"));
+    grid->addWidget(below, 0, above_column + 2, Qt::AlignRight);
+  }
+  for (size_t i = 0; i < cpus.size(); ++i)
+    grid->addWidget(new QLabel(QString::fromStdString(cpus[i])), static_cast<int>(i) + 1, 0);
+  group_box->setLayout(grid);
+  group_box->setFlat(true);
+  wrapper->addWidget(group_box);
+  wrapper->setMargin(0);
+}
+
+void Monitor::CpuIdle::refresh(const std::vector<double>& idle, const std::vector<double>& above, const std::vector<double>& below) {
+  auto set = [](const std::vector<QLabel*>& labels, const std::vector<double>& values) {
+    for (size_t i = 0; i < labels.size() && i < values.size(); ++i)
+      if (labels[i]) labels[i]->setText(QString::number(values[i], 'f', 1));
+  };
+  set(residency_, idle);
+  set(above_, above);
+  set(below_, below);
+}
+
+QWidget* Monitor::CpuIdle::channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const {
+  using Type = xxx::CpuSensors::Channel::Type;
+  const auto& v = (type == Type::Idle) ? residency_ : ((type == Type::IdleAbove) ? above_ : below_);
+  return (index < v.size()) ? v[index] : nullptr;
+}
+
+/*
+ * Monitor::CpuThrottle
+ */
+
+Monitor::CpuThrottle::CpuThrottle(
+  const std::vector<xxx::CpuSensors::Channel>& channels, QWidget* parent)
+  : QWidget(parent) {
+  using Type = xxx::CpuSensors::Channel::Type;
+  auto* wrapper = new QVBoxLayout(this);
+  auto* group_box = new QGroupBox();
+  auto* grid = new QGridLayout();
+  /* a row for each name ('packageN', 'packageN/cores' or 'cpuN'),
+   * the packages first */
+  std::vector<std::string> rows;
+  for (int packages = 1; packages >= 0; --packages) {
+    for (const auto& channel : channels) {
+      if (channel.type != Type::Throttle
+          || (channel.name.compare(0, 3, "cpu") != 0) != static_cast<bool>(packages)) continue;
+      rows.push_back(channel.name);
+    }
+  }
+  if (!rows.empty()) {
+    grid->addWidget(new QLabel(tr("Throttled")), 0, 0);
+    grid->addWidget(new QLabel(tr("Events")), 0, 1, Qt::AlignRight);
+    grid->addWidget(new QLabel(tr("ms")), 0, 2, Qt::AlignRight);
+  }
+  for (size_t i = 0; i < rows.size(); ++i)
+    grid->addWidget(new QLabel(QString::fromStdString(rows[i])), static_cast<int>(i) + 1, 0);
+  for (const auto& channel : channels) {
+    if (channel.type != Type::Throttle && channel.type != Type::ThrottleTime) continue;
+    auto row = static_cast<int>(std::find(rows.begin(), rows.end(), channel.name) - rows.begin());
+    if (row == static_cast<int>(rows.size())) continue;
+    auto& v = (channel.type == Type::Throttle) ? events_ : time_;
+    if (v.size() <= channel.index) v.resize(channel.index + 1, nullptr);
+    v[channel.index] = new QLabel("0");
+    v[channel.index]->setAlignment(Qt::AlignRight);
+    grid->addWidget(v[channel.index], row + 1, (channel.type == Type::Throttle) ? 1 : 2);
+  }
+  group_box->setLayout(grid);
+  group_box->setFlat(true);
+  wrapper->addWidget(group_box);
+  wrapper->setMargin(0);
+}
+
+void Monitor::CpuThrottle::refresh(const std::vector<double>& throttle, const std::vector<double>& throttle_time) {
+  auto set = [](const std::vector<QLabel*>& labels, const std::vector<double>& values) {
+    for (size_t i = 0; i < labels.size() && i < values.size(); ++i)
+      if (labels[i]) labels[i]->setText(QString::number(values[i], 'f', 0));
+  };
+  set(events_, throttle);
+  set(time_, throttle_time);
+}
+
+QWidget* Monitor::CpuThrottle::channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const {
+  const auto& v = (type == xxx::CpuSensors::Channel::Type::Throttle) ? events_ : time_;
+  return (index < v.size()) ? v[index] : nullptr;
+}
+
+/*
+ * Monitor::CpuPerf
+ */
+
+Monitor::CpuPerf::CpuPerf(
+  const std::vector<xxx::CpuSensors::Channel>& channels, QWidget* parent)
+  : QWidget(parent) {
+  using Type = xxx::CpuSensors::Channel::Type;
+  auto* wrapper = new QVBoxLayout(this);
+  auto* group_box = new QGroupBox();
+  auto* grid = new QGridLayout();
+  /* a row for each logical cpu (the channels of each type have the same names) */
+  std::vector<std::string> rows;
+  for (const auto& channel : channels)
+    if (channel.type == Type::Ipc) rows.push_back(channel.name);
+  if (!rows.empty()) {
+    grid->addWidget(new QLabel(tr("Counters")), 0, 0);
+    auto* ipc = new QLabel(tr("IPC"));
+    ipc->setToolTip(tr("Instructions per cycle"));
+    grid->addWidget(ipc, 0, 1, Qt::AlignRight);
+    auto* llc = new QLabel(tr("LLC MPKI"));
+    llc->setToolTip(tr("Last level cache misses per 1000 instructions"));
+    grid->addWidget(llc, 0, 2, Qt::AlignRight);
+    auto* branch = new QLabel(tr("Branch MPKI"));
+    branch->setToolTip(tr("Branch mispredictions per 1000 instructions"));
+    grid->addWidget(branch, 0, 3, Qt::AlignRight);
+  }
+  for (size_t i = 0; i < rows.size(); ++i)
+    grid->addWidget(new QLabel(QString::fromStdString(rows[i])), static_cast<int>(i) + 1, 0);
+  for (const auto& channel : channels) {
+    if (channel.type != Type::Ipc && channel.type != Type::LlcMisses
+        && channel.type != Type::BranchMisses) continue;
+    auto row = static_cast<int>(std::find(rows.begin(), rows.end(), channel.name) - rows.begin());
+    if (row == static_cast<int>(rows.size())) continue;
+    auto& v = (channel.type == Type::Ipc) ? ipc_ : ((channel.type == Type::LlcMisses) ? llc_ : branch_);
+    if (v.size() <= channel.index) v.resize(channel.index + 1, nullptr);
+    v[channel.index] = new QLabel("0");
+    v[channel.index]->setAlignment(Qt::AlignRight);
+    int column = (channel.type == Type::Ipc) ? 1 : ((channel.type == Type::LlcMisses) ? 2 : 3);
+    grid->addWidget(v[channel.index], row + 1, column);
+  }
+  group_box->setLayout(grid);
+  group_box->setFlat(true);
+  wrapper->addWidget(group_box);
+  wrapper->setMargin(0);
+}
+
+void Monitor::CpuPerf::refresh(const std::vector<double>& ipc, const std::vector<double>& llc_mpki, const std::vector<double>& branch_mpki) {
+  auto set = [](const std::vector<QLabel*>& labels, const std::vector<double>& values) {
+    for (size_t i = 0; i < labels.size() && i < values.size(); ++i)
+      if (labels[i]) labels[i]->setText(QString::number(values[i], 'f', 2));
+  };
+  set(ipc_, ipc);
+  set(llc_, llc_mpki);
+  set(branch_, branch_mpki);
+}
+
+QWidget* Monitor::CpuPerf::channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const {
+  using Type = xxx::CpuSensors::Channel::Type;
+  const auto& v = (type == Type::Ipc) ? ipc_ : ((type == Type::LlcMisses) ? llc_ : branch_);
+  return (index < v.size()) ? v[index] : nullptr;
+}
+
+/*
+ * Monitor::CpuPressure
+ */
+
+Monitor::CpuPressure::CpuPressure(
+  const std::vector<xxx::CpuSensors::Channel>& channels, QWidget* parent)
+  : QWidget(parent) {
+  using Type = xxx::CpuSensors::Channel::Type;
+  auto* wrapper = new QVBoxLayout(this);
+  auto* group_box = new QGroupBox();
+  auto* grid = new QGridLayout();
+  /* a row for each resource, the pressure channels are named 'RESOURCE/some' and 'RESOURCE/full' */
+  auto resource = [](const xxx::CpuSensors::Channel& channel) {
+    return (channel.type == Type::Pressure) ? channel.name.substr(0, channel.name.rfind('/')) : channel.name;
+  };
+  std::vector<std::string> rows;
+  for (const auto& channel : channels)
+    if (channel.type == Type::Pressure && std::find(rows.begin(), rows.end(), resource(channel)) == rows.end())
+      rows.push_back(resource(channel));
+  if (!rows.empty()) {
+    grid->addWidget(new QLabel(tr("Pressure")), 0, 0);
+    auto* some = new QLabel(tr("Some %"));
+    some->setToolTip(tr("Time that some tasks stalled on the resource"));
+    grid->addWidget(some, 0, 1, Qt::AlignRight);
+    auto* full = new QLabel(tr("Full %"));
+    full->setToolTip(tr("Time that all non-idle tasks stalled on the resource"));
+    grid->addWidget(full, 0, 2, Qt::AlignRight);
+    auto* stalls = new QLabel(tr("Stalls"));
+    stalls->setToolTip(tr("Stall events (%1)").arg(xxx::PressureStall::DefaultTrigger));
+    grid->addWidget(stalls, 0, 3, Qt::AlignRight);
+  }
+  for (size_t i = 0; i < rows.size(); ++i)
+    grid->addWidget(new QLabel(QString::fromStdString(rows[i])), static_cast<int>(i) + 1, 0);
+  for (const auto& channel : channels) {
+    if (channel.type != Type::Pressure && channel.type != Type::Stall) continue;
+    auto row = static_cast<int>(std::find(rows.begin(), rows.end(), resource(channel)) - rows.begin());
+    if (row == static_cast<int>(rows.size())) continue;
+    auto& v = (channel.type == Type::Pressure) ? pressure_ : stalls_;
+    if (v.size() <= channel.index) v.resize(channel.index + 1, nullptr);
+    v[channel.index] = new QLabel("0");
+    v[channel.index]->setAlignment(Qt::AlignRight);
+    int column = (channel.type == Type::Stall) ? 3
+        : ((channel.name.compare(channel.name.size() - 5, 5, "/full") == 0) ? 2 : 1);
+    grid->addWidget(v[channel.index], row + 1, column);
+    if (channel.type == Type::Stall) {
+      if (resources_.size() <= channel.index) resources_.resize(channel.index + 1);
+      resources_[channel.index] = QString::fromStdString(channel.name);
+    }
+  }
+  if (!stalls_.empty()) {
+    last_ = new QLabel(tr("Last stall: none"));
+    grid->addWidget(last_, static_cast<int>(rows.size()) + 1, 0, 1, 4);
+  }
+  group_box->setLayout(grid);
+  group_box->setFlat(true);
+  wrapper->addWidget(group_box);
+  wrapper->setMargin(0);
+}
+
+void Monitor::CpuPressure::refresh(const std::vector<double>& pressure, const std::vector<double>& stalls,
+    std::chrono::system_clock::time_point time) {
+  for (size_t i = 0; i < pressure_.size() && i < pressure.size(); ++i)
+    if (pressure_[i]) pressure_[i]->setText(QString::number(pressure[i], 'f', 1));
+  QString stalled;
+  for (size_t i = 0; i < stalls_.size() && i < stalls.size(); ++i) {
+    if (!stalls_[i]) continue;
+    stalls_[i]->setText(QString::number(stalls[i], 'f', 0));
+    if (stalls[i] > 0.) stalled += (stalled.isEmpty() ? "" : ", ") + resources_[i];
+  }
+  if (last_ && !stalled.isEmpty()) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    last_->setText(tr("Last stall: %1 (%2)").arg(QDateTime::fromMSecsSinceEpoch(ms).toString("hh:mm:ss")).arg(stalled));
+  }
+}
+
+QWidget* Monitor::CpuPressure::channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const {
+  const auto& v = (type == xxx::CpuSensors::Channel::Type::Pressure) ? pressure_ : stalls_;
+  return (index < v.size()) ? v[index] : nullptr;
+}
+
+/*
+ * Monitor::CpuInterrupts
+ */
+
+Monitor::CpuInterrupts::CpuInterrupts(QWidget* parent)
+  : QWidget(parent) {
+  auto* wrapper = new QVBoxLayout(this);
+  auto* group_box = new QGroupBox();
+  grid_ = new QGridLayout();
+  sources_.fill(nullptr);
+  group_box->setLayout(grid_);
+  group_box->setFlat(true);
+  wrapper->addWidget(group_box);
+  wrapper->setMargin(0);
+}
+
+void Monitor::CpuInterrupts::arrange(const xxx::InterruptMatrix& interrupts) {
+  while (auto* item = grid_->takeAt(0)) {
+    delete item->widget();
+    delete item;
+  }
+  sources_.fill(nullptr);
+  cpus_ = interrupts.cpus();
+  cells_.clear();
+  if (cpus_.empty()) return;
+  auto* title = new QLabel(tr("Interrupts/s"));
+  title->setToolTip(tr("The busiest interrupts and softirqs of the cpus during the last second"));
+  grid_->addWidget(title, 0, 0);
+  for (size_t i = 0; i < Columns; ++i) {
+    sources_[i] = new QLabel();
+    grid_->addWidget(sources_[i], 0, static_cast<int>(i) + 1, Qt::AlignRight);
+  }
+  cells_.resize(cpus_.size());
+  for (size_t c = 0; c < cells_.size(); ++c) {
+    int row = static_cast<int>(c) + 1;
+    grid_->addWidget(new QLabel(QString("cpu%1").arg(cpus_[c])), row, 0);
+    for (size_t i = 0; i < Columns; ++i) {
+      cells_[c][i] = new QLabel();
+      cells_[c][i]->setAlignment(Qt::AlignRight);
+      grid_->addWidget(cells_[c][i], row, static_cast<int>(i) + 1);
+    }
+  }
+}
+
+void Monitor::CpuInterrupts::refresh(const xxx::InterruptMatrix& interrupts) {
+  if (interrupts.cpus() != cpus_) arrange(interrupts);
+  const auto& sources = interrupts.sources();
+  const size_t rows = std::min(cells_.size(), interrupts.cpus().size());
+  /* the busiest sources of each cpu, ordered by their total */
+  hottest_.clear();
+  for (size_t c = 0; c < rows; ++c) {
+    const size_t* top = interrupts.top(c);
+    for (size_t j = 0; j < interrupts.top() && top[j] != SIZE_MAX; ++j)
+      if (std::find(hottest_.begin(), hottest_.end(), top[j]) == hottest_.end()) hottest_.push_back(top[j]);
+  }
+  std::stable_sort(hottest_.begin(), hottest_.end(),
+      [&sources](size_t a, size_t b) { return sources[a].total > sources[b].total; });
+  if (hottest_.size() > Columns) hottest_.resize(Columns);
+  double seconds = (interrupts.interval() > 0.) ? interrupts.interval() : 1.;
+  double busiest = 0.;
+  for (size_t c = 0; c < rows; ++c)
+    for (size_t s : hottest_) busiest = std::max(busiest, interrupts.delta(s, c) / seconds);
+  for (size_t i = 0; i < Columns; ++i) {
+    if (!sources_[i]) continue;
+    if (i < hottest_.size()) {
+      const auto& source = sources[hottest_[i]];
+      sources_[i]->setText(QString::fromStdString(source.name));
+      sources_[i]->setToolTip(source.softirq ? tr("%1 (softirq)").arg(QString::fromStdString(source.name))
+          : QString::fromStdString(source.name + ": " + source.description));
+    }
+    else {
+      sources_[i]->clear();
+      sources_[i]->setToolTip(QString());
+    }
+    for (size_t c = 0; c < rows; ++c) {
+      QLabel* cell = cells_[c][i];
+      if (i >= hottest_.size()) {
+        cell->clear();
+        cell->setStyleSheet(QString());
+        continue;
+      }
+      double rate = interrupts.delta(hottest_[i], c) / seconds;
+      cell->setText((rate < 1000.) ? QString::number(rate, 'f', 0) : QString("%1k").arg(rate / 1000., 0, 'f', 1));
+      int alpha = (busiest > 0.) ? static_cast<int>(std::log1p(rate) / std::log1p(busiest) * 200.) : 0;
+      cell->setStyleSheet(QString("background-color: rgba(255, 64, 0, %1)").arg(alpha));
+    }
+  }
+}
+
+/*
+ * Monitor::CpuPackages
+ */
+
+Monitor::CpuPackages::CpuPackages(const xxx::CpuTopology* topology, QWidget* parent)
+  : QWidget(parent) {
+  auto* wrapper = new QVBoxLayout(this);
+  auto* group_box = new QGroupBox();
+  auto* grid = new QGridLayout();
+  auto value_label = [grid](int row, int column) {
+    auto* label = new QLabel("0");
+    label->setAlignment(Qt::AlignRight);
+    grid->addWidget(label, row, column);
+    return label;
+  };
+  if (topology && !topology->packages().empty()) {
+    grid->addWidget(new QLabel(tr("Topology")), 0, 0);
+    grid->addWidget(new QLabel(tr("Load %")), 0, 1, Qt::AlignRight);
+    grid->addWidget(new QLabel("MHz"), 0, 2, Qt::AlignRight);
+    grid->addWidget(new QLabel("°C"), 0, 3, Qt::AlignRight);
+    grid->addWidget(new QLabel("W"), 0, 4, Qt::AlignRight);
+    auto* per_cycle = new QLabel("nJ/cycle");
+    per_cycle->setToolTip(tr("Energy per busy cycle of the logical cpus"));
+    grid->addWidget(per_cycle, 0, 5, Qt::AlignRight);
+    packages_.resize(topology->packages().size(), Row {});
+    cores_.resize(topology->cores().size(), Row {});
+    int row = 1;
+    for (size_t p = 0; p < topology->packages().size(); ++p) {
+      const auto& package = topology->packages()[p];
+      grid->addWidget(new QLabel(QString::fromStdString(package.name)), row, 0);
+      packages_[p] = { value_label(row, 1), value_label(row, 2), value_label(row, 3), value_label(row, 4), value_label(row, 5) };
+      ++row;
+      for (size_t c : package.cores) {
+        const auto& core = topology->cores()[c];
+        /* (the name of the core without the package) */
+        auto* name = new QLabel(QString::fromStdString(core.name.substr(package.name.size() + 1)));
+        name->setIndent(12);
+        grid->addWidget(name, row, 0);
+        cores_[c] = { value_label(row, 1), value_label(row, 2), value_label(row, 3), nullptr, nullptr };
+        ++row;
+      }
+    }
+  }
+  group_box->setLayout(grid);
+  group_box->setFlat(true);
+  wrapper->addWidget(group_box);
+  wrapper->setMargin(0);
+}
+
+void Monitor::CpuPackages::refresh(const std::vector<xxx::CpuTopologyRollup>& packages, const std::vector<xxx::CpuTopologyRollup>& cores) {
+  auto set = [](const std::vector<Row>& rows, const std::vector<xxx::CpuTopologyRollup>& values) {
+    for (size_t i = 0; i < rows.size() && i < values.size(); ++i) {
+      const Row& row = rows[i];
+      if (!row.load) continue;
+      /* (the cores and packages without online cpus are blank) */
+      bool online = values[i].cpus > 0;
+      row.load->setText(online ? QString::number(values[i].load, 'f', 1) : QString());
+      row.frequency->setText(online ? QString::number(values[i].frequency, 'f', 0) : QString());
+      row.temperature->setText(online ? QString::number(values[i].temperature, 'f', 0) : QString());
+      if (row.power) row.power->setText(online ? QString::number(values[i].power, 'f', 2) : QString());
+      if (row.energy_per_cycle) {
+        /* (blank without busy cycles or power zones) */
+        bool valid = online && values[i].energy_per_cycle > 0.;
+        row.energy_per_cycle->setText(valid ? QString::number(values[i].energy_per_cycle, 'f', 2) : QString());
+      }
+    }
+  };
+  set(packages_, packages);
+  set(cores_, cores);
+}
+
+/*
+ * Monitor::CpuPercentiles
  */
 
-Monitor::Monitor(QWidget* parent)
+Monitor::CpuPercentiles::CpuPercentiles(const std::vector<xxx::CpuSensors::Channel>& channels, const xxx::CpuTopology* topology, QWidget* parent)
   : QWidget(parent) {
-  /* update the sensors to ensure valid values */
-  sensors_.update();
+  using Type = xxx::CpuSensors::Channel::Type;
+  auto* wrapper = new QVBoxLayout(this);
+  auto* group_box = new QGroupBox();
+  auto* grid = new QGridLayout();
+  reset_ = new QPushButton(tr("Reset"), this);
+  reset_->setToolTip(tr("Restart the percentiles"));
+  auto add_row = [this, grid](const QString& name, const xxx::CpuSensors::Channel& channel, size_t package) {
+    Type type = channel.type;
+    int row = static_cast<int>(rows_.size()) + 1;
+    grid->addWidget(new QLabel(name), row, 0);
+    Row r { channel, package, {} };
+    for (int column = 0; column < 4; ++column) {
+      r.values[column] = new QLabel();
+      r.values[column]->setAlignment(Qt::AlignRight);
+      grid->addWidget(r.values[column], row, column + 1);
+    }
+    grid->addWidget(new QLabel(QString::fromUtf8(xxx::CpuSensors::Unit(type))), row, 5);
+    rows_.push_back(r);
+  };
+  if (topology && !topology->packages().empty()) {
+    grid->addWidget(new QLabel(tr("Percentiles")), 0, 0);
+    grid->addWidget(new QLabel("p50"), 0, 1, Qt::AlignRight);
+    grid->addWidget(new QLabel("p95"), 0, 2, Qt::AlignRight);
+    grid->addWidget(new QLabel("p99"), 0, 3, Qt::AlignRight);
+    grid->addWidget(new QLabel(tr("Max")), 0, 4, Qt::AlignRight);
+    grid->addWidget(reset_, 0, 5);
+    for (size_t p = 0; p < topology->packages().size(); ++p) {
+      auto name = QString::fromStdString(topology->packages()[p].name);
+      add_row(tr("%1 load").arg(name), { Type::Load, 0, std::string(), nullptr }, p);
+      add_row(tr("%1 frequency").arg(name), { Type::Frequency, 0, std::string(), nullptr }, p);
+      add_row(tr("%1 temperature").arg(name), { Type::Temperature, 0, std::string(), nullptr }, p);
+    }
+    for (const auto& channel : channels)
+      if (channel.type == Type::Power) add_row(QString::fromStdString(channel.name), channel, SIZE_MAX);
+  }
+  else reset_->hide();
+  group_box->setLayout(grid);
+  group_box->setFlat(true);
+  wrapper->addWidget(group_box);
+  wrapper->setMargin(0);
+}
+
+void Monitor::CpuPercentiles::refresh(const xxx::SensorSketches& sketches) {
+  static const double quantiles[] = { 0.5, 0.95, 0.99 };
+  for (const auto& row : rows_) {
+    size_t n;
+    if (row.package == SIZE_MAX) n = sketches.copy(row.channel, sketch_) ? 1 : 0;
+    else {
+      sketch_.reset();
+      n = sketches.merge(row.channel.type, row.package, sketch_);
+    }
+    /* (blank when there are no channels or no samples) */
+    bool valid = n > 0 && sketch_.count() > 0;
+    double v[4];
+    sketch_.quantiles(quantiles, v, 3);
+    v[3] = sketch_.max();
+    int precision = (row.channel.type == xxx::CpuSensors::Channel::Type::Power) ? 2 : 0;
+    for (size_t column = 0; column < 4; ++column)
+      row.values[column]->setText(valid ? QString::number(v[column], 'f', precision) : QString());
+  }
+}
+
+/*
+ * Monitor
+ */
+
+Monitor::Monitor(int sample_interval_ms, int sample_interval_max_ms, int refresh_interval_ms, QWidget* parent)
+  : QWidget(parent), history_(sensors_.channels()), sketches_(sensors_.channels()), ledger_(ENERGY_FILE) {
+  /* The sensors have been read once by their constructors, the first
+   * sample with valid activity values is taken by the sampler thread. */
+  channels_ = sensors_.layout();
+  topology_ = sensors_.topology();
+  cpu_count_ = cpuCount(*channels_);
+  /* (counted by the sampler thread) */
+  sensors_.count_interrupts(true);
   /* create the layouts/widgets */
-  auto* layout = new QVBoxLayout(this);
+  layout_ = new QVBoxLayout(this);
+  auto* tools = new QHBoxLayout();
+  record_ = new QPushButton(tr("&Record"));
+  record_->setCheckable(true);
+  record_->setToolTip(tr("Record the sensors to a file"));
+  auto* open = new QPushButton(tr("&Open..."));
+  open->setToolTip(tr("Replay a recording"));
+  live_ = new QPushButton(tr("&Live"));
+  live_->setToolTip(tr("Stop the replay and display the sensors"));
+  scrub_ = new QSlider(Qt::Horizontal);
+  scrub_time_ = new QLabel();
+  rate_ = new QLabel();
+  rate_->setToolTip(tr("The current sampling rate of the sensors"));
+  scroll_area_ = new QScrollArea();
+  scroll_area_->setWidgetResizable(true);
+  /* assemble the layouts/widgets */
+  tools->addWidget(record_);
+  tools->addWidget(open);
+  tools->addWidget(live_);
+  tools->addWidget(scrub_, 1);
+  tools->addWidget(scrub_time_);
+  tools->addStretch(1);
+  tools->addWidget(rate_);
+  layout_->addLayout(tools);
+  layout_->addWidget(scroll_area_, 1);
+  build(*channels_, topology_.get(), true);
+  live_->hide();
+  scrub_->hide();
+  scrub_time_->hide();
+  connect(record_, SIGNAL(toggled(bool)), this, SLOT(recordToggled(bool)));
+  connect(open, SIGNAL(clicked()), this, SLOT(openRecording()));
+  connect(live_, SIGNAL(clicked()), this, SLOT(showLive()));
+  connect(scrub_, SIGNAL(valueChanged(int)), this, SLOT(scrubTo(int)));
+  /* record every sample (on the sampler thread) */
+  sensors_.listen([this](const xxx::CpuSensors::Snapshot& snapshot) {
+    history_.append(snapshot);
+    sketches_.append(snapshot);
+    std::lock_guard<std::mutex> lock(recorder_mutex_);
+    if (recorder_) recorder_->append(snapshot);
+  });
+  /* setup a timer slot that refreshes the widgets */
+  timer_ = new QTimer(this);
+  connect(timer_, SIGNAL(timeout()), this, SLOT(timerCallback()));
+  /* start sampling the sensors (on their own thread) and start the timer */
+  setIntervals(sample_interval_ms, sample_interval_max_ms, refresh_interval_ms);
+}
+
+Monitor::~Monitor() {
+  /* stop the sampler before history_, sketches_ and recorder_ are destroyed */
+  sensors_.stop();
+  if (!ledger_.save()) DBGMSG("Could not write" << ledger_.path().c_str() << ":" << std::strerror(errno));
+}
+
+void Monitor::build(const std::vector<xxx::CpuSensors::Channel>& channels, const xxx::CpuTopology* topology, bool live) {
+  /* (the previous widget of the scroll area is deleted by setWidget()) */
+  delete cpu_activity_;
   auto* widget = new QFrame();
-  auto* scroll_area = new QScrollArea();
   auto* box = new QVBoxLayout();
   cpu_activity_ = new CpuActivity();
-  cpu_power_ = new CpuPower(sensors_.cpu_power());
-  cpu_temp_ = new CpuTemperature(sensors_.cpu_temperature());
-  cpu_frequency_ = new CpuFrequency(sensors_.cpu_frequency());
-  /* assemble the layouts/widgets */
+  cpu_power_ = new CpuPower(channels, live);
+  connect(cpu_power_->resetButton(), SIGNAL(clicked()), this, SLOT(resetEnergy()));
+  cpu_temp_ = new CpuTemperature(channels);
+  cpu_frequency_ = new CpuFrequency(channels);
+  cpu_idle_ = new CpuIdle(channels);
+  cpu_throttle_ = new CpuThrottle(channels);
+  cpu_perf_ = new CpuPerf(channels);
+  cpu_pressure_ = new CpuPressure(channels);
+  /* (the interrupts are not recorded) */
+  cpu_interrupts_ = new CpuInterrupts();
+  if (live && interrupts_) cpu_interrupts_->refresh(*interrupts_);
+  cpu_packages_ = new CpuPackages(topology);
+  box->addWidget(cpu_packages_);
+  /* (the percentiles of a recording are those of all its frames) */
+  cpu_percentiles_ = new CpuPercentiles(channels, topology);
+  if (live) connect(cpu_percentiles_->resetButton(), SIGNAL(clicked()), this, SLOT(resetPercentiles()));
+  else cpu_percentiles_->resetButton()->hide();
+  box->addWidget(cpu_percentiles_);
   box->addWidget(cpu_power_);
   box->addWidget(cpu_temp_);
   box->addWidget(cpu_frequency_);
+  box->addWidget(cpu_idle_);
+  box->addWidget(cpu_throttle_);
+  box->addWidget(cpu_perf_);
+  box->addWidget(cpu_pressure_);
+  box->addWidget(cpu_interrupts_);
   box->addStretch(1);
   widget->setLayout(box);
-  scroll_area->setWidget(widget);
-  scroll_area->setWidgetResizable(true);
-  layout->addWidget(cpu_activity_);
-  layout->addWidget(scroll_area, 1);
-  /* setup a timer slot that is called every 500ms */
-  QTimer *timer = new QTimer(this);
-  connect(timer, SIGNAL(timeout()), this, SLOT(timerCallback()));
-  timer->start(500);
+  scroll_area_->setWidget(widget);
+  layout_->insertWidget(1, cpu_activity_);
+  /* find the widget that displays each channel of the history
+   * (the tooltips only show the history of the sensors) */
+  history_widgets_.clear();
+  if (!live) return;
+  using Type = xxx::CpuSensors::Channel::Type;
+  for (const auto& channel : channels) {
+    QWidget* w = nullptr;
+    switch (channel.type) {
+      case Type::Load:
+        w = (channel.index == 0) ? cpu_activity_->channelWidget()
+            : cpu_frequency_->channelWidget(channel.index - 1, true);
+        break;
+      case Type::Frequency:
+        w = cpu_frequency_->channelWidget(channel.index, false);
+        break;
+      case Type::Temperature:
+        w = cpu_temp_->channelWidget(channel.index);
+        break;
+      case Type::Power:
+        w = cpu_power_->channelWidget(channel.index);
+        break;
+      case Type::Idle:
+      case Type::IdleAbove:
+      case Type::IdleBelow:
+        w = cpu_idle_->channelWidget(channel.type, channel.index);
+        break;
+      case Type::Throttle:
+      case Type::ThrottleTime:
+        w = cpu_throttle_->channelWidget(channel.type, channel.index);
+        break;
+      case Type::Ipc:
+      case Type::LlcMisses:
+      case Type::BranchMisses:
+        w = cpu_perf_->channelWidget(channel.type, channel.index);
+        break;
+      case Type::Pressure:
+      case Type::Stall:
+        w = cpu_pressure_->channelWidget(channel.type, channel.index);
+        break;
+      case Type::RunDelay:
+        w = cpu_frequency_->delayWidget(channel.index);
+        break;
+      case Type::RunTime:
+      case Type::Timeslices:
+        break;
+    }
+    history_widgets_.push_back(w);
+  }
+  history_time_ = std::chrono::steady_clock::time_point();
+}
+
+void Monitor::setIntervals(int sample_interval_ms, int sample_interval_max_ms, int refresh_interval_ms) {
+  sensors_.start(
+      std::chrono::milliseconds(sample_interval_ms),
+      std::chrono::milliseconds(sample_interval_max_ms));
+  timer_->start(refresh_interval_ms);
+}
+
+void Monitor::display(const xxx::CpuSensors::Snapshot& snapshot, std::chrono::system_clock::time_point time) {
+  cpu_activity_->refresh(snapshot.activity);
+  cpu_temp_->refresh(snapshot.temperature);
+  cpu_power_->refresh(snapshot.power);
+  cpu_frequency_->refresh(snapshot.frequency, snapshot.activity, snapshot.run_delay);
+  cpu_idle_->refresh(snapshot.idle, snapshot.idle_above, snapshot.idle_below);
+  cpu_throttle_->refresh(snapshot.throttle, snapshot.throttle_time);
+  cpu_perf_->refresh(snapshot.ipc, snapshot.llc_mpki, snapshot.branch_mpki);
+  cpu_pressure_->refresh(snapshot.pressure, snapshot.stalls, time);
+  cpu_packages_->refresh(snapshot.packages, snapshot.cores);
 }
 
 void Monitor::timerCallback() {
-  /* update all sensors and widgets */
-  sensors_.update();
-  cpu_activity_->refresh(sensors_.cpu_activity());
-  cpu_temp_->refresh(sensors_.cpu_temperature());
-  cpu_power_->refresh(sensors_.cpu_power());
-  cpu_frequency_->refresh(sensors_.cpu_frequency(), sensors_.cpu_activity());
+  /* update all widgets using the latest snapshot of the sensors,
+   * (nothing to do if no new snapshot was published) */
+  const auto& snapshot = sensors_.snapshot();
+  if (snapshot.sequence == sequence_) return;
+  sequence_ = snapshot.sequence;
+  if (snapshot.layout && snapshot.layout != channels_) relayout(snapshot.layout, snapshot.topology);
+  if (snapshot.interval.count() > 0) {
+    rate_->setText(tr("%1 ms (%2 Hz)")
+        .arg(snapshot.interval.count())
+        .arg(1000. / snapshot.interval.count(), 0, 'f', 1));
+  }
+  /* the energy is accounted while a recording is replayed,
+   * the lifetime energy is saved once per minute */
+  ledger_.update(snapshot);
+  if (snapshot.time - ledger_time_ >= std::chrono::minutes(1)) {
+    if (ledger_time_ != std::chrono::steady_clock::time_point() && !ledger_.save())
+      DBGMSG("Could not write" << ledger_.path().c_str() << ":" << std::strerror(errno));
+    ledger_time_ = snapshot.time;
+  }
+  if (recording_) return;
+  cpu_power_->refreshEnergy(ledger_.zones());
+  /* (the wall clock time the snapshot was sampled) */
+  display(snapshot, std::chrono::system_clock::now()
+      - std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::steady_clock::now() - snapshot.time));
+  /* the tooltips only change once per second (Second tier) */
+  if (snapshot.time - history_time_ >= std::chrono::seconds(1)) {
+    history_time_ = snapshot.time;
+    cpu_percentiles_->refresh(sketches_);
+    refreshHistory();
+  }
+  /* (a new matrix once per second) */
+  if (snapshot.interrupts && snapshot.interrupts != interrupts_) {
+    interrupts_ = snapshot.interrupts;
+    cpu_interrupts_->refresh(*interrupts_);
+  }
+}
+
+size_t Monitor::cpuCount(const std::vector<xxx::CpuSensors::Channel>& channels) {
+  /* the load channels, except the aggregate */
+  size_t count = 0;
+  for (const auto& channel : channels)
+    if (channel.type == xxx::CpuSensors::Channel::Type::Load && channel.index > 0) ++count;
+  return count;
+}
+
+void Monitor::relayout(const std::shared_ptr<const std::vector<xxx::CpuSensors::Channel>>& channels,
+    const std::shared_ptr<const xxx::CpuTopology>& topology) {
+  channels_ = channels;
+  topology_ = topology;
+  cpu_count_ = cpuCount(*channels_);
+  DBGMSG("Monitor::relayout(): Cpus changed, now" << cpu_count_ << "online")
+  if (!recording_) build(*channels_, topology_.get(), true);
+  emit cpusChanged();
+}
+
+void Monitor::recordToggled(bool checked) {
+  std::unique_ptr<xxx::SensorRecorder> recorder;
+  if (checked) {
+    auto path = QFileDialog::getSaveFileName(this, tr("Record sensors"),
+        "core-adjust.carec", tr("Core Adjust recordings (*.carec);;All files (*)"));
+    if (path.isEmpty()) {
+      record_->setChecked(false);
+      return;
+    }
+    try {
+      recorder = std::make_unique<xxx::SensorRecorder>(path.toStdString(), *channels_, *topology_);
+    }
+    catch (const std::runtime_error& e) {
+      QMessageBox::warning(this, "Core Adjust", e.what());
+      record_->setChecked(false);
+      return;
+    }
+    DBGMSG("Monitor::recordToggled(): Recording to" << path)
+  }
+  /* swap the recorder, the previous one (if any) is flushed and closed
+   * when it goes out of scope (without holding the lock) */
+  std::lock_guard<std::mutex> lock(recorder_mutex_);
+  recorder_.swap(recorder);
+}
+
+void Monitor::openRecording() {
+  auto path = QFileDialog::getOpenFileName(this, tr("Open recording"),
+      QString(), tr("Core Adjust recordings (*.carec);;All files (*)"));
+  if (path.isEmpty()) return;
+  std::unique_ptr<xxx::SensorRecording> recording;
+  try {
+    recording = std::make_unique<xxx::SensorRecording>(path.toStdString());
+  }
+  catch (const std::runtime_error& e) {
+    QMessageBox::warning(this, "Core Adjust", e.what());
+    return;
+  }
+  if (recording->size() == 0) {
+    QMessageBox::warning(this, "Core Adjust", tr("The recording is empty."));
+    return;
+  }
+  recording_ = std::move(recording);
+  replay_ = xxx::CpuSensors::Snapshot();
+  build(recording_->channels(), recording_->topology().get(), false);
+  replay_sketches_ = std::make_unique<xxx::SensorSketches>(recording_->channels());
+  for (size_t frame = 0; frame < recording_->size(); ++frame)
+    if (recording_->read(frame, replay_)) replay_sketches_->append(replay_);
+  cpu_percentiles_->refresh(*replay_sketches_);
+  live_->show();
+  scrub_->show();
+  scrub_time_->show();
+  scrub_->blockSignals(true);
+  scrub_->setRange(0, static_cast<int>(recording_->size() - 1));
+  scrub_->setValue(0);
+  scrub_->blockSignals(false);
+  scrubTo(0);
+}
+
+void Monitor::showLive() {
+  recording_.reset();
+  replay_sketches_.reset();
+  build(*channels_, topology_.get(), true);
+  live_->hide();
+  scrub_->hide();
+  scrub_time_->hide();
+  /* display the latest snapshot on the next timer event */
+  sequence_ = 0;
+}
+
+void Monitor::scrubTo(int frame) {
+  if (!recording_ || frame < 0) return;
+  if (!recording_->read(static_cast<size_t>(frame), replay_)) return;
+  auto time = recording_->start() + recording_->time(static_cast<size_t>(frame));
+  display(replay_, time);
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+  scrub_time_->setText(QString("%1 (%2/%3)")
+      .arg(QDateTime::fromMSecsSinceEpoch(ms).toString("yyyy-MM-dd hh:mm:ss.zzz"))
+      .arg(frame + 1)
+      .arg(recording_->size()));
+}
+
+void Monitor::resetPercentiles() {
+  sketches_.reset();
+  cpu_percentiles_->refresh(sketches_);
+  refreshHistory();
+}
+
+void Monitor::resetEnergy() {
+  ledger_.reset();
+  cpu_power_->refreshEnergy(ledger_.zones());
+}
+
+void Monitor::refreshHistory() {
+  using Tier = xxx::SensorHistory::Tier;
+  static const double quantiles[] = { 0.5, 0.95, 0.99 };
+  /* (by time, the interval between the samples may be longer than a second) */
+  auto now = std::chrono::steady_clock::now();
+  const xxx::SensorHistory::Period periods[] = {
+    { Tier::Second, now - std::chrono::minutes(1) },
+    { Tier::Minute, now - std::chrono::hours(1) }
+  };
+  /* the summaries of all channels at once, the sampler waits while the history is read
+   * (nothing to show until the history has appended a snapshot with the layout of channels_) */
+  if (!history_.summary(channels_, periods, 2, summaries_)) return;
+  if (!sketches_.quantiles(channels_, quantiles, 3, percentiles_)) percentiles_.assign(3 * channels_->size(), 0.);
+  const auto& channels = *channels_;
+  for (size_t i = 0; i < channels.size(); ++i) {
+    if (i >= history_widgets_.size() || history_widgets_[i] == nullptr) continue;
+    using Type = xxx::CpuSensors::Channel::Type;
+    Type type = channels[i].type;
+    int precision = (type == Type::Power) ? 3
+        : ((type == Type::Ipc || type == Type::LlcMisses || type == Type::BranchMisses) ? 2 : 1);
+    auto text = [&](const char* period, const xxx::SensorHistory::Point& p) {
+      return QString("%1: min %2, mean %3, max %4 %5")
+          .arg(period)
+          .arg(p.min, 0, 'f', precision)
+          .arg(p.mean, 0, 'f', precision)
+          .arg(p.max, 0, 'f', precision)
+          .arg(QString::fromUtf8(channels[i].unit));
+    };
+    const auto& minute = summaries_[2 * i];
+    const auto& hour = summaries_[2 * i + 1];
+    const double* p = &percentiles_[3 * i];
+    history_widgets_[i]->setToolTip(
+        QString::fromStdString(channels[i].name) + "\n"
+        + text("Last minute", minute) + "\n"
+        + text("Last hour", hour) + "\n"
+        + QString("Since start: p50 %1, p95 %2, p99 %3 %4")
+            .arg(p[0], 0, 'f', precision)
+            .arg(p[1], 0, 'f', precision)
+            .arg(p[2], 0, 'f', precision)
+            .arg(QString::fromUtf8(channels[i].unit)));
+  }
 }
 
 /*
@@ -272,22 +1170,60 @@ MonitorTab::MonitorTab(QWidget* parent)
 }
 
 void MonitorTab::timed(bool is_active_tab) {
+  /* (the tasks are only ranked while they are displayed) */
+  if (monitor_) monitor_->sensors_.rank_tasks(is_active_tab);
   /* Set a new value for each gauge. */
   if (monitor_ && is_active_tab) {
+    const auto& snapshot = monitor_->sensors_.snapshot();
+    const auto& cpu_activity = snapshot.activity;
+    if (cpu_activity.empty()) return;
     auto ip = previous_values_.begin();
-    auto it = monitor_->sensors_.cpu_activity().begin() + 1;
+    auto it = cpu_activity.begin() + 1;
     auto ig = gauges_.begin();
-    for (;it != monitor_->sensors_.cpu_activity().end() &&
+    for (;it != cpu_activity.end() &&
         ig != gauges_.end(); ++ip, ++it, ++ig) {
       auto delta = (it->total > *ip) ? (it->total - *ip) : (*ip - it->total);
       //delta = delta + delta + delta;
       (*ig)->setValueAnimated(it->total, 150 + delta);
       *ip = it->total;
     }
+    /* (a new ranking once per second) */
+    if (snapshot.tasks && snapshot.tasks != ranking_) {
+      ranking_ = snapshot.tasks;
+      refreshTasks();
+    }
+  }
+}
+
+void MonitorTab::refreshTasks() {
+  static const std::vector<xxx::ProcessActivityTop> none;
+  if (!ranking_) return;
+  for (size_t i = 0; i < tasks_.size() && i < logical_.size(); ++i) {
+    QString text, tooltip;
+    const auto& top = (logical_[i] < ranking_->size()) ? (*ranking_)[logical_[i]] : none;
+    for (const auto& task : top) {
+      if (!text.isEmpty()) {
+        text += "\n";
+        tooltip += "\n";
+      }
+      auto comm = QString::fromStdString(task.comm);
+      text += QString("%1 %2%").arg(comm).arg(task.load, 0, 'f', 0);
+      tooltip += tr("%1 (pid %2, tid %3): %4% on cpu%5")
+          .arg(comm).arg(task.pid).arg(task.tid).arg(task.load, 0, 'f', 1).arg(task.processor);
+    }
+    tasks_[i]->setText(text);
+    tasks_[i]->setToolTip(tooltip);
   }
 }
 
 void MonitorTab::setMonitor(Monitor* m) {
+  if (monitor_) disconnect(monitor_, nullptr, this, nullptr);
+  monitor_ = m;
+  if (monitor_) connect(monitor_, SIGNAL(cpusChanged()), this, SLOT(rebuild()));
+  rebuild();
+}
+
+void MonitorTab::rebuild() {
   /* delete all gauge widgets */
   for (auto* g : gauges_) {
     grid_->removeWidget(g);
@@ -296,24 +1232,35 @@ void MonitorTab::setMonitor(Monitor* m) {
   }
   gauges_.clear();
   previous_values_.clear();
-  monitor_ = m;
+  for (auto* l : tasks_) {
+    grid_->removeWidget(l);
+    l->setParent(nullptr);
+    delete l;
+  }
+  tasks_.clear();
+  logical_.clear();
   if (monitor_) {
     /* Add as many gauges as there are logical cpus */
+    size_t cpus = monitor_->cpu_count_;
     int width = 3;
-    if ((monitor_->sensors_.cpu_activity().size() - 1) <= 4) width = 2;
-    if ((monitor_->sensors_.cpu_activity().size() - 1) > 8) width = 4;
+    if (cpus <= 4) width = 2;
+    if (cpus > 8) width = 4;
     int grid_x = 0;
     int grid_y = 0;
-    for (size_t i = 0; i < monitor_->sensors_.cpu_activity().size() - 1; ++i) {
+    for (const auto& channel : *monitor_->channels_) {
+      /* a gauge for each load channel, except the aggregate */
+      if (channel.type != xxx::CpuSensors::Channel::Type::Load || channel.index == 0) continue;
       auto* g = new Gauge(nullptr, 100, 100, 230., true);
-      /* the cpu nr to display */      
-      size_t c = monitor_->sensors_.cpu_frequency().logical(i);
-      /* if no logical id could be fetched then use the count of the CpuActivity instead */
-      if (c == ULONG_MAX) c = i;
-      g->setLabel(QString("cpu%1 load (%)").arg(c));
-      grid_->addWidget(g, grid_y, grid_x);
+      g->setLabel(QString("%1 load (%)").arg(QString::fromStdString(channel.name)));
+      grid_->addWidget(g, grid_y * 2, grid_x);
       gauges_.push_back(g);
       previous_values_.push_back(0);
+      /* the top tasks below the gauge (the channels are named 'cpuN') */
+      auto* l = new QLabel();
+      l->setAlignment(Qt::AlignHCenter | Qt::AlignTop);
+      grid_->addWidget(l, grid_y * 2 + 1, grid_x);
+      tasks_.push_back(l);
+      logical_.push_back(std::strtoul(channel.name.c_str() + 3, nullptr, 10));
       ++grid_x;
       if (grid_x == width) {
         grid_x = 0;
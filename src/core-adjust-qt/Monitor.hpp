@@ -27,34 +27,151 @@
 #ifndef CoreAdjust_MonitorWidget
 #define CoreAdjust_MonitorWidget
 
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <QLabel>
 #include <QGridLayout>
+#include <QPushButton>
+#include <QScrollArea>
+#include <QSlider>
+#include <QTimer>
 #include "CpuSensors.hpp"
+#include "EnergyLedger.hpp"
 #include "Gauge.hpp"
+#include "InterruptActivity.hpp"
+#include "ProcessActivity.hpp"
+#include "SensorHistory.hpp"
+#include "SensorRecording.hpp"
+#include "SensorSketches.hpp"
 #include "TabMemberBase.hpp"
 
-/** @brief A widget that displays the data generated by an instance of xxx::CpuSensors. */
+/** @brief A widget that displays the data generated by an instance of xxx::CpuSensors.
+  *
+  * The sensors are sampled by the sampler thread of xxx::CpuSensors, this
+  * widget only consumes the latest published snapshot on the GUI thread.
+  * The sampling and the refresh (display) intervals are independent,
+  * the sampling interval adapts to the rate of change of the sensors
+  * (see xxx::RateController) and the effective rate is displayed.
+  * Every sample is also added to a xxx::SensorHistory, the tooltips of the
+  * values show the minimum, mean and maximum of the last minute and hour.
+  * The percentiles of every channel since the start (or the last reset)
+  * are kept in a xxx::SensorSketches, they are shown in the tooltips and
+  * (merged per package) in a summary panel.
+  * The samples can be recorded to a file (xxx::SensorRecorder), a recording
+  * (xxx::SensorRecording) is replayed using the same widgets, with the
+  * topology and the percentiles of the recording.
+  * The interrupts of the cpus (xxx::InterruptActivity) are counted once
+  * per second by the sampler thread, they are not recorded.
+  * When cpus are hotplugged the widgets are rebuilt for the new channels
+  * (the history of the remaining channels is kept) and cpusChanged() is emitted. */
 class Monitor : public QWidget {
   Q_OBJECT
   class CpuActivity;
   class CpuTemperature;
   class CpuPower;
   class CpuFrequency;
+  class CpuIdle;
+  class CpuThrottle;
+  class CpuPerf;
+  class CpuPressure;
+  class CpuInterrupts;
+  class CpuPackages;
+  class CpuPercentiles;
   friend class MonitorTab;
   private:
     xxx::CpuSensors sensors_;
-    CpuActivity* cpu_activity_;
+    xxx::SensorHistory history_;
+    xxx::SensorSketches sketches_;
+    /* The energy of the power zones (updated with the displayed live snapshots) */
+    xxx::EnergyLedger ledger_;
+    /* Time of the last save of ledger_ */
+    std::chrono::steady_clock::time_point ledger_time_;
+    /* The interrupts of the last displayed (live) snapshot (or nullptr) */
+    std::shared_ptr<const xxx::InterruptMatrix> interrupts_;
+    QVBoxLayout* layout_;
+    QScrollArea* scroll_area_;
+    CpuActivity* cpu_activity_ { nullptr };
     CpuTemperature* cpu_temp_;
     CpuPower* cpu_power_;
     CpuFrequency* cpu_frequency_;
+    CpuIdle* cpu_idle_;
+    CpuThrottle* cpu_throttle_;
+    CpuPerf* cpu_perf_;
+    CpuPressure* cpu_pressure_;
+    CpuInterrupts* cpu_interrupts_;
+    CpuPackages* cpu_packages_;
+    CpuPercentiles* cpu_percentiles_;
+    QTimer* timer_;
+    QPushButton* record_;
+    QPushButton* live_;
+    QSlider* scrub_;
+    QLabel* scrub_time_;
+    QLabel* rate_;
+    /* The channels of the displayed (live) snapshots */
+    std::shared_ptr<const std::vector<xxx::CpuSensors::Channel>> channels_;
+    /* The cores and packages of the displayed (live) snapshots */
+    std::shared_ptr<const xxx::CpuTopology> topology_;
+    /* The number of online logical cpus (in channels_) */
+    size_t cpu_count_;
+    /* Sequence number of the last displayed snapshot */
+    uint64_t sequence_ { 0 };
+    /* The widget that displays each channel of history_ (or nullptr) */
+    std::vector<QWidget*> history_widgets_;
+    /* (reused for the tooltips of all channels) */
+    std::vector<xxx::SensorHistory::Point> summaries_;
+    std::vector<double> percentiles_;
+    /* Time of the last update of the tooltips */
+    std::chrono::steady_clock::time_point history_time_;
+    /* The active recorder (used by the sampler thread) */
+    std::mutex recorder_mutex_;
+    std::unique_ptr<xxx::SensorRecorder> recorder_;
+    /* The recording that is replayed (nullptr == display the sensors) */
+    std::unique_ptr<xxx::SensorRecording> recording_;
+    xxx::CpuSensors::Snapshot replay_;
+    /* The percentiles of all frames of the replayed recording */
+    std::unique_ptr<xxx::SensorSketches> replay_sketches_;
+    /* (Re)create the widgets that display the channels */
+    void build(const std::vector<xxx::CpuSensors::Channel>& channels, const xxx::CpuTopology* topology, bool live);
+    /* Display a snapshot that was sampled at a (wall clock) time */
+    void display(const xxx::CpuSensors::Snapshot& snapshot, std::chrono::system_clock::time_point time);
+    void refreshHistory();
+    /* The number of logical cpus in channels */
+    static size_t cpuCount(const std::vector<xxx::CpuSensors::Channel>& channels);
+    /* Adopt the channels and topology of a snapshot */
+    void relayout(const std::shared_ptr<const std::vector<xxx::CpuSensors::Channel>>& channels,
+        const std::shared_ptr<const xxx::CpuTopology>& topology);
+  signals:
+    /** @brief Emitted when cpus went online or offline. */
+    void cpusChanged();
   private slots:
     void timerCallback(void);
+    void recordToggled(bool checked);
+    void openRecording();
+    void showLive();
+    void scrubTo(int frame);
+    void resetPercentiles();
+    void resetEnergy();
   public:
-    explicit Monitor(QWidget* parent = nullptr);
-    virtual ~Monitor() = default;
+    /** @param sample_interval_ms Minimum time between two samples of the sensors.
+      * @param sample_interval_max_ms Maximum time between two samples of the sensors.
+      * @param refresh_interval_ms Time between two refreshes of the widgets. */
+    explicit Monitor(
+        int sample_interval_ms = 500,
+        int sample_interval_max_ms = 2000,
+        int refresh_interval_ms = 500,
+        QWidget* parent = nullptr);
+    virtual ~Monitor();
+    /** @brief Change the sampling and refresh intervals. */
+    void setIntervals(int sample_interval_ms, int sample_interval_max_ms, int refresh_interval_ms);
 };
 
-/** @brief A TabMemberWidget that displays the data generated by an instance of xxx::CpuActivity. */
+/** @brief A TabMemberWidget that displays the data generated by an instance of xxx::CpuActivity.
+  *
+  * Below the gauge of each logical cpu are the tasks that used the most
+  * cpu time on it during the last second (xxx::ProcessActivity, ranked by
+  * the sampler thread while the tab is active). */
 class MonitorTab : public TabMemberWidget {
   /* This class uses the CpuSensors instance from a Monitor widget... */
   Q_OBJECT
@@ -72,12 +189,22 @@ class MonitorTab : public TabMemberWidget {
 
     void setMonitor(Monitor* m);
 
+  private slots:
+    /* (Re)create the gauges for the cpus of the monitor */
+    void rebuild();
+
   private:
     QVBoxLayout* layout_;
     QGridLayout* grid_ { nullptr };
     Monitor* monitor_ { nullptr };
     std::vector<Gauge*> gauges_;
     std::vector<unsigned int> previous_values_;
+    /* The top tasks of each gauge and the logical cpu of each gauge */
+    std::vector<QLabel*> tasks_;
+    std::vector<unsigned long> logical_;
+    /* The displayed ranking of the tasks */
+    std::shared_ptr<const xxx::ProcessActivity::Ranking> ranking_;
+    void refreshTasks();
 };
 
 /** @brief A widget that displays the data generated by an instance of xxx::CpuActivity. */
@@ -89,21 +216,30 @@ class Monitor::CpuActivity : public QWidget {
   public:
     explicit CpuActivity(QWidget* parent = nullptr);
     virtual ~CpuActivity() = default;
-    void refresh(const xxx::CpuActivity&);
+    void refresh(const std::vector<xxx::CpuActivityEntry>&);
+    QWidget* channelWidget() const { return gauge_; }
 };
 
-/** @brief A widget that displays the data generated by an instance of xxx::CpuTemperature. */
+/** @brief A widget that displays the temperature channels of xxx::CpuSensors. */
 class Monitor::CpuTemperature : public QWidget {
   Q_OBJECT
   private:
     std::vector<QLabel*> v_;
   public:
-    explicit CpuTemperature(const xxx::CpuTemperature&, QWidget* parent = nullptr);
+    explicit CpuTemperature(const std::vector<xxx::CpuSensors::Channel>&, QWidget* parent = nullptr);
     virtual ~CpuTemperature() = default;
-    void refresh(const xxx::CpuTemperature&);
+    void refresh(const std::vector<int>&);
+    QWidget* channelWidget(size_t index) const;
 };
 
-/** @brief A widget that displays the data generated by an instance of xxx::PowerCap::IntelRAPL. */
+/** @brief A widget that displays the power channels of xxx::CpuSensors (xxx::PowerCap::IntelRAPL).
+  *
+  * The RAPL zones are followed by the power of the system and its share
+  * that is not used by the packages, if a power supply measures it
+  * (xxx::PowerSupply).
+  * Next to the power of each zone is the energy since the last reset
+  * (xxx::EnergyLedger, the tooltip shows the energy since the start and
+  * the lifetime energy). */
 class Monitor::CpuPower : public QWidget {
   Q_OBJECT
   private:
@@ -113,23 +249,193 @@ class Monitor::CpuPower : public QWidget {
       std::vector<QLabel*> sub_zones;
     };
     std::vector<Entry> v_;
+    /* The energy label of each zone and sub zone (in the order of the power channels) */
+    std::vector<QLabel*> energy_;
+    QPushButton* reset_;
   public:
-    explicit CpuPower(const xxx::PowerCap::IntelRAPL&, QWidget* parent = nullptr);
+    /** @param energy Display the energy of the zones (see refreshEnergy()). */
+    CpuPower(const std::vector<xxx::CpuSensors::Channel>&, bool energy, QWidget* parent = nullptr);
     virtual ~CpuPower() = default;
-    void refresh(const xxx::PowerCap::IntelRAPL&);
+    void refresh(const std::vector<double>&);
+    void refreshEnergy(const std::vector<xxx::EnergyLedger::Zone>&);
+    QPushButton* resetButton() const { return reset_; }
+    /* index is the index of the zone or sub zone in the flattened power vector */
+    QWidget* channelWidget(size_t index) const;
 };
 
-/** @brief A widget that displays the data generated by an instance of xxx::CpuFrequency and xxx::CpuActivity. */
+/** @brief A widget that displays the frequency and load channels of xxx::CpuSensors.
+  *
+  * Next to the load of each cpu is its run-queue delay (xxx::CpuSchedStat),
+  * the time tasks waited for the cpu, which tells an oversubscribed cpu
+  * from a busy one. */
 class Monitor::CpuFrequency : public QWidget {
   Q_OBJECT
   private:
     std::vector<QLabel*> vfreq_;
     std::vector<QLabel*> vload_;
+    /* The label of each RunDelay channel (by index) */
+    std::vector<QLabel*> vdelay_;
   public:
-    explicit CpuFrequency(const xxx::CpuFrequency&, QWidget* parent = nullptr);
+    explicit CpuFrequency(const std::vector<xxx::CpuSensors::Channel>&, QWidget* parent = nullptr);
     virtual ~CpuFrequency() = default;
-    void refresh(const xxx::CpuFrequency&, const xxx::CpuActivity&);
+    void refresh(const std::vector<unsigned long>&, const std::vector<xxx::CpuActivityEntry>&, const std::vector<double>& run_delay);
+    QWidget* channelWidget(size_t index, bool load) const;
+    QWidget* delayWidget(size_t index) const;
 };
 
-#endif
+/** @brief A widget that displays the idle channels of xxx::CpuSensors (xxx::CpuIdle).
+  *
+  * A row for each logical cpu with the residency of each idle state
+  * and the above/below mis-prediction rates. */
+class Monitor::CpuIdle : public QWidget {
+  Q_OBJECT
+  private:
+    /* The label of each Idle, IdleAbove and IdleBelow channel (by index) */
+    std::vector<QLabel*> residency_;
+    std::vector<QLabel*> above_;
+    std::vector<QLabel*> below_;
+  public:
+    explicit CpuIdle(const std::vector<xxx::CpuSensors::Channel>&, QWidget* parent = nullptr);
+    virtual ~CpuIdle() = default;
+    void refresh(const std::vector<double>& idle, const std::vector<double>& above, const std::vector<double>& below);
+    QWidget* channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const;
+};
 
+/** @brief A widget that displays the throttle channels of xxx::CpuSensors (xxx::ThermalThrottle).
+  *
+  * A row for each package, the aggregate of the cpus of each package and
+  * each logical cpu with the throttle events and time of the last interval. */
+class Monitor::CpuThrottle : public QWidget {
+  Q_OBJECT
+  private:
+    /* The label of each Throttle and ThrottleTime channel (by index) */
+    std::vector<QLabel*> events_;
+    std::vector<QLabel*> time_;
+  public:
+    explicit CpuThrottle(const std::vector<xxx::CpuSensors::Channel>&, QWidget* parent = nullptr);
+    virtual ~CpuThrottle() = default;
+    void refresh(const std::vector<double>& throttle, const std::vector<double>& throttle_time);
+    QWidget* channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const;
+};
+
+/** @brief A widget that displays the hardware counter channels of xxx::CpuSensors (xxx::PerfCounters).
+  *
+  * A row for each logical cpu with the instructions per cycle and
+  * the cache and branch misses per 1000 instructions. */
+class Monitor::CpuPerf : public QWidget {
+  Q_OBJECT
+  private:
+    /* The label of each Ipc, LlcMisses and BranchMisses channel (by index) */
+    std::vector<QLabel*> ipc_;
+    std::vector<QLabel*> llc_;
+    std::vector<QLabel*> branch_;
+  public:
+    explicit CpuPerf(const std::vector<xxx::CpuSensors::Channel>&, QWidget* parent = nullptr);
+    virtual ~CpuPerf() = default;
+    void refresh(const std::vector<double>& ipc, const std::vector<double>& llc_mpki, const std::vector<double>& branch_mpki);
+    QWidget* channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const;
+};
+
+/** @brief A widget that displays the pressure and stall channels of xxx::CpuSensors (xxx::PressureStall).
+  *
+  * A row for each resource (and the cpu of each top-level cgroup) with
+  * the share of the last interval that some and all tasks stalled and
+  * the trigger events of that interval, followed by the time of the last
+  * stall event. */
+class Monitor::CpuPressure : public QWidget {
+  Q_OBJECT
+  private:
+    /* The label of each Pressure and Stall channel (by index) */
+    std::vector<QLabel*> pressure_;
+    std::vector<QLabel*> stalls_;
+    /* The resource of each Stall channel (by index) */
+    std::vector<QString> resources_;
+    QLabel* last_ { nullptr };
+  public:
+    explicit CpuPressure(const std::vector<xxx::CpuSensors::Channel>&, QWidget* parent = nullptr);
+    virtual ~CpuPressure() = default;
+    /** @param time The (wall clock) time of the sample, shown as the time of a stall. */
+    void refresh(const std::vector<double>& pressure, const std::vector<double>& stalls,
+        std::chrono::system_clock::time_point time);
+    QWidget* channelWidget(xxx::CpuSensors::Channel::Type type, size_t index) const;
+};
+
+/** @brief A heat-map of the interrupts of the cpus (xxx::InterruptActivity).
+  *
+  * A row for each logical cpu and a column for each of the sources
+  * (interrupts and softirqs) that were among the busiest of any cpu
+  * during the last interval, ordered by their total. The cells show the
+  * interrupts per second, shaded (on a logarithmic scale) relative to the
+  * busiest cell. The rows are created by the first refresh() and again
+  * when the cpus of the matrix changed. */
+class Monitor::CpuInterrupts : public QWidget {
+  Q_OBJECT
+  private:
+    static constexpr size_t Columns = 8;
+    QGridLayout* grid_;
+    std::array<QLabel*, Columns> sources_;
+    /* The cpu and the cells of each row (the columns of the matrix) */
+    std::vector<unsigned long> cpus_;
+    std::vector<std::array<QLabel*, Columns>> cells_;
+    /* The sources of the columns (reused by refresh()) */
+    std::vector<size_t> hottest_;
+    /* (Re)create the rows for the cpus of a matrix */
+    void arrange(const xxx::InterruptMatrix&);
+  public:
+    explicit CpuInterrupts(QWidget* parent = nullptr);
+    virtual ~CpuInterrupts() = default;
+    void refresh(const xxx::InterruptMatrix&);
+};
+
+/** @brief A widget that displays the aggregates of the sensors per package and per core (xxx::CpuTopology).
+  *
+  * A row for each package followed by a row for each of its cores
+  * with the mean load and frequency, the temperature and the power
+  * and energy per busy cycle of the packages. */
+class Monitor::CpuPackages : public QWidget {
+  Q_OBJECT
+  private:
+    /* The labels of a row: load, frequency, temperature, power and energy per cycle (packages only) */
+    struct Row {
+      QLabel* load;
+      QLabel* frequency;
+      QLabel* temperature;
+      QLabel* power;
+      QLabel* energy_per_cycle;
+    };
+    std::vector<Row> packages_;
+    std::vector<Row> cores_;
+  public:
+    /** @param topology The topology of the snapshots (nullptr == no rows). */
+    explicit CpuPackages(const xxx::CpuTopology* topology, QWidget* parent = nullptr);
+    virtual ~CpuPackages() = default;
+    void refresh(const std::vector<xxx::CpuTopologyRollup>& packages, const std::vector<xxx::CpuTopologyRollup>& cores);
+};
+
+/** @brief A widget that displays the percentiles of the sensors (xxx::SensorSketches).
+  *
+  * A row with the p50, p95, p99 and maximum of the load, frequency and
+  * temperature of the cpus of each package, followed by a row for each
+  * power zone. The percentiles are those since the start or the last reset. */
+class Monitor::CpuPercentiles : public QWidget {
+  Q_OBJECT
+  private:
+    /* A row merges the channels of a type of a package (or shows a single channel if package == SIZE_MAX) */
+    struct Row {
+      xxx::CpuSensors::Channel channel;
+      size_t package;
+      std::array<QLabel*, 4> values;
+    };
+    std::vector<Row> rows_;
+    QPushButton* reset_;
+    /* (reused for each row) */
+    xxx::PercentileSketch sketch_;
+  public:
+    /** @param topology The topology of the snapshots (nullptr == no rows). */
+    CpuPercentiles(const std::vector<xxx::CpuSensors::Channel>&, const xxx::CpuTopology* topology, QWidget* parent = nullptr);
+    virtual ~CpuPercentiles() = default;
+    void refresh(const xxx::SensorSketches&);
+    QPushButton* resetButton() const { return reset_; }
+};
+
+#endif
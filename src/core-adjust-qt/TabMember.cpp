@@ -73,6 +73,28 @@
   * in the INI file on ACPI power events (ie. when switching between
   * AC and battery power).
   *
+  * @fn int monitorSampleInterval() const
+  * @brief The (minimum) time (in ms) between two samples of the Monitor sensors.
+  *
+  * @fn void monitorSampleInterval(int ms)
+  * @brief The (minimum) time (in ms) between two samples of the Monitor sensors.
+  *
+  * @fn int monitorSampleIntervalMax() const
+  * @brief The maximum time (in ms) between two samples of the Monitor sensors.
+  *
+  * The sampling interval backs off up to this value while the sensors
+  * do not change (see xxx::RateController), a value less than or equal
+  * to monitorSampleInterval() gives a fixed interval.
+  *
+  * @fn void monitorSampleIntervalMax(int ms)
+  * @brief The maximum time (in ms) between two samples of the Monitor sensors.
+  *
+  * @fn int monitorRefreshInterval() const
+  * @brief The time (in ms) between two refreshes of the Monitor widgets.
+  *
+  * @fn void monitorRefreshInterval(int ms)
+  * @brief The time (in ms) between two refreshes of the Monitor widgets.
+  *
   *
   *
   * @class TabMemberValues
@@ -228,6 +250,7 @@
   * @fn void TabSettings::restore()
   * @brief Restore the in-memory backup of all settings.
   */
+#include <algorithm>
 #include <sstream>
 #include <QDebug>
 #include <QMessageBox>
@@ -263,6 +286,30 @@ void CommonSettings::applyOnAcpiPowerEvent(bool v) {
   apply_on_acpi_power_event_ = v;
 }
 
+int CommonSettings::monitorSampleInterval() const {
+  return monitor_sample_interval_;
+}
+
+void CommonSettings::monitorSampleInterval(int v) {
+  monitor_sample_interval_ = std::clamp(v, MonitorIntervalMin, MonitorIntervalMax);
+}
+
+int CommonSettings::monitorSampleIntervalMax() const {
+  return monitor_sample_interval_max_;
+}
+
+void CommonSettings::monitorSampleIntervalMax(int v) {
+  monitor_sample_interval_max_ = std::clamp(v, MonitorIntervalMin, MonitorIntervalMax);
+}
+
+int CommonSettings::monitorRefreshInterval() const {
+  return monitor_refresh_interval_;
+}
+
+void CommonSettings::monitorRefreshInterval(int v) {
+  monitor_refresh_interval_ = std::clamp(v, MonitorIntervalMin, MonitorIntervalMax);
+}
+
 /*
  * Class TabMemberSettings impl
  */
@@ -399,11 +446,17 @@ TabSettings::TabSettings(const CpuInfo& cpuInfo, TabValues& tabValues) {
   applyOnBootAndResume(qs.value(INI_APPLY_ON_BOOT, false).toBool());
   applyOnAcpiPowerEvent(qs.value(INI_APPLY_ON_ACPI, false).toBool());
   saveOnExit(qs.value(INI_SAVE_ON_EXIT, false).toBool());
+  monitorSampleInterval(qs.value(INI_MONITOR_SAMPLE, 500).toInt());
+  monitorSampleIntervalMax(qs.value(INI_MONITOR_SAMPLE_MAX, 2000).toInt());
+  monitorRefreshInterval(qs.value(INI_MONITOR_REFRESH, 500).toInt());
   qs.endGroup();
 
   DBGMSG("TabSettings(): CommonSettings::applyOnBootAndResume() <--" << applyOnBootAndResume())
   DBGMSG("TabSettings(): CommonSettings::applyOnAcpiPowerEvent() <--" << applyOnAcpiPowerEvent())
   DBGMSG("TabSettings(): CommonSettings::saveOnExit() <--" << saveOnExit())
+  DBGMSG("TabSettings(): CommonSettings::monitorSampleInterval() <--" << monitorSampleInterval())
+  DBGMSG("TabSettings(): CommonSettings::monitorSampleIntervalMax() <--" << monitorSampleIntervalMax())
+  DBGMSG("TabSettings(): CommonSettings::monitorRefreshInterval() <--" << monitorRefreshInterval())
 
   auto ci_iter = cpuInfo.begin();
   auto tv_iter = tabValues.begin();
@@ -431,10 +484,16 @@ TabSettings::~TabSettings() {
     DBGMSG("~TabSettings(): CommonSettings::applyOnBootAndResume() -->" << applyOnBootAndResume())
     DBGMSG("~TabSettings(): CommonSettings::applyOnAcpiPowerEvent() -->" << applyOnAcpiPowerEvent())
     DBGMSG("~TabSettings(): CommonSettings::saveOnExit() -->" << saveOnExit())
+    DBGMSG("~TabSettings(): CommonSettings::monitorSampleInterval() -->" << monitorSampleInterval())
+    DBGMSG("~TabSettings(): CommonSettings::monitorSampleIntervalMax() -->" << monitorSampleIntervalMax())
+    DBGMSG("~TabSettings(): CommonSettings::monitorRefreshInterval() -->" << monitorRefreshInterval())
     qs.beginGroup(INI_GRP_COMMON);
     qs.setValue(INI_APPLY_ON_BOOT, QVariant::fromValue<bool>(applyOnBootAndResume()));
     qs.setValue(INI_APPLY_ON_ACPI, QVariant::fromValue<bool>(applyOnAcpiPowerEvent()));
     qs.setValue(INI_SAVE_ON_EXIT, QVariant::fromValue<bool>(saveOnExit()));
+    qs.setValue(INI_MONITOR_SAMPLE, QVariant::fromValue<int>(monitorSampleInterval()));
+    qs.setValue(INI_MONITOR_SAMPLE_MAX, QVariant::fromValue<int>(monitorSampleIntervalMax()));
+    qs.setValue(INI_MONITOR_REFRESH, QVariant::fromValue<int>(monitorRefreshInterval()));
     qs.endGroup();
 
     if (saveOnExit()) {
@@ -61,6 +61,9 @@ class CommonSettings
     bool save_on_exit_ { true };
     bool apply_on_boot_and_resume_ { false };
     bool apply_on_acpi_power_event_ { false };
+    int monitor_sample_interval_ { 500 };
+    int monitor_sample_interval_max_ { 2000 };
+    int monitor_refresh_interval_ { 500 };
 
   public:
     bool saveOnExit() const;
@@ -69,6 +72,15 @@ class CommonSettings
     void applyOnBootAndResume(bool state);
     bool applyOnAcpiPowerEvent() const;
     void applyOnAcpiPowerEvent(bool state);
+    int monitorSampleInterval() const;
+    void monitorSampleInterval(int ms);
+    int monitorSampleIntervalMax() const;
+    void monitorSampleIntervalMax(int ms);
+    int monitorRefreshInterval() const;
+    void monitorRefreshInterval(int ms);
+
+    static constexpr int MonitorIntervalMin { 50 };
+    static constexpr int MonitorIntervalMax { 10000 };
 };
 
 class TabMemberValues
@@ -183,6 +195,9 @@ class TabSettings
     static constexpr const char* INI_SAVE_ON_EXIT { "GUI_Save_On_Exit" };
     static constexpr const char* INI_APPLY_ON_BOOT { "Apply_On_Boot_And_Resume" };
     static constexpr const char* INI_APPLY_ON_ACPI { "Apply_On_Acpi_Power_Event" };
+    static constexpr const char* INI_MONITOR_SAMPLE { "GUI_Monitor_Sample_Interval" };
+    static constexpr const char* INI_MONITOR_SAMPLE_MAX { "GUI_Monitor_Sample_Interval_Max" };
+    static constexpr const char* INI_MONITOR_REFRESH { "GUI_Monitor_Refresh_Interval" };
 
     static constexpr const char* CfgPath { CONFIG_FILE };
     static constexpr const char* ScriptPath { SCRIPT_EXEC };
@@ -0,0 +1,871 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/core-adjust-stat/Output.cpp
+ * @brief Format the CpuSensors snapshots for core-adjust-stat (implementation).
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Output.hpp"
+
+using Channel = xxx::CpuSensors::Channel;
+
+namespace {
+
+  /* The percentiles of the sketches */
+  const double quantiles[] = { 0.5, 0.95, 0.99 };
+  const char* const quantile_labels[] = { "0.5", "0.95", "0.99" };
+  constexpr size_t QUANTILES = sizeof(quantiles) / sizeof(quantiles[0]);
+
+  /* The channel types with percentiles (the types that are merged per package first) */
+  const Channel::Type sketched_types[] = {
+    Channel::Type::Load, Channel::Type::Frequency, Channel::Type::Temperature, Channel::Type::Power
+  };
+  constexpr size_t MERGED_TYPES = 3;
+
+  inline int sketch_decimals(Channel::Type type) {
+    return (type == Channel::Type::Power) ? 3 : 1;
+  }
+
+} // ends namespace
+
+/*
+ * OutputBuffer
+ */
+
+char* OutputBuffer::reserve(size_t n) {
+  if (size_ + n > buffer_.size())
+    buffer_.resize(std::max(buffer_.size() * 2, size_ + n));
+  return buffer_.data() + size_;
+}
+
+void OutputBuffer::put(std::string_view s) {
+  std::memcpy(reserve(s.size()), s.data(), s.size());
+  size_ += s.size();
+}
+
+void OutputBuffer::put(char c) {
+  *reserve(1) = c;
+  ++size_;
+}
+
+void OutputBuffer::put(int64_t value) {
+  char* p = reserve(24);
+  size_ += static_cast<size_t>(std::to_chars(p, p + 24, value).ptr - p);
+}
+
+void OutputBuffer::put(uint64_t value) {
+  char* p = reserve(24);
+  size_ += static_cast<size_t>(std::to_chars(p, p + 24, value).ptr - p);
+}
+
+void OutputBuffer::put(double value, int decimals) {
+  char* p = reserve(64);
+  auto r = std::to_chars(p, p + 64, value, std::chars_format::fixed, decimals);
+  if (r.ec == std::errc()) size_ += static_cast<size_t>(r.ptr - p);
+  else put('0');
+}
+
+void OutputBuffer::putJson(std::string_view s) {
+  static const char* hex = "0123456789abcdef";
+  put('"');
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      put('\\');
+      put(c);
+    }
+    else if (static_cast<unsigned char>(c) < 0x20) {
+      put("\\u00");
+      put(hex[(c >> 4) & 0xf]);
+      put(hex[c & 0xf]);
+    }
+    else put(c);
+  }
+  put('"');
+}
+
+void OutputBuffer::putLabel(std::string_view s) {
+  for (char c : s) {
+    if (c == '\\' || c == '"') put('\\');
+    if (c == '\n') put("\\n");
+    else put(c);
+  }
+}
+
+bool OutputBuffer::write(int fd) const {
+  const char* p = buffer_.data();
+  size_t n = size_;
+  while (n > 0) {
+    ssize_t r = ::write(fd, p, n);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += r;
+    n -= static_cast<size_t>(r);
+  }
+  return true;
+}
+
+/*
+ * Output
+ */
+
+Output::Output(std::vector<Channel> channels, std::shared_ptr<const xxx::CpuTopology> topology)
+  : channels_(std::move(channels)),
+    topology_(std::move(topology)) {
+}
+
+/*
+ * ColumnOutput
+ */
+
+ColumnOutput::ColumnOutput(std::vector<Channel> channels,
+    std::shared_ptr<const xxx::CpuTopology> topology, bool summary_only, unsigned header_rows)
+  : Output(std::move(channels), std::move(topology)),
+    summary_only_(summary_only),
+    header_rows_(std::max(header_rows, 1u)) {
+  header_ = "CPU\tBusy%\tMHz";
+  for (size_t i = 0; i < channels_.size(); ++i) {
+    switch (channels_[i].type) {
+      case Channel::Type::Load:
+        load_.push_back(i);
+        break;
+      case Channel::Type::Frequency:
+        break;
+      case Channel::Type::Temperature:
+        temperature_.push_back(i);
+        header_ += "\t" + channels_[i].name;
+        break;
+      case Channel::Type::Power:
+        power_.push_back(i);
+        header_ += "\t" + channels_[i].name + "(W)";
+        break;
+      case Channel::Type::Idle:
+      case Channel::Type::IdleAbove:
+      case Channel::Type::IdleBelow:
+      case Channel::Type::Throttle:
+      case Channel::Type::ThrottleTime:
+      case Channel::Type::Ipc:
+      case Channel::Type::LlcMisses:
+      case Channel::Type::BranchMisses:
+      case Channel::Type::Pressure:
+      case Channel::Type::Stall:
+      case Channel::Type::RunTime:
+      case Channel::Type::RunDelay:
+      case Channel::Type::Timeslices:
+        /* (too many columns, use the json or prometheus format) */
+        break;
+    }
+  }
+  header_ += "\n";
+  /* the frequency of a load channel has the same name (the logical cpu,
+   * not every cpu has a cpufreq policy so they can not be paired by index) */
+  for (size_t i : load_) {
+    size_t f = SIZE_MAX;
+    if (channels_[i].index > 0)
+      f = xxx::CpuSensors::find(channels_, { Channel::Type::Frequency, 0, channels_[i].name, nullptr });
+    frequency_.push_back(f);
+  }
+}
+
+bool ColumnOutput::write(const xxx::CpuSensors::Snapshot& s, std::chrono::system_clock::time_point) {
+  buffer_.clear();
+  if (rows_++ % header_rows_ == 0) buffer_.put(header_);
+  /* summary row */
+  double frequency = 0;
+  size_t cpus = 0;
+  for (size_t f : frequency_) {
+    if (f == SIZE_MAX) continue;
+    frequency += xxx::CpuSensors::value(s, channels_[f]);
+    ++cpus;
+  }
+  buffer_.put("-\t");
+  buffer_.put((s.activity.empty()) ? 0u : s.activity[0].total);
+  buffer_.put('\t');
+  if (cpus) buffer_.put(static_cast<uint64_t>(frequency / cpus + 0.5));
+  else buffer_.put('-');
+  for (size_t i : temperature_) {
+    buffer_.put('\t');
+    buffer_.put(static_cast<int64_t>(xxx::CpuSensors::value(s, channels_[i])));
+  }
+  for (size_t i : power_) {
+    buffer_.put('\t');
+    buffer_.put(xxx::CpuSensors::value(s, channels_[i]), 2);
+  }
+  buffer_.put('\n');
+  /* a row for each package (multi-socket systems only) */
+  for (size_t p = 0; s.packages.size() > 1 && p < s.packages.size(); ++p) {
+    if (s.packages[p].cpus == 0) continue;
+    buffer_.put('p');
+    buffer_.put(static_cast<uint64_t>(topology_->packages()[p].id));
+    buffer_.put('\t');
+    buffer_.put(s.packages[p].load, 0);
+    buffer_.put('\t');
+    buffer_.put(s.packages[p].frequency, 0);
+    buffer_.put('\n');
+  }
+  /* a row for each logical cpu */
+  for (size_t n = 0; !summary_only_ && n < load_.size(); ++n) {
+    const Channel& c = channels_[load_[n]];
+    if (c.index == 0) continue;
+    std::string_view name(c.name);
+    if (name.substr(0, 3) == "cpu") name.remove_prefix(3);
+    buffer_.put(name);
+    buffer_.put('\t');
+    buffer_.put(static_cast<uint64_t>(xxx::CpuSensors::value(s, c)));
+    buffer_.put('\t');
+    if (frequency_[n] != SIZE_MAX)
+      buffer_.put(static_cast<uint64_t>(xxx::CpuSensors::value(s, channels_[frequency_[n]])));
+    else buffer_.put('-');
+    buffer_.put('\n');
+  }
+  return buffer_.write(STDOUT_FILENO);
+}
+
+bool ColumnOutput::finish() {
+  if (!sketches_) return true;
+  buffer_.clear();
+  buffer_.put("\nChannel\tp50\tp95\tp99\tmax\n");
+  auto row = [this](std::string_view name, std::string_view unit, int decimals) {
+    double v[QUANTILES];
+    sketch_.quantiles(quantiles, v, QUANTILES);
+    buffer_.put(name);
+    buffer_.put('(');
+    buffer_.put(unit);
+    buffer_.put(')');
+    for (double value : v) {
+      buffer_.put('\t');
+      buffer_.put(value, decimals);
+    }
+    buffer_.put('\t');
+    buffer_.put(sketch_.max(), decimals);
+    buffer_.put('\n');
+  };
+  for (Channel::Type type : sketched_types) {
+    for (size_t i = 0; i < channels_.size(); ++i) {
+      if (channels_[i].type != type || !sketches_->copy(i, sketch_) || sketch_.count() == 0) continue;
+      row(channels_[i].name, channels_[i].unit, sketch_decimals(type));
+    }
+  }
+  /* the cpus of each package */
+  for (size_t p = 0; p < topology_->packages().size(); ++p) {
+    for (size_t t = 0; t < MERGED_TYPES; ++t) {
+      Channel::Type type = sketched_types[t];
+      sketch_.reset();
+      if (sketches_->merge(type, p, sketch_) == 0 || sketch_.count() == 0) continue;
+      row(topology_->packages()[p].name + "/" + xxx::CpuSensors::Name(type),
+          xxx::CpuSensors::Unit(type), sketch_decimals(type));
+    }
+  }
+  return buffer_.write(STDOUT_FILENO);
+}
+
+/*
+ * JsonOutput
+ */
+
+JsonOutput::JsonOutput(std::vector<Channel> channels, std::shared_ptr<const xxx::CpuTopology> topology)
+  : Output(std::move(channels), std::move(topology)) {
+  auto key = [this](const std::string& name) {
+    buffer_.clear();
+    buffer_.putJson(name);
+    buffer_.put(':');
+    return std::string(buffer_.data(), buffer_.size());
+  };
+  for (const auto& c : channels_) keys_.push_back(key(c.name));
+  for (const auto& p : topology_->packages()) package_keys_.push_back(key(p.name));
+  for (const auto& c : topology_->cores()) core_keys_.push_back(key(c.name));
+}
+
+bool JsonOutput::write(const xxx::CpuSensors::Snapshot& s, std::chrono::system_clock::time_point time) {
+  buffer_.clear();
+  buffer_.put("{\"time\":");
+  buffer_.put(static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+      time.time_since_epoch()).count()));
+  /* (the channels are ordered by type) */
+  for (int t = 0; t <= static_cast<int>(Channel::Type::Timeslices); ++t) {
+    auto type = static_cast<Channel::Type>(t);
+    buffer_.put(",\"");
+    buffer_.put(xxx::CpuSensors::Name(type));
+    buffer_.put("\":{");
+    bool first = true;
+    for (size_t i = 0; i < channels_.size(); ++i) {
+      if (channels_[i].type != type) continue;
+      if (!first) buffer_.put(',');
+      first = false;
+      buffer_.put(keys_[i]);
+      double value = xxx::CpuSensors::value(s, channels_[i]);
+      if (type == Channel::Type::Power) buffer_.put(value, 3);
+      else if (type == Channel::Type::Idle || type == Channel::Type::IdleAbove
+          || type == Channel::Type::IdleBelow || type == Channel::Type::Pressure
+          || type == Channel::Type::RunTime || type == Channel::Type::RunDelay) buffer_.put(value, 1);
+      else if (type == Channel::Type::Ipc || type == Channel::Type::LlcMisses
+          || type == Channel::Type::BranchMisses) buffer_.put(value, 2);
+      else buffer_.put(static_cast<int64_t>(value));
+    }
+    buffer_.put('}');
+  }
+  /* the energy of the power zones */
+  for (int lifetime = 0; lifetime < 2; ++lifetime) {
+    if (lifetime && !ledger_) break;
+    buffer_.put(lifetime ? ",\"lifetime_energy\":{" : ",\"energy\":{");
+    bool first = true;
+    size_t zone = 0;
+    for (size_t i = 0; i < channels_.size(); ++i) {
+      if (channels_[i].type != Channel::Type::Power) continue;
+      if (!first) buffer_.put(',');
+      first = false;
+      buffer_.put(keys_[i]);
+      if (!lifetime)
+        buffer_.put((channels_[i].index < s.energy.size()) ? s.energy[channels_[i].index] : 0., 3);
+      else {
+        /* (the zones of the ledger are the power channels of the same layout) */
+        buffer_.put((zone < ledger_->zones().size()) ? ledger_->zones()[zone].lifetime : 0., 3);
+        ++zone;
+      }
+    }
+    buffer_.put('}');
+  }
+  /* the inputs of the hwmon chips */
+  if (hwmon_) {
+    buffer_.put(",\"hwmon\":{");
+    for (size_t i = 0; i < hwmon_->size(); ++i) {
+      const auto& e = (*hwmon_)[i];
+      if (i > 0) buffer_.put(',');
+      buffer_.putJson(e.name);
+      buffer_.put(':');
+      if (std::isnan(e.value)) buffer_.put("null");
+      else buffer_.put(e.value, (e.kind == xxx::HwmonEntry::Kind::Fan) ? 0 : 3);
+    }
+    buffer_.put('}');
+  }
+  /* the aggregates of the packages and cores */
+  auto rollups = [this](const char* object, const std::vector<xxx::CpuTopologyRollup>& v,
+      const std::vector<std::string>& keys, bool power) {
+    buffer_.put(",\"");
+    buffer_.put(object);
+    buffer_.put("\":{");
+    bool first = true;
+    for (size_t i = 0; i < v.size() && i < keys.size(); ++i) {
+      if (v[i].cpus == 0) continue;
+      if (!first) buffer_.put(',');
+      first = false;
+      buffer_.put(keys[i]);
+      buffer_.put("{\"load\":");
+      buffer_.put(v[i].load, 1);
+      buffer_.put(",\"frequency\":");
+      buffer_.put(v[i].frequency, 0);
+      buffer_.put(",\"temperature\":");
+      buffer_.put(v[i].temperature, 0);
+      if (power) {
+        buffer_.put(",\"power\":");
+        buffer_.put(v[i].power, 3);
+        buffer_.put(",\"energy\":");
+        buffer_.put(v[i].energy, 3);
+        buffer_.put(",\"energy_per_cycle\":");
+        buffer_.put(v[i].energy_per_cycle, 3);
+      }
+      buffer_.put('}');
+    }
+    buffer_.put('}');
+  };
+  rollups("packages", s.packages, package_keys_, true);
+  rollups("cores", s.cores, core_keys_, false);
+  /* the percentiles of the channels and of the cpus of each package */
+  if (sketches_) {
+    buffer_.put(",\"percentiles\":{");
+    for (Channel::Type type : sketched_types) {
+      if (type != sketched_types[0]) buffer_.put(',');
+      buffer_.put('"');
+      buffer_.put(xxx::CpuSensors::Name(type));
+      buffer_.put("\":{");
+      bool first = true;
+      for (size_t i = 0; i < channels_.size(); ++i) {
+        if (channels_[i].type != type || !sketches_->copy(i, sketch_)) continue;
+        if (!first) buffer_.put(',');
+        first = false;
+        buffer_.put(keys_[i]);
+        putPercentiles(sketch_decimals(type));
+      }
+      buffer_.put('}');
+    }
+    buffer_.put(",\"packages\":{");
+    for (size_t p = 0; p < package_keys_.size(); ++p) {
+      if (p > 0) buffer_.put(',');
+      buffer_.put(package_keys_[p]);
+      buffer_.put('{');
+      for (size_t t = 0; t < MERGED_TYPES; ++t) {
+        if (t > 0) buffer_.put(',');
+        buffer_.put('"');
+        buffer_.put(xxx::CpuSensors::Name(sketched_types[t]));
+        buffer_.put("\":");
+        sketch_.reset();
+        if (sketches_->merge(sketched_types[t], p, sketch_) == 0) buffer_.put("null");
+        else putPercentiles(sketch_decimals(sketched_types[t]));
+      }
+      buffer_.put('}');
+    }
+    buffer_.put("}}");
+  }
+  buffer_.put("}\n");
+  return buffer_.write(STDOUT_FILENO);
+}
+
+void JsonOutput::putPercentiles(int decimals) {
+  double v[QUANTILES];
+  sketch_.quantiles(quantiles, v, QUANTILES);
+  buffer_.put('[');
+  for (size_t k = 0; k < QUANTILES; ++k) {
+    if (k > 0) buffer_.put(',');
+    buffer_.put(v[k], decimals);
+  }
+  buffer_.put(']');
+}
+
+/*
+ * PrometheusOutput
+ */
+
+namespace {
+
+  /* Escape a label value */
+  std::string label_value(std::string_view s) {
+    std::string rv;
+    for (char c : s) {
+      if (c == '\\' || c == '"') rv += '\\';
+      if (c == '\n') rv += "\\n";
+      else rv += c;
+    }
+    return rv;
+  }
+
+  struct ThrottleBit {
+    xxx::ThrottleStatus::Bit bit;
+    const char* name;
+    bool package;
+  };
+
+  const ThrottleBit throttle_bits[] = {
+    { xxx::ThrottleStatus::THERMAL, "thermal", true },
+    { xxx::ThrottleStatus::PROCHOT, "prochot", true },
+    { xxx::ThrottleStatus::CRITICAL, "critical_temperature", true },
+    { xxx::ThrottleStatus::POWER_LIMIT, "power_limit", true },
+    { xxx::ThrottleStatus::CURRENT_LIMIT, "current_limit", false },
+    { xxx::ThrottleStatus::CROSS_DOMAIN, "cross_domain_limit", false }
+  };
+
+} // ends namespace
+
+PrometheusOutput::PrometheusOutput(
+    std::vector<Channel> channels, std::shared_ptr<const xxx::CpuTopology> topology,
+    std::string path, std::string config_file)
+  : Output(std::move(channels), std::move(topology)),
+    path_(std::move(path)),
+    tmp_path_(path_ + ".tmp"),
+    tuning_(std::move(config_file)) {
+  /* the labels of a logical cpu (its core and package are formatted by the topology) */
+  auto cpu_labels = [this](const std::string& number) {
+    char* end = nullptr;
+    unsigned long logical = std::strtoul(number.c_str(), &end, 10);
+    const auto& cpu = topology_->cpu((end != number.c_str() && *end == '\0') ? logical : ULONG_MAX);
+    return (cpu.logical != ULONG_MAX) ? cpu.labels : "cpu=\"" + label_value(number) + "\"";
+  };
+  for (const auto& c : channels_) {
+    switch (c.type) {
+      case Channel::Type::Load:
+        labels_.push_back((c.index == 0) ? std::string("{cpu=\"all\"}")
+            : "{" + cpu_labels(c.name.substr(3)) + "}");
+        break;
+      case Channel::Type::Frequency:
+        labels_.push_back("{" + cpu_labels(c.name.substr(3)) + "}");
+        break;
+      case Channel::Type::Temperature:
+        labels_.push_back("{sensor=\"" + label_value(c.name) + "\"}");
+        break;
+      case Channel::Type::Power:
+        labels_.push_back("{zone=\"" + label_value(c.name) + "\"}");
+        break;
+      case Channel::Type::Idle: {
+        /* 'cpuN/STATE' */
+        size_t slash = c.name.find('/');
+        labels_.push_back("{" + cpu_labels(c.name.substr(3, slash - 3))
+            + ",state=\"" + label_value(c.name.substr(slash + 1)) + "\"}");
+        break;
+      }
+      case Channel::Type::IdleAbove:
+      case Channel::Type::IdleBelow:
+      case Channel::Type::Ipc:
+      case Channel::Type::LlcMisses:
+      case Channel::Type::BranchMisses:
+      case Channel::Type::RunTime:
+      case Channel::Type::RunDelay:
+      case Channel::Type::Timeslices:
+        labels_.push_back("{" + cpu_labels(c.name.substr(3)) + "}");
+        break;
+      case Channel::Type::Throttle:
+      case Channel::Type::ThrottleTime:
+        /* 'cpuN', 'packageN' or 'packageN/cores' */
+        if (c.name.compare(0, 3, "cpu") == 0)
+          labels_.push_back("{" + cpu_labels(c.name.substr(3)) + "}");
+        else {
+          size_t slash = c.name.find('/');
+          labels_.push_back("{package=\"" + label_value(c.name.substr(7, slash - 7))
+              + "\",scope=\"" + ((slash == std::string::npos) ? "package" : "cores") + "\"}");
+        }
+        break;
+      case Channel::Type::Pressure:
+      case Channel::Type::Stall: {
+        /* '[CGROUP/]RESOURCE' followed by '/some' or '/full' for the pressure */
+        std::string name = c.name, kind;
+        if (c.type == Channel::Type::Pressure) {
+          kind = ",kind=\"" + name.substr(name.rfind('/') + 1) + "\"";
+          name.erase(name.rfind('/'));
+        }
+        size_t slash = name.rfind('/');
+        std::string cgroup = (slash == std::string::npos) ? std::string()
+            : ",cgroup=\"" + label_value(name.substr(0, slash)) + "\"";
+        labels_.push_back("{resource=\"" + label_value(name.substr(slash + 1)) + "\"" + cgroup + kind + "}");
+        break;
+      }
+    }
+  }
+  for (const auto& e : throttle_.cpus())
+    throttle_cpu_labels_.push_back(cpu_labels(std::to_string(e.id)));
+  for (const auto& e : throttle_.packages())
+    throttle_package_labels_.push_back("package=\"" + std::to_string(e.id) + "\"");
+  formatTuning();
+}
+
+void PrometheusOutput::formatTuning() {
+  /* (only called when the INI file was modified) */
+  std::string& s = tuning_metrics_;
+  s.clear();
+  s += "# HELP core_adjust_voltage_offset_millivolts Configured FIVR voltage offset.\n"
+       "# TYPE core_adjust_voltage_offset_millivolts gauge\n";
+  for (const auto& p : tuning_.processors()) {
+    for (size_t plane = 0; plane < p.voltage_offset.size(); ++plane) {
+      if (!p.voltage_offset[plane]) continue;
+      s += "core_adjust_voltage_offset_millivolts{processor=\"" + std::to_string(p.id)
+          + "\",plane=\"" + std::to_string(plane) + "\"} "
+          + std::to_string(*p.voltage_offset[plane]) + "\n";
+    }
+  }
+  s += "# HELP core_adjust_target_temperature_celsius Configured target temperature.\n"
+       "# TYPE core_adjust_target_temperature_celsius gauge\n";
+  for (const auto& p : tuning_.processors()) {
+    if (p.target_temperature) {
+      s += "core_adjust_target_temperature_celsius{processor=\"" + std::to_string(p.id)
+          + "\",power=\"ac\"} " + std::to_string(*p.target_temperature) + "\n";
+    }
+    if (p.target_temperature_battery) {
+      s += "core_adjust_target_temperature_celsius{processor=\"" + std::to_string(p.id)
+          + "\",power=\"battery\"} " + std::to_string(*p.target_temperature_battery) + "\n";
+    }
+  }
+  s += "# HELP core_adjust_turbo_ratio_limit Configured turbo ratio limit for a number of active cores.\n"
+       "# TYPE core_adjust_turbo_ratio_limit gauge\n";
+  for (const auto& p : tuning_.processors()) {
+    for (size_t cores = 0; cores < p.turbo_ratio_limit.size(); ++cores) {
+      if (!p.turbo_ratio_limit[cores]) continue;
+      s += "core_adjust_turbo_ratio_limit{processor=\"" + std::to_string(p.id)
+          + "\",cores=\"" + std::to_string(cores + 1) + "\"} "
+          + std::to_string(*p.turbo_ratio_limit[cores]) + "\n";
+    }
+  }
+}
+
+void PrometheusOutput::putSummaryHeader(std::string_view name, std::string_view help) {
+  buffer_.put("# HELP ");
+  buffer_.put(name);
+  buffer_.put("_distribution ");
+  buffer_.put(help);
+  buffer_.put("\n# TYPE ");
+  buffer_.put(name);
+  buffer_.put("_distribution summary\n");
+}
+
+void PrometheusOutput::putSummary(std::string_view name, std::string_view labels, int decimals) {
+  double v[QUANTILES];
+  sketch_.quantiles(quantiles, v, QUANTILES);
+  for (size_t k = 0; k < QUANTILES; ++k) {
+    buffer_.put(name);
+    buffer_.put("_distribution{");
+    buffer_.put(labels);
+    if (!labels.empty()) buffer_.put(',');
+    buffer_.put("quantile=\"");
+    buffer_.put(quantile_labels[k]);
+    buffer_.put("\"} ");
+    buffer_.put(v[k], decimals);
+    buffer_.put('\n');
+  }
+  for (int count = 0; count < 2; ++count) {
+    buffer_.put(name);
+    buffer_.put(count ? "_distribution_count" : "_distribution_sum");
+    if (!labels.empty()) {
+      buffer_.put('{');
+      buffer_.put(labels);
+      buffer_.put('}');
+    }
+    buffer_.put(' ');
+    if (count) buffer_.put(sketch_.count());
+    else buffer_.put(sketch_.mean() * static_cast<double>(sketch_.count()), decimals);
+    buffer_.put('\n');
+  }
+}
+
+bool PrometheusOutput::write(const xxx::CpuSensors::Snapshot& s, std::chrono::system_clock::time_point time) {
+  static const struct {
+    Channel::Type type;
+    const char* name;
+    const char* help;
+    int decimals;
+  } metrics[] = {
+    { Channel::Type::Load, "core_adjust_cpu_load_percent", "Processor load.", 0 },
+    { Channel::Type::Frequency, "core_adjust_cpu_frequency_mhz", "Current frequency (scaling_cur_freq).", 0 },
+    { Channel::Type::Temperature, "core_adjust_temperature_celsius", "Coretemp temperature.", 0 },
+    { Channel::Type::Power, "core_adjust_power_watts", "Average power of a RAPL power zone (or of the system, from the power supplies).", 3 },
+    { Channel::Type::Idle, "core_adjust_cpu_idle_residency_percent", "Time spent in a cpuidle state.", 1 },
+    { Channel::Type::IdleAbove, "core_adjust_cpu_idle_above_percent", "Idle state entries that were too deep for the idle time.", 1 },
+    { Channel::Type::IdleBelow, "core_adjust_cpu_idle_below_percent", "Idle state entries where a deeper state would have matched the idle time.", 1 },
+    { Channel::Type::Throttle, "core_adjust_thermal_throttle_events", "Thermal throttle events during the last interval.", 0 },
+    { Channel::Type::ThrottleTime, "core_adjust_thermal_throttle_milliseconds", "Time throttled during the last interval.", 0 },
+    { Channel::Type::Ipc, "core_adjust_cpu_instructions_per_cycle", "Instructions retired per cpu cycle.", 2 },
+    { Channel::Type::LlcMisses, "core_adjust_cpu_llc_misses_per_kilo_instructions", "Last level cache misses per 1000 instructions.", 2 },
+    { Channel::Type::BranchMisses, "core_adjust_cpu_branch_misses_per_kilo_instructions", "Branch mispredictions per 1000 instructions.", 2 },
+    { Channel::Type::Pressure, "core_adjust_pressure_stall_percent", "Time that some (or all) tasks stalled on a resource during the last interval (PSI).", 1 },
+    { Channel::Type::Stall, "core_adjust_pressure_stall_events", "PSI trigger events of a resource during the last interval.", 0 },
+    { Channel::Type::RunTime, "core_adjust_cpu_run_time_percent", "Time the cpu ran tasks during the last interval (schedstat).", 1 },
+    { Channel::Type::RunDelay, "core_adjust_cpu_run_delay_percent", "Time tasks waited on the run queue of the cpu during the last interval (schedstat).", 1 },
+    { Channel::Type::Timeslices, "core_adjust_cpu_timeslices", "Timeslices run on the cpu during the last interval (schedstat).", 0 }
+  };
+  if (tuning_.reload()) formatTuning();
+  throttle_.update();
+
+  buffer_.clear();
+  /* sensors */
+  for (const auto& m : metrics) {
+    buffer_.put("# HELP ");
+    buffer_.put(m.name);
+    buffer_.put(' ');
+    buffer_.put(m.help);
+    buffer_.put("\n# TYPE ");
+    buffer_.put(m.name);
+    buffer_.put(" gauge\n");
+    for (size_t i = 0; i < channels_.size(); ++i) {
+      if (channels_[i].type != m.type) continue;
+      buffer_.put(m.name);
+      buffer_.put(labels_[i]);
+      buffer_.put(' ');
+      buffer_.put(xxx::CpuSensors::value(s, channels_[i]), m.decimals);
+      buffer_.put('\n');
+    }
+    if (!sketches_ || std::find(std::begin(sketched_types), std::end(sketched_types), m.type)
+        == std::end(sketched_types)) continue;
+    bool first = true;
+    for (size_t i = 0; i < channels_.size(); ++i) {
+      if (channels_[i].type != m.type || !sketches_->copy(i, sketch_)) continue;
+      if (first) putSummaryHeader(m.name, "Distribution of the samples since the start (or the last reset).");
+      first = false;
+      std::string_view labels(labels_[i]);
+      putSummary(m.name, labels.substr(1, labels.size() - 2), sketch_decimals(m.type));
+    }
+  }
+  /* the energy of the power zones (counters) */
+  for (int lifetime = 0; lifetime < 2; ++lifetime) {
+    if (lifetime && !ledger_) break;
+    const char* name = lifetime ? "core_adjust_energy_lifetime_joules_total" : "core_adjust_energy_joules_total";
+    buffer_.put("# HELP ");
+    buffer_.put(name);
+    buffer_.put(lifetime ? " Energy used by a RAPL power zone (or the system), including the previous runs.\n"
+                         : " Energy used by a RAPL power zone (or the system) since the start.\n");
+    buffer_.put("# TYPE ");
+    buffer_.put(name);
+    buffer_.put(" counter\n");
+    size_t zone = 0;
+    for (size_t i = 0; i < channels_.size(); ++i) {
+      if (channels_[i].type != Channel::Type::Power) continue;
+      buffer_.put(name);
+      buffer_.put(labels_[i]);
+      buffer_.put(' ');
+      if (!lifetime)
+        buffer_.put((channels_[i].index < s.energy.size()) ? s.energy[channels_[i].index] : 0., 3);
+      else {
+        buffer_.put((zone < ledger_->zones().size()) ? ledger_->zones()[zone].lifetime : 0., 3);
+        ++zone;
+      }
+      buffer_.put('\n');
+    }
+  }
+  /* the inputs of the hwmon chips */
+  static const struct {
+    xxx::HwmonEntry::Kind kind;
+    const char* name;
+    const char* help;
+    int decimals;
+  } hwmon_metrics[] = {
+    { xxx::HwmonEntry::Kind::Temperature, "core_adjust_hwmon_temperature_celsius", "Temperature input of a hwmon chip.", 1 },
+    { xxx::HwmonEntry::Kind::Voltage, "core_adjust_hwmon_voltage_volts", "Voltage input of a hwmon chip.", 3 },
+    { xxx::HwmonEntry::Kind::Fan, "core_adjust_hwmon_fan_rpm", "Fan input of a hwmon chip.", 0 },
+    { xxx::HwmonEntry::Kind::Power, "core_adjust_hwmon_power_watts", "Power input of a hwmon chip.", 3 },
+    { xxx::HwmonEntry::Kind::Current, "core_adjust_hwmon_current_amperes", "Current input of a hwmon chip.", 3 }
+  };
+  for (const auto& m : hwmon_metrics) {
+    if (!hwmon_) break;
+    bool first = true;
+    for (const auto& e : *hwmon_) {
+      if (e.kind != m.kind || std::isnan(e.value)) continue;
+      if (first) {
+        buffer_.put("# HELP ");
+        buffer_.put(m.name);
+        buffer_.put(' ');
+        buffer_.put(m.help);
+        buffer_.put("\n# TYPE ");
+        buffer_.put(m.name);
+        buffer_.put(" gauge\n");
+        first = false;
+      }
+      buffer_.put(m.name);
+      buffer_.put("{chip=\"");
+      buffer_.putLabel(e.chip);
+      buffer_.put("\",device=\"");
+      buffer_.putLabel(e.device);
+      buffer_.put("\",sensor=\"");
+      buffer_.putLabel(e.label);
+      if (e.package != ULONG_MAX) {
+        buffer_.put("\",package=\"");
+        buffer_.put(static_cast<uint64_t>(e.package));
+      }
+      buffer_.put("\"} ");
+      buffer_.put(e.value, m.decimals);
+      buffer_.put('\n');
+    }
+  }
+  /* the aggregates of the cores and packages */
+  static const struct {
+    const char* name;
+    const char* help;
+    double xxx::CpuTopologyRollup::* value;
+    int decimals;
+    bool package;
+  } rollups[] = {
+    { "core_adjust_core_load_percent", "Mean load of the logical cpus of a core.", &xxx::CpuTopologyRollup::load, 1, false },
+    { "core_adjust_core_frequency_mhz", "Mean frequency of the logical cpus of a core.", &xxx::CpuTopologyRollup::frequency, 0, false },
+    { "core_adjust_core_temperature_celsius", "Coretemp temperature of a core.", &xxx::CpuTopologyRollup::temperature, 0, false },
+    { "core_adjust_package_load_percent", "Mean load of the logical cpus of a package.", &xxx::CpuTopologyRollup::load, 1, true },
+    { "core_adjust_package_frequency_mhz", "Mean frequency of the logical cpus of a package.", &xxx::CpuTopologyRollup::frequency, 0, true },
+    { "core_adjust_package_temperature_celsius", "Coretemp temperature of a package (or its hottest core).", &xxx::CpuTopologyRollup::temperature, 0, true },
+    { "core_adjust_package_energy_per_cycle_nanojoules", "Energy of a package per busy cycle of its logical cpus.", &xxx::CpuTopologyRollup::energy_per_cycle, 3, true }
+  };
+  for (const auto& m : rollups) {
+    const auto& v = m.package ? s.packages : s.cores;
+    buffer_.put("# HELP ");
+    buffer_.put(m.name);
+    buffer_.put(' ');
+    buffer_.put(m.help);
+    buffer_.put("\n# TYPE ");
+    buffer_.put(m.name);
+    buffer_.put(" gauge\n");
+    for (size_t i = 0; i < v.size(); ++i) {
+      if (v[i].cpus == 0) continue;
+      buffer_.put(m.name);
+      buffer_.put('{');
+      buffer_.put(m.package ? topology_->packages()[i].labels : topology_->cores()[i].labels);
+      buffer_.put("} ");
+      buffer_.put(v[i].*m.value, m.decimals);
+      buffer_.put('\n');
+    }
+  }
+  /* the percentiles of the cpus of each package */
+  static const char* const merged[MERGED_TYPES] = {
+    "core_adjust_package_load_percent",
+    "core_adjust_package_frequency_mhz",
+    "core_adjust_package_temperature_celsius"
+  };
+  for (size_t t = 0; sketches_ && t < MERGED_TYPES; ++t) {
+    putSummaryHeader(merged[t], "Distribution of the samples of the cpus of a package since the start (or the last reset).");
+    for (size_t p = 0; p < topology_->packages().size(); ++p) {
+      sketch_.reset();
+      if (sketches_->merge(sketched_types[t], p, sketch_) == 0) continue;
+      putSummary(merged[t], topology_->packages()[p].labels, sketch_decimals(sketched_types[t]));
+    }
+  }
+  /* thermal status bits */
+  for (int package = 0; package < 2; ++package) {
+    const auto& entries = package ? throttle_.packages() : throttle_.cpus();
+    const auto& labels = package ? throttle_package_labels_ : throttle_cpu_labels_;
+    const char* name = package ? "core_adjust_package_thermal_status" : "core_adjust_thermal_status";
+    buffer_.put("# HELP ");
+    buffer_.put(name);
+    buffer_.put(package ? " IA32_PACKAGE_THERM_STATUS status bits.\n" : " IA32_THERM_STATUS status bits.\n");
+    buffer_.put("# TYPE ");
+    buffer_.put(name);
+    buffer_.put(" gauge\n");
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (!entries[i].valid) continue;
+      for (const auto& b : throttle_bits) {
+        if (package && !b.package) continue;
+        buffer_.put(name);
+        buffer_.put('{');
+        buffer_.put(labels[i]);
+        buffer_.put(",status=\"");
+        buffer_.put(b.name);
+        buffer_.put("\"} ");
+        buffer_.put(entries[i].bit(b.bit) ? '1' : '0');
+        buffer_.put('\n');
+      }
+    }
+  }
+  /* tuning values */
+  buffer_.put(tuning_metrics_);
+  buffer_.put("# HELP core_adjust_sample_timestamp_seconds Time of the sample.\n"
+              "# TYPE core_adjust_sample_timestamp_seconds gauge\n"
+              "core_adjust_sample_timestamp_seconds ");
+  buffer_.put(std::chrono::duration<double>(time.time_since_epoch()).count(), 3);
+  buffer_.put('\n');
+
+  /* write the temporary file and rename it */
+  int fd = ::open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool ok = (fd >= 0) && buffer_.write(fd);
+  int error = errno;
+  if (fd >= 0 && ::close(fd) != 0 && ok) {
+    ok = false;
+    error = errno;
+  }
+  if (ok && ::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+    ok = false;
+    error = errno;
+  }
+  if (!ok) {
+    std::fprintf(stderr, "core-adjust-stat: could not write '%s': %s\n",
+        path_.c_str(), std::strerror(error));
+    ::unlink(tmp_path_.c_str());
+  }
+  return ok;
+}
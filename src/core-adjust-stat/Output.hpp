@@ -0,0 +1,213 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/core-adjust-stat/Output.hpp
+ * @brief Format the CpuSensors snapshots for core-adjust-stat.
+ */
+#ifndef core_adjust_stat_Output_hpp
+#define core_adjust_stat_Output_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CpuSensors.hpp"
+#include "EnergyLedger.hpp"
+#include "HwmonSensors.hpp"
+#include "SensorSketches.hpp"
+#include "ThrottleStatus.hpp"
+#include "TuningValues.hpp"
+
+/** @brief A character buffer that is reused for each sample.
+  *
+  * The buffer only grows (when a sample does not fit), so once the
+  * output of a sample fits formatting does not allocate memory. */
+class OutputBuffer {
+  public:
+    explicit OutputBuffer(size_t capacity = 4096) : buffer_(capacity) {}
+    inline void clear() { size_ = 0; }
+    inline const char* data() const { return buffer_.data(); }
+    inline size_t size() const { return size_; }
+    void put(std::string_view s);
+    void put(char c);
+    void put(int64_t value);
+    void put(uint64_t value);
+    void put(int value) { put(static_cast<int64_t>(value)); }
+    void put(unsigned int value) { put(static_cast<uint64_t>(value)); }
+    /** @brief Put a double in fixed notation with the given number of decimals. */
+    void put(double value, int decimals);
+    /** @brief Put a string as a (quoted and escaped) JSON string. */
+    void putJson(std::string_view s);
+    /** @brief Put a string as an (unquoted) escaped Prometheus label value. */
+    void putLabel(std::string_view s);
+    /** @brief Write the buffer to a file descriptor.
+      * @returns false on error. */
+    bool write(int fd) const;
+  private:
+    std::vector<char> buffer_;
+    size_t size_ { 0 };
+    char* reserve(size_t n);
+};
+
+/** @brief Base class of the output formats of core-adjust-stat. */
+class Output {
+  public:
+    /** @param channels The channels of the snapshots (see xxx::CpuSensors::Snapshot::layout).
+      * @param topology The topology of the snapshots (see xxx::CpuSensors::Snapshot::topology). */
+    Output(std::vector<xxx::CpuSensors::Channel> channels,
+        std::shared_ptr<const xxx::CpuTopology> topology);
+    virtual ~Output() = default;
+    /** @brief Write the output for a snapshot.
+      * @param time The (wall clock) time of the snapshot.
+      * @returns false if the output could not be written. */
+    virtual bool write(const xxx::CpuSensors::Snapshot& snapshot,
+        std::chrono::system_clock::time_point time) = 0;
+    /** @brief Write the output that follows the last snapshot.
+      * @returns false if the output could not be written. */
+    virtual bool finish() { return true; }
+    /** @brief Add the p50, p95 and p99 of the load, frequency, temperature
+      * and power channels (nullptr == no percentiles).
+      * @note The snapshot must be appended to the sketches before write() is called. */
+    inline void setSketches(const xxx::SensorSketches* sketches) { sketches_ = sketches; }
+    /** @brief Add the lifetime energy of the power zones (nullptr == no lifetime energy).
+      * @note The ledger must be updated with the snapshot before write() is called. */
+    inline void setLedger(const xxx::EnergyLedger* ledger) { ledger_ = ledger; }
+    /** @brief Add the inputs of the hwmon chips (nullptr == no hwmon inputs, not in the column format).
+      * @note The inputs must be updated before write() is called. */
+    inline void setHwmon(const xxx::HwmonSensors* hwmon) { hwmon_ = hwmon; }
+  protected:
+    std::vector<xxx::CpuSensors::Channel> channels_;
+    std::shared_ptr<const xxx::CpuTopology> topology_;
+    OutputBuffer buffer_;
+    const xxx::SensorSketches* sketches_ { nullptr };
+    const xxx::EnergyLedger* ledger_ { nullptr };
+    const xxx::HwmonSensors* hwmon_ { nullptr };
+    /* (reused for each channel so formatting does not allocate) */
+    xxx::PercentileSketch sketch_;
+};
+
+/** @brief Turbostat style output.
+  *
+  * A summary row ('-') with the system load, the average frequency, all
+  * temperatures and all power zones, followed by a row with the load and
+  * frequency of each logical cpu (unless summary_only is true).
+  * On multi-socket systems the summary row is followed by a row ('pN')
+  * with the load and frequency of each package.
+  * The columns are separated by tabs, a header is written every 'header_rows' samples.
+  * The percentiles (if any) are written by finish(), a row for each channel
+  * followed by a row for the cpus of each package. */
+class ColumnOutput : public Output {
+  public:
+    ColumnOutput(std::vector<xxx::CpuSensors::Channel> channels,
+        std::shared_ptr<const xxx::CpuTopology> topology,
+        bool summary_only, unsigned header_rows = 20);
+    bool write(const xxx::CpuSensors::Snapshot& snapshot,
+        std::chrono::system_clock::time_point time) override;
+    bool finish() override;
+  private:
+    bool summary_only_;
+    unsigned header_rows_;
+    unsigned rows_ { 0 };
+    std::string header_;
+    /* Indexes into channels_ (the frequency of each load channel or SIZE_MAX) */
+    std::vector<size_t> load_, frequency_, temperature_, power_;
+};
+
+/** @brief Newline delimited JSON output, one object for each sample:
+  *
+  * {"time":<ms since the Unix epoch>,"load":{"cpu":..,"cpu0":..},
+  *  "frequency":{"cpu0":..},"temperature":{"Core 0":..},"power":{"package-0":..},
+  *  "idle":{"cpu0/C1":..},"idle_above":{"cpu0":..},"idle_below":{"cpu0":..},
+  *  "throttle":{"cpu0":..,"package0":..,"package0/cores":..},"throttle_time":{..},
+  *  "ipc":{"cpu0":..},"llc_mpki":{"cpu0":..},"branch_mpki":{"cpu0":..},
+  *  "pressure":{"cpu/some":..,"system.slice/cpu/some":..},"stalls":{"cpu":..},
+  *  "run_time":{"cpu0":..},"run_delay":{"cpu0":..},"timeslices":{"cpu0":..},
+  *  "energy":{"package-0":<J since the start>},"lifetime_energy":{"package-0":<J>},
+  *  "hwmon":{"nct6775/fan2":..,"coretemp-1/Core 0":..},
+  *  "packages":{"package0":{"load":..,"frequency":..,"temperature":..,"power":..,
+  *   "energy":..,"energy_per_cycle":<nJ>}},
+  *  "cores":{"package0/core0":{"load":..,"frequency":..,"temperature":..}},
+  *  "percentiles":{"load":{"cpu0":[p50,p95,p99]},"frequency":{..},"temperature":{..},"power":{..},
+  *   "packages":{"package0":{"load":[..],"frequency":[..],"temperature":[..]}}}}
+  * (a package without channels of a type has null percentiles,
+  * the percentiles are only written when sketches are set, see Output::setSketches(),
+  * the lifetime energy only when a ledger is set, see Output::setLedger(),
+  * the hwmon inputs only when set, see Output::setHwmon(), an input that
+  * could not be read is null). */
+class JsonOutput : public Output {
+  public:
+    JsonOutput(std::vector<xxx::CpuSensors::Channel> channels,
+        std::shared_ptr<const xxx::CpuTopology> topology);
+    bool write(const xxx::CpuSensors::Snapshot& snapshot,
+        std::chrono::system_clock::time_point time) override;
+  private:
+    /* The quoted and escaped name of each channel followed by ':' */
+    std::vector<std::string> keys_;
+    /* The same for each package and core of topology_ */
+    std::vector<std::string> package_keys_;
+    std::vector<std::string> core_keys_;
+    void putPercentiles(int decimals);
+};
+
+/** @brief Prometheus text format output for the node_exporter textfile collector.
+  *
+  * Each sample rewrites the output file: the metrics are written to
+  * '<file>.tmp' which is then renamed to '<file>', so the collector never
+  * reads a partially written file.
+  * Besides the sensors the file contains the thermal status bits (MSRs)
+  * and the tuning values from the Core Adjust INI file (reread when modified).
+  * The metrics of a logical cpu are labeled with its core and package,
+  * the aggregates of each core and package are separate metrics.
+  * The percentiles (see Output::setSketches()) are summaries named after
+  * the gauge with a '_distribution' suffix.
+  * The energy of the power zones is a counter (joules since the start),
+  * the lifetime energy (see Output::setLedger()) includes the previous runs.
+  * The hwmon inputs (see Output::setHwmon()) are labeled with their chip,
+  * hwmon device and label (and the package of a coretemp input). */
+class PrometheusOutput : public Output {
+  public:
+    PrometheusOutput(std::vector<xxx::CpuSensors::Channel> channels,
+        std::shared_ptr<const xxx::CpuTopology> topology,
+        std::string path, std::string config_file);
+    bool write(const xxx::CpuSensors::Snapshot& snapshot,
+        std::chrono::system_clock::time_point time) override;
+  private:
+    std::string path_;
+    std::string tmp_path_;
+    xxx::ThrottleStatus throttle_;
+    TuningValues tuning_;
+    /* The label set of each channel, ie. '{cpu="3",core="1",package="0"}' */
+    std::vector<std::string> labels_;
+    /* The label of each cpu/package of throttle_, ie. 'cpu="3"' */
+    std::vector<std::string> throttle_cpu_labels_;
+    std::vector<std::string> throttle_package_labels_;
+    /* The (formatted) metrics of tuning_ */
+    std::string tuning_metrics_;
+    void formatTuning();
+    /* Put the HELP and TYPE of a summary */
+    void putSummaryHeader(std::string_view name, std::string_view help);
+    /* Put the quantiles, sum and count of sketch_ ('labels' without braces) */
+    void putSummary(std::string_view name, std::string_view labels, int decimals);
+};
+
+#endif
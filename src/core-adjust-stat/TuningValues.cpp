@@ -0,0 +1,105 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/core-adjust-stat/TuningValues.cpp
+ * @brief Read the tuning values from the Core Adjust INI file (implementation).
+ */
+
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sys/stat.h>
+#include "Strings.hpp"
+#include "TuningValues.hpp"
+
+TuningValues::TuningValues(std::string path)
+  : path_(std::move(path)) {
+  reload();
+}
+
+bool TuningValues::reload() {
+  struct stat st;
+  if (stat(path_.c_str(), &st) != 0) {
+    bool changed = loaded_;
+    processors_.clear();
+    loaded_ = false;
+    return changed;
+  }
+  if (loaded_ && st.st_mtim.tv_sec == mtime_.tv_sec && st.st_mtim.tv_nsec == mtime_.tv_nsec)
+    return false;
+  mtime_ = st.st_mtim;
+  loaded_ = true;
+  processors_.clear();
+
+  /* Read the 'key=value' pairs of all 'ProcessorN' sections */
+  std::map<unsigned long, std::map<std::string, std::string>> sections;
+  std::map<std::string, std::string>* section = nullptr;
+  std::ifstream ifs(path_);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    xxx::trim(line);
+    if (line.empty() || line[0] == ';' || line[0] == '#') continue;
+    if (line.front() == '[' && line.back() == ']') {
+      section = nullptr;
+      auto name = line.substr(1, line.size() - 2);
+      /* (a section with an id that is not a number or out of range is skipped) */
+      unsigned long id;
+      if (name.compare(0, 9, "Processor") != 0 || name.size() <= 9) continue;
+      auto [end, ec] = std::from_chars(name.data() + 9, name.data() + name.size(), id);
+      if (ec == std::errc() && end == name.data() + name.size()) section = &sections[id];
+      continue;
+    }
+    auto eq = line.find('=');
+    if (section == nullptr || eq == std::string::npos) continue;
+    (*section)[line.substr(0, eq)] = line.substr(eq + 1);
+  }
+
+  /* Convert the enabled values */
+  for (const auto& [id, values] : sections) {
+    auto enabled = [&values](const std::string& key) {
+      auto it = values.find(key);
+      return it != values.end() && it->second == "true";
+    };
+    auto value = [&values](const std::string& key, auto& out) {
+      auto it = values.find(key);
+      if (it == values.end() || it->second.empty()) return;
+      char* end = nullptr;
+      double d = std::strtod(it->second.c_str(), &end);
+      if (*end == '\0') out = static_cast<typename std::decay_t<decltype(out)>::value_type>(d);
+    };
+    Processor p;
+    p.id = id;
+    for (size_t plane = 0; plane < p.voltage_offset.size(); ++plane) {
+      auto key = "Voltage_Offset_Plane_" + std::to_string(plane);
+      if (enabled(key + "_Enabled")) value(key, p.voltage_offset[plane]);
+    }
+    if (enabled("Target_Temperature_Enabled"))
+      value("Target_Temperature", p.target_temperature);
+    if (enabled("Target_Temperature_Battery_Enabled"))
+      value("Target_Temperature_Battery", p.target_temperature_battery);
+    if (enabled("TBT_Ratio_Limit_Enabled")) {
+      for (size_t cores = 0; cores < p.turbo_ratio_limit.size(); ++cores)
+        value("TBT_Ratio_Limit_" + std::to_string(cores + 1) + "C", p.turbo_ratio_limit[cores]);
+    }
+    processors_.push_back(std::move(p));
+  }
+  return true;
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/core-adjust-stat/TuningValues.hpp
+ * @brief Read the tuning values from the Core Adjust INI file.
+ */
+#ifndef core_adjust_stat_TuningValues_hpp
+#define core_adjust_stat_TuningValues_hpp
+
+#include <array>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <vector>
+
+/** @brief The tuning values of each processor as stored in the Core Adjust INI file.
+  *
+  * These are the values that the core-adjust script applies, a value is
+  * only present if it is enabled in the INI file (ie. 'Target_Temperature_Enabled=true'). */
+class TuningValues {
+  public:
+    struct Processor {
+      /** @brief The physical id of the processor ('ProcessorN' section). */
+      unsigned long id;
+      /** @brief FIVR voltage offset of plane 0...5 in mV. */
+      std::array<std::optional<double>, 6> voltage_offset;
+      /** @brief Target temperature in °C (AC powered). */
+      std::optional<unsigned> target_temperature;
+      /** @brief Target temperature in °C (battery powered). */
+      std::optional<unsigned> target_temperature_battery;
+      /** @brief Turbo ratio limit for 1...18 active cores. */
+      std::array<std::optional<unsigned>, 18> turbo_ratio_limit;
+    };
+
+    explicit TuningValues(std::string path);
+
+    /** @brief Read the INI file if it was modified since the last call.
+      * @returns true if the file was (re)read. */
+    bool reload();
+
+    /** @brief The processors found in the INI file. */
+    inline const std::vector<Processor>& processors() const { return processors_; }
+
+  private:
+    std::string path_;
+    struct timespec mtime_ { 0, 0 };
+    bool loaded_ { false };
+    std::vector<Processor> processors_;
+};
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/core-adjust-stat/main.cpp
+ * @brief Core Adjust headless sensor sampler entry point.
+ */
+// STL
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+// POSIX
+#include <getopt.h>
+#include <sys/resource.h>
+#include <time.h>
+// App
+#include "config.h"
+#include "CpuSensors.hpp"
+#include "EnergyLedger.hpp"
+#include "HwmonSensors.hpp"
+#include "Output.hpp"
+#include "RuleEngine.hpp"
+#include "SensorSketches.hpp"
+
+#ifndef CONFIG_FILE
+#define CONFIG_FILE "/etc/core-adjust/core-adjust.ini"
+#endif
+
+namespace {
+
+  volatile std::sig_atomic_t stop_requested = 0;
+  volatile std::sig_atomic_t reset_requested = 0;
+
+  void signal_handler(int) {
+    stop_requested = 1;
+  }
+
+  void reset_handler(int) {
+    reset_requested = 1;
+  }
+
+  void usage(FILE* f) {
+    std::fprintf(f,
+        "Usage: core-adjust-stat [OPTION]...\n"
+        "Sample the processor load, frequency, temperature and power.\n"
+        "\n"
+        "  -i, --interval=MS     time between two samples (default 1000)\n"
+        "  -n, --count=N         exit after N samples (default 0, run until interrupted)\n"
+        "  -f, --format=FORMAT   'columns' (default), 'json' (newline delimited)\n"
+        "                        or 'prometheus' (node_exporter textfile collector)\n"
+        "  -o, --output=FILE     the file that is rewritten for each sample (prometheus format)\n"
+        "  -c, --config=FILE     the Core Adjust INI file (prometheus format, default %s)\n"
+        "  -p, --percentiles     add the p50, p95 and p99 of the load, frequency, temperature\n"
+        "                        and power since the start (SIGUSR1 restarts them)\n"
+        "  -r, --rules=FILE      evaluate the threshold rules in FILE on each sample\n"
+        "  -E, --energy-file=FILE\n"
+        "                        add the lifetime energy of the power zones and save it\n"
+        "                        to FILE (every minute and on exit)\n"
+        "  -H, --hwmon           add the temperature, voltage, fan, power and current inputs\n"
+        "                        of all hwmon chips (json and prometheus formats)\n"
+        "  -S, --summary         only print the summary row (columns format)\n"
+        "  -O, --overhead        print the CPU time used by this program on exit\n"
+        "      --no-io-uring     read the sensors using pread() instead of io_uring\n"
+        "  -h, --help            display this help and exit\n"
+        "  -V, --version         output version information and exit\n",
+        CONFIG_FILE);
+  }
+
+  double cpu_seconds() {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0.;
+    return static_cast<double>(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)
+        + static_cast<double>(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+  }
+
+} // ends namespace
+
+int main(int argc, char** argv) {
+  long interval_ms = 1000;
+  unsigned long count = 0;
+  enum class Format { Columns, Json, Prometheus } format = Format::Columns;
+  std::string output_file;
+  std::string config_file(CONFIG_FILE);
+  std::string rules_file;
+  std::string energy_file;
+  bool summary_only = false;
+  bool overhead = false;
+  bool percentiles = false;
+  bool hwmon_inputs = false;
+  bool use_io_uring = true;
+
+  /* Parse the command line */
+  enum { NO_IO_URING = 256 };
+  static const struct option options[] = {
+    { "interval", required_argument, nullptr, 'i' },
+    { "count", required_argument, nullptr, 'n' },
+    { "format", required_argument, nullptr, 'f' },
+    { "output", required_argument, nullptr, 'o' },
+    { "config", required_argument, nullptr, 'c' },
+    { "percentiles", no_argument, nullptr, 'p' },
+    { "rules", required_argument, nullptr, 'r' },
+    { "energy-file", required_argument, nullptr, 'E' },
+    { "hwmon", no_argument, nullptr, 'H' },
+    { "summary", no_argument, nullptr, 'S' },
+    { "overhead", no_argument, nullptr, 'O' },
+    { "no-io-uring", no_argument, nullptr, NO_IO_URING },
+    { "help", no_argument, nullptr, 'h' },
+    { "version", no_argument, nullptr, 'V' },
+    { nullptr, 0, nullptr, 0 }
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "i:n:f:o:c:pr:E:HSOhV", options, nullptr)) != -1) {
+    char* end = nullptr;
+    switch (opt) {
+      case 'i':
+        interval_ms = std::strtol(optarg, &end, 10);
+        if (*optarg == '\0' || *end != '\0' || interval_ms < 10) {
+          std::fprintf(stderr, "core-adjust-stat: invalid interval '%s' (minimum 10 ms)\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'n':
+        count = std::strtoul(optarg, &end, 10);
+        if (*optarg == '\0' || *end != '\0') {
+          std::fprintf(stderr, "core-adjust-stat: invalid count '%s'\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'f':
+        if (std::strcmp(optarg, "json") == 0) format = Format::Json;
+        else if (std::strcmp(optarg, "columns") == 0) format = Format::Columns;
+        else if (std::strcmp(optarg, "prometheus") == 0) format = Format::Prometheus;
+        else {
+          std::fprintf(stderr, "core-adjust-stat: unknown format '%s'\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'o': output_file = optarg; break;
+      case 'c': config_file = optarg; break;
+      case 'p': percentiles = true; break;
+      case 'r': rules_file = optarg; break;
+      case 'E': energy_file = optarg; break;
+      case 'H': hwmon_inputs = true; break;
+      case 'S': summary_only = true; break;
+      case 'O': overhead = true; break;
+      case NO_IO_URING: use_io_uring = false; break;
+      case 'h': usage(stdout); return EXIT_SUCCESS;
+      case 'V': std::printf("core-adjust-stat (%s) %s\n", PACKAGE_NAME, PACKAGE_VERSION); return EXIT_SUCCESS;
+      default: usage(stderr); return EXIT_FAILURE;
+    }
+  }
+  if (format == Format::Prometheus && output_file.empty()) {
+    std::fprintf(stderr, "core-adjust-stat: the prometheus format requires --output=FILE\n");
+    return EXIT_FAILURE;
+  }
+
+  /* Stop (at the next sample) on SIGINT/SIGTERM, do not restart the sleep.
+   * A closed stdout (ie. a pipe to 'head') makes write() fail with EPIPE.
+   * SIGUSR1 restarts the percentiles at the next sample. */
+  struct sigaction sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signal_handler;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+  sa.sa_handler = reset_handler;
+  sigaction(SIGUSR1, &sa, nullptr);
+
+  /* Open the sensors and preallocate the output buffer,
+   * all memory is allocated before (and while formatting) the first sample. */
+  xxx::CpuSensors sensors(use_io_uring);
+  auto make_output = [&](const std::vector<xxx::CpuSensors::Channel>& channels,
+      const std::shared_ptr<const xxx::CpuTopology>& topology) {
+    std::unique_ptr<Output> output;
+    switch (format) {
+      case Format::Columns:
+        output = std::make_unique<ColumnOutput>(channels, topology, summary_only);
+        break;
+      case Format::Json:
+        output = std::make_unique<JsonOutput>(channels, topology);
+        break;
+      case Format::Prometheus:
+        output = std::make_unique<PrometheusOutput>(channels, topology, output_file, config_file);
+        break;
+    }
+    return output;
+  };
+  auto layout = sensors.layout();
+  std::unique_ptr<Output> output = make_output(*layout, sensors.topology());
+  std::unique_ptr<xxx::SensorSketches> sketches;
+  if (percentiles) {
+    sketches = std::make_unique<xxx::SensorSketches>(*layout);
+    output->setSketches(sketches.get());
+  }
+  std::unique_ptr<xxx::EnergyLedger> ledger;
+  if (!energy_file.empty()) {
+    ledger = std::make_unique<xxx::EnergyLedger>(energy_file);
+    output->setLedger(ledger.get());
+  }
+  std::unique_ptr<xxx::HwmonSensors> hwmon;
+  if (hwmon_inputs) {
+    hwmon = std::make_unique<xxx::HwmonSensors>();
+    output->setHwmon(hwmon.get());
+  }
+
+  /* The rules are compiled (and their channels resolved) before the first sample */
+  std::unique_ptr<xxx::RuleEngine> rules;
+  if (!rules_file.empty()) {
+    try {
+      rules = std::make_unique<xxx::RuleEngine>(rules_file);
+    }
+    catch (const std::runtime_error& e) {
+      std::fprintf(stderr, "core-adjust-stat: %s\n", e.what());
+      return EXIT_FAILURE;
+    }
+    rules->setLogger([](const char* message) { std::fprintf(stderr, "core-adjust-stat: %s\n", message); });
+    rules->bind(*layout, sensors.cpu_power());
+  }
+
+  /* Sample at a fixed (drift free) rate, the first sample is taken
+   * after one interval so it has valid load values. */
+  auto start = std::chrono::steady_clock::now();
+  double start_cpu = cpu_seconds();
+  auto saved = start;
+  unsigned long samples = 0;
+  bool failed = false;
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (!stop_requested && (count == 0 || samples < count)) {
+    next.tv_sec += interval_ms / 1000;
+    next.tv_nsec += (interval_ms % 1000) * 1000000L;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_sec += 1;
+      next.tv_nsec -= 1000000000L;
+    }
+    int rv;
+    while ((rv = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr)) == EINTR
+        && !stop_requested) {}
+    if (rv != 0) break;
+    sensors.update();
+    const auto& snapshot = sensors.snapshot();
+    if (sketches) {
+      if (reset_requested) {
+        reset_requested = 0;
+        sketches->reset();
+      }
+      sketches->append(snapshot);
+    }
+    if (ledger) {
+      ledger->update(snapshot);
+      if (std::chrono::steady_clock::now() - saved >= std::chrono::minutes(1)) {
+        saved = std::chrono::steady_clock::now();
+        if (!ledger->save())
+          std::fprintf(stderr, "core-adjust-stat: could not write '%s': %s\n",
+              energy_file.c_str(), std::strerror(errno));
+      }
+    }
+    /* Cpus were hotplugged, start over with the new channels
+     * (the column format prints a new header). */
+    if (snapshot.layout != layout) {
+      layout = snapshot.layout;
+      output = make_output(*layout, snapshot.topology);
+      output->setSketches(sketches.get());
+      output->setLedger(ledger.get());
+      output->setHwmon(hwmon.get());
+      if (rules) {
+        rules->hotplug();
+        rules->bind(*layout, sensors.cpu_power());
+      }
+      /* (the coretemp hwmon of a package is removed with its last cpu) */
+      if (hwmon) hwmon->hotplug();
+    }
+    if (hwmon) hwmon->update();
+    if (rules) rules->evaluate(snapshot);
+    if (!output->write(snapshot, std::chrono::system_clock::now())) {
+      failed = true;
+      break;
+    }
+    ++samples;
+  }
+  if (!failed && !output->finish()) failed = true;
+  if (ledger && !ledger->save()) {
+    std::fprintf(stderr, "core-adjust-stat: could not write '%s': %s\n",
+        energy_file.c_str(), std::strerror(errno));
+    failed = true;
+  }
+
+  if (overhead) {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = cpu_seconds() - start_cpu;
+    std::fprintf(stderr,
+        "core-adjust-stat: %lu samples in %.3f s, CPU time %.3f ms (%.4f%% of one core, %.1f us per sample)\n",
+        samples, elapsed, cpu * 1e3, (elapsed > 0) ? cpu / elapsed * 100. : 0.,
+        (samples > 0) ? cpu / samples * 1e6 : 0.);
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
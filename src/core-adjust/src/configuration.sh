@@ -197,6 +197,8 @@ ParseConfigurationFile() {
           "Apply_On_Boot_And_Resume") apply_on_boot_and_resume=${BASH_REMATCH[2]};;
           "Apply_On_Acpi_Power_Event") apply_on_acpi_power_event=${BASH_REMATCH[2]};;
           "GUI_Save_On_Exit") gui_save=${BASH_REMATCH[2]};;
+          # Used by the GUI only
+          "GUI_Monitor_Sample_Interval"|"GUI_Monitor_Sample_Interval_Max"|"GUI_Monitor_Refresh_Interval") ;;
           # SMP
           "SMT_Disable_Enabled") smp_disable_enable=${BASH_REMATCH[2]};;
           "SMT_Disable") smp_disable=${BASH_REMATCH[2]};;
@@ -22,162 +22,239 @@
  * @file src/libcommon/CpuActivity.cpp
  * @brief Measure CPU activity by interpreting /proc/stat.
  */
-#include <fstream>
-#include <sstream>
-#include <string>
+#include <algorithm>
+#include <charconv>
+#include <climits>
 
 #include "CpuActivity.hpp"
 
 namespace xxx {
 
+  void CpuActivity::Statistics::resize(size_t cpus) {
+    for (auto& v : sample) v.resize(cpus, 0);
+    for (auto& v : time) v.resize(cpus, 0);
+    for (auto& v : period) v.resize(cpus, 0);
+    for (auto& v : percent) v.resize(cpus, 0);
+    scale.resize(cpus, 0.);
+  }
+
   CpuActivity::CpuActivity(bool detail, bool account_for_guest)
-    : detailed_cpu_activity_(detail), account_for_guest_(account_for_guest) {
+    : detailed_cpu_activity_(detail),
+      account_for_guest_(account_for_guest),
+      proc_stat_("/proc/stat"),
+      buffer_(4096) {
     /* Scan the /proc/stat file for entries starting with 'cpu' or 'cpuN'
      * (where N is a positive value starting at 0) and create a place where
-     * the statistics on those lines will be stored. */
-    std::string line_buf;
-    std::string label;
-    std::ifstream ifs("/proc/stat");
-    while (ifs.good()) {
-      std::getline(ifs, line_buf);
-      std::istringstream iss(line_buf);
-      iss >> label;
-      if (label.find("cpu") == 0) {
-        cpu_stats_.emplace_back();
-        emplace_back();
-      }
+     * the statistics on those lines will be stored.
+     * (This also primes the counters so that the first update() reports
+     * the activity since construction instead of the activity since boot.) */
+    calculate(parse(read()));
+  }
+
+  std::string_view CpuActivity::read() {
+    while (true) {
+      ssize_t n = proc_stat_.read(buffer_.data(), buffer_.size());
+      if (n <= 0) return std::string_view();
+      /* The 'cpu' lines are listed first, if the buffer is too small to
+       * hold all of them then enlarge it and read again. */
+      std::string_view text(buffer_.data(), static_cast<size_t>(n));
+      if (static_cast<size_t>(n) < buffer_.size() ||
+          text.rfind("\nintr") != std::string_view::npos) return text;
+      buffer_.resize(buffer_.size() * 2);
     }
   }
 
-  void CpuActivity::update()
-  {
+  size_t CpuActivity::parse(std::string_view text) {
+    using S = Statistics;
     size_t cpu_count = 0;
 
-    uint64_t user_time, nice_time, system_time, idle_time,
-        io_wait, irq, soft_irq, steal, guest, guest_nice,
-        idle_all_time, system_all_time, guest_all_time, total_time;
-
-    std::string line_buf;
-    std::string label;
-    std::ifstream ifs("/proc/stat");
-
-    while (ifs.good()) {
-      /* Read a line of text from /proc/stat and extract the 'label'. */
-      std::getline(ifs, line_buf);
-      std::istringstream iss(line_buf);
-      iss >> label;
-
-      /* We are only interested in lines that are labeled 'cpu' or 'cpuN'. */
-      if (label.find("cpu") == 0) {
-
-        /* Extract the (10) values from the line. */
-        iss >> user_time >> nice_time >> system_time >> idle_time
-            >> io_wait >> irq >> soft_irq >> steal >> guest >> guest_nice;
-
-        /* Guest time is already accounted for in user_time/nice_time. */
-        user_time = user_time - guest;
-        nice_time = nice_time - guest_nice;
-
-        /* Calculate totals. */
-        idle_all_time = idle_time + io_wait;
-        system_all_time = system_time + irq + soft_irq;
-        guest_all_time = guest + guest_nice;
-        total_time = user_time + nice_time + system_all_time + idle_all_time + steal + guest_all_time;
-
-        /* Update the statistics and calculate the percentages for this cpu. */
-        try {
-          Statistics& stats = cpu_stats_.at(cpu_count);
-          CpuActivityEntry& cpu_activity = at(cpu_count);
-          ++cpu_count;
-
-          stats.period.user = wrap_substract(user_time, stats.time.user);
-          stats.period.nice = wrap_substract(nice_time, stats.time.nice);
-          stats.period.system = wrap_substract(system_time, stats.time.system);
-          stats.period.idle = wrap_substract(idle_time, stats.time.idle);
-          stats.period.io_wait = wrap_substract(io_wait, stats.time.io_wait);
-          stats.period.irq = wrap_substract(irq, stats.time.irq);
-          stats.period.soft_irq = wrap_substract(soft_irq, stats.time.soft_irq);
-          stats.period.steal = wrap_substract(steal, stats.time.steal);
-          stats.period.guest = wrap_substract(guest_all_time, stats.time.guest);
-          stats.period.system_all = wrap_substract(system_all_time, stats.time.system_all);
-          stats.period.idle_all = wrap_substract(idle_all_time, stats.time.idle_all);
-          stats.period.total = wrap_substract(total_time, stats.time.total);
-
-          stats.time.user = user_time;
-          stats.time.nice = nice_time;
-          stats.time.system = system_time;
-          stats.time.idle = idle_time;
-          stats.time.io_wait = io_wait;
-          stats.time.irq = irq;
-          stats.time.soft_irq = soft_irq;
-          stats.time.steal = steal;
-          stats.time.guest = guest_all_time;
-          stats.time.system_all = system_all_time;
-          stats.time.idle_all = idle_all_time;
-          stats.time.total = total_time;
-
-          double period_total =
-              (stats.period.total == 0) ? 1. : stats.period.total;
-
-          unsigned int percent_total;
-
-          cpu_activity.nice =
-              static_cast<unsigned int>(stats.period.nice / period_total * 100.);
-          cpu_activity.user =
-              static_cast<unsigned int>(stats.period.user / period_total * 100.);
-
-          if (detailed_cpu_activity_) {
-            cpu_activity.kernel =
-                static_cast<unsigned int>(stats.period.system / period_total * 100.);
-            cpu_activity.irq =
-                static_cast<unsigned int>(stats.period.irq / period_total * 100.);
-            cpu_activity.soft_irq =
-                static_cast<unsigned int>(stats.period.soft_irq / period_total * 100.);
-            cpu_activity.steal =
-                static_cast<unsigned int>(stats.period.steal / period_total * 100.);
-            cpu_activity.guest =
-                static_cast<unsigned int>(stats.period.guest / period_total * 100.);
-            cpu_activity.io_wait =
-                static_cast<unsigned int>(stats.period.io_wait / period_total * 100.);
-
-            if (account_for_guest_) {
-               percent_total =
-                   cpu_activity.nice + cpu_activity.user +
-                   cpu_activity.kernel + cpu_activity.irq +
-                   cpu_activity.soft_irq + cpu_activity.steal +
-                   cpu_activity.guest;
-            } else {
-               percent_total =
-                   cpu_activity.nice + cpu_activity.user +
-                   cpu_activity.kernel + cpu_activity.irq +
-                   cpu_activity.soft_irq;
-            }
-          }
-          else {
-            cpu_activity.kernel =
-                static_cast<unsigned int>(stats.period.system_all / period_total * 100.);
-            cpu_activity.irq =
-                static_cast<unsigned int>((stats.period.steal + stats.period.guest) / period_total * 100.);
-            percent_total =
-                cpu_activity.nice + cpu_activity.user +
-                cpu_activity.kernel + cpu_activity.irq;
-          }
-
-          cpu_activity.total = clamp(percent_total, 0, 100);
+    while (!text.empty()) {
+      /* Get the next (complete) line of text. */
+      size_t eol = text.find('\n');
+      if (eol == std::string_view::npos) break;
+      std::string_view line = text.substr(0, eol);
+      text.remove_prefix(eol + 1);
 
-        }
-        catch(...) {
-          /*
-           * Catch out-of-bound exceptions,
-           * a new hotplugged cpu will be picked up on the next update.
-           */
-          cpu_stats_.emplace_back();
-          emplace_back();
-          return;
+      /* We are only interested in lines that are labeled 'cpu' or 'cpuN'.
+       * These lines are listed first, stop at the first other line. */
+      if (line.compare(0, 3, "cpu") != 0) break;
+
+      /* A new hotplugged cpu, make room for its statistics. */
+      if (cpu_count >= cpu_stats_.size()) cpu_stats_.resize(cpu_count + 1);
+      if (cpu_count >= parsed_.size()) parsed_.resize(cpu_count + 1);
+
+      /* The logical cpu number of the line ('cpu' is the aggregate). */
+      size_t label = std::min(line.find(' '), line.size());
+      size_t& logical = parsed_[cpu_count];
+      if (std::from_chars(line.data() + 3, line.data() + label, logical).ec != std::errc())
+        logical = ULONG_MAX;
+
+      /* Extract the (10) values from the line (skipping the label). */
+      line.remove_prefix(label);
+      uint64_t v[10] {};
+      for (auto& value : v) {
+        size_t pos = line.find_first_not_of(' ');
+        if (pos == std::string_view::npos) break;
+        line.remove_prefix(pos);
+        SysfsAttribute::Parse(line, value);
+        line.remove_prefix(std::min(line.find(' '), line.size()));
+      }
+
+      const uint64_t &user_time = v[0], &nice_time = v[1], &system_time = v[2],
+          &idle_time = v[3], &io_wait = v[4], &irq = v[5], &soft_irq = v[6],
+          &steal = v[7], &guest = v[8], &guest_nice = v[9];
+
+      auto& sample = cpu_stats_.sample;
+      const size_t i = cpu_count++;
+
+      /* Guest time is already accounted for in user_time/nice_time. */
+      sample[S::USER][i] = user_time - guest;
+      sample[S::NICE][i] = nice_time - guest_nice;
+      sample[S::SYSTEM][i] = system_time;
+      sample[S::IDLE][i] = idle_time;
+      sample[S::IO_WAIT][i] = io_wait;
+      sample[S::IRQ][i] = irq;
+      sample[S::SOFT_IRQ][i] = soft_irq;
+      sample[S::STEAL][i] = steal;
+      sample[S::GUEST][i] = guest + guest_nice;
+
+      /* Calculate totals. */
+      sample[S::IDLE_ALL][i] = idle_time + io_wait;
+      sample[S::SYSTEM_ALL][i] = system_time + irq + soft_irq;
+      sample[S::TOTAL][i] =
+          sample[S::USER][i] + sample[S::NICE][i] + sample[S::SYSTEM_ALL][i] +
+          sample[S::IDLE_ALL][i] + steal + sample[S::GUEST][i];
+    }
+    return cpu_count;
+  }
+
+  void CpuActivity::arrange(size_t cpus) {
+    if (logical_.size() == cpus
+        && std::equal(logical_.begin(), logical_.end(), parsed_.begin())) return;
+    /* The cpus in /proc/stat changed (or this is the first update).
+     * A cpu that was online keeps its previous counters, a new cpu starts
+     * with its current counters (so its first period is empty instead of
+     * the time since boot). */
+    std::vector<uint64_t> time(cpus);
+    for (size_t f = 0; f < Statistics::FIELD_COUNT; ++f) {
+      for (size_t i = 0; i < cpus; ++i) {
+        auto it = std::find(logical_.begin(), logical_.end(), parsed_[i]);
+        time[i] = (it == logical_.end())
+            ? cpu_stats_.sample[f][i]
+            : cpu_stats_.time[f][static_cast<size_t>(it - logical_.begin())];
+      }
+      cpu_stats_.time[f].swap(time);
+      time.resize(cpus);
+    }
+    cpu_stats_.resize(cpus);
+    logical_.assign(parsed_.begin(), parsed_.begin() + static_cast<ptrdiff_t>(cpus));
+  }
+
+  void CpuActivity::calculate(size_t cpus) {
+    using S = Statistics;
+    auto& st = cpu_stats_;
+
+    arrange(cpus);
+
+    /* Calculate the period of each field and remember the current values.
+     * (One field at a time so the inner loop runs over contiguous arrays.) */
+    for (size_t f = 0; f < S::FIELD_COUNT; ++f) {
+      const uint64_t* __restrict sample = st.sample[f].data();
+      uint64_t* __restrict time = st.time[f].data();
+      uint64_t* __restrict period = st.period[f].data();
+      for (size_t i = 0; i < cpus; ++i) {
+        period[i] = wrap_substract(sample[i], time[i]);
+        time[i] = sample[i];
+      }
+    }
+
+    /* The scale factor that converts a period into a percentage. */
+    {
+      const uint64_t* __restrict total = st.period[S::TOTAL].data();
+      double* __restrict scale = st.scale.data();
+      for (size_t i = 0; i < cpus; ++i) {
+        scale[i] = 100. / ((total[i] == 0) ? 1. : static_cast<double>(total[i]));
+      }
+    }
+
+    /* Calculate the percentages for each field. */
+    for (size_t f = 0; f < S::FIELD_COUNT; ++f) {
+      const uint64_t* __restrict period = st.period[f].data();
+      const double* __restrict scale = st.scale.data();
+      unsigned int* __restrict percent = st.percent[f].data();
+      for (size_t i = 0; i < cpus; ++i) {
+        percent[i] = static_cast<unsigned int>(period[i] * scale[i]);
+      }
+    }
+
+    /* Update the output vector. */
+    if (size() != cpus) resize(cpus);
+    const auto& pct = st.percent;
+    for (size_t i = 0; i < cpus; ++i) {
+      CpuActivityEntry& cpu_activity = (*this)[i];
+      unsigned int percent_total;
+
+      cpu_activity.nice = pct[S::NICE][i];
+      cpu_activity.user = pct[S::USER][i];
+
+      if (detailed_cpu_activity_) {
+        cpu_activity.kernel = pct[S::SYSTEM][i];
+        cpu_activity.irq = pct[S::IRQ][i];
+        cpu_activity.soft_irq = pct[S::SOFT_IRQ][i];
+        cpu_activity.steal = pct[S::STEAL][i];
+        cpu_activity.guest = pct[S::GUEST][i];
+        cpu_activity.io_wait = pct[S::IO_WAIT][i];
+
+        if (account_for_guest_) {
+           percent_total =
+               cpu_activity.nice + cpu_activity.user +
+               cpu_activity.kernel + cpu_activity.irq +
+               cpu_activity.soft_irq + cpu_activity.steal +
+               cpu_activity.guest;
+        } else {
+           percent_total =
+               cpu_activity.nice + cpu_activity.user +
+               cpu_activity.kernel + cpu_activity.irq +
+               cpu_activity.soft_irq;
         }
       }
+      else {
+        cpu_activity.kernel = pct[S::SYSTEM_ALL][i];
+        cpu_activity.irq = static_cast<unsigned int>(
+            (st.period[S::STEAL][i] + st.period[S::GUEST][i]) * st.scale[i]);
+        percent_total =
+            cpu_activity.nice + cpu_activity.user +
+            cpu_activity.kernel + cpu_activity.irq;
+      }
+
+      cpu_activity.total = clamp(percent_total, 0, 100);
     }
   }
 
-} // ends namespace xxx
+  void CpuActivity::update() {
+    calculate(parse(read()));
+  }
+
+  size_t CpuActivity::logical(size_t index) const {
+    if (index >= logical_.size()) return ULONG_MAX;
+    return logical_[index];
+  }
 
+  void CpuActivity::enqueue(ReadBatch& batch) {
+    /* Room for the 'cpu' lines (of up to 256 characters)
+     * of the current cpus and a few hotplugged ones. */
+    slot_size_ = (cpu_stats_.size() + 8) * 256;
+    slot_ = batch.add(proc_stat_, slot_size_);
+  }
+
+  void CpuActivity::update(const ReadBatch& batch) {
+    std::string_view text = batch.data(slot_);
+    /* More cpus were hotplugged than fit in the slot, read the file
+     * without the batch (the slot is enlarged when the sensors are
+     * enqueued again). */
+    if (text.size() >= slot_size_ && text.find("\nintr") == std::string_view::npos)
+      text = read();
+    calculate(parse(text));
+  }
+
+} // ends namespace xxx
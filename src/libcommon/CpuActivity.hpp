@@ -25,9 +25,14 @@
 #ifndef libcommon_linux_sensors_CpuActivity_hpp
 #define libcommon_linux_sensors_CpuActivity_hpp
 
+#include <array>
 #include <cstdint>
+#include <string_view>
 #include <vector>
 
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
 namespace xxx {
 
   /** @brief Processor activity statistics for a single logical cpu. */
@@ -41,22 +46,37 @@ namespace xxx {
     *
     * This class is a vector of CpuActivityEntry.
     * Index 0 of the vector is the aggregate of all processors,
-    * followed by an entry for each logical cpu. */
+    * followed by an entry for each online logical cpu.
+    *
+    * /proc/stat only lists the online cpus, the statistics are kept per
+    * logical cpu number so that the counters of cpus that stay online are
+    * not mixed up when another cpu is hotplugged. */
   class CpuActivity : public std::vector<CpuActivityEntry> {
     public:
 
-      /** @brief Processor activity statistics (for internal usage by class CpuActivity). */
+      /** @brief Processor activity statistics (for internal usage by class CpuActivity).
+        *
+        * The counters are stored as a structure of arrays: one contiguous
+        * array per field, with an element for each line read from /proc/stat.
+        * This allows the compiler to vectorize the loops in update() that
+        * calculate the deltas and percentages for all cpus. */
       struct Statistics {
-        struct {
-          uint64_t
-              user, nice, system, idle, io_wait, irq, soft_irq, steal, guest,
-              system_all, idle_all, total;
-        } time;
-        struct {
-          uint64_t
-              user, nice, system, idle, io_wait, irq, soft_irq, steal, guest,
-              system_all, idle_all, total;
-        } period;
+        /** @brief Index of each counter field in the arrays below. */
+        enum Field : size_t {
+          USER, NICE, SYSTEM, IDLE, IO_WAIT, IRQ, SOFT_IRQ, STEAL, GUEST,
+          SYSTEM_ALL, IDLE_ALL, TOTAL, FIELD_COUNT
+        };
+        template<typename T>
+        using Fields = std::array<std::vector<T>, FIELD_COUNT>;
+        Fields<uint64_t> sample;       /* values read by the last update */
+        Fields<uint64_t> time;         /* values read by the previous update */
+        Fields<uint64_t> period;       /* sample - time */
+        Fields<unsigned int> percent;  /* period / total period * 100 */
+        std::vector<double> scale;     /* 100 / total period */
+        /** @brief The number of cpus in the arrays. */
+        inline size_t size() const { return scale.size(); }
+        /** @brief Resize all arrays to hold 'cpus' entries. */
+        void resize(size_t cpus);
       };
 
       /** @param detail
@@ -70,14 +90,53 @@ namespace xxx {
       /* Refreshes the activity counters. */
       void update();
 
+      /** @brief Add /proc/stat to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+
+      /** @brief Refreshes the activity counters from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+
+      /** @brief get the logical cpu number for entry 'index'
+        * (ULONG_MAX for the aggregate at index 0 or if out of range). */
+      size_t logical(size_t index) const;
+
     protected:
 
       /** @brief Statistics for each logical cpu. */
-      std::vector<Statistics> cpu_stats_;
+      Statistics cpu_stats_;
+      /** @brief The logical cpu number of each entry in cpu_stats_. */
+      std::vector<size_t> logical_;
+      /** @brief The logical cpu numbers of the lines read by parse(). */
+      std::vector<size_t> parsed_;
 
       bool detailed_cpu_activity_;
       bool account_for_guest_;
 
+      /** @brief The /proc/stat file. */
+      SysfsAttribute proc_stat_;
+      /** @brief Buffer used to read /proc/stat. */
+      std::vector<char> buffer_;
+      /** @brief The slot of /proc/stat in a ReadBatch. */
+      size_t slot_ { 0 };
+      /** @brief The size of that slot. */
+      size_t slot_size_ { 0 };
+
+      /** @brief Read /proc/stat into buffer_.
+        * @returns The text read. */
+      std::string_view read();
+
+      /** @brief Parse the text of /proc/stat into cpu_stats_.sample.
+        * @returns The number of 'cpu' lines parsed. */
+      size_t parse(std::string_view text);
+
+      /** @brief Move the statistics of the cpus that stayed online
+        * to their new entry when the list of cpus in /proc/stat changed. */
+      void arrange(size_t cpus);
+
+      /** @brief Calculate the periods and percentages for the
+        * first 'cpus' entries of cpu_stats_ and store the results. */
+      void calculate(size_t cpus);
+
       /** @brief Subtract two unsigned integers,
         * limiting the result to a positive integer value. */
       inline uint64_t wrap_substract(uint64_t a, uint64_t b);
@@ -22,25 +22,22 @@
  * @file src/libcommon/CpuFrequency.cpp
  * @brief Measure CPU frequency using sysfs.
  */
+#include <algorithm>
 #include <climits>
-#include <iostream>
 #include <fstream>
-#include <sstream>
+#include <string>
+#include <unistd.h>
 
 #include "CpuFrequency.hpp"
-#include "Directory.hpp"
 
 xxx::CpuFrequency::CpuFrequency() {
   size_t count = 0;
   while (true) {
-    std::stringstream ss;
-    ss << "/sys/devices/system/cpu/cpu" << count;
-    auto&& directory = Directory::Read(ss.str().c_str(), false);
-    if (directory.size() == 0) break; // no more cpus
+    std::string path("/sys/devices/system/cpu/cpu");
+    path.append(std::to_string(count));
+    if (access(path.c_str(), F_OK) != 0) break; // no more cpus
     // Test if the cpu is online
-    std::stringstream ss1;
-    ss1 << ss.str() << "/online";
-    std::ifstream ifs(ss1.str());
+    std::ifstream ifs(path + "/online");
     if (ifs.good()) {
       int online;
       ifs >> online;
@@ -50,35 +47,36 @@ xxx::CpuFrequency::CpuFrequency() {
       }
     }
     // cpu is online, is there a 'cpufreq/scaling_cur_freq' file?
-    for (auto& entry : directory) {
-      if (S_ISDIR(entry.second.st_mode)) {
-        if (entry.first.compare("cpufreq") == 0) {
-          ss << "/cpufreq/scaling_cur_freq";
-          std::ifstream ifs(ss.str());
-          if (!ifs.good()) continue;
-          uint64_t freq;
-          ifs >> freq;
-          // add the cpu to our vectors
-          push_back(freq / 1000);
-          logical_.push_back(count);
-          break;
-        }
-      }
+    SysfsAttribute attr(path + "/cpufreq/scaling_cur_freq");
+    uint64_t freq;
+    if (attr.read(freq)) {
+      // add the cpu to our vectors
+      push_back(freq / 1000);
+      logical_.push_back(count);
+      scaling_cur_freq_.push_back(std::move(attr));
     }
     ++count;
   }
 }
 
 void xxx::CpuFrequency::update() {
-  auto ilogical = logical_.begin();
-  for (auto ifreq = begin(); ifreq != end(); ++ifreq, ++ilogical) {
-    std::stringstream ss;
-    ss << "/sys/devices/system/cpu/cpu" << *ilogical << "/cpufreq/scaling_cur_freq";
-    std::ifstream ifs(ss.str());
-    if (!ifs.good()) continue;
+  auto iattr = scaling_cur_freq_.begin();
+  for (auto ifreq = begin(); ifreq != end(); ++ifreq, ++iattr) {
     uint64_t freq;
-    ifs >> freq;
-    *ifreq = freq / 1000;
+    if (iattr->read(freq)) *ifreq = freq / 1000;
+  }
+}
+
+void xxx::CpuFrequency::enqueue(ReadBatch& batch) {
+  slot_ = batch.size();
+  for (auto& attr : scaling_cur_freq_) batch.add(attr);
+}
+
+void xxx::CpuFrequency::update(const ReadBatch& batch) {
+  size_t slot = slot_;
+  for (auto ifreq = begin(); ifreq != end(); ++ifreq, ++slot) {
+    uint64_t freq;
+    if (SysfsAttribute::Parse(batch.data(slot), freq)) *ifreq = freq / 1000;
   }
 }
 
@@ -87,3 +85,31 @@ size_t xxx::CpuFrequency::logical(size_t index) const {
   return logical_[index];
 }
 
+void xxx::CpuFrequency::hotplug(const std::vector<unsigned>& online) {
+  std::vector<unsigned long> freqs;
+  std::vector<size_t> logical;
+  std::vector<SysfsAttribute> attrs;
+  for (unsigned cpu : online) {
+    auto it = std::find(logical_.begin(), logical_.end(), cpu);
+    if (it != logical_.end()) {
+      // the cpu stayed online, keep its entry
+      size_t i = static_cast<size_t>(it - logical_.begin());
+      freqs.push_back((*this)[i]);
+      logical.push_back(cpu);
+      attrs.push_back(std::move(scaling_cur_freq_[i]));
+      continue;
+    }
+    // a new cpu, is there a 'cpufreq/scaling_cur_freq' file?
+    SysfsAttribute attr("/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+        + "/cpufreq/scaling_cur_freq");
+    uint64_t freq;
+    if (attr.read(freq)) {
+      freqs.push_back(freq / 1000);
+      logical.push_back(cpu);
+      attrs.push_back(std::move(attr));
+    }
+  }
+  assign(freqs.begin(), freqs.end());
+  logical_.swap(logical);
+  scaling_cur_freq_.swap(attrs);
+}
@@ -28,6 +28,9 @@
 #include <cstdint>
 #include <vector>
 
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
 namespace xxx {
 
   /** @brief CPU frequency readout using /sys/bus/cpu/devices/cpu?/cpufreq/scaling_cur_freq
@@ -37,12 +40,27 @@ namespace xxx {
   class CpuFrequency : public std::vector<unsigned long> {
     private:
       std::vector<size_t> logical_;
+      /* scaling_cur_freq attribute for each entry */
+      std::vector<SysfsAttribute> scaling_cur_freq_;
+      /* ReadBatch slot of the first scaling_cur_freq attribute */
+      size_t slot_ { 0 };
     public:
       CpuFrequency();
       /** @brief Update all frequencies in the vector. */
       void update();
+      /** @brief Add the scaling_cur_freq attributes to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update all frequencies in the vector from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
       /** @brief get the logical cpu number for entry 'index' */
       size_t logical(size_t index) const;
+      /** @brief Adapt the vector to a new set of online cpus.
+        *
+        * The entries (and attributes) of cpus that stay online are kept,
+        * entries are added for new cpus and removed for offline cpus.
+        * @note Call enqueue() again after calling this function.
+        * @param online The (sorted) logical cpu numbers of the online cpus. */
+      void hotplug(const std::vector<unsigned>& online);
   };
 
 } /* ends namespace xxx */
@@ -0,0 +1,112 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuHotplug.cpp
+ * @brief Detect cpu hotplug events using kernel uevents (implementation).
+ */
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "CpuHotplug.hpp"
+
+xxx::CpuHotplug::CpuHotplug()
+  : online_attr_("/sys/devices/system/cpu/online"),
+    buffer_(8192) {
+  fd_ = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+      NETLINK_KOBJECT_UEVENT);
+  if (fd_ >= 0) {
+    struct sockaddr_nl addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1; /* kernel uevents */
+    if (::bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+  rescan();
+}
+
+xxx::CpuHotplug::~CpuHotplug() {
+  if (fd_ >= 0) ::close(fd_);
+}
+
+bool xxx::CpuHotplug::ParseList(std::string_view text, std::vector<unsigned>& cpus) {
+  cpus.clear();
+  const char* p = text.data();
+  const char* end = p + text.size();
+  while (p != end && *p != '\n') {
+    unsigned first, last;
+    auto r = std::from_chars(p, end, first);
+    if (r.ec != std::errc()) return false;
+    p = r.ptr;
+    last = first;
+    if (p != end && *p == '-') {
+      r = std::from_chars(p + 1, end, last);
+      if (r.ec != std::errc() || last < first) return false;
+      p = r.ptr;
+    }
+    for (unsigned cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    if (p != end && *p == ',') ++p;
+  }
+  return true;
+}
+
+bool xxx::CpuHotplug::receive() {
+  bool hotplug = false;
+  while (true) {
+    ssize_t n = ::recv(fd_, buffer_.data(), buffer_.size(), MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      /* ENOBUFS: events were dropped, one of them may have been ours */
+      if (errno == ENOBUFS) hotplug = true;
+      break;
+    }
+    /* The message starts with 'action@devpath' */
+    std::string_view msg(buffer_.data(), strnlen(buffer_.data(), static_cast<size_t>(n)));
+    size_t at = msg.find('@');
+    if (at == std::string_view::npos) continue;
+    std::string_view action = msg.substr(0, at);
+    std::string_view devpath = msg.substr(at + 1);
+    if (devpath.compare(0, 23, "/devices/system/cpu/cpu") == 0
+        && (action == "online" || action == "offline"
+            || action == "add" || action == "remove")) hotplug = true;
+  }
+  return hotplug;
+}
+
+bool xxx::CpuHotplug::rescan() {
+  char buf[1024];
+  ssize_t n = online_attr_.read(&buf[0], sizeof(buf));
+  if (n <= 0 || !ParseList(std::string_view(&buf[0], static_cast<size_t>(n)), scratch_))
+    return false;
+  if (scratch_ == online_) return false;
+  online_.swap(scratch_);
+  return true;
+}
+
+bool xxx::CpuHotplug::poll() {
+  if (fd_ >= 0 && !receive()) return false;
+  return rescan();
+}
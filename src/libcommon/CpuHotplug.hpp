@@ -0,0 +1,81 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuHotplug.hpp
+ * @brief Detect cpu hotplug events using kernel uevents.
+ */
+#ifndef libcommon_linux_sensors_CpuHotplug_hpp
+#define libcommon_linux_sensors_CpuHotplug_hpp
+
+#include <string_view>
+#include <vector>
+
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief Watches for logical cpus going online or offline.
+    *
+    * The kernel uevents are received on a (non-blocking) NETLINK_KOBJECT_UEVENT
+    * socket, the set of online cpus is only reread from
+    * /sys/devices/system/cpu/online after an 'online', 'offline', 'add' or
+    * 'remove' event of a cpu device.
+    * If the netlink socket can not be opened then the 'online' attribute
+    * is read by every call to poll() instead. */
+  class CpuHotplug {
+    public:
+      CpuHotplug();
+      ~CpuHotplug();
+
+      CpuHotplug(const CpuHotplug&) = delete;
+      CpuHotplug& operator=(const CpuHotplug&) = delete;
+
+      /** @brief Are the uevents received (true) or is the 'online' attribute polled (false)? */
+      inline bool uevents() const { return fd_ >= 0; }
+
+      /** @brief The netlink socket (ie. to wait for events using poll()) or -1. */
+      inline int fd() const { return fd_; }
+
+      /** @brief Check for hotplug events without blocking.
+        * @returns true if the set of online cpus changed. */
+      bool poll();
+
+      /** @brief The (sorted) logical cpu numbers of the online cpus. */
+      inline const std::vector<unsigned>& online() const { return online_; }
+
+      /** @brief Parse a cpu list, ie. '0-3,5,7-8'.
+        * @returns false if the list could not be parsed. */
+      static bool ParseList(std::string_view text, std::vector<unsigned>& cpus);
+
+    private:
+      int fd_ { -1 };
+      SysfsAttribute online_attr_;
+      std::vector<unsigned> online_;
+      std::vector<unsigned> scratch_;
+      std::vector<char> buffer_;
+      /** @brief Did we receive a cpu hotplug event? */
+      bool receive();
+      /** @brief Reread the online cpus, true if they changed. */
+      bool rescan();
+  };
+
+} // ends namespace xxx
+
+#endif
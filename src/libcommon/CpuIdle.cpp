@@ -0,0 +1,146 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuIdle.cpp
+ * @brief Measure the cpuidle state residency and mis-predictions using sysfs (implementation).
+ */
+#include <algorithm>
+#include <fstream>
+
+#include "CpuHotplug.hpp"
+#include "CpuIdle.hpp"
+
+namespace xxx {
+
+  CpuIdle::CpuIdle() {
+    std::vector<unsigned> online;
+    std::ifstream ifs("/sys/devices/system/cpu/online");
+    std::string list;
+    if (ifs.good()) std::getline(ifs, list);
+    CpuHotplug::ParseList(list, online);
+    hotplug(online);
+    time_ = std::chrono::steady_clock::now();
+  }
+
+  bool CpuIdle::open(size_t cpu, CpuIdleEntry& entry) {
+    static constexpr const char* counters[CpuIdleState::COUNTER_COUNT] = {
+      "/time", "/usage", "/above", "/below"
+    };
+    std::string cpuidle("/sys/devices/system/cpu/cpu");
+    cpuidle.append(std::to_string(cpu));
+    cpuidle.append("/cpuidle/state");
+    entry.logical = cpu;
+    entry.above = 0.;
+    entry.below = 0.;
+    entry.states.clear();
+    while (true) {
+      std::string path(cpuidle + std::to_string(entry.states.size()));
+      std::ifstream ifs(path + "/name");
+      if (!ifs.good()) break; // no more states
+      CpuIdleState state;
+      std::getline(ifs, state.name);
+      state.residency = 0.;
+      state.usage = 0;
+      state.delta.fill(0);
+      state.previous.fill(0);
+      state.slot.fill(SIZE_MAX);
+      for (size_t c = 0; c < CpuIdleState::COUNTER_COUNT; ++c) {
+        /* ('above' and 'below' are missing on older kernels) */
+        state.attr[c] = SysfsAttribute(path + counters[c]);
+        state.attr[c].read(state.previous[c]);
+      }
+      entry.states.push_back(std::move(state));
+    }
+    return !entry.states.empty();
+  }
+
+  void CpuIdle::hotplug(const std::vector<unsigned>& online) {
+    std::vector<CpuIdleEntry> entries;
+    for (unsigned cpu : online) {
+      auto it = std::find_if(begin(), end(),
+          [cpu](const auto& e) { return e.logical == cpu; });
+      if (it != end()) {
+        // the cpu stayed online, keep its entry
+        entries.push_back(std::move(*it));
+        continue;
+      }
+      CpuIdleEntry entry;
+      if (open(cpu, entry)) entries.push_back(std::move(entry));
+    }
+    assign(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+  }
+
+  void CpuIdle::calculate() {
+    auto now = std::chrono::steady_clock::now();
+    /* (the 'time' attribute is in microseconds) */
+    double elapsed = std::chrono::duration<double, std::micro>(now - time_).count();
+    time_ = now;
+    if (elapsed <= 0.) elapsed = 1.;
+    for (auto& entry : *this) {
+      uint64_t usage = 0, above = 0, below = 0;
+      for (auto& state : entry.states) {
+        state.residency = std::min(100., static_cast<double>(state.delta[CpuIdleState::TIME]) / elapsed * 100.);
+        state.usage = state.delta[CpuIdleState::USAGE];
+        usage += state.delta[CpuIdleState::USAGE];
+        above += state.delta[CpuIdleState::ABOVE];
+        below += state.delta[CpuIdleState::BELOW];
+      }
+      entry.above = usage ? static_cast<double>(above) / static_cast<double>(usage) * 100. : 0.;
+      entry.below = usage ? static_cast<double>(below) / static_cast<double>(usage) * 100. : 0.;
+    }
+  }
+
+  void CpuIdle::update() {
+    for (auto& entry : *this) {
+      for (auto& state : entry.states) {
+        for (size_t c = 0; c < CpuIdleState::COUNTER_COUNT; ++c) {
+          uint64_t value = state.previous[c];
+          if (state.attr[c].good()) state.attr[c].read(value);
+          state.delta[c] = (value > state.previous[c]) ? value - state.previous[c] : 0;
+          state.previous[c] = value;
+        }
+      }
+    }
+    calculate();
+  }
+
+  void CpuIdle::enqueue(ReadBatch& batch) {
+    /* (the attributes that are missing, ie. 'above' and 'below' on older kernels, are not read) */
+    for (auto& entry : *this)
+      for (auto& state : entry.states)
+        for (size_t c = 0; c < CpuIdleState::COUNTER_COUNT; ++c)
+          state.slot[c] = state.attr[c].good() ? batch.add(state.attr[c]) : SIZE_MAX;
+  }
+
+  void CpuIdle::update(const ReadBatch& batch) {
+    for (auto& entry : *this) {
+      for (auto& state : entry.states) {
+        for (size_t c = 0; c < CpuIdleState::COUNTER_COUNT; ++c) {
+          uint64_t value = state.previous[c];
+          if (state.slot[c] != SIZE_MAX) SysfsAttribute::Parse(batch.data(state.slot[c]), value);
+          state.delta[c] = (value > state.previous[c]) ? value - state.previous[c] : 0;
+          state.previous[c] = value;
+        }
+      }
+    }
+    calculate();
+  }
+
+} // ends namespace xxx
@@ -0,0 +1,100 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuIdle.hpp
+ * @brief Measure the cpuidle state residency and mis-predictions using sysfs.
+ */
+#ifndef libcommon_linux_sensors_CpuIdle_hpp
+#define libcommon_linux_sensors_CpuIdle_hpp
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief A single idle state (/sys/devices/system/cpu/cpuN/cpuidle/stateK) of a logical cpu. */
+  struct CpuIdleState {
+    friend class CpuIdle;
+    public:
+      std::string name;   /* name of the state, ie. 'C1E' */
+      double residency;   /* time spent in the state during the last interval (%) */
+      uint64_t usage;     /* number of times the state was entered during the last interval */
+    private:
+      enum Counter : size_t { TIME, USAGE, ABOVE, BELOW, COUNTER_COUNT };
+      /* the time, usage, above and below attributes */
+      std::array<SysfsAttribute, COUNTER_COUNT> attr;
+      /* the ReadBatch slot of each attribute (SIZE_MAX == not open) */
+      std::array<size_t, COUNTER_COUNT> slot;
+      /* the values read by the previous update */
+      std::array<uint64_t, COUNTER_COUNT> previous;
+      /* the values read by the last update minus previous */
+      std::array<uint64_t, COUNTER_COUNT> delta;
+  };
+
+  /** @brief The idle states of a single logical cpu. */
+  struct CpuIdleEntry {
+    size_t logical;                   /* the logical cpu number */
+    std::vector<CpuIdleState> states;
+    double above;  /* entries (of all states) during the last interval where the
+                      idle time was too short for the state, ie. too deep (%) */
+    double below;  /* entries (of all states) during the last interval where a
+                      deeper state would have matched the idle time (%) */
+  };
+
+  /** @brief Measure the residency of the cpuidle states of all online logical cpus.
+    *
+    * This class is a vector of CpuIdleEntry, one for each online logical
+    * cpu that has cpuidle states. The attributes are opened once and read
+    * using their persistent file descriptors (or a ReadBatch).
+    * The values are calculated over the interval between two updates. */
+  class CpuIdle : public std::vector<CpuIdleEntry> {
+    public:
+      CpuIdle();
+      /** @brief Update the residency of all states. */
+      void update();
+      /** @brief Add the state attributes to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update the residency of all states from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+      /** @brief Adapt the vector to a new set of online cpus.
+        *
+        * The entries of cpus that stay online are kept, entries are
+        * added for new cpus and removed for offline cpus.
+        * @note Call enqueue() again after calling this function.
+        * @param online The (sorted) logical cpu numbers of the online cpus. */
+      void hotplug(const std::vector<unsigned>& online);
+    private:
+      /* The time of the last update */
+      std::chrono::steady_clock::time_point time_;
+      /* Open the states of a logical cpu (false if it has none) */
+      static bool open(size_t cpu, CpuIdleEntry& entry);
+      /* Calculate the values of all entries from the counters in 'delta' */
+      void calculate();
+  };
+
+} // ends namespace xxx
+
+#endif
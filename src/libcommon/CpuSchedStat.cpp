@@ -0,0 +1,121 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuSchedStat.cpp
+ * @brief Measure the run time and run-queue delay of each cpu by interpreting /proc/schedstat (implementation).
+ */
+#include <algorithm>
+#include <charconv>
+
+#include "CpuSchedStat.hpp"
+
+namespace xxx {
+
+  CpuSchedStat::CpuSchedStat()
+    : schedstat_("/proc/schedstat"),
+      buffer_(4096) {
+    /* (this primes the counters so the first update() reports the interval since construction) */
+    time_ = std::chrono::steady_clock::now();
+    if (schedstat_.good()) parse(read());
+  }
+
+  std::string_view CpuSchedStat::read() {
+    while (true) {
+      ssize_t n = schedstat_.read(buffer_.data(), buffer_.size());
+      if (n <= 0) return std::string_view();
+      /* (a read that fills the buffer may be truncated, enlarge it and read again) */
+      if (static_cast<size_t>(n) < buffer_.size()) return std::string_view(buffer_.data(), static_cast<size_t>(n));
+      buffer_.resize(buffer_.size() * 2);
+    }
+  }
+
+  void CpuSchedStat::parse(std::string_view text) {
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - time_).count();
+    time_ = now;
+    /* % = ns / (s * 1e9) * 100 */
+    double scale = (seconds > 0.) ? 1. / (seconds * 1e7) : 0.;
+    auto delta = [](uint64_t a, uint64_t b) { return static_cast<double>((a > b) ? a - b : 0); };
+    size_t count = 0;
+    while (!text.empty()) {
+      size_t eol = std::min(text.find('\n'), text.size());
+      std::string_view line = text.substr(0, eol);
+      text.remove_prefix(std::min(eol + 1, text.size()));
+      /* 'cpuN yld_count 0 sched_count sched_goidle ttwu_count ttwu_local rq_cpu_time run_delay pcount' */
+      if (line.compare(0, 3, "cpu") != 0) continue;
+      size_t label = std::min(line.find(' '), line.size());
+      unsigned long logical;
+      if (std::from_chars(line.data() + 3, line.data() + label, logical).ec != std::errc()) continue;
+      line.remove_prefix(label);
+      uint64_t v[9] {};
+      for (auto& value : v) {
+        size_t pos = line.find_first_not_of(' ');
+        if (pos == std::string_view::npos) break;
+        line.remove_prefix(pos);
+        SysfsAttribute::Parse(line, value);
+        line.remove_prefix(std::min(line.find(' '), line.size()));
+      }
+      /* The online cpus changed, move the entry of a known cpu or add a new one
+       * (a new cpu starts with its current counters, so its first interval is empty) */
+      if (count >= size() || (*this)[count].logical != logical) {
+        auto it = std::find_if(begin() + static_cast<ptrdiff_t>(count), end(),
+            [logical](const CpuSchedStatEntry& e) { return e.logical == logical; });
+        if (it != end()) std::rotate(begin() + static_cast<ptrdiff_t>(count), it, it + 1);
+        else {
+          CpuSchedStatEntry e;
+          e.logical = logical;
+          e.run_ns = v[6];
+          e.delay_ns = v[7];
+          e.slices = v[8];
+          insert(begin() + static_cast<ptrdiff_t>(count), e);
+        }
+      }
+      auto& e = (*this)[count++];
+      e.run_time = std::min(delta(v[6], e.run_ns) * scale, 100.);
+      e.run_delay = delta(v[7], e.delay_ns) * scale;
+      e.timeslices = delta(v[8], e.slices);
+      e.run_ns = v[6];
+      e.delay_ns = v[7];
+      e.slices = v[8];
+    }
+    /* (the cpus that went offline) */
+    if (count < size()) erase(begin() + static_cast<ptrdiff_t>(count), end());
+  }
+
+  void CpuSchedStat::update() {
+    if (schedstat_.good()) parse(read());
+  }
+
+  void CpuSchedStat::enqueue(ReadBatch& batch) {
+    /* room for the current size of the file (its domain lines make it
+     * much larger than the cpu lines) and a few hotplugged cpus */
+    slot_ = schedstat_.good() ? batch.add(schedstat_, buffer_.size() + 8192) : SIZE_MAX;
+  }
+
+  void CpuSchedStat::update(const ReadBatch& batch) {
+    if (slot_ == SIZE_MAX) return;
+    std::string_view text = batch.data(slot_);
+    /* the file no longer fits in the slot, read it without the batch
+     * (the slot is enlarged when the sensors are enqueued again) */
+    if (text.size() >= buffer_.size() + 8192) text = read();
+    parse(text);
+  }
+
+} // ends namespace xxx
@@ -0,0 +1,83 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuSchedStat.hpp
+ * @brief Measure the run time and run-queue delay of each cpu by interpreting /proc/schedstat.
+ */
+#ifndef libcommon_linux_sensors_CpuSchedStat_hpp
+#define libcommon_linux_sensors_CpuSchedStat_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief Scheduler statistics of a single logical cpu during the last interval. */
+  struct CpuSchedStatEntry {
+    friend class CpuSchedStat;
+    public:
+      unsigned long logical;
+      double run_time;   /* % of the interval that the cpu ran tasks */
+      double run_delay;  /* time that tasks waited on the run queue of the cpu (% of
+                          * the interval, more than 100 when several tasks waited) */
+      double timeslices; /* the number of timeslices run on the cpu */
+    private:
+      /* The counters read by the last update (ns, ns and timeslices) */
+      uint64_t run_ns;
+      uint64_t delay_ns;
+      uint64_t slices;
+  };
+
+  /** @brief Measure the time each cpu ran tasks and the time tasks waited for it using /proc/schedstat.
+    *
+    * A busy cpu has a high run time, an oversubscribed cpu also has a
+    * run-queue delay. The 'cpuN' lines are parsed in a single pass over a
+    * buffer that is kept between the updates (the 'domainN' lines are
+    * skipped), the entries are only rearranged when the online cpus change.
+    * The vector is empty if the kernel has no CONFIG_SCHEDSTATS. */
+  class CpuSchedStat : public std::vector<CpuSchedStatEntry> {
+    public:
+      CpuSchedStat();
+      void update();
+      /** @brief Add /proc/schedstat to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update the entries from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+    private:
+      SysfsAttribute schedstat_;
+      /* Buffer used to read /proc/schedstat */
+      std::vector<char> buffer_;
+      /* The slot of /proc/schedstat in a ReadBatch (or SIZE_MAX) */
+      size_t slot_ { SIZE_MAX };
+      std::chrono::steady_clock::time_point time_;
+      /* Read /proc/schedstat into buffer_ (enlarged until the file fits) */
+      std::string_view read();
+      /* Parse the 'cpuN' lines and calculate the values of the interval */
+      void parse(std::string_view text);
+  };
+
+} // ends namespace xxx
+
+#endif
@@ -22,26 +22,655 @@
  * @brief Measure several CPU statisics.
  */
 
-#include <thread>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
 #include "CpuSensors.hpp"
 
-xxx::CpuSensors::CpuSensors()
+xxx::CpuSensors::CpuSensors(bool use_io_uring)
   : cpu_active_(),
     cpu_freq_(),
     cpu_temp_(),
-    cpu_power_() {
+    cpu_power_(),
+    power_supply_(),
+    cpu_idle_(),
+    cpu_throttle_(),
+    cpu_perf_(),
+    pressure_(),
+    cpu_sched_(),
+    batch_(use_io_uring),
+    topology_(std::make_shared<const CpuTopology>()) {
+  cpu_active_.enqueue(batch_);
+  cpu_freq_.enqueue(batch_);
+  cpu_temp_.enqueue(batch_);
+  cpu_power_.enqueue(batch_);
+  power_supply_.enqueue(batch_);
+  cpu_idle_.enqueue(batch_);
+  cpu_throttle_.enqueue(batch_);
+  pressure_.enqueue(batch_);
+  pressure_.arm();
+  cpu_sched_.enqueue(batch_);
+  layout_ = std::make_shared<const std::vector<Channel>>(describe());
+  map();
+}
+
+
+xxx::CpuSensors::~CpuSensors() {
+  stop();
+}
+
+
+void xxx::CpuSensors::rearrange() {
+  cpu_freq_.hotplug(hotplug_.online());
+  cpu_temp_.hotplug();
+  cpu_idle_.hotplug(hotplug_.online());
+  cpu_throttle_.hotplug(hotplug_.online());
+  cpu_perf_.hotplug(hotplug_.online());
+  /* (the topology of a cpu can only be read while it is online) */
+  auto topology = std::make_shared<CpuTopology>(*topology_);
+  if (topology->add(hotplug_.online())) topology_ = std::move(topology);
+  batch_.clear();
+  cpu_active_.enqueue(batch_);
+  cpu_freq_.enqueue(batch_);
+  cpu_temp_.enqueue(batch_);
+  cpu_power_.enqueue(batch_);
+  power_supply_.enqueue(batch_);
+  cpu_idle_.enqueue(batch_);
+  cpu_throttle_.enqueue(batch_);
+  pressure_.enqueue(batch_);
+  cpu_sched_.enqueue(batch_);
+  layout_changed_ = true;
 }
 
 
 void xxx::CpuSensors::update() {
-  std::thread
-      th1(&CpuActivity::update, &cpu_active_),
-      th2(&CpuFrequency::update, &cpu_freq_),
-      th3(&CpuTemperature::update, &cpu_temp_),
-      th4(&PowerCap::IntelRAPL::update, &cpu_power_);
-  th1.join();
-  th2.join();
-  th3.join();
-  th4.join();
+  if (hotplug_.poll()) rearrange();
+  batch_.submit();
+  cpu_active_.update(batch_);
+  cpu_freq_.update(batch_);
+  cpu_temp_.update(batch_);
+  cpu_power_.update(batch_);
+  power_supply_.update(batch_);
+  cpu_idle_.update(batch_);
+  cpu_throttle_.update(batch_);
+  pressure_.update(batch_);
+  cpu_sched_.update(batch_);
+  cpu_perf_.update();
+  publish();
+}
+
+
+void xxx::CpuSensors::publish() {
+  Snapshot& s = snapshots_[back_];
+  /* (/proc/stat may list a hotplugged cpu before its uevent is received) */
+  size_t load_channels = 0, sched_channels = 0;
+  for (const auto& c : *layout_) {
+    load_channels += (c.type == Channel::Type::Load);
+    sched_channels += (c.type == Channel::Type::RunTime);
+  }
+  if (layout_changed_ || load_channels != cpu_active_.size() || sched_channels != cpu_sched_.size()) {
+    layout_ = std::make_shared<const std::vector<Channel>>(describe());
+    layout_changed_ = false;
+    map();
+  }
+  s.layout = layout_;
+  s.topology = topology_;
+  s.sequence = ++sequence_;
+  s.time = std::chrono::steady_clock::now();
+  /* (assign() reuses the capacity of the vectors) */
+  s.activity.assign(cpu_active_.begin(), cpu_active_.end());
+  s.frequency.assign(cpu_freq_.begin(), cpu_freq_.end());
+  s.temperature.resize(cpu_temp_.size());
+  for (size_t i = 0; i < cpu_temp_.size(); ++i)
+    s.temperature[i] = cpu_temp_[i].value;
+  s.power.clear();
+  s.energy.clear();
+  for (const auto& power_zone : cpu_power_) {
+    s.power.push_back(power_zone.average_power());
+    s.energy.push_back(power_zone.energy());
+    for (const auto& sub_zone : power_zone) {
+      s.power.push_back(sub_zone.average_power());
+      s.energy.push_back(sub_zone.energy());
+    }
+  }
+  if (power_supply_.measured()) {
+    /* the share of the system power that is not used by the packages,
+     * its energy only accumulates while the system power is measured
+     * (the package energy always does, so the totals can not be subtracted) */
+    double package_power = 0.;
+    for (const auto& power_zone : cpu_power_)
+      if (power_zone.name().compare(0, 8, "package-") == 0) package_power += power_zone.average_power();
+    double system_power = power_supply_.system_power();
+    double other_power = (system_power > 0.) ? std::max(system_power - package_power, 0.) : 0.;
+    if (other_time_ != std::chrono::steady_clock::time_point())
+      other_energy_ += other_power * std::chrono::duration<double>(s.time - other_time_).count();
+    other_time_ = s.time;
+    s.power.push_back(system_power);
+    s.power.push_back(other_power);
+    s.energy.push_back(power_supply_.system_energy());
+    s.energy.push_back(other_energy_);
+  }
+  s.idle.clear();
+  s.idle_above.clear();
+  s.idle_below.clear();
+  for (const auto& cpu : cpu_idle_) {
+    for (const auto& state : cpu.states) s.idle.push_back(state.residency);
+    s.idle_above.push_back(cpu.above);
+    s.idle_below.push_back(cpu.below);
+  }
+  s.throttle.clear();
+  s.throttle_time.clear();
+  for (const auto& cpu : cpu_throttle_.cpus()) {
+    s.throttle.push_back(static_cast<double>(cpu.count));
+    s.throttle_time.push_back(static_cast<double>(cpu.time_ms));
+  }
+  for (const auto& package : cpu_throttle_.packages()) {
+    s.throttle.push_back(static_cast<double>(package.count));
+    s.throttle_time.push_back(static_cast<double>(package.time_ms));
+  }
+  for (const auto& package : cpu_throttle_.packages()) {
+    s.throttle.push_back(static_cast<double>(package.core_count));
+    s.throttle_time.push_back(static_cast<double>(package.core_time_ms));
+  }
+  s.ipc.clear();
+  s.llc_mpki.clear();
+  s.branch_mpki.clear();
+  for (const auto& cpu : cpu_perf_) {
+    s.ipc.push_back(cpu.ipc);
+    s.llc_mpki.push_back(cpu.llc_mpki);
+    s.branch_mpki.push_back(cpu.branch_mpki);
+  }
+  s.pressure.clear();
+  s.stalls.clear();
+  for (const auto& resource : pressure_) {
+    s.pressure.push_back(resource.some);
+    if (resource.has_full) s.pressure.push_back(resource.full);
+    if (resource.armed) s.stalls.push_back(static_cast<double>(resource.stalls));
+  }
+  s.run_time.clear();
+  s.run_delay.clear();
+  s.timeslices.clear();
+  for (const auto& cpu : cpu_sched_) {
+    s.run_time.push_back(cpu.run_time);
+    s.run_delay.push_back(cpu.run_delay);
+    s.timeslices.push_back(cpu.timeslices);
+  }
+  Rollup(s, rollup_, *topology_);
+  count(s);
+  rank(s);
+  s.interval = rate_.update(s.time, s.activity, s.temperature, s.power);
+  /* Make the back buffer the new middle buffer */
+  back_ = middle_.exchange(back_ | SnapshotFresh, std::memory_order_acq_rel)
+      & SnapshotIndex;
+  /* The published buffer is not written to before the next publish(),
+   * so the listeners can read it while a consumer may also be reading it. */
+  for (auto& listener : listeners_) listener(s);
+}
+
+
+std::vector<xxx::CpuSensors::Channel> xxx::CpuSensors::describe() const {
+  using Type = Channel::Type;
+  std::vector<Channel> v;
+  auto cpu_name = [](size_t c, size_t i) {
+    return "cpu" + std::to_string((c == ULONG_MAX) ? i : c);
+  };
+  for (size_t i = 0; i < cpu_active_.size(); ++i)
+    v.push_back({ Type::Load, i, (i == 0) ? std::string("cpu") : cpu_name(cpu_active_.logical(i), i - 1), Unit(Type::Load) });
+  for (size_t i = 0; i < cpu_freq_.size(); ++i)
+    v.push_back({ Type::Frequency, i, cpu_name(cpu_freq_.logical(i), i), Unit(Type::Frequency) });
+  for (size_t i = 0; i < cpu_temp_.size(); ++i)
+    v.push_back({ Type::Temperature, i, cpu_temp_[i].name, Unit(Type::Temperature) });
+  size_t i = 0;
+  for (const auto& power_zone : cpu_power_) {
+    v.push_back({ Type::Power, i++, power_zone.name(), Unit(Type::Power) });
+    for (const auto& sub_zone : power_zone)
+      v.push_back({ Type::Power, i++, power_zone.name() + "/" + sub_zone.name(), Unit(Type::Power) });
+  }
+  if (power_supply_.measured()) {
+    v.push_back({ Type::Power, i++, "system", Unit(Type::Power) });
+    v.push_back({ Type::Power, i++, "system/other", Unit(Type::Power) });
+  }
+  i = 0;
+  for (const auto& cpu : cpu_idle_)
+    for (const auto& state : cpu.states)
+      v.push_back({ Type::Idle, i++, cpu_name(cpu.logical, 0) + "/" + state.name, Unit(Type::Idle) });
+  for (size_t n = 0; n < cpu_idle_.size(); ++n)
+    v.push_back({ Type::IdleAbove, n, cpu_name(cpu_idle_[n].logical, n), Unit(Type::IdleAbove) });
+  for (size_t n = 0; n < cpu_idle_.size(); ++n)
+    v.push_back({ Type::IdleBelow, n, cpu_name(cpu_idle_[n].logical, n), Unit(Type::IdleBelow) });
+  for (Type type : { Type::Throttle, Type::ThrottleTime }) {
+    i = 0;
+    for (const auto& cpu : cpu_throttle_.cpus())
+      v.push_back({ type, i++, cpu_name(cpu.id, 0), Unit(type) });
+    for (const auto& package : cpu_throttle_.packages())
+      v.push_back({ type, i++, "package" + std::to_string(package.id), Unit(type) });
+    for (const auto& package : cpu_throttle_.packages())
+      v.push_back({ type, i++, "package" + std::to_string(package.id) + "/cores", Unit(type) });
+  }
+  for (Type type : { Type::Ipc, Type::LlcMisses, Type::BranchMisses })
+    for (size_t n = 0; n < cpu_perf_.size(); ++n)
+      v.push_back({ type, n, cpu_name(cpu_perf_[n].logical, n), Unit(type) });
+  i = 0;
+  for (const auto& resource : pressure_) {
+    v.push_back({ Type::Pressure, i++, resource.name + "/some", Unit(Type::Pressure) });
+    if (resource.has_full)
+      v.push_back({ Type::Pressure, i++, resource.name + "/full", Unit(Type::Pressure) });
+  }
+  i = 0;
+  for (const auto& resource : pressure_)
+    if (resource.armed) v.push_back({ Type::Stall, i++, resource.name, Unit(Type::Stall) });
+  for (Type type : { Type::RunTime, Type::RunDelay, Type::Timeslices })
+    for (size_t n = 0; n < cpu_sched_.size(); ++n)
+      v.push_back({ type, n, cpu_name(cpu_sched_[n].logical, n), Unit(type) });
+  return v;
+}
+
+
+void xxx::CpuSensors::map() {
+  const CpuTopology& t = *topology_;
+  rollup_.load.assign(cpu_active_.size(), SIZE_MAX);
+  for (size_t i = 1; i < cpu_active_.size(); ++i)
+    rollup_.load[i] = t.cpu(cpu_active_.logical(i)).core;
+  rollup_.frequency.assign(cpu_freq_.size(), SIZE_MAX);
+  for (size_t i = 0; i < cpu_freq_.size(); ++i)
+    rollup_.frequency[i] = t.cpu(cpu_freq_.logical(i)).core;
+  rollup_.temperature_core.assign(cpu_temp_.size(), SIZE_MAX);
+  rollup_.temperature_package.assign(cpu_temp_.size(), SIZE_MAX);
+  for (size_t i = 0; i < cpu_temp_.size(); ++i) {
+    size_t core;
+    size_t package = t.coretemp(cpu_temp_[i].label, cpu_temp_[i].package, core);
+    if (core != SIZE_MAX) rollup_.temperature_core[i] = core;
+    else rollup_.temperature_package[i] = package;
+  }
+  /* the RAPL zones are named 'package-N' (the sub-zones are skipped) */
+  rollup_.power.clear();
+  for (const auto& power_zone : cpu_power_) {
+    unsigned long id;
+    size_t package = SIZE_MAX;
+    if (std::sscanf(power_zone.name().c_str(), "package-%lu", &id) == 1) package = t.package(id);
+    rollup_.power.push_back(package);
+    rollup_.power.insert(rollup_.power.end(), power_zone.size(), SIZE_MAX);
+  }
+  if (power_supply_.measured()) rollup_.power.insert(rollup_.power.end(), 2, SIZE_MAX);
+}
+
+
+xxx::CpuSensors::RollupMap xxx::CpuSensors::Map(const std::vector<Channel>& channels, const CpuTopology& t) {
+  RollupMap map;
+  auto at = [](std::vector<size_t>& v, size_t index) -> size_t& {
+    if (v.size() <= index) v.resize(index + 1, SIZE_MAX);
+    return v[index];
+  };
+  /* 'cpuN', 'package-N' (RAPL), 'Package id N' or 'Core N (package N)' (coretemp),
+   * a core temperature without a package is on the only package */
+  for (const auto& c : channels) {
+    unsigned long id;
+    char end;
+    const char* name = c.name.c_str();
+    switch (c.type) {
+      case Channel::Type::Load:
+        at(map.load, c.index) = (c.index > 0 && std::sscanf(name, "cpu%lu%c", &id, &end) == 1) ? t.cpu(id).core : SIZE_MAX;
+        break;
+      case Channel::Type::Frequency:
+        at(map.frequency, c.index) = (std::sscanf(name, "cpu%lu%c", &id, &end) == 1) ? t.cpu(id).core : SIZE_MAX;
+        break;
+      case Channel::Type::Temperature: {
+        const char* suffix = std::strstr(name, " (package ");
+        unsigned long package_id = t.packages().empty() ? 0 : t.packages().front().id;
+        if (suffix && std::sscanf(suffix, " (package %lu)%c", &id, &end) == 1) package_id = id;
+        else if (t.packages().size() != 1 && std::strncmp(name, "Package ", 8) != 0) package_id = ULONG_MAX;
+        size_t core;
+        size_t package = t.coretemp(c.name, package_id, core);
+        at(map.temperature_core, c.index) = core;
+        at(map.temperature_package, c.index) = (core == SIZE_MAX) ? package : SIZE_MAX;
+        break;
+      }
+      case Channel::Type::Power:
+        at(map.power, c.index) = (std::sscanf(name, "package-%lu%c", &id, &end) == 1) ? t.package(id) : SIZE_MAX;
+        break;
+      default:
+        break;
+    }
+  }
+  return map;
+}
+
+
+void xxx::CpuSensors::Rollup(Snapshot& s, const RollupMap& map, const CpuTopology& topology) {
+  s.cores.assign(topology.cores().size(), CpuTopologyRollup {});
+  s.packages.assign(topology.packages().size(), CpuTopologyRollup {});
+  for (size_t i = 0; i < s.activity.size() && i < map.load.size(); ++i) {
+    if (map.load[i] == SIZE_MAX) continue;
+    auto& core = s.cores[map.load[i]];
+    core.load += s.activity[i].total;
+    ++core.cpus;
+  }
+  for (size_t i = 0; i < s.frequency.size() && i < map.frequency.size(); ++i)
+    if (map.frequency[i] != SIZE_MAX) s.cores[map.frequency[i]].frequency += s.frequency[i];
+  for (size_t i = 0; i < s.temperature.size() && i < map.temperature_core.size(); ++i)
+    if (map.temperature_core[i] != SIZE_MAX) s.cores[map.temperature_core[i]].temperature = s.temperature[i];
+  /* the packages are the sum of their cores, the hottest core
+   * is used when there is no package temperature input */
+  const auto& cores = topology.cores();
+  for (size_t c = 0; c < s.cores.size(); ++c) {
+    auto& core = s.cores[c];
+    auto& package = s.packages[cores[c].package];
+    package.load += core.load;
+    package.frequency += core.frequency;
+    package.cpus += core.cpus;
+    package.temperature = std::max(package.temperature, core.temperature);
+    if (core.cpus == 0) continue;
+    /* (the busy cycles of the package in MHz, until divided into the power below) */
+    package.energy_per_cycle += core.load / 100. * core.frequency / core.cpus;
+    core.load /= core.cpus;
+    core.frequency /= core.cpus;
+  }
+  for (auto& package : s.packages) {
+    if (package.cpus == 0) continue;
+    package.load /= package.cpus;
+    package.frequency /= package.cpus;
+  }
+  for (size_t i = 0; i < s.temperature.size() && i < map.temperature_package.size(); ++i)
+    if (map.temperature_package[i] != SIZE_MAX) s.packages[map.temperature_package[i]].temperature = s.temperature[i];
+  for (size_t i = 0; i < s.power.size() && i < map.power.size(); ++i) {
+    if (map.power[i] == SIZE_MAX) continue;
+    auto& package = s.packages[map.power[i]];
+    package.power = s.power[i];
+    package.energy = (i < s.energy.size()) ? s.energy[i] : 0.;
+  }
+  /* nJ per cycle = W / (busy MHz * 1e6) * 1e9 */
+  for (auto& package : s.packages) {
+    double busy_mhz = package.energy_per_cycle;
+    package.energy_per_cycle = (busy_mhz > 0.) ? package.power * 1e3 / busy_mhz : 0.;
+  }
+}
+
+
+size_t xxx::CpuSensors::find(const std::vector<Channel>& channels, const Channel& channel) {
+  for (size_t i = 0; i < channels.size(); ++i)
+    if (channels[i].type == channel.type && channels[i].name == channel.name) return i;
+  return SIZE_MAX;
+}
+
+
+double xxx::CpuSensors::value(const Snapshot& s, const Channel& c) {
+  switch (c.type) {
+    case Channel::Type::Load:
+      return (c.index < s.activity.size()) ? s.activity[c.index].total : 0.;
+    case Channel::Type::Frequency:
+      return (c.index < s.frequency.size()) ? s.frequency[c.index] : 0.;
+    case Channel::Type::Temperature:
+      return (c.index < s.temperature.size()) ? s.temperature[c.index] : 0.;
+    case Channel::Type::Power:
+      return (c.index < s.power.size()) ? s.power[c.index] : 0.;
+    case Channel::Type::Idle:
+      return (c.index < s.idle.size()) ? s.idle[c.index] : 0.;
+    case Channel::Type::IdleAbove:
+      return (c.index < s.idle_above.size()) ? s.idle_above[c.index] : 0.;
+    case Channel::Type::IdleBelow:
+      return (c.index < s.idle_below.size()) ? s.idle_below[c.index] : 0.;
+    case Channel::Type::Throttle:
+      return (c.index < s.throttle.size()) ? s.throttle[c.index] : 0.;
+    case Channel::Type::ThrottleTime:
+      return (c.index < s.throttle_time.size()) ? s.throttle_time[c.index] : 0.;
+    case Channel::Type::Ipc:
+      return (c.index < s.ipc.size()) ? s.ipc[c.index] : 0.;
+    case Channel::Type::LlcMisses:
+      return (c.index < s.llc_mpki.size()) ? s.llc_mpki[c.index] : 0.;
+    case Channel::Type::BranchMisses:
+      return (c.index < s.branch_mpki.size()) ? s.branch_mpki[c.index] : 0.;
+    case Channel::Type::Pressure:
+      return (c.index < s.pressure.size()) ? s.pressure[c.index] : 0.;
+    case Channel::Type::Stall:
+      return (c.index < s.stalls.size()) ? s.stalls[c.index] : 0.;
+    case Channel::Type::RunTime:
+      return (c.index < s.run_time.size()) ? s.run_time[c.index] : 0.;
+    case Channel::Type::RunDelay:
+      return (c.index < s.run_delay.size()) ? s.run_delay[c.index] : 0.;
+    case Channel::Type::Timeslices:
+      return (c.index < s.timeslices.size()) ? s.timeslices[c.index] : 0.;
+  }
+  return 0.;
+}
+
+
+void xxx::CpuSensors::assign(Snapshot& s, const Channel& c, double value) {
+  auto element = [&c](auto& v) -> auto& {
+    if (v.size() <= c.index) v.resize(c.index + 1);
+    return v[c.index];
+  };
+  switch (c.type) {
+    case Channel::Type::Load:
+      element(s.activity).total = static_cast<unsigned int>(std::lround(value));
+      break;
+    case Channel::Type::Frequency:
+      element(s.frequency) = static_cast<unsigned long>(std::lround(value));
+      break;
+    case Channel::Type::Temperature:
+      element(s.temperature) = static_cast<int>(std::lround(value));
+      break;
+    case Channel::Type::Power:
+      element(s.power) = value;
+      break;
+    case Channel::Type::Idle:
+      element(s.idle) = value;
+      break;
+    case Channel::Type::IdleAbove:
+      element(s.idle_above) = value;
+      break;
+    case Channel::Type::IdleBelow:
+      element(s.idle_below) = value;
+      break;
+    case Channel::Type::Throttle:
+      element(s.throttle) = value;
+      break;
+    case Channel::Type::ThrottleTime:
+      element(s.throttle_time) = value;
+      break;
+    case Channel::Type::Ipc:
+      element(s.ipc) = value;
+      break;
+    case Channel::Type::LlcMisses:
+      element(s.llc_mpki) = value;
+      break;
+    case Channel::Type::BranchMisses:
+      element(s.branch_mpki) = value;
+      break;
+    case Channel::Type::Pressure:
+      element(s.pressure) = value;
+      break;
+    case Channel::Type::Stall:
+      element(s.stalls) = value;
+      break;
+    case Channel::Type::RunTime:
+      element(s.run_time) = value;
+      break;
+    case Channel::Type::RunDelay:
+      element(s.run_delay) = value;
+      break;
+    case Channel::Type::Timeslices:
+      element(s.timeslices) = value;
+      break;
+  }
+}
+
+
+const char* xxx::CpuSensors::Unit(Channel::Type type) {
+  switch (type) {
+    case Channel::Type::Load: return "%";
+    case Channel::Type::Frequency: return "MHz";
+    case Channel::Type::Temperature: return "°C";
+    case Channel::Type::Power: return "W";
+    case Channel::Type::Idle:
+    case Channel::Type::IdleAbove:
+    case Channel::Type::IdleBelow: return "%";
+    case Channel::Type::Throttle: return "events";
+    case Channel::Type::ThrottleTime: return "ms";
+    case Channel::Type::Ipc: return "IPC";
+    case Channel::Type::LlcMisses:
+    case Channel::Type::BranchMisses: return "MPKI";
+    case Channel::Type::Pressure: return "%";
+    case Channel::Type::Stall: return "events";
+    case Channel::Type::RunTime:
+    case Channel::Type::RunDelay: return "%";
+    case Channel::Type::Timeslices: return "slices";
+  }
+  return "";
+}
+
+
+const char* xxx::CpuSensors::Name(Channel::Type type) {
+  switch (type) {
+    case Channel::Type::Load: return "load";
+    case Channel::Type::Frequency: return "frequency";
+    case Channel::Type::Temperature: return "temperature";
+    case Channel::Type::Power: return "power";
+    case Channel::Type::Idle: return "idle";
+    case Channel::Type::IdleAbove: return "idle_above";
+    case Channel::Type::IdleBelow: return "idle_below";
+    case Channel::Type::Throttle: return "throttle";
+    case Channel::Type::ThrottleTime: return "throttle_time";
+    case Channel::Type::Ipc: return "ipc";
+    case Channel::Type::LlcMisses: return "llc_mpki";
+    case Channel::Type::BranchMisses: return "branch_mpki";
+    case Channel::Type::Pressure: return "pressure";
+    case Channel::Type::Stall: return "stalls";
+    case Channel::Type::RunTime: return "run_time";
+    case Channel::Type::RunDelay: return "run_delay";
+    case Channel::Type::Timeslices: return "timeslices";
+  }
+  return "";
+}
+
+
+void xxx::CpuSensors::listen(Listener listener) {
+  if (running()) return;
+  listeners_.push_back(std::move(listener));
 }
 
+
+const xxx::CpuSensors::Snapshot& xxx::CpuSensors::snapshot() {
+  /* Take the middle buffer if it holds a newer snapshot */
+  if (middle_.load(std::memory_order_relaxed) & SnapshotFresh) {
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel)
+        & SnapshotIndex;
+  }
+  return snapshots_[front_];
+}
+
+
+void xxx::CpuSensors::start(std::chrono::milliseconds interval) {
+  start(interval, interval);
+}
+
+
+void xxx::CpuSensors::start(
+    std::chrono::milliseconds min_interval,
+    std::chrono::milliseconds max_interval,
+    const RateController::Thresholds& thresholds) {
+  stop();
+  stop_ = false;
+  wake_ = false;
+  rate_ = RateController(min_interval, max_interval, thresholds);
+  /* (the watcher is set up before the sampler starts to account its events) */
+  pressure_.watch([this](size_t) { wake(); });
+  sampler_ = std::thread(&CpuSensors::sample, this);
+}
+
+
+void xxx::CpuSensors::stop() {
+  if (!sampler_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  sampler_.join();
+  /* (only after the sampler is gone, it reads the watch state in account()) */
+  pressure_.unwatch();
+}
+
+
+void xxx::CpuSensors::sample() {
+  auto next = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    lock.unlock();
+    update();
+    lock.lock();
+    /* Wait until the next sampling time (without drifting), a stall event or until stopped */
+    next += rate_.interval();
+    auto now = std::chrono::steady_clock::now();
+    if (next < now) next = now;
+    cv_.wait_until(lock, next, [this]() { return stop_ || wake_; });
+    /* (after a stall event the interval starts again from that sample) */
+    if (wake_) {
+      wake_ = false;
+      next = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+
+void xxx::CpuSensors::count(Snapshot& s) {
+  if (!count_interrupts_) {
+    interrupts_.reset();
+    interrupt_matrix_.reset();
+  }
+  else if (!interrupts_) {
+    /* (reads the first counters) */
+    try {
+      interrupts_ = std::make_unique<InterruptActivity>();
+    }
+    catch (const std::runtime_error&) {
+      count_interrupts_ = false;
+    }
+    interrupts_time_ = s.time;
+  }
+  else if (s.time - interrupts_time_ >= std::chrono::seconds(1)) {
+    interrupts_time_ = s.time;
+    interrupts_->update();
+    /* (a copy of the result, the snapshots that hold the previous one may still be read) */
+    interrupt_matrix_ = std::make_shared<const InterruptMatrix>(*interrupts_);
+  }
+  s.interrupts = interrupt_matrix_;
+}
+
+
+void xxx::CpuSensors::rank(Snapshot& s) {
+  if (!rank_tasks_) {
+    /* (closes the stat files of the tasks) */
+    processes_.reset();
+    ranking_.reset();
+  }
+  else if (!processes_) {
+    /* (the first update only reads the cpu time of the tasks) */
+    try {
+      processes_ = std::make_unique<ProcessActivity>();
+      processes_->update();
+    }
+    catch (const std::runtime_error&) {
+      rank_tasks_ = false;
+    }
+    tasks_time_ = s.time;
+  }
+  else if (s.time - tasks_time_ >= std::chrono::seconds(1)) {
+    tasks_time_ = s.time;
+    processes_->update();
+    ranking_ = std::make_shared<const ProcessActivity::Ranking>(processes_->ranking());
+  }
+  s.tasks = ranking_;
+}
+
+
+void xxx::CpuSensors::wake() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_ = true;
+  }
+  cv_.notify_all();
+}
@@ -25,39 +25,367 @@
 #ifndef libcommon_linux_sensors_CpuSensors_hpp
 #define libcommon_linux_sensors_CpuSensors_hpp
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "CpuActivity.hpp"
 #include "CpuFrequency.hpp"
+#include "CpuHotplug.hpp"
+#include "CpuIdle.hpp"
+#include "CpuSchedStat.hpp"
 #include "CpuTemperature.hpp"
+#include "CpuTopology.hpp"
+#include "InterruptActivity.hpp"
+#include "PerfCounters.hpp"
 #include "PowerCap.hpp"
+#include "PowerSupply.hpp"
+#include "PressureStall.hpp"
+#include "ProcessActivity.hpp"
+#include "RateController.hpp"
+#include "ThermalThrottle.hpp"
+#include "ReadBatch.hpp"
 
 namespace xxx {
 
-  /** @brief Collection of CPU sensors. */
+  /** @brief Collection of CPU sensors.
+    *
+    * The sensors are either refreshed by calling update() or by a sampler
+    * thread that is started with start(). In both cases the new values are
+    * published as an immutable Snapshot which is retrieved with snapshot().
+    *
+    * The snapshots are triple-buffered: the sampler thread fills a back
+    * buffer and swaps it with the 'middle' buffer using a single atomic
+    * exchange, snapshot() swaps the front buffer with the middle buffer
+    * if that holds a newer snapshot. Neither side ever blocks the other.
+    *
+    * Cpu hotplug events are checked before every update, the per-cpu
+    * sensors are then adapted incrementally and the snapshots get a new
+    * layout (see Snapshot::layout).
+    *
+    * A PressureStall trigger event wakes the sampler thread, the stall is
+    * in the next snapshot right away instead of after the interval.
+    *
+    * The interrupts of the cpus (InterruptActivity) are counted and the
+    * tasks of the cpus (ProcessActivity) are ranked once per second by the
+    * same thread, but only when enabled with count_interrupts() and
+    * rank_tasks(). */
   class CpuSensors {
     public:
 
-      CpuSensors();
-      ~CpuSensors() = default;
+      /** @brief Describes a single value (a channel) of a Snapshot. */
+      struct Channel {
+        /** @brief The Snapshot vector that holds the value. */
+        enum class Type {
+          Load, Frequency, Temperature, Power, Idle, IdleAbove, IdleBelow,
+          Throttle, ThrottleTime, Ipc, LlcMisses, BranchMisses,
+          Pressure, Stall, RunTime, RunDelay, Timeslices
+        };
+        Type type;
+        /** @brief Index into the Snapshot vector. */
+        size_t index;
+        /** @brief Name of the channel, ie. 'cpu3', 'Package id 0' or 'cpu3/C1E'. */
+        std::string name;
+        /** @brief Unit of the value, ie. '%' or 'MHz'. */
+        const char* unit;
+      };
+
+      /** @brief The values of all sensors at one point in time. */
+      struct Snapshot {
+        /** @brief Incremented for each new snapshot (0 == no values yet). */
+        uint64_t sequence { 0 };
+        /** @brief The time the sensors were read. */
+        std::chrono::steady_clock::time_point time;
+        /** @brief See CpuActivity. */
+        std::vector<CpuActivityEntry> activity;
+        /** @brief See CpuFrequency. */
+        std::vector<unsigned long> frequency;
+        /** @brief The value of each entry in CpuTemperature. */
+        std::vector<int> temperature;
+        /** @brief The average power of each PowerZone of
+          * PowerCap::IntelRAPL followed by that of its sub-zones.
+          * When a power supply measures the power of the system it is
+          * followed by the system power ('system') and the share of the
+          * system power that is not used by the packages ('system/other'). */
+        std::vector<double> power;
+        /** @brief The energy (J) used since the start by each PowerZone and
+          * its sub-zones (indexed like power, see PowerCap::Attributes::energy()). */
+        std::vector<double> energy;
+        /** @brief The residency (%) of each state of each entry in CpuIdle. */
+        std::vector<double> idle;
+        /** @brief The above and below mis-prediction rates (%) of each entry in CpuIdle. */
+        std::vector<double> idle_above;
+        std::vector<double> idle_below;
+        /** @brief The throttle events and time (ms) during the last interval of
+          * each cpu in ThermalThrottle, followed by those of each package
+          * and the aggregate of the cpus of each package. */
+        std::vector<double> throttle;
+        std::vector<double> throttle_time;
+        /** @brief The instructions per cycle and the last level cache and
+          * branch misses per 1000 instructions of each entry in PerfCounters. */
+        std::vector<double> ipc;
+        std::vector<double> llc_mpki;
+        std::vector<double> branch_mpki;
+        /** @brief The share (%) of the last interval that some tasks and, when
+          * reported, all tasks stalled on each entry in PressureStall. */
+        std::vector<double> pressure;
+        /** @brief The trigger events during the last interval of each
+          * entry in PressureStall that has a trigger. */
+        std::vector<double> stalls;
+        /** @brief The run time and run-queue delay (%) and the timeslices
+          * during the last interval of each entry in CpuSchedStat. */
+        std::vector<double> run_time;
+        std::vector<double> run_delay;
+        std::vector<double> timeslices;
+        /** @brief The aggregate of the sensors of each core and each package
+          * (indexed like CpuTopology::cores() and packages() of Snapshot::topology). */
+        std::vector<CpuTopologyRollup> cores;
+        std::vector<CpuTopologyRollup> packages;
+        /** @brief The cores and packages of the cpus.
+          *
+          * Replaced (like the layout) when a cpu that was not seen before is
+          * hotplugged, the indexes of the known cores and packages do not change. */
+        std::shared_ptr<const CpuTopology> topology;
+        /** @brief The channels of this snapshot.
+          *
+          * A new layout is created (the old one is never modified) when
+          * cpus are hotplugged, compare the pointers to detect a change. */
+        std::shared_ptr<const std::vector<Channel>> layout;
+        /** @brief The interrupts of each cpu during the last second (see
+          * count_interrupts(), nullptr == not counted).
+          * Replaced once per second, the matrix is never modified. */
+        std::shared_ptr<const InterruptMatrix> interrupts;
+        /** @brief The tasks that used the most cpu time on each cpu during the
+          * last second (see rank_tasks(), nullptr == not ranked).
+          * Replaced once per second, the ranking is never modified. */
+        std::shared_ptr<const ProcessActivity::Ranking> tasks;
+        /** @brief The time until the next snapshot of the sampler thread
+          * (as chosen by its RateController). */
+        std::chrono::milliseconds interval { 0 };
+      };
+
+      /** @brief A function that is called for each new Snapshot. */
+      using Listener = std::function<void(const Snapshot&)>;
+
+      /** @param use_io_uring Read all sensors using a single io_uring
+        * submission (true) or using pread() (false). */
+      explicit CpuSensors(bool use_io_uring = true);
+      ~CpuSensors();
 
-      /* Refreshes the values for all sensors (in parallel). */
+      CpuSensors(const CpuSensors&) = delete;
+      CpuSensors& operator=(const CpuSensors&) = delete;
+
+      /** @brief Refreshes the values for all sensors (in a single ReadBatch)
+        * and publishes a new Snapshot.
+        * @note Do not call this function while the sampler thread is running. */
       void update();
 
+      /** @brief Start the sampler thread.
+        * @param interval The time between two updates. */
+      void start(std::chrono::milliseconds interval);
+
+      /** @brief Start the sampler thread with an adaptive interval.
+        * @param min_interval The shortest time between two updates.
+        * @param max_interval The longest time between two updates.
+        * @param thresholds See RateController. */
+      void start(
+          std::chrono::milliseconds min_interval,
+          std::chrono::milliseconds max_interval,
+          const RateController::Thresholds& thresholds = RateController::Thresholds());
+
+      /** @brief Stop the sampler thread (if it is running). */
+      void stop();
+
+      /** @brief Is the sampler thread running? */
+      inline bool running() const { return sampler_.joinable(); }
+
+      /** @brief Get the most recently published Snapshot.
+        * @note This function may only be called from a single (consumer) thread.
+        * The returned reference is valid until the next call to snapshot(). */
+      const Snapshot& snapshot();
+
+      /** @brief Get a description of every channel in a Snapshot.
+        *
+        * The channels are ordered by type (load, frequency, temperature,
+        * power, idle, throttle, perf, pressure, scheduler) and then by index.
+        * @note While the sampler thread is running use Snapshot::layout instead. */
+      inline const std::vector<Channel>& channels() const { return *layout_; }
+
+      /** @brief The channels as they are shared with the snapshots (see Snapshot::layout).
+        * @note While the sampler thread is running use Snapshot::layout instead. */
+      inline std::shared_ptr<const std::vector<Channel>> layout() const { return layout_; }
+
+      /** @brief The cores and packages of the cpus (see Snapshot::topology).
+        * @note While the sampler thread is running use Snapshot::topology instead. */
+      inline std::shared_ptr<const CpuTopology> topology() const { return topology_; }
+
+      /** @brief Find a channel by type and name.
+        * @returns The position in 'channels' or SIZE_MAX. */
+      static size_t find(const std::vector<Channel>& channels, const Channel& channel);
+
+      /** @brief Get the value of a channel from a Snapshot (or 0 if not present). */
+      static double value(const Snapshot& snapshot, const Channel& channel);
+
+      /** @brief Set the value of a channel in a Snapshot (the vectors grow when needed). */
+      static void assign(Snapshot& snapshot, const Channel& channel, double value);
+
+      /** @brief The unit of the values of a channel type. */
+      static const char* Unit(Channel::Type type);
+
+      /** @brief The name of a channel type, ie. 'temperature' or 'idle_above'. */
+      static const char* Name(Channel::Type type);
+
+      /** @brief The index of the core or package of each sensor value of a layout (or SIZE_MAX). */
+      struct RollupMap {
+        std::vector<size_t> load;                /* core of each Load channel */
+        std::vector<size_t> frequency;           /* core of each Frequency channel */
+        std::vector<size_t> temperature_core;    /* core of each Temperature channel */
+        std::vector<size_t> temperature_package; /* package of each 'Package id' input */
+        std::vector<size_t> power;               /* package of each Power channel */
+      };
+
+      /** @brief Map the channels of a layout to the cores and packages of a topology by their names.
+        *
+        * Used for the snapshots of a recording, the sampler maps its
+        * sensors directly (see Rollup()). */
+      static RollupMap Map(const std::vector<Channel>& channels, const CpuTopology& topology);
+
+      /** @brief Aggregate the values of a Snapshot per core and per package.
+        * @param map The cores and packages of the values (see Map()).
+        * @param topology The topology the map refers to. */
+      static void Rollup(Snapshot& s, const RollupMap& map, const CpuTopology& topology);
+
+      /** @brief Add a function that is called for every new Snapshot.
+        *
+        * The function is called by the thread that updates the sensors
+        * (the sampler thread when it is running) right after the Snapshot
+        * is published and must not block.
+        * @note Listeners can only be added while the sampler is stopped. */
+      void listen(Listener listener);
+
+      /** @brief Count the interrupts of each cpu, see Snapshot::interrupts.
+        *
+        * /proc/interrupts has a counter for each cpu on every line, so it is
+        * large on hosts with many cpus and only read while this is enabled.
+        * Can be called while the sampler thread is running. */
+      inline void count_interrupts(bool enable) { count_interrupts_ = enable; }
+
+      /** @brief Rank the tasks of each cpu, see Snapshot::tasks.
+        *
+        * That reads the stat file of every task, so it should only be
+        * enabled while the tasks are displayed (the state of the tasks is
+        * dropped when disabled). Can be called while the sampler thread is running. */
+      inline void rank_tasks(bool enable) { rank_tasks_ = enable; }
+
+      /** @note While the sampler thread is running the values in these sensors
+        * are modified concurrently, use them only for their layout (labels,
+        * logical cpu numbers, zone names) and use snapshot() for the values. */
       inline const CpuActivity& cpu_activity();
       inline const CpuFrequency& cpu_frequency();
       inline const CpuTemperature& cpu_temperature();
       inline const PowerCap::IntelRAPL& cpu_power();
+      inline const PowerSupply& power_supply();
+      inline const CpuIdle& cpu_idle();
+      inline const ThermalThrottle& cpu_throttle();
+      inline const PerfCounters& cpu_perf();
+      inline const PressureStall& pressure();
+      inline const CpuSchedStat& cpu_schedstat();
 
     protected:
       CpuActivity cpu_active_;
       CpuFrequency cpu_freq_;
       CpuTemperature cpu_temp_;
       PowerCap::IntelRAPL cpu_power_;
+      PowerSupply power_supply_;
+      CpuIdle cpu_idle_;
+      ThermalThrottle cpu_throttle_;
+      /** @brief (not part of the ReadBatch, see PerfCounters) */
+      PerfCounters cpu_perf_;
+      PressureStall pressure_;
+      CpuSchedStat cpu_sched_;
+      /** @brief The attributes of all sensors, read once per update(). */
+      ReadBatch batch_;
+      /** @brief Watches for cpus going online or offline. */
+      CpuHotplug hotplug_;
+      /** @brief Chooses the interval of the sampler thread. */
+      RateController rate_;
+      /** @brief The cores and packages of the cpus. */
+      std::shared_ptr<const CpuTopology> topology_;
+
+    private:
+      /* Snapshot triple buffer */
+      static constexpr unsigned SnapshotIndex = 0x3;
+      static constexpr unsigned SnapshotFresh = 0x4;
+      std::array<Snapshot, 3> snapshots_;
+      std::atomic<unsigned> middle_ { 1 };
+      unsigned back_ { 0 };
+      unsigned front_ { 2 };
+      uint64_t sequence_ { 0 };
+      std::vector<Listener> listeners_;
+      /* The energy (J) of 'system/other' and the time it was last accounted */
+      double other_energy_ { 0. };
+      std::chrono::steady_clock::time_point other_time_;
+      /* The channels of the published snapshots */
+      std::shared_ptr<const std::vector<Channel>> layout_;
+      bool layout_changed_ { false };
+      /* The index of the core or package of each sensor value,
+       * updated with the layout so the rollups need no lookups. */
+      RollupMap rollup_;
+
+      /* Sampler thread */
+      std::thread sampler_;
+      std::mutex mutex_;
+      std::condition_variable cv_;
+      bool stop_ { false };
+      /* Set by a PressureStall trigger event */
+      bool wake_ { false };
+
+      /* Counted once per second by the thread that publishes the snapshots */
+      std::atomic<bool> count_interrupts_ { false };
+      std::unique_ptr<InterruptActivity> interrupts_;
+      std::shared_ptr<const InterruptMatrix> interrupt_matrix_;
+      std::chrono::steady_clock::time_point interrupts_time_;
+      std::atomic<bool> rank_tasks_ { false };
+      std::unique_ptr<ProcessActivity> processes_;
+      std::shared_ptr<const ProcessActivity::Ranking> ranking_;
+      std::chrono::steady_clock::time_point tasks_time_;
+
+      /** @brief Copy the sensor values into the back buffer and publish it. */
+      void publish();
+      /** @brief Adapt the sensors to the online cpus and enqueue them again. */
+      void rearrange();
+      /** @brief Describe the channels of the sensors. */
+      std::vector<Channel> describe() const;
+      /** @brief Map the sensor values to the cores and packages of the topology. */
+      void map();
+      /** @brief Count the interrupts (once per second) for a Snapshot. */
+      void count(Snapshot& s);
+      /** @brief Rank the tasks (once per second) for a Snapshot. */
+      void rank(Snapshot& s);
+      /** @brief The sampler thread. */
+      void sample();
+      /** @brief Let the sampler thread take the next sample right away. */
+      void wake();
   };
 
   const CpuActivity& CpuSensors::cpu_activity() { return cpu_active_; }
   const CpuFrequency& CpuSensors::cpu_frequency() { return cpu_freq_; }
   const CpuTemperature& CpuSensors::cpu_temperature() { return cpu_temp_; }
   const PowerCap::IntelRAPL& CpuSensors::cpu_power() { return cpu_power_; }
+  const PowerSupply& CpuSensors::power_supply() { return power_supply_; }
+  const CpuIdle& CpuSensors::cpu_idle() { return cpu_idle_; }
+  const ThermalThrottle& CpuSensors::cpu_throttle() { return cpu_throttle_; }
+  const PerfCounters& CpuSensors::cpu_perf() { return cpu_perf_; }
+  const PressureStall& CpuSensors::pressure() { return pressure_; }
+  const CpuSchedStat& CpuSensors::cpu_schedstat() { return cpu_sched_; }
 
 } // ends namespace xxx
 
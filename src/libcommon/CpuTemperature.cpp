@@ -22,53 +22,67 @@
  * @file src/libcommon/CpuTemperature.cpp
  * @brief Measure CPU temperature using sysfs (implementation).
  */
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 
 #include "Directory.hpp"
 #include "CpuTemperature.hpp"
+#include "HwmonSensors.hpp"
 
 namespace xxx {
 
   CpuTemperature::CpuTemperature() {
-    static constexpr const char* str_coretemp_ = "coretemp";
-    std::string sysfs_path;
-    /* Locate the directory in sysfs that contains the 'coretemp' hwmon */
-    Directory::Traverse("/sys/class/hwmon", [&](auto path, auto st) {
-      if (S_ISDIR(st->st_mode)) {
-        auto&& dir = Directory::Read(path);
-        long idx = dir.find("name");
-        if (idx >= 0) {
-          std::string fn(path);
-          fn.push_back('/');
-          fn.append(std::get<0>(dir[static_cast<size_t>(idx)]));
-          std::ifstream ifs(fn);
-          if (ifs.good()) {
-            std::string buf;
-            std::getline(ifs, buf);
-            if (buf == str_coretemp_) {
-              /* Found it! stop scanning */
-              sysfs_path = path;
-              return 1;
-            }
-          }
-        }
+    scan();
+    /* update the current values */
+    update();
+  }
+
+  void CpuTemperature::scan() {
+    /* Create a vector of the available inputs of each coretemp hwmon. */
+    std::vector<CpuTemperatureEntry> entries;
+    auto chips = HwmonSensors::Chips("coretemp");
+    for (const auto& path : chips) {
+      /* The numbers of the available temp?_input files (these need not be
+       * consecutive, the number of a core input is derived from its core id). */
+      std::vector<unsigned> numbers;
+      for (const auto& entry : Directory::Read(path.c_str())) {
+        unsigned n;
+        char suffix[8];
+        /* (not temp?_label, temp?_max etc.) */
+        if (std::sscanf(std::get<0>(entry).c_str(), "temp%u_%7s", &n, suffix) == 2
+            && std::strcmp(suffix, "input") == 0)
+          numbers.push_back(n);
       }
-      return 0;
-    });
-    /* Create a vector of available inputs. */
-    if (!sysfs_path.empty()) {
-      while (true) {
+      std::sort(numbers.begin(), numbers.end());
+      /* The package of the coretemp device (from its 'Package id N' input) */
+      unsigned long package = HwmonSensors::CoretempPackage(path);
+      if (package == ULONG_MAX) package = 0;
+      for (unsigned n : numbers) {
+        auto it = std::find_if(begin(), end(),
+            [&](const auto& e) { return e.number == n && e.path == path; });
+        if (it != end()) {
+          /* keep the existing input */
+          entries.push_back(std::move(*it));
+          continue;
+        }
         std::stringstream ss;
-        ss << sysfs_path << "/temp" << size() + 1;
+        ss << path << "/temp" << n;
         /* temp?_input */
         std::string fn(ss.str());
         fn.append("_input");
-        std::ifstream ifs(fn);
-        if (!ifs.good()) break;
         CpuTemperatureEntry i;
-        i.path = std::move(fn);
-        ifs.close();
+        i.number = n;
+        i.path = path;
+        i.package = package;
+        i.value = -1;
+        i.input = SysfsAttribute(fn);
+        if (!i.input.good()) continue;
+        std::ifstream ifs;
         /* temp?_label */
         fn = ss.str();
         fn.append("_label");
@@ -97,24 +111,40 @@ namespace xxx {
         else i.crit = -1;
         ifs.close();
         /* add the input to our vector */
-        push_back(std::move(i));
+        entries.push_back(std::move(i));
       }
     }
-    /* update the current values */
-    update();
+    /* The labels of the cores are repeated by each package */
+    for (auto& e : entries) {
+      e.name = e.label;
+      if (chips.size() > 1 && e.label.compare(0, 8, "Package ") != 0)
+        e.name += " (package " + std::to_string(e.package) + ")";
+    }
+    assign(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+  }
+
+  void CpuTemperature::hotplug() {
+    scan();
   }
 
   void CpuTemperature::update() {
     /* update the value of each input */
-    for (auto& input : *this) {
-      std::ifstream ifs(input.path);
-      if (ifs.good()) {
-        ifs >> input.value;
-        input.value /= 1000;
-      }
-      else {
-        input.value = -1;
-      }
+    for (auto& entry : *this) {
+      int value;
+      entry.value = entry.input.read(value) ? value / 1000 : -1;
+    }
+  }
+
+  void CpuTemperature::enqueue(ReadBatch& batch) {
+    slot_ = batch.size();
+    for (auto& entry : *this) batch.add(entry.input);
+  }
+
+  void CpuTemperature::update(const ReadBatch& batch) {
+    size_t slot = slot_;
+    for (auto& entry : *this) {
+      int value;
+      entry.value = SysfsAttribute::Parse(batch.data(slot++), value) ? value / 1000 : -1;
     }
   }
 
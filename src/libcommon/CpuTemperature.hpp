@@ -28,6 +28,9 @@
 #include <string>
 #include <vector>
 
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
 namespace xxx {
 
   /** @brief A single 'coretemp input' from /sys/class/hwmon. */
@@ -35,18 +38,42 @@ namespace xxx {
     friend class CpuTemperature;
     public:
       std::string label;  /* label of the input */
+      std::string name;   /* the label, followed by the package on multi-socket systems ('Core 0 (package 1)') */
       int max;            /* maximum temperature in °C */
       int crit;           /* critical temperature in °C */
       int value;          /* last updated value from the input */
+      unsigned long package; /* physical package id of the coretemp device */
     private:
-      std::string path;   /* sysfs path of the hwmon coretemp input */
+      SysfsAttribute input; /* the hwmon coretemp temp?_input attribute */
+      unsigned number;      /* the '?' in temp?_input */
+      std::string path;     /* the directory of the coretemp hwmon */
   };
 
-  /** @brief Measure processor temperature(s) by interpreting the 'coretemp inputs' listed in /sys/class/hwmon. */
+  /** @brief Measure processor temperature(s) by interpreting the 'coretemp inputs' listed in /sys/class/hwmon.
+    *
+    * There is a coretemp hwmon for each package, the inputs of all
+    * packages are in the order of their hwmon (see HwmonSensors::Chips()). */
   class CpuTemperature : public std::vector<CpuTemperatureEntry> {
     public:
       CpuTemperature();
       void update();
+      /** @brief Add the temp?_input attributes to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update the value of each input from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+      /** @brief Rescan the inputs after a cpu was hotplugged.
+        *
+        * The coretemp driver removes the input of a core when all its
+        * logical cpus are offline (and adds it again when one is online),
+        * the hwmon of a package is removed when all its cpus are offline.
+        * The entries of inputs that still exist are kept.
+        * @note Call enqueue() again after calling this function. */
+      void hotplug();
+    private:
+      /* ReadBatch slot of the first input */
+      size_t slot_ { 0 };
+      /* Create the vector of available inputs */
+      void scan();
   };
 
 } // ends namespace xxx
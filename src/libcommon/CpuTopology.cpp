@@ -0,0 +1,140 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuTopology.cpp
+ * @brief Map logical cpus to their cores and packages using /sys/devices/system/cpu/cpuN/topology (implementation).
+ */
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "CpuHotplug.hpp"
+#include "CpuTopology.hpp"
+
+namespace {
+
+  bool read_id(const std::string& path, unsigned long& id) {
+    std::ifstream ifs(path);
+    long value = -1;
+    if (ifs.good()) ifs >> value;
+    /* (die_id is -1 when the kernel does not know the die) */
+    id = (value < 0) ? 0 : static_cast<unsigned long>(value);
+    return ifs.good() || ifs.eof();
+  }
+
+} // ends namespace
+
+xxx::CpuTopology::CpuTopology() {
+  std::vector<unsigned> online;
+  std::ifstream ifs("/sys/devices/system/cpu/online");
+  std::string list;
+  if (ifs.good()) std::getline(ifs, list);
+  CpuHotplug::ParseList(list, online);
+  add(online);
+}
+
+xxx::CpuTopology::CpuTopology(const std::vector<CpuTopologyIds>& cpus) {
+  for (const auto& ids : cpus)
+    if (ids.logical >= cpus_.size() || cpus_[ids.logical].logical == ULONG_MAX) insert(ids);
+  for (auto& core : cores_) std::sort(core.cpus.begin(), core.cpus.end());
+  for (auto& pkg : packages_) std::sort(pkg.cpus.begin(), pkg.cpus.end());
+}
+
+bool xxx::CpuTopology::add(const std::vector<unsigned>& online) {
+  bool added = false;
+  for (unsigned logical : online) {
+    if (logical < cpus_.size() && cpus_[logical].logical != ULONG_MAX) continue;
+    std::string path("/sys/devices/system/cpu/cpu" + std::to_string(logical) + "/topology/");
+    CpuTopologyIds ids { logical, 0, 0, 0 };
+    if (!read_id(path + "physical_package_id", ids.package)
+        || !read_id(path + "core_id", ids.core)) continue;
+    if (!read_id(path + "die_id", ids.die)) ids.die = 0;
+    insert(ids);
+    added = true;
+  }
+  if (added) {
+    for (auto& core : cores_) std::sort(core.cpus.begin(), core.cpus.end());
+    for (auto& pkg : packages_) std::sort(pkg.cpus.begin(), pkg.cpus.end());
+  }
+  return added;
+}
+
+void xxx::CpuTopology::insert(const CpuTopologyIds& ids) {
+  unsigned long logical = ids.logical, package_id = ids.package, die_id = ids.die, core_id = ids.core;
+  /* the package */
+  size_t p = package(package_id);
+  if (p == SIZE_MAX) {
+    p = packages_.size();
+    std::string id(std::to_string(package_id));
+    packages_.push_back({ package_id, {}, {}, "package" + id, "package=\"" + id + "\"" });
+  }
+  auto& pkg = packages_[p];
+  /* the core */
+  auto it = std::find_if(pkg.cores.begin(), pkg.cores.end(), [&](size_t c) {
+    return cores_[c].id == core_id && cores_[c].die == die_id;
+  });
+  size_t c;
+  if (it != pkg.cores.end()) c = *it;
+  else {
+    c = cores_.size();
+    std::string id(std::to_string(core_id));
+    std::string die((die_id) ? "/die" + std::to_string(die_id) : "");
+    cores_.push_back({ core_id, die_id, p, {}, pkg.name + die + "/core" + id,
+        "core=\"" + id + "\"," + ((die_id) ? "die=\"" + std::to_string(die_id) + "\"," : "") + pkg.labels });
+    pkg.cores.push_back(c);
+  }
+  cores_[c].cpus.push_back(logical);
+  pkg.cpus.push_back(logical);
+  /* the logical cpu */
+  if (cpus_.size() <= logical) cpus_.resize(logical + 1);
+  cpus_[logical] = { logical, c, p,
+      "cpu=\"" + std::to_string(logical) + "\"," + cores_[c].labels };
+}
+
+std::vector<xxx::CpuTopologyIds> xxx::CpuTopology::ids() const {
+  std::vector<CpuTopologyIds> v;
+  for (const auto& cpu : cpus_) {
+    if (cpu.logical == ULONG_MAX) continue;
+    const auto& core = cores_[cpu.core];
+    v.push_back({ cpu.logical, packages_[cpu.package].id, core.die, core.id });
+  }
+  return v;
+}
+
+size_t xxx::CpuTopology::package(unsigned long id) const {
+  for (size_t p = 0; p < packages_.size(); ++p)
+    if (packages_[p].id == id) return p;
+  return SIZE_MAX;
+}
+
+size_t xxx::CpuTopology::coretemp(const std::string& label, unsigned long package_id, size_t& core) const {
+  core = SIZE_MAX;
+  size_t p = package(package_id);
+  if (p == SIZE_MAX) return SIZE_MAX;
+  unsigned long id;
+  if (std::sscanf(label.c_str(), "Package id %lu", &id) == 1) return package(id);
+  if (std::sscanf(label.c_str(), "Core %lu", &id) != 1) return SIZE_MAX;
+  for (size_t c : packages_[p].cores) {
+    if (cores_[c].id != id) continue;
+    core = c;
+    return p;
+  }
+  return SIZE_MAX;
+}
@@ -0,0 +1,140 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/CpuTopology.hpp
+ * @brief Map logical cpus to their cores and packages using /sys/devices/system/cpu/cpuN/topology.
+ */
+#ifndef libcommon_linux_sensors_CpuTopology_hpp
+#define libcommon_linux_sensors_CpuTopology_hpp
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xxx {
+
+  /** @brief A logical cpu of the CpuTopology. */
+  struct CpuTopologyCpu {
+    unsigned long logical { ULONG_MAX }; /* logical cpu number (ULONG_MAX == unknown cpu) */
+    size_t core { SIZE_MAX };            /* index into CpuTopology::cores() */
+    size_t package { SIZE_MAX };         /* index into CpuTopology::packages() */
+    /** @brief Prometheus labels, ie. 'cpu="3",core="1",package="0"'. */
+    std::string labels;
+  };
+
+  /** @brief A physical core of the CpuTopology. */
+  struct CpuTopologyCore {
+    unsigned long id;                 /* core_id (unique within a die) */
+    unsigned long die;                /* die_id (0 if the package has a single die) */
+    size_t package;                   /* index into CpuTopology::packages() */
+    std::vector<unsigned long> cpus;  /* logical cpu numbers of the core (its threads) */
+    /** @brief Name of the core, ie. 'package0/core1' ('package0/die1/core1' on multi-die packages). */
+    std::string name;
+    /** @brief Prometheus labels, ie. 'core="1",package="0"'. */
+    std::string labels;
+  };
+
+  /** @brief A physical package (socket) of the CpuTopology. */
+  struct CpuTopologyPackage {
+    unsigned long id;                 /* physical_package_id */
+    std::vector<size_t> cores;        /* indexes into CpuTopology::cores() */
+    std::vector<unsigned long> cpus;  /* logical cpu numbers of the package */
+    /** @brief Name of the package, ie. 'package0'. */
+    std::string name;
+    /** @brief Prometheus labels, ie. 'package="0"'. */
+    std::string labels;
+  };
+
+  /** @brief The ids of a logical cpu as read from its topology directory (see CpuTopology::ids()). */
+  struct CpuTopologyIds {
+    unsigned long logical;  /* logical cpu number */
+    unsigned long package;  /* physical_package_id */
+    unsigned long die;      /* die_id */
+    unsigned long core;     /* core_id */
+  };
+
+  /** @brief The aggregate of the sensors of a core or package (see CpuSensors::Snapshot).
+    *
+    * Values that have no sensor are 0, ie. the power of a core. */
+  struct CpuTopologyRollup {
+    double load;        /* mean load of the online logical cpus (%) */
+    double frequency;   /* mean frequency of the online logical cpus (MHz) */
+    double temperature; /* coretemp input of the core or package, or the hottest core (°C) */
+    double power;       /* average power of the RAPL package zone (W) */
+    double energy;      /* energy used by the RAPL package zone since the start (J) */
+    double energy_per_cycle; /* energy per busy cycle of the logical cpus (nJ) */
+    unsigned cpus;      /* the number of online logical cpus */
+  };
+
+  /** @brief Map each logical cpu to its core and package.
+    *
+    * The topology is read once, when cpus are hotplugged only the cpus
+    * that were not seen before are added (the topology of a cpu is not
+    * available while it is offline). The indexes of the cores and packages
+    * never change, so they can be used to index the rollups of the sensors.
+    * The names and labels are formatted once for the exporters. */
+  class CpuTopology {
+    public:
+      /** @brief Read the topology of the online cpus. */
+      CpuTopology();
+
+      /** @brief Build the topology of known cpus (ie. those of a recording) without reading sysfs. */
+      explicit CpuTopology(const std::vector<CpuTopologyIds>& cpus);
+
+      /** @brief Add the cpus that are not in the topology yet.
+        * @param online The (sorted) logical cpu numbers of the online cpus.
+        * @returns true if a cpu was added. */
+      bool add(const std::vector<unsigned>& online);
+
+      /** @brief Get a logical cpu (the entry of an unknown cpu has logical == ULONG_MAX). */
+      inline const CpuTopologyCpu& cpu(unsigned long logical) const {
+        return (logical < cpus_.size()) ? cpus_[logical] : unknown_;
+      }
+      inline const std::vector<CpuTopologyCore>& cores() const { return cores_; }
+      inline const std::vector<CpuTopologyPackage>& packages() const { return packages_; }
+
+      /** @brief The ids of every cpu in the topology (ordered by logical cpu number). */
+      std::vector<CpuTopologyIds> ids() const;
+
+      /** @brief Find a package by its physical_package_id.
+        * @returns The index of the package or SIZE_MAX. */
+      size_t package(unsigned long id) const;
+
+      /** @brief Find the core or package of a coretemp input.
+        * @param label The label of the input, ie. 'Core 1' or 'Package id 0'.
+        * @param package_id The physical_package_id of the coretemp device.
+        * @param[out] core The index of the core (SIZE_MAX for a package input).
+        * @returns The index of the package or SIZE_MAX if the label is unknown. */
+      size_t coretemp(const std::string& label, unsigned long package_id, size_t& core) const;
+
+    private:
+      /* Indexed by logical cpu number */
+      std::vector<CpuTopologyCpu> cpus_;
+      std::vector<CpuTopologyCore> cores_;
+      std::vector<CpuTopologyPackage> packages_;
+      CpuTopologyCpu unknown_;
+      /** @brief Add a cpu that is not in the topology yet. */
+      void insert(const CpuTopologyIds& ids);
+  };
+
+} // ends namespace xxx
+
+#endif
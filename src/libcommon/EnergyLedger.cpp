@@ -0,0 +1,122 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/EnergyLedger.cpp
+ * @brief The energy used by each RAPL power zone since the start, since a reset and over the lifetime (implementation).
+ */
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "EnergyLedger.hpp"
+
+xxx::EnergyLedger::EnergyLedger(std::string path)
+  : path_(std::move(path)) {
+  if (path_.empty()) return;
+  std::ifstream ifs(path_);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    auto tab = line.rfind('\t');
+    if (tab == std::string::npos || tab == 0) continue;
+    std::istringstream iss(line.substr(tab + 1));
+    double joules;
+    if (iss >> joules && joules >= 0.) stored_.emplace_back(line.substr(0, tab), joules);
+  }
+}
+
+double xxx::EnergyLedger::stored(const std::string& name) const {
+  for (const auto& s : stored_)
+    if (s.first == name) return s.second;
+  return 0.;
+}
+
+void xxx::EnergyLedger::update(const CpuSensors::Snapshot& snapshot) {
+  if (!snapshot.layout) return;
+  if (snapshot.layout != layout_) {
+    /* the zones of the power channels (the marks of the known zones are kept) */
+    std::vector<Zone> zones;
+    std::vector<double> marks;
+    for (const auto& c : *snapshot.layout) {
+      if (c.type != CpuSensors::Channel::Type::Power) continue;
+      size_t i = 0;
+      while (i < zones_.size() && zones_[i].name != c.name) ++i;
+      zones.push_back({ c.name, 0., 0., 0. });
+      marks.push_back((i < marks_.size()) ? marks_[i] : 0.);
+    }
+    zones_.swap(zones);
+    marks_.swap(marks);
+    layout_ = snapshot.layout;
+  }
+  size_t z = 0;
+  for (const auto& c : *layout_) {
+    if (c.type != CpuSensors::Channel::Type::Power) continue;
+    Zone& zone = zones_[z];
+    zone.start = (c.index < snapshot.energy.size()) ? snapshot.energy[c.index] : 0.;
+    zone.reset = zone.start - marks_[z];
+    zone.lifetime = stored(zone.name) + zone.start;
+    ++z;
+  }
+}
+
+void xxx::EnergyLedger::reset() {
+  for (size_t i = 0; i < zones_.size(); ++i) {
+    marks_[i] = zones_[i].start;
+    zones_[i].reset = 0.;
+  }
+}
+
+bool xxx::EnergyLedger::save() const {
+  if (path_.empty()) return true;
+  /* create the directory of the file (one level, ie. /var/lib/core-adjust) */
+  auto slash = path_.rfind('/');
+  if (slash != std::string::npos && slash > 0)
+    if (::mkdir(path_.substr(0, slash).c_str(), 0755) != 0 && errno != EEXIST) return false;
+  std::string tmp = path_ + ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::trunc);
+    if (!ofs.good()) return false;
+    ofs.precision(3);
+    ofs << std::fixed;
+    for (const auto& zone : zones_) ofs << zone.name << '\t' << zone.lifetime << '\n';
+    for (const auto& s : stored_) {
+      bool present = false;
+      for (const auto& zone : zones_) present |= (zone.name == s.first);
+      if (!present) ofs << s.first << '\t' << s.second << '\n';
+    }
+    ofs.flush();
+    if (!ofs.good()) {
+      int error = errno;
+      ::unlink(tmp.c_str());
+      errno = error;
+      return false;
+    }
+  }
+  if (::rename(tmp.c_str(), path_.c_str()) != 0) {
+    int error = errno;
+    ::unlink(tmp.c_str());
+    errno = error;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/EnergyLedger.hpp
+ * @brief The energy used by each RAPL power zone since the start, since a reset and over the lifetime.
+ */
+#ifndef libcommon_EnergyLedger_hpp
+#define libcommon_EnergyLedger_hpp
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CpuSensors.hpp"
+
+namespace xxx {
+
+  /** @brief Totals of the energy used by each power zone (and sub-zone) of the CpuSensors snapshots.
+    *
+    * The lifetime totals are read from a file when constructed and
+    * written by save(), as lines of 'zone<TAB>joules'. The totals of
+    * zones that are not present (anymore) are kept in the file.
+    * @note The file is not locked, two programs that save to the same
+    * file both add their energy to the total that they read. */
+  class EnergyLedger {
+    public:
+      struct Zone {
+        /** @brief The name of the power channel, ie. 'package-0' or 'package-0/core'. */
+        std::string name;
+        /** @brief The energy (J) since the start, since the last reset() and over the lifetime. */
+        double start;
+        double reset;
+        double lifetime;
+      };
+
+      /** @param path The file with the lifetime totals (empty == the lifetime is the time since the start). */
+      explicit EnergyLedger(std::string path = std::string());
+
+      /** @brief Update the totals from a snapshot (see CpuSensors::Snapshot::energy). */
+      void update(const CpuSensors::Snapshot& snapshot);
+
+      /** @brief Restart the totals since the last reset. */
+      void reset();
+
+      /** @brief Write the lifetime totals (to a temporary file that is renamed).
+        * @returns false on error (see errno), true if saved or if there is no file. */
+      bool save() const;
+
+      /** @brief The power zones in the order of the power channels. */
+      inline const std::vector<Zone>& zones() const { return zones_; }
+
+      inline const std::string& path() const { return path_; }
+
+    private:
+      std::string path_;
+      std::vector<Zone> zones_;
+      /* The lifetime totals that were read from the file */
+      std::vector<std::pair<std::string, double>> stored_;
+      /* The 'start' of each zone at the last reset */
+      std::vector<double> marks_;
+      std::shared_ptr<const std::vector<CpuSensors::Channel>> layout_;
+      /** @brief The lifetime total of a zone that was read from the file (or 0). */
+      double stored(const std::string& name) const;
+  };
+
+} // ends namespace xxx
+
+#endif
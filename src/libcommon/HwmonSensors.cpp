@@ -0,0 +1,223 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/HwmonSensors.cpp
+ * @brief Read all the inputs of the hwmon chips in sysfs (implementation).
+ */
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+#include "Directory.hpp"
+#include "HwmonSensors.hpp"
+
+namespace {
+
+  /* The attribute prefix, unit and scale of each kind of input */
+  struct InputKind {
+    xxx::HwmonEntry::Kind kind;
+    const char* prefix;
+    const char* unit;
+    double scale;
+  };
+
+  const InputKind input_kinds[] = {
+    { xxx::HwmonEntry::Kind::Temperature, "temp", "°C", 1e-3 },
+    { xxx::HwmonEntry::Kind::Voltage, "in", "V", 1e-3 },
+    { xxx::HwmonEntry::Kind::Fan, "fan", "RPM", 1. },
+    { xxx::HwmonEntry::Kind::Power, "power", "W", 1e-6 },
+    { xxx::HwmonEntry::Kind::Current, "curr", "A", 1e-3 }
+  };
+
+  /* The first line of a file (empty if it could not be read) */
+  std::string first_line(const std::string& fn) {
+    std::string line;
+    std::ifstream ifs(fn);
+    if (ifs.good()) std::getline(ifs, line);
+    return line;
+  }
+
+  /* The number of a hwmon directory ('hwmonN') for sorting */
+  unsigned long hwmon_number(const std::string& path) {
+    unsigned long n = ULONG_MAX;
+    auto slash = path.rfind('/');
+    std::sscanf(path.c_str() + ((slash == std::string::npos) ? 0 : slash + 1), "hwmon%lu", &n);
+    return n;
+  }
+
+} // ends namespace
+
+namespace xxx {
+
+  const char* HwmonEntry::Unit(Kind kind) {
+    for (const auto& k : input_kinds)
+      if (k.kind == kind) return k.unit;
+    return "";
+  }
+
+  HwmonSensors::HwmonSensors() {
+    scan();
+    /* update the current values */
+    update();
+  }
+
+  std::vector<std::string> HwmonSensors::Chips(const char* name) {
+    std::vector<std::string> paths;
+    for (const auto& entry : Directory::Read("/sys/class/hwmon", true)) {
+      const std::string& path = std::get<0>(entry);
+      if (name && first_line(path + "/name") != name) continue;
+      paths.push_back(path);
+    }
+    std::sort(paths.begin(), paths.end(), [](const auto& a, const auto& b) {
+      return hwmon_number(a) < hwmon_number(b);
+    });
+    return paths;
+  }
+
+  unsigned long HwmonSensors::CoretempPackage(const std::string& path) {
+    unsigned long package;
+    for (const auto& entry : Directory::Read(path.c_str())) {
+      unsigned n;
+      char end;
+      if (std::sscanf(std::get<0>(entry).c_str(), "temp%u_labe%c", &n, &end) != 2 || end != 'l') continue;
+      if (std::sscanf(first_line(path + "/" + std::get<0>(entry)).c_str(), "Package id %lu", &package) == 1)
+        return package;
+    }
+    /* (the device link points at the platform device 'coretemp.N') */
+    char link[PATH_MAX];
+    ssize_t n = ::readlink((path + "/device").c_str(), link, sizeof(link) - 1);
+    if (n > 0) {
+      link[n] = '\0';
+      const char* base = std::strrchr(link, '/');
+      if (std::sscanf(base ? base + 1 : link, "coretemp.%lu", &package) == 1) return package;
+    }
+    return ULONG_MAX;
+  }
+
+  void HwmonSensors::scan() {
+    std::vector<HwmonEntry> entries;
+    for (const auto& path : Chips()) {
+      std::string chip = first_line(path + "/name");
+      if (chip.empty()) continue;
+      auto slash = path.rfind('/');
+      std::string device = path.substr(slash + 1);
+      unsigned long package = (chip == "coretemp") ? CoretempPackage(path) : ULONG_MAX;
+      /* The numbers of the available inputs of each kind (in the order of their numbers) */
+      auto&& dir = Directory::Read(path.c_str());
+      for (const auto& k : input_kinds) {
+        std::vector<unsigned> numbers;
+        size_t prefix = std::strlen(k.prefix);
+        for (const auto& entry : dir) {
+          const std::string& fn = std::get<0>(entry);
+          if (fn.compare(0, prefix, k.prefix) != 0) continue;
+          unsigned n;
+          char suffix[16];
+          /* ?_input or (for power meters without an input) power?_average */
+          if (std::sscanf(fn.c_str() + prefix, "%u_%15s", &n, suffix) != 2) continue;
+          if (std::strcmp(suffix, "input") != 0
+              && (k.kind != HwmonEntry::Kind::Power || std::strcmp(suffix, "average") != 0
+                  || dir.find((std::string(k.prefix) + std::to_string(n) + "_input").c_str()) >= 0)) continue;
+          numbers.push_back(n);
+        }
+        std::sort(numbers.begin(), numbers.end());
+        for (unsigned n : numbers) {
+          std::string base = path + "/" + k.prefix + std::to_string(n);
+          auto it = std::find_if(begin(), end(), [&](const auto& e) {
+            return e.kind == k.kind && e.number == n && e.device == device && e.chip == chip;
+          });
+          if (it != end()) {
+            /* keep the existing input */
+            entries.push_back(std::move(*it));
+            continue;
+          }
+          HwmonEntry e;
+          e.chip = chip;
+          e.device = device;
+          e.kind = k.kind;
+          e.number = n;
+          e.scale = k.scale;
+          e.value = NAN;
+          e.package = package;
+          e.input = SysfsAttribute(base + "_input");
+          if (!e.input.good() && k.kind == HwmonEntry::Kind::Power)
+            e.input = SysfsAttribute(base + "_average");
+          if (!e.input.good()) continue;
+          e.label = first_line(base + "_label");
+          if (e.label.empty()) e.label = k.prefix + std::to_string(n);
+          entries.push_back(std::move(e));
+        }
+      }
+    }
+    /* The names of the inputs (the chips with the same name are numbered) */
+    for (auto& e : entries) {
+      std::vector<std::string> devices;
+      for (const auto& other : entries)
+        if (other.chip == e.chip && std::find(devices.begin(), devices.end(), other.device) == devices.end())
+          devices.push_back(other.device);
+      e.name = e.chip;
+      if (devices.size() > 1) {
+        auto n = static_cast<size_t>(std::find(devices.begin(), devices.end(), e.device) - devices.begin());
+        e.name += "-" + std::to_string((e.package != ULONG_MAX) ? e.package : n);
+      }
+      e.name += "/" + e.label;
+    }
+    assign(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+  }
+
+  void HwmonSensors::hotplug() {
+    scan();
+  }
+
+  size_t HwmonSensors::find(HwmonEntry::Kind kind, const std::string& chip, const std::string& label) const {
+    for (size_t i = 0; i < size(); ++i) {
+      const auto& e = (*this)[i];
+      if (e.kind == kind && e.chip == chip && e.label == label) return i;
+    }
+    return SIZE_MAX;
+  }
+
+  void HwmonSensors::update() {
+    /* update the value of each input */
+    for (auto& entry : *this) {
+      long long value;
+      entry.value = entry.input.read(value) ? static_cast<double>(value) * entry.scale : NAN;
+    }
+  }
+
+  void HwmonSensors::enqueue(ReadBatch& batch) {
+    slot_ = batch.size();
+    for (auto& entry : *this) batch.add(entry.input);
+  }
+
+  void HwmonSensors::update(const ReadBatch& batch) {
+    size_t slot = slot_;
+    for (auto& entry : *this) {
+      long long value;
+      entry.value = SysfsAttribute::Parse(batch.data(slot++), value)
+          ? static_cast<double>(value) * entry.scale : NAN;
+    }
+  }
+
+} // ends namespace xxx
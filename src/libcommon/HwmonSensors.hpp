@@ -0,0 +1,100 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/HwmonSensors.hpp
+ * @brief Read all the inputs of the hwmon chips in sysfs.
+ */
+
+#ifndef libcommon_linux_sensors_HwmonSensors_hpp
+#define libcommon_linux_sensors_HwmonSensors_hpp
+
+#include <string>
+#include <vector>
+
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief A single input of a hwmon chip (ie. 'temp1_input' or 'fan2_input'). */
+  struct HwmonEntry {
+    friend class HwmonSensors;
+    public:
+      /** @brief The type of input (the prefix of its attributes). */
+      enum class Kind { Temperature, Voltage, Fan, Power, Current };
+      std::string chip;   /* the name of the chip, ie. 'coretemp' or 'nct6775' */
+      std::string device; /* the hwmon directory, ie. 'hwmon3' */
+      std::string label;  /* the ?_label of the input or the name of the input ('fan2') */
+      Kind kind;
+      double value;       /* last updated value in °C, V, RPM, W or A (NAN on error) */
+      unsigned long package; /* the package of a coretemp input (or ULONG_MAX) */
+      /** @brief The unique name of the input, 'chip/label' or 'chip-N/label' when there are
+        * several chips with the same name (N is the package of a coretemp chip, else 0, 1, ..). */
+      std::string name;
+      /** @brief The unit of a kind of input. */
+      static const char* Unit(Kind kind);
+    private:
+      SysfsAttribute input; /* the ?_input (or power?_average) attribute */
+      unsigned number;      /* the '?' in ?_input */
+      double scale;         /* the unit of the attribute, ie. 0.001 for millidegree Celsius */
+  };
+
+  /** @brief Discover and read the inputs of all hwmon chips in /sys/class/hwmon.
+    *
+    * The temp, in, fan, power and curr inputs of every chip are found
+    * once, each input is read through a persistent file descriptor (see
+    * SysfsAttribute). The inputs of a coretemp chip are mapped to the
+    * physical package of that chip, so the inputs of all packages of a
+    * multi-socket system are found. */
+  class HwmonSensors : public std::vector<HwmonEntry> {
+    public:
+      HwmonSensors();
+      void update();
+      /** @brief Add the input attributes to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update the value of each input from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+      /** @brief Rescan the chips and their inputs (ie. after a cpu was hotplugged).
+        *
+        * The entries of inputs that still exist are kept.
+        * @note Call enqueue() again after calling this function. */
+      void hotplug();
+      /** @brief Find an input by chip and label.
+        * @returns The index of the input or SIZE_MAX. */
+      size_t find(HwmonEntry::Kind kind, const std::string& chip, const std::string& label) const;
+
+      /** @brief The directories of the hwmon chips with a name (all chips if nullptr).
+        * @returns The paths in the order of the hwmon numbers. */
+      static std::vector<std::string> Chips(const char* name = nullptr);
+      /** @brief The physical package of a coretemp chip (or ULONG_MAX).
+        *
+        * From the 'Package id N' input of the chip or else the instance
+        * number of its platform device ('coretemp.N'). */
+      static unsigned long CoretempPackage(const std::string& path);
+    private:
+      /* ReadBatch slot of the first input */
+      size_t slot_ { 0 };
+      /* Create the vector of available inputs */
+      void scan();
+  };
+
+} // ends namespace xxx
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/InterruptActivity.cpp
+ * @brief Count the interrupts and softirqs of each cpu by interpreting /proc/interrupts and /proc/softirqs (implementation).
+ */
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "InterruptActivity.hpp"
+
+namespace {
+
+  inline const char* skip_spaces(const char* p, const char* end) {
+    while (p < end && *p == ' ') ++p;
+    return p;
+  }
+
+  inline bool is_digit(char c) {
+    return static_cast<unsigned>(c - '0') < 10;
+  }
+
+  inline const char* parse_number(const char* p, const char* end, uint64_t& value) {
+    value = 0;
+    while (p < end && is_digit(*p)) value = value * 10 + static_cast<uint64_t>(*p++ - '0');
+    return p;
+  }
+
+  inline const char* end_of_line(const char* p, const char* end) {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    return eol ? eol : end;
+  }
+
+  /* The cpus of the header line ('CPU0 CPU1 ..') */
+  void parse_header(const char* p, const char* eol, std::vector<unsigned long>& cpus) {
+    cpus.clear();
+    while ((p = skip_spaces(p, eol)) < eol) {
+      if (eol - p < 4 || std::memcmp(p, "CPU", 3) != 0) break;
+      uint64_t cpu;
+      p = parse_number(p + 3, eol, cpu);
+      cpus.push_back(cpu);
+      while (p < eol && *p != ' ') ++p;
+    }
+  }
+
+} // ends namespace
+
+namespace xxx {
+
+  InterruptActivity::InterruptActivity(size_t top)
+    : InterruptMatrix(top) {
+    files_[0].attribute = SysfsAttribute("/proc/interrupts");
+    files_[0].softirq = false;
+    files_[0].buffer.resize(16384);
+    files_[1].attribute = SysfsAttribute("/proc/softirqs");
+    files_[1].softirq = true;
+    files_[1].buffer.resize(4096);
+    for (auto& file : files_) Read(file);
+    if (files_[0].text.empty()) throw std::runtime_error("InterruptActivity: could not read /proc/interrupts");
+    arrange();
+    time_ = std::chrono::steady_clock::now();
+  }
+
+  void InterruptActivity::Read(File& file) {
+    file.text = std::string_view();
+    while (true) {
+      ssize_t n = file.attribute.read(file.buffer.data(), file.buffer.size());
+      if (n <= 0) return;
+      /* (a read that fills the buffer may be truncated, enlarge it and read again) */
+      if (static_cast<size_t>(n) < file.buffer.size()) {
+        file.text = std::string_view(file.buffer.data(), static_cast<size_t>(n));
+        return;
+      }
+      file.buffer.resize(file.buffer.size() * 2);
+    }
+  }
+
+  bool InterruptActivity::parse(File& file) {
+    const char* p = file.text.data();
+    const char* end = p + file.text.size();
+    if (p == end) return file.cpus.empty() && file.rows == 0;
+    /* the header, compared with the cpus of the last update */
+    const char* eol = end_of_line(p, end);
+    size_t n = 0;
+    while ((p = skip_spaces(p, eol)) < eol) {
+      if (eol - p < 4 || std::memcmp(p, "CPU", 3) != 0) break;
+      uint64_t cpu;
+      p = parse_number(p + 3, eol, cpu);
+      if (n >= file.cpus.size() || file.cpus[n] != cpu) return false;
+      ++n;
+      while (p < eol && *p != ' ') ++p;
+    }
+    if (n != file.cpus.size()) return false;
+    /* the rows 'LABEL: COUNT COUNT .. DESCRIPTION', in the order of the last update */
+    const size_t columns = cpus_.size();
+    size_t r = 0;
+    for (p = eol + 1; p < end; p = eol + 1) {
+      eol = end_of_line(p, end);
+      p = skip_spaces(p, eol);
+      const char* colon = static_cast<const char*>(std::memchr(p, ':', static_cast<size_t>(eol - p)));
+      if (colon == nullptr) continue;
+      if (r >= file.rows) return false;
+      const std::string& name = sources_[file.first + r].name;
+      if (name.size() != static_cast<size_t>(colon - p) || std::memcmp(name.data(), p, name.size()) != 0) return false;
+      uint64_t* row = &sample_[(file.first + r) * columns];
+      const char* q = colon + 1;
+      size_t c = 0;
+      for (; c < file.columns.size(); ++c) {
+        q = skip_spaces(q, eol);
+        if (q == eol || !is_digit(*q)) break;
+        uint64_t value;
+        q = parse_number(q, eol, value);
+        if (file.columns[c] != SIZE_MAX) row[file.columns[c]] = value;
+      }
+      /* (a row with a single system wide counter, ie. 'ERR', is not attributed to a cpu) */
+      if (c < file.columns.size()) std::fill(row, row + columns, 0);
+      ++r;
+    }
+    return r == file.rows;
+  }
+
+  void InterruptActivity::arrange() {
+    std::vector<unsigned long> cpus;
+    cpus.swap(cpus_);
+    std::vector<InterruptSource> sources;
+    sources.swap(sources_);
+    std::vector<uint64_t> count;
+    count.swap(count_);
+    /* the columns are the (online) cpus of /proc/interrupts */
+    for (auto& file : files_) {
+      const char* p = file.text.data();
+      const char* end = p + file.text.size();
+      parse_header(p, end_of_line(p, end), file.cpus);
+    }
+    cpus_ = files_[0].cpus;
+    for (auto& file : files_) {
+      file.columns.clear();
+      for (unsigned long cpu : file.cpus) {
+        auto it = std::find(cpus_.begin(), cpus_.end(), cpu);
+        file.columns.push_back((it != cpus_.end()) ? static_cast<size_t>(it - cpus_.begin()) : SIZE_MAX);
+      }
+    }
+    /* the sources */
+    for (auto& file : files_) {
+      file.first = sources_.size();
+      const char* p = file.text.data();
+      const char* end = p + file.text.size();
+      for (p = end_of_line(p, end) + 1; p < end; p = end_of_line(p, end) + 1) {
+        const char* eol = end_of_line(p, end);
+        p = skip_spaces(p, eol);
+        const char* colon = static_cast<const char*>(std::memchr(p, ':', static_cast<size_t>(eol - p)));
+        if (colon == nullptr) continue;
+        InterruptSource source;
+        source.name.assign(p, colon);
+        source.softirq = file.softirq;
+        source.total = 0;
+        /* skip the counters, the remainder (with single spaces) is the description */
+        const char* q = colon + 1;
+        for (size_t c = 0; c < file.cpus.size(); ++c) {
+          q = skip_spaces(q, eol);
+          if (q == eol || !is_digit(*q)) break;
+          while (q < eol && is_digit(*q)) ++q;
+        }
+        while ((q = skip_spaces(q, eol)) < eol) {
+          const char* word = q;
+          while (q < eol && *q != ' ') ++q;
+          if (!source.description.empty()) source.description += ' ';
+          source.description.append(word, q);
+        }
+        sources_.push_back(std::move(source));
+      }
+      file.rows = sources_.size() - file.first;
+    }
+    const size_t columns = cpus_.size();
+    sample_.assign(sources_.size() * columns, 0);
+    for (auto& file : files_) parse(file);
+    /* the known sources keep their counters on the known cpus,
+     * the others start at their current counters */
+    count_ = sample_;
+    for (size_t r = 0; r < sources_.size(); ++r) {
+      auto it = std::find_if(sources.begin(), sources.end(), [this, r](const InterruptSource& s) {
+        return s.softirq == sources_[r].softirq && s.name == sources_[r].name;
+      });
+      if (it == sources.end()) continue;
+      size_t old_row = static_cast<size_t>(it - sources.begin());
+      for (size_t c = 0; c < columns; ++c) {
+        auto jt = std::find(cpus.begin(), cpus.end(), cpus_[c]);
+        if (jt != cpus.end())
+          count_[r * columns + c] = count[old_row * cpus.size() + static_cast<size_t>(jt - cpus.begin())];
+      }
+    }
+    delta_.assign(sample_.size(), 0);
+    top_.assign(columns * top_size_, SIZE_MAX);
+  }
+
+  void InterruptActivity::update() {
+    for (auto& file : files_) Read(file);
+    bool changed = false;
+    for (auto& file : files_) changed |= !parse(file);
+    if (changed) arrange();
+    auto now = std::chrono::steady_clock::now();
+    interval_ = std::chrono::duration<double>(now - time_).count();
+    time_ = now;
+    /* the interrupts of the interval (a counter that was reset counts 0) */
+    const size_t n = sample_.size();
+    const uint64_t* __restrict sample = sample_.data();
+    uint64_t* __restrict count = count_.data();
+    uint64_t* __restrict delta = delta_.data();
+    for (size_t i = 0; i < n; ++i) {
+      delta[i] = (sample[i] > count[i]) ? sample[i] - count[i] : 0;
+      count[i] = sample[i];
+    }
+    /* the totals and the sources with the most interrupts on each cpu */
+    const size_t columns = cpus_.size();
+    std::fill(top_.begin(), top_.end(), SIZE_MAX);
+    for (size_t r = 0; r < sources_.size(); ++r) {
+      const uint64_t* row = &delta_[r * columns];
+      uint64_t total = 0;
+      for (size_t c = 0; c < columns; ++c) {
+        total += row[c];
+        if (row[c] == 0 || top_size_ == 0) continue;
+        size_t* slots = &top_[c * top_size_];
+        size_t j = top_size_;
+        while (j > 0 && (slots[j - 1] == SIZE_MAX || delta_[slots[j - 1] * columns + c] < row[c])) --j;
+        if (j == top_size_) continue;
+        std::copy_backward(slots + j, slots + top_size_ - 1, slots + top_size_);
+        slots[j] = r;
+      }
+      sources_[r].total = total;
+    }
+  }
+
+} // ends namespace xxx
@@ -0,0 +1,135 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/InterruptActivity.hpp
+ * @brief Count the interrupts and softirqs of each cpu by interpreting /proc/interrupts and /proc/softirqs.
+ */
+#ifndef libcommon_linux_sensors_InterruptActivity_hpp
+#define libcommon_linux_sensors_InterruptActivity_hpp
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief A row of /proc/interrupts or /proc/softirqs. */
+  struct InterruptSource {
+    /** @brief The label of the row, ie. '24', 'LOC' or 'NET_RX'. */
+    std::string name;
+    /** @brief The text after the counters, ie. 'IO-APIC 5-edge ACPI:Ged'
+      * or 'Local timer interrupts' (empty for a softirq). */
+    std::string description;
+    /** @brief Is this a row of /proc/softirqs? */
+    bool softirq;
+    /** @brief The interrupts on all cpus during the last interval. */
+    uint64_t total;
+  };
+
+  /** @brief The interrupts of each source on each cpu during an interval.
+    *
+    * The result of an InterruptActivity, a copy of it is immutable and can
+    * be handed to another thread (see CpuSensors::Snapshot::interrupts). */
+  class InterruptMatrix {
+    public:
+      /** @brief The logical cpu of each column. */
+      inline const std::vector<unsigned long>& cpus() const { return cpus_; }
+      /** @brief The rows, the interrupts followed by the softirqs. */
+      inline const std::vector<InterruptSource>& sources() const { return sources_; }
+      /** @brief The interrupts of a source on a cpu (column) during the last interval. */
+      inline uint64_t delta(size_t source, size_t column) const { return delta_[source * cpus_.size() + column]; }
+      /** @brief The sources with the most interrupts on a cpu (column) during
+        * the last interval, highest first (top() entries, SIZE_MAX if none). */
+      inline const size_t* top(size_t column) const { return &top_[column * top_size_]; }
+      inline size_t top() const { return top_size_; }
+      /** @brief The length of the last interval (s). */
+      inline double interval() const { return interval_; }
+
+    protected:
+      explicit InterruptMatrix(size_t top) : top_size_(top) {}
+      std::vector<unsigned long> cpus_;
+      std::vector<InterruptSource> sources_;
+      /* sources_.size() rows of cpus_.size() columns */
+      std::vector<uint64_t> delta_;
+      size_t top_size_;
+      std::vector<size_t> top_;
+      double interval_ { 0. };
+  };
+
+  /** @brief Count the interrupts of each source on each cpu during an interval.
+    *
+    * The counters are kept as a matrix with a row for each source (the
+    * interrupts followed by the softirqs) and a column for each cpu in
+    * /proc/interrupts (the online cpus, /proc/softirqs lists all possible
+    * cpus and is mapped onto those columns).
+    *
+    * The files are read into buffers that are kept between the updates,
+    * they can be very wide (a counter for each cpu on every line). Each
+    * update() parses them in a single pass that stores the counters into
+    * the matrix without allocating memory; only when the layout of a file
+    * changed (an interrupt was registered or a cpu hotplugged) the sources
+    * are listed again, the counters of the known sources and cpus are kept. */
+  class InterruptActivity : public InterruptMatrix {
+    public:
+      /** @param top The number of sources ranked for each cpu.
+        * @throws std::runtime_error if /proc/interrupts can not be read. */
+      explicit InterruptActivity(size_t top = 3);
+
+      /** @brief Read the counters and calculate the interrupts of the last interval.
+        * (The constructor reads the first counters.) */
+      void update();
+
+    private:
+      /* /proc/interrupts or /proc/softirqs */
+      struct File {
+        SysfsAttribute attribute;
+        bool softirq;
+        std::vector<char> buffer;
+        std::string_view text;
+        /* The cpu of each column of the file (as read by the last update) */
+        std::vector<unsigned long> cpus;
+        /* The matrix column of each column of the file (or SIZE_MAX) */
+        std::vector<size_t> columns;
+        /* The first row of the file in the matrix and its number of rows */
+        size_t first { 0 };
+        size_t rows { 0 };
+      };
+      std::array<File, 2> files_;
+      /* The counters, laid out like delta_ (which is sample_ - count_) */
+      std::vector<uint64_t> sample_;  /* counters read by the last update */
+      std::vector<uint64_t> count_;   /* counters read by the previous update */
+      std::chrono::steady_clock::time_point time_;
+      /** @brief Read a file into its buffer (enlarged until the file fits). */
+      static void Read(File& file);
+      /** @brief Parse the counters of a file into sample_.
+        * @returns false if the layout of the file changed. */
+      bool parse(File& file);
+      /** @brief List the cpus and sources of the files again, keep the counters of the known ones. */
+      void arrange();
+  };
+
+} // ends namespace xxx
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/PerfCounters.cpp
+ * @brief Measure instructions per cycle and miss rates using perf_event_open(2) (implementation).
+ */
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "CpuHotplug.hpp"
+#include "PerfCounters.hpp"
+
+xxx::PerfCounters::PerfCounters() {
+  std::vector<unsigned> online;
+  std::ifstream ifs("/sys/devices/system/cpu/online");
+  std::string list;
+  if (ifs.good()) std::getline(ifs, list);
+  CpuHotplug::ParseList(list, online);
+  hotplug(online);
+}
+
+xxx::PerfCounters::~PerfCounters() {
+  for (auto& e : *this) close(e);
+}
+
+bool xxx::PerfCounters::open(PerfCountersEntry& entry) {
+  static constexpr uint64_t config[PerfCountersEntry::EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_REF_CPU_CYCLES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+  entry.fd.fill(-1);
+  entry.position.fill(-1);
+  entry.total.fill(0);
+  entry.delta.fill(0);
+  entry.count = 0;
+  entry.enabled = entry.running = 0;
+  entry.ipc = entry.llc_mpki = entry.branch_mpki = 0.;
+  for (int event = 0; event < PerfCountersEntry::EVENTS; ++event) {
+    struct perf_event_attr attr {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config[event];
+    attr.read_format = PERF_FORMAT_GROUP
+        | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    /* the group is enabled once all its events are opened */
+    attr.disabled = (event == PerfCountersEntry::CYCLES);
+    int group = entry.fd[PerfCountersEntry::CYCLES];
+    int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr,
+        -1, static_cast<int>(entry.logical), group, PERF_FLAG_FD_CLOEXEC));
+    if (fd < 0) {
+      /* no group leader, no counters */
+      if (event == PerfCountersEntry::CYCLES) return false;
+      continue;
+    }
+    entry.fd[event] = fd;
+    entry.position[event] = static_cast<int>(entry.count++);
+  }
+  int leader = entry.fd[PerfCountersEntry::CYCLES];
+  ::ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ::ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+void xxx::PerfCounters::close(PerfCountersEntry& entry) {
+  /* (close the members before the group leader) */
+  for (auto it = entry.fd.rbegin(); it != entry.fd.rend(); ++it) {
+    if (*it >= 0) ::close(*it);
+    *it = -1;
+  }
+}
+
+void xxx::PerfCounters::hotplug(const std::vector<unsigned>& online) {
+  std::vector<PerfCountersEntry> entries;
+  for (unsigned cpu : online) {
+    auto it = std::find_if(begin(), end(),
+        [cpu](const auto& e) { return e.logical == cpu; });
+    if (it != end()) {
+      // the cpu stayed online, keep its counters
+      entries.push_back(*it);
+      it->fd.fill(-1); // (now owned by 'entries')
+      continue;
+    }
+    PerfCountersEntry entry {};
+    entry.logical = cpu;
+    if (open(entry)) entries.push_back(entry);
+  }
+  for (auto& e : *this) close(e);
+  swap(entries);
+}
+
+void xxx::PerfCounters::update() {
+  using E = PerfCountersEntry;
+  for (auto& e : *this) {
+    ssize_t n = ::read(e.fd[E::CYCLES], buffer_.data(),
+        (3 + e.count) * sizeof(uint64_t));
+    if (n < static_cast<ssize_t>((3 + e.count) * sizeof(uint64_t))
+        || buffer_[0] != e.count) continue;
+    const uint64_t enabled = buffer_[1], running = buffer_[2];
+    const uint64_t* values = buffer_.data() + 3;
+    /* Scale the deltas when the group was multiplexed with other events
+     * (the ratios of the events in a group are not affected by this). */
+    double scale = 1.;
+    if (running > e.running && enabled > e.enabled)
+      scale = static_cast<double>(enabled - e.enabled) / (running - e.running);
+    else if (running == e.running)
+      scale = 0.; // the group did not run at all
+    for (int event = 0; event < E::EVENTS; ++event) {
+      if (e.position[event] < 0) continue;
+      uint64_t value = values[e.position[event]];
+      uint64_t delta = (value > e.total[event]) ? value - e.total[event] : 0;
+      e.delta[event] = static_cast<uint64_t>(delta * scale);
+      e.total[event] = value;
+    }
+    e.enabled = enabled;
+    e.running = running;
+    /* (an idle cpu does not count cycles nor instructions) */
+    e.ipc = e.llc_mpki = e.branch_mpki = 0.;
+    if (e.delta[E::CYCLES] == 0 || e.delta[E::INSTRUCTIONS] == 0) continue;
+    double kilo_instructions = e.delta[E::INSTRUCTIONS] / 1000.;
+    e.ipc = static_cast<double>(e.delta[E::INSTRUCTIONS]) / e.delta[E::CYCLES];
+    e.llc_mpki = e.delta[E::LLC_MISSES] / kilo_instructions;
+    e.branch_mpki = e.delta[E::BRANCH_MISSES] / kilo_instructions;
+  }
+}
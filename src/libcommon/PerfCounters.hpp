@@ -0,0 +1,94 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/PerfCounters.hpp
+ * @brief Measure instructions per cycle and miss rates using perf_event_open(2).
+ */
+#ifndef libcommon_linux_sensors_PerfCounters_hpp
+#define libcommon_linux_sensors_PerfCounters_hpp
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace xxx {
+
+  /** @brief The hardware counters of a logical cpu. */
+  struct PerfCountersEntry {
+    friend class PerfCounters;
+    public:
+      /** @brief The counted hardware events (in group order, CYCLES is the leader). */
+      enum Event { CYCLES, INSTRUCTIONS, REF_CYCLES, LLC_MISSES, BRANCH_MISSES, EVENTS };
+      unsigned long logical;         /* logical cpu number */
+      double ipc;                    /* instructions per cycle during the last interval */
+      double llc_mpki;               /* last level cache misses per 1000 instructions */
+      double branch_mpki;            /* branch misses per 1000 instructions */
+      std::array<uint64_t, EVENTS> delta; /* events during the last interval */
+      /** @brief Is an event counted on this cpu? */
+      inline bool available(Event event) const { return position[event] >= 0; }
+    private:
+      std::array<int, EVENTS> fd;         /* (-1 if the event is not available) */
+      std::array<int, EVENTS> position;   /* index of the event in the group read */
+      std::array<uint64_t, EVENTS> total; /* value of the previous read */
+      unsigned count;                     /* number of events in the group */
+      uint64_t enabled, running;          /* group times of the previous read (ns) */
+  };
+
+  /** @brief Count cycles, instructions, reference cycles, last level cache
+    * misses and branch misses of each online logical cpu.
+    *
+    * The events of a cpu are opened as a single group (with the cycles as
+    * the group leader) so that they are scheduled onto the PMU together and
+    * are read with a single read() (PERF_FORMAT_GROUP). Events that are not
+    * supported by the cpu are left out of the group.
+    *
+    * Counting all processes on a cpu requires CAP_PERFMON (or root) or a
+    * perf_event_paranoid setting of 0 or less, when the events cannot be
+    * opened this sensor simply has no entries.
+    * @note The file descriptors of perf events cannot be read at an offset,
+    * so this sensor does not take part in a ReadBatch. */
+  class PerfCounters : public std::vector<PerfCountersEntry> {
+    public:
+      PerfCounters();
+      ~PerfCounters();
+
+      PerfCounters(const PerfCounters&) = delete;
+      PerfCounters& operator=(const PerfCounters&) = delete;
+
+      /** @brief Read the counters of all cpus and calculate the rates. */
+      void update();
+      /** @brief Adapt the entries to a new set of online cpus.
+        *
+        * The counters of cpus that stay online are kept, the events of
+        * offline cpus are closed.
+        * @param online The (sorted) logical cpu numbers of the online cpus. */
+      void hotplug(const std::vector<unsigned>& online);
+
+    private:
+      /* Buffer for a group read: nr, time_enabled, time_running, values[nr] */
+      std::array<uint64_t, 3 + PerfCountersEntry::EVENTS> buffer_;
+      /* Open the events of a cpu (returns false if there is no group leader) */
+      static bool open(PerfCountersEntry& entry);
+      static void close(PerfCountersEntry& entry);
+  };
+
+} // ends namespace xxx
+
+#endif
@@ -22,32 +22,46 @@
  * @file src/libcommon/PowerCap.cpp
  * @brief Client for reading Intel RAPL "Running Average Power Limit" (RAPL) technology (implementation).
  */
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <fstream>
 
 #include "Directory.hpp"
 #include "PowerCap.hpp"
 
-namespace xxx {
+namespace {
+
+  /* Read the value of an attribute */
+  template<typename T>
+  bool read_attribute(const std::string& path, T& value) {
+    std::ifstream ifs(path);
+    if (!ifs.good()) return false;
+    ifs >> value;
+    return !ifs.fail();
+  }
+
+  /* Does an attribute exist? */
+  bool have_attribute(const std::string& path) {
+    std::ifstream ifs(path);
+    return ifs.good();
+  }
 
-#define POWERCAP_READ(VAR) \
-  s = path;                \
-  s.append("/" #VAR);      \
-  ifs.open(s);             \
-  if (ifs.good()) {        \
-    have_##VAR##_ = true;  \
-    ifs >> VAR##_;         \
-  }                        \
-  ifs.close();
-
-#define POWERCAP_READ_PATH(VAR) \
-  s = path;                     \
-  s.append("/" #VAR);           \
-  ifs.open(s);                  \
-  if (ifs.good()) {             \
-    have_##VAR##_ = true;       \
-    VAR##_path_ = s;            \
-  }                             \
-  ifs.close();
+  /* The (constant) numeric attributes of a constraint, 'constraint_N_<name>' */
+  const struct {
+    const char* name;
+    bool xxx::PowerCap::Constraint::* have;
+    uint64_t xxx::PowerCap::Constraint::* value;
+  } constraint_attributes[] = {
+    { "min_power_uw", &xxx::PowerCap::Constraint::have_min_power_uw, &xxx::PowerCap::Constraint::min_power_uw },
+    { "max_power_uw", &xxx::PowerCap::Constraint::have_max_power_uw, &xxx::PowerCap::Constraint::max_power_uw },
+    { "min_time_window_us", &xxx::PowerCap::Constraint::have_min_time_window_us, &xxx::PowerCap::Constraint::min_time_window_us },
+    { "max_time_window_us", &xxx::PowerCap::Constraint::have_max_time_window_us, &xxx::PowerCap::Constraint::max_time_window_us }
+  };
+
+} // ends namespace
+
+namespace xxx {
 
   /*
    * Attributes
@@ -56,36 +70,62 @@ namespace xxx {
   PowerCap::Attributes::Attributes()
     : have_name_(false),
       have_energy_uj_(false),
+      energy_uj_slot_(0),
       have_max_energy_range_uj_(false),
       max_energy_range_uj_(0),
       energy_uj_(0),
+      have_prev_energy_uj_(false),
       prev_energy_uj_(0),
+      total_energy_uj_(0),
       power_(0.),
       prev_power_(0.) { }
 
   PowerCap::Attributes::Attributes(const std::string& path)
     : Attributes() {
-    std::string s;
-    std::ifstream ifs;
-    POWERCAP_READ(name)
-    POWERCAP_READ_PATH(energy_uj)
-    POWERCAP_READ(max_energy_range_uj)
+    have_name_ = read_attribute(path + "/name", name_);
+    energy_uj_attr_ = SysfsAttribute(path + "/energy_uj");
+    have_energy_uj_ = energy_uj_attr_.good();
+    have_max_energy_range_uj_ = read_attribute(path + "/max_energy_range_uj", max_energy_range_uj_);
   }
 
   void PowerCap::Attributes::update(uint64_t diff_us) {
-    if (have_energy_uj_) {
-      std::ifstream ifs(energy_uj_path_);
-      ifs >> energy_uj_;
-      if (prev_energy_uj_ > 0 && energy_uj_ >= prev_energy_uj_) {
-        // P = E / t = Watt
-        power_ = static_cast<double>(energy_uj_ - prev_energy_uj_) / diff_us;
-      }
-      else {
-        power_ = prev_power_;
-      }
-      prev_energy_uj_ = energy_uj_;
-      prev_power_ = power_;
+    uint64_t energy_uj;
+    if (have_energy_uj_ && energy_uj_attr_.read(energy_uj))
+      update(energy_uj, diff_us);
+  }
+
+  void PowerCap::Attributes::enqueue(ReadBatch& batch) {
+    if (have_energy_uj_) energy_uj_slot_ = batch.add(energy_uj_attr_);
+  }
+
+  void PowerCap::Attributes::update(const ReadBatch& batch, uint64_t diff_us) {
+    uint64_t energy_uj;
+    if (have_energy_uj_ &&
+        SysfsAttribute::Parse(batch.data(energy_uj_slot_), energy_uj))
+      update(energy_uj, diff_us);
+  }
+
+  void PowerCap::Attributes::update(uint64_t energy_uj, uint64_t diff_us) {
+    energy_uj_ = energy_uj;
+    bool valid = have_prev_energy_uj_;
+    uint64_t delta = 0;
+    if (valid && energy_uj_ >= prev_energy_uj_) delta = energy_uj_ - prev_energy_uj_;
+    else if (valid && have_max_energy_range_uj_ && prev_energy_uj_ <= max_energy_range_uj_) {
+      // the counter wrapped (at most once, the range lasts for minutes)
+      delta = max_energy_range_uj_ - prev_energy_uj_ + energy_uj_;
+    }
+    else valid = false;
+    if (valid && diff_us > 0) {
+      // P = E / t = Watt
+      power_ = static_cast<double>(delta) / diff_us;
+    }
+    else {
+      power_ = prev_power_;
     }
+    total_energy_uj_ += delta;
+    have_prev_energy_uj_ = true;
+    prev_energy_uj_ = energy_uj_;
+    prev_power_ = power_;
   }
 
   /*
@@ -93,71 +133,44 @@ namespace xxx {
    */
 
   PowerCap::Constraints::Constraints()
-    : have_enabled_(false),
-      have_constraint_0_(false),
-      have_constraint_0_name_(false),
-      have_constraint_0_min_power_uw_(false),
-      constraint_0_min_power_uw_(0),
-      have_constraint_0_max_power_uw_(false),
-      constraint_0_max_power_uw_(0),
-      have_constraint_0_min_time_window_us_(false),
-      constraint_0_min_time_window_us_(0),
-      have_constraint_0_max_time_window_us_(false),
-      constraint_0_max_time_window_us_(0),
-      have_constraint_1_(false),
-      have_constraint_1_name_(false),
-      have_constraint_1_min_power_uw_(false),
-      constraint_1_min_power_uw_(0),
-      have_constraint_1_max_power_uw_(false),
-      constraint_1_max_power_uw_(0),
-      have_constraint_1_min_time_window_us_(false),
-      constraint_1_min_time_window_us_(0),
-      have_constraint_1_max_time_window_us_(false),
-      constraint_1_max_time_window_us_(0) { }
-
-  PowerCap::Constraints::Constraints(const std::string& path)
+    : have_enabled_(false) { }
+
+  PowerCap::Constraints::Constraints(const char* powercap_driver, const std::string& path)
     : Constraints() {
-    std::string s;
-    std::ifstream ifs;
-    POWERCAP_READ_PATH(enabled)
-    s = path;
-    s.append("/constraint_0_power_limit_uw");
-    ifs.open(s);
-    if (ifs.good()) {
-      have_constraint_0_ = true;
-      constraint_0_power_limit_uw_path_ = s;
-      s = path;
-      s.append("/constraint_0_time_window_us");
-      constraint_0_time_window_us_path_ = s;
-    }
-    ifs.close();
-    if (have_constraint_0_) {
-      POWERCAP_READ(constraint_0_name)
-      POWERCAP_READ(constraint_0_min_power_uw)
-      POWERCAP_READ(constraint_0_max_power_uw)
-      POWERCAP_READ(constraint_0_min_time_window_us)
-      POWERCAP_READ(constraint_0_max_time_window_us)
+    if (have_attribute(path + "/enabled")) {
+      have_enabled_ = true;
+      enabled_path_ = path + "/enabled";
     }
-    s = path;
-    s.append("/constraint_1_power_limit_uw");
-    ifs.open(s);
-    if (ifs.good()) {
-      have_constraint_1_ = true;
-      constraint_1_power_limit_uw_path_ = s;
-      s = path;
-      s.append("/constraint_1_time_window_us");
-      constraint_1_time_window_us_path_ = s;
-    }
-    ifs.close();
-    if (have_constraint_1_) {
-      POWERCAP_READ(constraint_1_name)
-      POWERCAP_READ(constraint_1_min_power_uw)
-      POWERCAP_READ(constraint_1_max_power_uw)
-      POWERCAP_READ(constraint_1_min_time_window_us)
-      POWERCAP_READ(constraint_1_max_time_window_us)
+    /* constraint_0_*, constraint_1_*, .. (until there is no power limit) */
+    for (unsigned n = 0; ; ++n) {
+      std::string prefix = path + "/constraint_" + std::to_string(n) + "_";
+      Constraint c {};
+      c.control_type = powercap_driver;
+      c.number = n;
+      c.power_limit_uw_path = prefix + "power_limit_uw";
+      if (!have_attribute(c.power_limit_uw_path)) break;
+      if (have_attribute(prefix + "time_window_us")) c.time_window_us_path = prefix + "time_window_us";
+      std::ifstream ifs(prefix + "name");
+      if (ifs.good()) std::getline(ifs, c.name);
+      for (const auto& a : constraint_attributes)
+        c.*a.have = read_attribute(prefix + a.name, c.*a.value);
+      constraints_.push_back(std::move(c));
     }
   }
 
+  size_t PowerCap::Constraints::find(const std::string& control_type, unsigned number) const {
+    for (size_t i = 0; i < constraints_.size(); ++i)
+      if (constraints_[i].control_type == control_type && constraints_[i].number == number) return i;
+    return SIZE_MAX;
+  }
+
+  double PowerCap::Constraints::power_limit(size_t constraint) const {
+    if (constraint >= constraints_.size()) return 0.;
+    uint64_t uw = 0;
+    read_attribute(constraints_[constraint].power_limit_uw_path, uw);
+    return static_cast<double>(uw) / 1e6;
+  }
+
   /*
    * SubZone
    */
@@ -166,9 +179,9 @@ namespace xxx {
     : Attributes(),
       Constraints() { }
 
-  PowerCap::SubZone::SubZone(const std::string& path)
+  PowerCap::SubZone::SubZone(const char* powercap_driver, const std::string& path)
     : Attributes(path),
-      Constraints(path) { }
+      Constraints(powercap_driver, path) { }
 
   /*
    * PowerZone
@@ -180,7 +193,8 @@ namespace xxx {
 
   PowerCap::PowerZone::PowerZone(const char* powercap_driver, const std::string& path)
     : Attributes(path),
-      Constraints(path) {
+      Constraints(powercap_driver, path),
+      control_type_(powercap_driver) {
     for (auto& e : Directory::Read(path.c_str(), false)) {
       if (S_ISDIR(std::get<1>(e).st_mode)) {
         std::string fn(powercap_driver);
@@ -189,7 +203,7 @@ namespace xxx {
           fn = path;
           fn.push_back('/');
           fn.append(std::get<0>(e));
-          emplace_back(fn);
+          emplace_back(powercap_driver, fn);
         }
       }
     }
@@ -200,6 +214,16 @@ namespace xxx {
     for (auto& sub_zone : *this) sub_zone.update(diff_us);
   }
 
+  void PowerCap::PowerZone::enqueue(ReadBatch& batch) {
+    Attributes::enqueue(batch);
+    for (auto& sub_zone : *this) sub_zone.enqueue(batch);
+  }
+
+  void PowerCap::PowerZone::update(const ReadBatch& batch, uint64_t diff_us) {
+    Attributes::update(batch, diff_us);
+    for (auto& sub_zone : *this) sub_zone.update(batch, diff_us);
+  }
+
   /*
    * IntelRAPL
    */
@@ -207,15 +231,47 @@ namespace xxx {
   PowerCap::IntelRAPL::IntelRAPL()
     : PowerZones(),
       tp_(std::chrono::high_resolution_clock::now()) {
-    int isEnabled = 0;
-    std::ifstream ifs("/sys/devices/virtual/powercap/intel-rapl/enabled");
-    ifs >> isEnabled;
-    ifs.close();
-    if (isEnabled)
-      for (auto& e : Directory::Read("/sys/devices/virtual/powercap/intel-rapl", true))
-        if (S_ISDIR(std::get<1>(e).st_mode))
-          if (std::get<0>(e).find("intel-rapl:") != std::string::npos)
-            emplace_back("intel-rapl", std::get<0>(e));
+    /* The control types are the entries without a ':' (the zones are
+     * 'type:N' and the sub-zones 'type:N:M'), intel-rapl sorts first. */
+    std::vector<std::string> control_types;
+    for (auto& e : Directory::Read("/sys/class/powercap", false))
+      if (std::get<0>(e).find(':') == std::string::npos) control_types.push_back(std::get<0>(e));
+    std::sort(control_types.begin(), control_types.end());
+    std::vector<std::string> real_paths;
+    for (const auto& type : control_types) {
+      std::string path = "/sys/class/powercap/" + type;
+      int isEnabled = 1;
+      read_attribute(path + "/enabled", isEnabled);
+      if (!isEnabled) continue;
+      std::string zone_prefix = type + ":";
+      auto&& dir = Directory::Read(path.c_str(), true);
+      std::sort(dir.begin(), dir.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+      for (auto& e : dir) {
+        if (!S_ISDIR(std::get<1>(e).st_mode)) continue;
+        const std::string& zone_path = std::get<0>(e);
+        auto slash = zone_path.rfind('/');
+        if (zone_path.compare(slash + 1, zone_prefix.size(), zone_prefix) != 0) continue;
+        /* the same directory by another path */
+        char* real = ::realpath(zone_path.c_str(), nullptr);
+        std::string real_path(real ? real : zone_path.c_str());
+        std::free(real);
+        if (std::find(real_paths.begin(), real_paths.end(), real_path) != real_paths.end()) continue;
+        real_paths.push_back(real_path);
+        PowerZone zone(type.c_str(), zone_path);
+        /* the same zone in another control type */
+        auto it = std::find_if(begin(), end(), [&zone](const auto& z) {
+          return z.control_type_ != zone.control_type_
+              && z.have_name_ && zone.have_name_ && z.name_ == zone.name_;
+        });
+        if (it == end()) {
+          emplace_back(std::move(zone));
+          continue;
+        }
+        /* keep the zone with the energy counter, with the constraints of both */
+        if (!it->have_energy_uj_ && zone.have_energy_uj_) std::swap(*it, zone);
+        for (auto& c : zone.constraints_) it->constraints_.push_back(std::move(c));
+      }
+    }
     update();
   }
 
@@ -227,5 +283,17 @@ namespace xxx {
     tp_ = high_resolution_clock::now();
   }
 
+  void PowerCap::IntelRAPL::enqueue(ReadBatch& batch) {
+    for (auto& power_zone : *this) power_zone.enqueue(batch);
+  }
+
+  void PowerCap::IntelRAPL::update(const ReadBatch& batch) {
+    using namespace std::chrono;
+    auto tnow = high_resolution_clock::now();
+    uint64_t diff_us = duration_cast<duration<uint64_t, std::micro>>(tnow - tp_).count();
+    for (auto& power_zone : *this) power_zone.update(batch, diff_us);
+    tp_ = tnow;
+  }
+
 } // ends namespace xxx
 
@@ -29,6 +29,9 @@
 #include <vector>
 #include <chrono>
 
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
 namespace xxx {
 
   /** @brief Power Capping Framework
@@ -38,8 +41,8 @@ namespace xxx {
     * 'control types', which correspond to different methods of power capping.
     *
     * The classes in this namespace use the framework to access the
-    * Intel RAPL ("Running Average Power Limit") technology control type.
-    * @note Sysfs location: /sys/devices/virtual/powercap/intel-rapl
+    * Intel RAPL ("Running Average Power Limit") technology control types.
+    * @note Sysfs location: /sys/class/powercap
     * @see kernel sources: Documentation/power/powercap/powercap.txt */
   namespace PowerCap {
 
@@ -49,64 +52,85 @@ namespace xxx {
       public:
         Attributes();
         ~Attributes() = default;
+        Attributes(Attributes&&) = default;
+        Attributes& operator=(Attributes&&) = default;
         explicit Attributes(const std::string& path);
 
         inline const std::string& name() const { return name_; }
         inline double average_power() const { return power_; }
+        /** @brief The energy (in Joule) used since the first update.
+          *
+          * Unlike energy_uj this does not wrap, a counter that wrapped
+          * (at max_energy_range_uj) between two updates is accounted for. */
+        inline double energy() const { return static_cast<double>(total_energy_uj_) / 1e6; }
 
       protected:
         void update(uint64_t diff_us);
+        void enqueue(ReadBatch& batch);
+        void update(const ReadBatch& batch, uint64_t diff_us);
+        /** @brief Calculate the average power and the total energy from a new energy_uj value. */
+        void update(uint64_t energy_uj, uint64_t diff_us);
 
         bool have_name_;
         std::string name_;
         bool have_energy_uj_;
-        std::string energy_uj_path_;
+        SysfsAttribute energy_uj_attr_;
+        size_t energy_uj_slot_;
         bool have_max_energy_range_uj_;
         uint64_t max_energy_range_uj_;
 
         uint64_t energy_uj_;
+        bool have_prev_energy_uj_;
         uint64_t prev_energy_uj_;
+        uint64_t total_energy_uj_;
         double power_;
         double prev_power_;
     };
 
+    /** @brief A single constraint of a PowerZone (the constraint_N_* attributes).
+      * @see kernel sources: Documentation/power/powercap/powercap.txt */
+    struct Constraint {
+      std::string name;                /* ie. 'long_term', 'short_term' or 'peak_power' */
+      std::string control_type;        /* the control type of the zone that has the constraint */
+      unsigned number;                 /* N of the constraint_N_* attributes */
+      std::string power_limit_uw_path;
+      std::string time_window_us_path; /* (empty if there is no time window, ie. peak_power) */
+      bool have_min_power_uw;
+      uint64_t min_power_uw;
+      bool have_max_power_uw;
+      uint64_t max_power_uw;
+      bool have_min_time_window_us;
+      uint64_t min_time_window_us;
+      bool have_max_time_window_us;
+      uint64_t max_time_window_us;
+    };
+
     /** @brief PowerZone constraints
       * @see kernel sources: Documentation/power/powercap/powercap.txt */
     class Constraints {
       public:
         Constraints();
         ~Constraints() = default;
-        explicit Constraints(const std::string& path);
+        Constraints(const char* powercap_driver, const std::string& path);
+
+        /** @brief The constraints of the zone, those of its own control type first
+          * (ie. RAPL: 0 = long term (PL1), 1 = short term (PL2), 2 = peak power (PL4)),
+          * followed by those of the same zone in another control type (see IntelRAPL). */
+        inline const std::vector<Constraint>& constraints() const { return constraints_; }
+
+        /** @brief Find a constraint by its control type and number.
+          * @returns The index into constraints() or SIZE_MAX. */
+        size_t find(const std::string& control_type, unsigned number) const;
+
+        /** @brief Read the current power limit of a constraint.
+          * @param constraint The index of the constraint (see constraints() and find()).
+          * @returns The limit in Watt or 0 if the constraint is not available. */
+        double power_limit(size_t constraint) const;
 
       protected:
         bool have_enabled_;
         std::string enabled_path_;
-        bool have_constraint_0_;
-        std::string constraint_0_power_limit_uw_path_;
-        std::string constraint_0_time_window_us_path_;
-        bool have_constraint_0_name_;
-        std::string constraint_0_name_;
-        bool have_constraint_0_min_power_uw_;
-        uint64_t constraint_0_min_power_uw_;
-        bool have_constraint_0_max_power_uw_;
-        uint64_t constraint_0_max_power_uw_;
-        bool have_constraint_0_min_time_window_us_;
-        uint64_t constraint_0_min_time_window_us_;
-        bool have_constraint_0_max_time_window_us_;
-        uint64_t constraint_0_max_time_window_us_;
-        bool have_constraint_1_;
-        std::string constraint_1_power_limit_uw_path_;
-        std::string constraint_1_time_window_us_path_;
-        bool have_constraint_1_name_;
-        std::string constraint_1_name_;
-        bool have_constraint_1_min_power_uw_;
-        uint64_t constraint_1_min_power_uw_;
-        bool have_constraint_1_max_power_uw_;
-        uint64_t constraint_1_max_power_uw_;
-        bool have_constraint_1_min_time_window_us_;
-        uint64_t constraint_1_min_time_window_us_;
-        bool have_constraint_1_max_time_window_us_;
-        uint64_t constraint_1_max_time_window_us_;
+        std::vector<Constraint> constraints_;
     };
 
     /** @brief Sub PowerZone
@@ -116,7 +140,9 @@ namespace xxx {
       public:
         SubZone();
         ~SubZone() = default;
-        explicit SubZone(const std::string& path);
+        SubZone(SubZone&&) = default;
+        SubZone& operator=(SubZone&&) = default;
+        SubZone(const char* powercap_driver, const std::string& path);
     };
 
     /** @brief A vector of SubZone. */
@@ -124,6 +150,8 @@ namespace xxx {
       public:
         using std::vector<SubZone>::vector;
         ~SubZones() = default;
+        SubZones(SubZones&&) = default;
+        SubZones& operator=(SubZones&&) = default;
     };
 
     /** @brief A single PowerZone and its (optional) sub-zones.
@@ -133,9 +161,16 @@ namespace xxx {
       public:
         PowerZone();
         ~PowerZone() = default;
+        PowerZone(PowerZone&&) = default;
+        PowerZone& operator=(PowerZone&&) = default;
         explicit PowerZone(const char* powercap_driver, const std::string& path);
+        /** @brief The control type of the zone, ie. 'intel-rapl' or 'intel-rapl-mmio'. */
+        inline const std::string& control_type() const { return control_type_; }
       protected:
+        std::string control_type_;
         void update(uint64_t diff_us);
+        void enqueue(ReadBatch& batch);
+        void update(const ReadBatch& batch, uint64_t diff_us);
     };
 
     /** @brief A vector of PowerZone. */
@@ -143,12 +178,20 @@ namespace xxx {
       public:
         using std::vector<PowerZone>::vector;
         ~PowerZones() = default;
+        PowerZones(PowerZones&&) = default;
+        PowerZones& operator=(PowerZones&&) = default;
     };
 
-    /** @brief Client for reading Intel RAPL ("Running Average Power Limit") technology powercap control-type
-      * (/sys/devices/virtual/powercap/intel-rapl).
+    /** @brief Client for reading Intel RAPL ("Running Average Power Limit") technology powercap control-types
+      * (/sys/class/powercap).
       *
       * A vector where each entry represents a PowerZone and its sub-zones.
+      * The zones of all (enabled) control types are read, ie. 'intel-rapl'
+      * (MSR) and 'intel-rapl-mmio'. A zone that is exposed by more than one
+      * control type (the package zone of intel-rapl-mmio) is only read once,
+      * from the control type that has its energy counter (or else the first).
+      * The constraints of the other control type are added to that zone,
+      * the MMIO power limits are other registers than those of the MSR.
       * @see kernel sources: Documentation/power/powercap/powercap.txt */
     class IntelRAPL : public PowerZones {
       public:
@@ -163,6 +206,10 @@ namespace xxx {
           * per time interval into powerusage in Watts.
           */
         void update();
+        /** @brief Add the energy counters of all PowerZones to a ReadBatch. */
+        void enqueue(ReadBatch& batch);
+        /** @brief Update the PowerZones from the data read by a ReadBatch. */
+        void update(const ReadBatch& batch);
       protected:
         /** @brief Timepoint used to calculate the time interval
           * between consequtive calls to IntelRAPL::update(). */
@@ -0,0 +1,145 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/PowerSupply.cpp
+ * @brief Measure the power of the system using the power supplies in sysfs (implementation).
+ */
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+
+#include "Directory.hpp"
+#include "PowerSupply.hpp"
+
+namespace {
+
+  /* The first line of a file (empty if it could not be read) */
+  std::string first_line(const std::string& fn) {
+    std::string line;
+    std::ifstream ifs(fn);
+    if (ifs.good()) std::getline(ifs, line);
+    return line;
+  }
+
+  /* Read an attribute into a string (without the newline) */
+  void read_text(xxx::SysfsAttribute& attr, std::string& text) {
+    char buf[32];
+    ssize_t n = attr.good() ? attr.read(buf, sizeof(buf)) : -1;
+    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' ')) --n;
+    /* (assign() reuses the capacity) */
+    if (n >= 0) text.assign(buf, static_cast<size_t>(n));
+    else text.clear();
+  }
+
+  void decode_text(std::string_view data, std::string& text) {
+    while (!data.empty() && (data.back() == '\n' || data.back() == ' ')) data.remove_suffix(1);
+    text.assign(data.data(), data.size());
+  }
+
+} // ends namespace
+
+namespace xxx {
+
+  void PowerSupplyEntry::decode(long long power_uw, long long current_ua, long long voltage_uv) {
+    /* (some batteries report a negative power or current while discharging) */
+    if (power_uw != LLONG_MIN) power = static_cast<double>(std::llabs(power_uw)) / 1e6;
+    else if (current_ua != LLONG_MIN && voltage_uv != LLONG_MIN)
+      power = static_cast<double>(std::llabs(current_ua)) / 1e6 * static_cast<double>(std::llabs(voltage_uv)) / 1e6;
+    else power = -1.;
+  }
+
+  PowerSupply::PowerSupply() {
+    Directory::Traverse("/sys/class/power_supply", [this](auto path, auto) {
+      std::string base(path);
+      /* (skip the batteries of peripherals, ie. a wireless mouse) */
+      if (first_line(base + "/scope") == "Device") return 0;
+      PowerSupplyEntry e;
+      auto slash = base.rfind('/');
+      e.name = base.substr(slash + 1);
+      e.type = first_line(base + "/type");
+      e.online = true;
+      e.power = -1.;
+      e.power_now = SysfsAttribute(base + "/power_now");
+      e.current_now = SysfsAttribute(base + "/current_now");
+      e.voltage_now = SysfsAttribute(base + "/voltage_now");
+      e.online_ = SysfsAttribute(base + "/online");
+      e.status_ = SysfsAttribute(base + "/status");
+      for (auto& slot : e.slots) slot = SIZE_MAX;
+      this->push_back(std::move(e));
+      return 0;
+    });
+    for (const auto& e : *this)
+      measured_ |= e.power_now.good() || (e.current_now.good() && e.voltage_now.good());
+    tp_ = std::chrono::steady_clock::now();
+    update();
+  }
+
+  void PowerSupply::update() {
+    for (auto& e : *this) {
+      long long power = LLONG_MIN, current = LLONG_MIN, voltage = LLONG_MIN;
+      if (e.power_now.good()) e.power_now.read(power);
+      if (e.current_now.good()) e.current_now.read(current);
+      if (e.voltage_now.good()) e.voltage_now.read(voltage);
+      e.decode(power, current, voltage);
+      int online;
+      if (e.online_.good() && e.online_.read(online)) e.online = online != 0;
+      read_text(e.status_, e.status);
+    }
+    account();
+  }
+
+  void PowerSupply::enqueue(ReadBatch& batch) {
+    for (auto& e : *this) {
+      SysfsAttribute* attrs[] = { &e.power_now, &e.current_now, &e.voltage_now, &e.online_, &e.status_ };
+      for (size_t i = 0; i < 5; ++i)
+        e.slots[i] = attrs[i]->good() ? batch.add(*attrs[i]) : SIZE_MAX;
+    }
+  }
+
+  void PowerSupply::update(const ReadBatch& batch) {
+    for (auto& e : *this) {
+      long long values[3] = { LLONG_MIN, LLONG_MIN, LLONG_MIN };
+      for (size_t i = 0; i < 3; ++i)
+        if (e.slots[i] != SIZE_MAX) SysfsAttribute::Parse(batch.data(e.slots[i]), values[i]);
+      e.decode(values[0], values[1], values[2]);
+      int online;
+      if (e.slots[3] != SIZE_MAX && SysfsAttribute::Parse(batch.data(e.slots[3]), online)) e.online = online != 0;
+      if (e.slots[4] != SIZE_MAX) decode_text(batch.data(e.slots[4]), e.status);
+    }
+    account();
+  }
+
+  void PowerSupply::account() {
+    double power = 0.;
+    for (const auto& e : *this) {
+      if (e.power < 0.) continue;
+      if (e.type == "Battery") {
+        if (e.status == "Discharging") power += e.power;
+      }
+      else if (e.online) power += e.power;
+    }
+    auto now = std::chrono::steady_clock::now();
+    system_energy_ += power * std::chrono::duration<double>(now - tp_).count();
+    tp_ = now;
+    system_power_ = power;
+  }
+
+} // ends namespace xxx
@@ -0,0 +1,91 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/PowerSupply.hpp
+ * @brief Measure the power of the system using the power supplies in sysfs.
+ */
+
+#ifndef libcommon_linux_sensors_PowerSupply_hpp
+#define libcommon_linux_sensors_PowerSupply_hpp
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief A single power supply from /sys/class/power_supply (ie. 'BAT0' or 'AC'). */
+  struct PowerSupplyEntry {
+    friend class PowerSupply;
+    public:
+      std::string name;   /* name of the supply */
+      std::string type;   /* 'Battery', 'Mains', 'USB', 'UPS' .. */
+      bool online;        /* the supply is online (always true if there is no online attribute) */
+      std::string status; /* 'Charging', 'Discharging', 'Full' .. (empty if there is no status attribute) */
+      double power;       /* W, power_now or current_now * voltage_now (-1 if it can not be measured) */
+    private:
+      SysfsAttribute power_now;   /* µW */
+      SysfsAttribute current_now; /* µA */
+      SysfsAttribute voltage_now; /* µV */
+      SysfsAttribute online_;
+      SysfsAttribute status_;
+      /* ReadBatch slot of each attribute (or SIZE_MAX) */
+      size_t slots[5];
+      void decode(long long power_uw, long long current_ua, long long voltage_uv);
+  };
+
+  /** @brief Measure the power used by the whole system with the power supplies in /sys/class/power_supply.
+    *
+    * RAPL only measures the power of the packages (and DRAM), the system
+    * power includes the rest of the platform. It is the power drawn from
+    * the discharging batteries plus that of the (online) supplies that
+    * measure their output, ie. a DC supply or a UPS.
+    * The supplies are found once by the constructor, the supplies of
+    * peripherals (scope 'Device') are ignored. */
+  class PowerSupply : public std::vector<PowerSupplyEntry> {
+    public:
+      PowerSupply();
+      void update();
+      /** @brief Add the attributes of the supplies to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update the supplies from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+      /** @brief Can a supply measure its power (when found by the constructor)? */
+      inline bool measured() const { return measured_; }
+      /** @brief The power used by the system (W, 0 if it is unknown, ie. on mains power
+        * without a supply that measures its output). */
+      inline double system_power() const { return system_power_; }
+      /** @brief The energy (J) used by the system since the start (the integral of system_power()). */
+      inline double system_energy() const { return system_energy_; }
+    private:
+      bool measured_ { false };
+      double system_power_ { 0. };
+      double system_energy_ { 0. };
+      std::chrono::steady_clock::time_point tp_;
+      /* Sum the power of the supplies (after each update) */
+      void account();
+  };
+
+} // ends namespace xxx
+
+#endif
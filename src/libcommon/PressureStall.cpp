@@ -0,0 +1,233 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/PressureStall.cpp
+ * @brief Measure the pressure stall information (PSI) of the cpu, memory and io (implementation).
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "Directory.hpp"
+#include "PressureStall.hpp"
+
+namespace {
+
+  /* The root of the cgroup v2 hierarchy (unified or hybrid) */
+  const char* cgroup2_root() {
+    if (access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0) return "/sys/fs/cgroup";
+    return "/sys/fs/cgroup/unified";
+  }
+
+} // ends namespace
+
+namespace xxx {
+
+  void PressureStallEntry::decode(std::string_view text, double seconds) {
+    /* 'some avg10=0.00 avg60=0.00 avg300=0.00 total=0' and the same for 'full' */
+    while (!text.empty()) {
+      size_t eol = std::min(text.find('\n'), text.size());
+      std::string_view line = text.substr(0, eol);
+      text.remove_prefix(std::min(eol + 1, text.size()));
+      bool is_full = line.compare(0, 5, "full ") == 0;
+      if (!is_full && line.compare(0, 5, "some ") != 0) continue;
+      size_t pos = line.find("total=");
+      uint64_t total;
+      if (pos == std::string_view::npos || !SysfsAttribute::Parse(line.substr(pos + 6), total)) continue;
+      uint64_t& previous = is_full ? full_total : some_total;
+      double& percent = is_full ? full : some;
+      /* µs stalled / (s * 1e6) * 100 */
+      percent = (seconds > 0. && total >= previous)
+          ? std::min(static_cast<double>(total - previous) / seconds / 1e4, 100.) : 0.;
+      previous = total;
+    }
+  }
+
+  PressureStall::PressureStall(bool cgroups) {
+    auto add = [this](const std::string& path, std::string name) {
+      PressureStallEntry e;
+      e.name = std::move(name);
+      e.file = SysfsAttribute(path);
+      /* (the files exist but can not be read when booted with psi=0) */
+      char buf[256];
+      ssize_t n = e.file.good() ? e.file.read(buf, sizeof(buf)) : -1;
+      if (n <= 0) return;
+      std::string_view text(buf, static_cast<size_t>(n));
+      e.has_full = text.find("full ") != std::string_view::npos;
+      e.some = e.full = 0.;
+      e.armed = false;
+      e.stalls = e.events = 0;
+      e.some_total = e.full_total = 0;
+      e.slot = SIZE_MAX;
+      e.decode(text, 0.);
+      this->push_back(std::move(e));
+    };
+    for (const char* resource : { "cpu", "memory", "io" })
+      add(std::string("/proc/pressure/") + resource, resource);
+    if (cgroups) {
+      std::vector<std::string> groups;
+      Directory::Traverse(cgroup2_root(), [&groups](auto fn, auto st) {
+        if (S_ISDIR(st->st_mode)) groups.push_back(fn);
+        return 0;
+      }, false);
+      std::sort(groups.begin(), groups.end());
+      for (const auto& group : groups)
+        add(std::string(cgroup2_root()) + "/" + group + "/cpu.pressure", group + "/cpu");
+    }
+    triggers_.assign(size(), -1);
+    events_ = std::make_unique<std::atomic<uint64_t>[]>(size());
+    for (size_t i = 0; i < size(); ++i) events_[i] = 0;
+    /* a pollfd for each trigger followed by the one of stop_fd_ */
+    polled_.assign(size() + 1, pollfd { -1, POLLPRI, 0 });
+    polled_.back().events = POLLIN;
+    tp_ = std::chrono::steady_clock::now();
+  }
+
+  PressureStall::~PressureStall() {
+    unwatch();
+    disarm();
+  }
+
+  void PressureStall::update() {
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - tp_).count();
+    tp_ = now;
+    char buf[256];
+    for (auto& e : *this) {
+      ssize_t n = e.file.read(buf, sizeof(buf));
+      if (n > 0) e.decode(std::string_view(buf, static_cast<size_t>(n)), seconds);
+    }
+    account();
+  }
+
+  void PressureStall::enqueue(ReadBatch& batch) {
+    for (auto& e : *this) e.slot = e.file.good() ? batch.add(e.file, 256) : SIZE_MAX;
+  }
+
+  void PressureStall::update(const ReadBatch& batch) {
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - tp_).count();
+    tp_ = now;
+    for (auto& e : *this)
+      if (e.slot != SIZE_MAX) e.decode(batch.data(e.slot), seconds);
+    account();
+  }
+
+  size_t PressureStall::arm(const char* trigger) {
+    bool watched = watching();
+    Listener listener = listener_;
+    unwatch();
+    disarm();
+    /* Without CAP_SYS_RESOURCE the window must be a multiple of 2 s,
+     * that trigger keeps the ratio of the stall time to the window. */
+    char unprivileged[64] = "";
+    char kind[8];
+    unsigned long stall_us, window_us;
+    if (std::sscanf(trigger, "%7s %lu %lu", kind, &stall_us, &window_us) == 3 && window_us > 0) {
+      unsigned long window = (window_us + 1999999) / 2000000 * 2000000;
+      std::snprintf(unprivileged, sizeof(unprivileged), "%s %lu %lu",
+          kind, static_cast<unsigned long>(static_cast<double>(stall_us) * window / window_us), window);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < size(); ++i) {
+      auto& e = (*this)[i];
+      int fd = open(e.file.path().c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+      if (fd >= 0 && write(fd, trigger, std::strlen(trigger) + 1) < 0
+          && (*unprivileged == '\0' || write(fd, unprivileged, std::strlen(unprivileged) + 1) < 0)) {
+        close(fd);
+        fd = -1;
+      }
+      triggers_[i] = polled_[i].fd = fd;
+      e.armed = fd >= 0;
+      n += e.armed;
+    }
+    armed_ = n;
+    if (watched) watch(std::move(listener));
+    return n;
+  }
+
+  void PressureStall::disarm() {
+    for (size_t i = 0; i < size(); ++i) {
+      if (triggers_[i] >= 0) close(triggers_[i]);
+      triggers_[i] = polled_[i].fd = -1;
+      (*this)[i].armed = false;
+    }
+    armed_ = 0;
+  }
+
+  void PressureStall::watch(Listener listener) {
+    unwatch();
+    if (armed_ == 0) return;
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd_ < 0) return;
+    polled_.back().fd = stop_fd_;
+    listener_ = std::move(listener);
+    watcher_ = std::thread([this]() { while (collect(-1)) {} });
+  }
+
+  void PressureStall::unwatch() {
+    if (!watcher_.joinable()) return;
+    uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) < 0) {}
+    watcher_.join();
+    close(stop_fd_);
+    stop_fd_ = polled_.back().fd = -1;
+    listener_ = nullptr;
+  }
+
+  bool PressureStall::collect(int timeout) {
+    int n = poll(polled_.data(), polled_.size(), timeout);
+    if (n < 0) return errno == EINTR;
+    if (polled_.back().revents & POLLIN) return false;
+    for (size_t i = 0; n > 0 && i < size(); ++i) {
+      short revents = polled_[i].revents;
+      if (revents == 0) continue;
+      --n;
+      /* (the cgroup was removed, its trigger is closed by disarm()) */
+      if (revents & (POLLERR | POLLNVAL)) {
+        polled_[i].fd = -1;
+        continue;
+      }
+      if (revents & POLLPRI) {
+        events_[i].fetch_add(1, std::memory_order_relaxed);
+        if (listener_) listener_(i);
+      }
+    }
+    return true;
+  }
+
+  void PressureStall::account() {
+    /* (without the watch() thread the events are collected here, without waiting) */
+    if (armed_ > 0 && !watching()) collect(0);
+    for (size_t i = 0; i < size(); ++i) {
+      auto& e = (*this)[i];
+      uint64_t events = events_[i].load(std::memory_order_relaxed);
+      e.stalls = events - e.events;
+      e.events = events;
+    }
+  }
+
+} // ends namespace xxx
@@ -0,0 +1,141 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/PressureStall.hpp
+ * @brief Measure the pressure stall information (PSI) of the cpu, memory and io.
+ */
+
+#ifndef libcommon_linux_sensors_PressureStall_hpp
+#define libcommon_linux_sensors_PressureStall_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief The pressure of a single resource (ie. /proc/pressure/cpu or a cgroup cpu.pressure). */
+  struct PressureStallEntry {
+    friend class PressureStall;
+    public:
+      std::string name; /* 'cpu', 'memory', 'io' or the cgroup and resource, ie. 'system.slice/cpu' */
+      bool has_full;    /* the resource has a 'full' line */
+      double some;      /* % of the last interval that some tasks stalled on the resource */
+      double full;      /* % of the last interval that all non-idle tasks stalled (0 if !has_full) */
+      bool armed;       /* a trigger is registered on the resource (see PressureStall::arm()) */
+      uint64_t stalls;  /* trigger events during the last interval */
+    private:
+      SysfsAttribute file;
+      /* ReadBatch slot of the file */
+      size_t slot;
+      /* The stall times (µs) read by the last update */
+      uint64_t some_total;
+      uint64_t full_total;
+      /* The trigger events counted up to the last update */
+      uint64_t events;
+      void decode(std::string_view text, double seconds);
+  };
+
+  /** @brief Measure the pressure stall information of the system and of the top-level cgroups.
+    *
+    * The resources are /proc/pressure/{cpu,memory,io} and the cpu.pressure
+    * of the child groups of the cgroup v2 root (ie. 'system.slice'), they
+    * are found once by the constructor. The share of each interval that
+    * the tasks stalled is calculated from the 'total' stall times.
+    *
+    * Instead of sampling fast enough to catch a short stall a kernel
+    * trigger is registered on each resource with arm(), ie. 'some 150000
+    * 1000000' (150 ms of stall within a 1 s window). The events of the
+    * triggers are collected with a non-blocking poll() by update() or by
+    * a thread that waits for them (see watch()), which costs nothing while
+    * there are no stalls.
+    * Registering a trigger requires CAP_SYS_RESOURCE, without it (linux
+    * 6.5 and later) the window is stretched to a multiple of 2 s. */
+  class PressureStall : public std::vector<PressureStallEntry> {
+    public:
+      /** @brief A function that is called for each trigger event (with the index of the entry). */
+      using Listener = std::function<void(size_t)>;
+
+      /** @brief 150 ms of (partial) stall within 1 s. */
+      static constexpr const char* DefaultTrigger = "some 150000 1000000";
+
+      /** @param cgroups Include the cpu.pressure of the top-level cgroups. */
+      explicit PressureStall(bool cgroups = true);
+      ~PressureStall();
+
+      PressureStall(const PressureStall&) = delete;
+      PressureStall& operator=(const PressureStall&) = delete;
+
+      void update();
+      /** @brief Add the pressure files to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update the pressure from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+
+      /** @brief Register a trigger on each resource (replaces the previous triggers).
+        * @param trigger 'some|full STALL_US WINDOW_US'.
+        * @returns The number of triggers that could be registered. */
+      size_t arm(const char* trigger = DefaultTrigger);
+      /** @brief Start a thread that waits for the trigger events.
+        *
+        * The listener is called by that thread and must not block.
+        * @note The entries must not be modified while the thread is running,
+        *   and watch() and unwatch() must not run concurrently with update(). */
+      void watch(Listener listener);
+      /** @brief Stop the thread started by watch() (if it is running). */
+      void unwatch();
+      /** @brief Is the watch() thread running? */
+      inline bool watching() const { return watcher_.joinable(); }
+
+    private:
+      /* The file descriptor of the trigger of each entry (or -1) */
+      std::vector<int> triggers_;
+      size_t armed_ { 0 };
+      /* The triggers followed by stop_fd_ (-1 == not polled) */
+      std::vector<pollfd> polled_;
+      /* The trigger events of each entry (counted by collect()) */
+      std::unique_ptr<std::atomic<uint64_t>[]> events_;
+      /* Wakes the watch() thread when it must stop (an eventfd) */
+      int stop_fd_ { -1 };
+      std::thread watcher_;
+      Listener listener_;
+      std::chrono::steady_clock::time_point tp_;
+      /* Count the trigger events (waits up to timeout ms, -1 == until stopped)
+       * @returns false if the watch() thread must stop */
+      bool collect(int timeout);
+      /* Copy the trigger events into the entries (after each update) */
+      void account();
+      void disarm();
+  };
+
+} // ends namespace xxx
+
+#endif
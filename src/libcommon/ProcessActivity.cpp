@@ -0,0 +1,270 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/ProcessActivity.cpp
+ * @brief Attribute the cpu time to the tasks (threads) of each process (implementation).
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "ProcessActivity.hpp"
+
+namespace {
+
+  /* Parse a decimal number (of a /proc file), advances s */
+  inline uint64_t number(const char*& s, const char* end) {
+    uint64_t v = 0;
+    while (s < end && *s >= '0' && *s <= '9') v = v * 10 + static_cast<uint64_t>(*s++ - '0');
+    return v;
+  }
+
+  /* Skip n fields (and the spaces that follow them) */
+  inline void skip(const char*& s, const char* end, int n) {
+    while (n-- > 0 && s < end) {
+      while (s < end && *s != ' ') ++s;
+      while (s < end && *s == ' ') ++s;
+    }
+  }
+
+  /* Is the name of a /proc entry a number? */
+  inline bool numeric(const char* name) {
+    if (*name == '\0') return false;
+    for (; *name; ++name)
+      if (*name < '0' || *name > '9') return false;
+    return true;
+  }
+
+} // ends namespace
+
+xxx::ProcessActivity::ProcessActivity(size_t top, size_t max_descriptors)
+  : top_size_(std::max<size_t>(top, 1)),
+    max_descriptors_(max_descriptors) {
+  proc_ = ::opendir("/proc");
+  if (!proc_) throw std::runtime_error(std::string("Could not open '/proc': ") + std::strerror(errno));
+  long tck = ::sysconf(_SC_CLK_TCK);
+  clock_ticks_ = (tck > 0) ? static_cast<double>(tck) : 100.;
+}
+
+xxx::ProcessActivity::~ProcessActivity() {
+  for (auto& p : processes_) {
+    close(p.second.fd);
+    for (auto& t : p.second.tasks) close(t.fd);
+  }
+  ::closedir(proc_);
+}
+
+void xxx::ProcessActivity::close(int& fd) {
+  if (fd < 0) return;
+  ::close(fd);
+  fd = -1;
+  --descriptors_;
+}
+
+void xxx::ProcessActivity::release() {
+  for (auto& p : processes_) {
+    close(p.second.fd);
+    for (auto& t : p.second.tasks) close(t.fd);
+  }
+}
+
+size_t xxx::ProcessActivity::available() const {
+  struct rlimit limit;
+  if (::getrlimit(RLIMIT_NOFILE, &limit) != 0) return 0;
+  if (limit.rlim_cur == RLIM_INFINITY) return SIZE_MAX;
+  /* the descriptors of the process that are not stat files
+   * (the directory itself is not counted) */
+  DIR* dir = ::opendir("/proc/self/fd");
+  if (!dir) return 0;
+  size_t used = 0;
+  while (struct dirent* e = ::readdir(dir))
+    used += numeric(e->d_name);
+  ::closedir(dir);
+  used = (used > descriptors_ + 1) ? used - descriptors_ - 1 : 0;
+  auto cur = static_cast<size_t>(limit.rlim_cur);
+  return (cur > used) ? cur - used : 0;
+}
+
+bool xxx::ProcessActivity::Parse(const char* s, size_t size, Stat& stat) {
+  /* 'pid (comm) state ppid ...', the comm may contain spaces and parentheses */
+  const char* end = s + size;
+  const char* open = static_cast<const char*>(std::memchr(s, '(', size));
+  const char* close = end;
+  while (close > s && *(close - 1) != ')') --close;
+  if (!open || close <= open + 1) return false;
+  stat.comm = open + 1;
+  stat.comm_size = static_cast<size_t>(close - 1 - stat.comm);
+  /* field 3 (state) follows the ') ' */
+  const char* p = close + 1;
+  skip(p, end, 11);               /* to field 14 (utime) */
+  stat.ticks = number(p, end);
+  skip(p, end, 1);
+  stat.ticks += number(p, end);   /* field 15 (stime) */
+  skip(p, end, 5);                /* to field 20 (num_threads) */
+  stat.threads = static_cast<long>(number(p, end));
+  skip(p, end, 19);               /* to field 39 (processor) */
+  if (p >= end) return false;
+  stat.processor = number(p, end);
+  return true;
+}
+
+bool xxx::ProcessActivity::read(int& fd, const char* path, bool keep, Stat& stat) {
+  ssize_t n;
+  if (fd >= 0) n = ::pread(fd, buffer_, sizeof(buffer_) - 1, 0);
+  else {
+    int f = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (f < 0 && errno == EMFILE && descriptors_ > 0) {
+      /* out of descriptors, open and close the stat files until the next update() */
+      release();
+      budget_ = 0;
+      f = ::open(path, O_RDONLY | O_CLOEXEC);
+    }
+    if (f < 0) return false;
+    n = ::pread(f, buffer_, sizeof(buffer_) - 1, 0);
+    if (keep && n > 0 && descriptors_ < budget_) {
+      fd = f;
+      ++descriptors_;
+    }
+    else ::close(f);
+  }
+  /* (a task that exited reads as an error or as an empty file) */
+  if (n <= 0) return false;
+  buffer_[n] = '\0';
+  return Parse(buffer_, static_cast<size_t>(n), stat);
+}
+
+void xxx::ProcessActivity::list(pid_t pid, Process& process) {
+  std::snprintf(path_, sizeof(path_), "/proc/%d/task", static_cast<int>(pid));
+  DIR* dir = ::opendir(path_);
+  std::vector<pid_t> tids;
+  if (dir) {
+    while (struct dirent* e = ::readdir(dir))
+      if (numeric(e->d_name)) tids.push_back(static_cast<pid_t>(std::strtol(e->d_name, nullptr, 10)));
+    ::closedir(dir);
+  }
+  std::sort(tids.begin(), tids.end());
+  /* keep the state of the known tasks */
+  std::vector<Task> tasks;
+  tasks.reserve(tids.size());
+  auto it = process.tasks.begin();
+  for (pid_t tid : tids) {
+    while (it != process.tasks.end() && it->tid < tid) close((it++)->fd);
+    if (it != process.tasks.end() && it->tid == tid) tasks.push_back(std::move(*it++));
+    else {
+      tasks.emplace_back();
+      tasks.back().tid = tid;
+    }
+  }
+  for (; it != process.tasks.end(); ++it) close(it->fd);
+  process.tasks.swap(tasks);
+}
+
+void xxx::ProcessActivity::account(pid_t pid, Task& task, const Stat& stat, double interval) {
+  uint64_t delta = (task.updates > 0 && stat.ticks >= task.ticks) ? stat.ticks - task.ticks : 0;
+  task.ticks = stat.ticks;
+  task.processor = stat.processor;
+  if (task.comm.compare(0, std::string::npos, stat.comm, stat.comm_size) != 0)
+    task.comm.assign(stat.comm, stat.comm_size);
+  ++task.updates;
+  ++tasks_;
+  if (delta == 0 || interval <= 0.) return;
+  if (task.processor >= top_.size()) top_.resize(task.processor + 1);
+  auto& top = top_[task.processor];
+  double load = static_cast<double>(delta) / clock_ticks_ / interval * 100.;
+  /* insert (the lists are short) */
+  if (top.size() == top_size_ && top.back().load >= load) return;
+  if (top.size() < top_size_) top.emplace_back();
+  size_t i = top.size() - 1;
+  for (; i > 0 && top[i - 1].load < load; --i) top[i] = std::move(top[i - 1]);
+  top[i].pid = pid;
+  top[i].tid = task.tid;
+  top[i].comm = task.comm;
+  top[i].processor = task.processor;
+  top[i].load = load;
+}
+
+void xxx::ProcessActivity::update() {
+  auto now = std::chrono::steady_clock::now();
+  double interval = (time_.time_since_epoch().count() != 0)
+      ? std::chrono::duration<double>(now - time_).count() : 0.;
+  time_ = now;
+  for (auto& top : top_) top.clear();
+  tasks_ = 0;
+  /* leave half of the free descriptors to the rest of the process,
+   * close the stat files above the budget */
+  budget_ = std::min(max_descriptors_, available() / 2);
+  if (descriptors_ > budget_) release();
+  for (auto& p : processes_) p.second.seen = false;
+  ::rewinddir(proc_);
+  while (struct dirent* e = ::readdir(proc_)) {
+    if (!numeric(e->d_name)) continue;
+    auto pid = static_cast<pid_t>(std::strtol(e->d_name, nullptr, 10));
+    Process& process = processes_[pid];
+    Stat stat;
+    std::snprintf(path_, sizeof(path_), "/proc/%d/stat", static_cast<int>(pid));
+    if (!read(process.fd, path_, process.updates > 0, stat)) continue;
+    process.seen = true;
+    ++process.updates;
+    if (stat.threads <= 1) {
+      /* the process is its only task */
+      if (process.tasks.size() != 1 || process.tasks[0].tid != pid) {
+        for (auto& t : process.tasks) close(t.fd);
+        process.tasks.clear();
+        process.tasks.emplace_back();
+        process.tasks[0].tid = pid;
+      }
+      process.threads = stat.threads;
+      account(pid, process.tasks[0], stat, interval);
+      continue;
+    }
+    if (stat.threads != process.threads) {
+      process.threads = stat.threads;
+      list(pid, process);
+    }
+    for (auto& task : process.tasks) {
+      std::snprintf(path_, sizeof(path_), "/proc/%d/task/%d/stat", static_cast<int>(pid), static_cast<int>(task.tid));
+      if (read(task.fd, path_, task.updates > 0, stat)) account(pid, task, stat, interval);
+      /* (a task exited, list them again on the next update) */
+      else process.threads = 0;
+    }
+  }
+  /* forget the processes that exited */
+  for (auto it = processes_.begin(); it != processes_.end();) {
+    if (it->second.seen) {
+      ++it;
+      continue;
+    }
+    close(it->second.fd);
+    for (auto& t : it->second.tasks) close(t.fd);
+    it = processes_.erase(it);
+  }
+}
+
+const std::vector<xxx::ProcessActivityTop>& xxx::ProcessActivity::top(unsigned long cpu) const {
+  static const std::vector<ProcessActivityTop> none;
+  return (cpu < top_.size()) ? top_[cpu] : none;
+}
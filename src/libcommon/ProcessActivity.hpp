@@ -0,0 +1,158 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/ProcessActivity.hpp
+ * @brief Attribute the cpu time to the tasks (threads) of each process.
+ */
+#ifndef libcommon_linux_sensors_ProcessActivity_hpp
+#define libcommon_linux_sensors_ProcessActivity_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/types.h>
+
+namespace xxx {
+
+  /** @brief A task that used cpu time during the last interval. */
+  struct ProcessActivityTop {
+    /** @brief The process id and the task (thread) id. */
+    pid_t pid;
+    pid_t tid;
+    /** @brief The name of the task (the comm field). */
+    std::string comm;
+    /** @brief The cpu the task last ran on (the processor field). */
+    unsigned long processor;
+    /** @brief The cpu time of the task during the last interval (% of one cpu). */
+    double load;
+  };
+
+  /** @brief Readout of /proc/[pid]/stat and /proc/[pid]/task/[tid]/stat.
+    *
+    * Each update() reads the directory of /proc to find the processes
+    * and then the stat file of each process, the tasks of a process are
+    * only listed again when its number of threads changed. The stat file
+    * of a single threaded process is also that of its only task.
+    *
+    * The stat files of the tasks that survive a second update() are kept
+    * open and read with a pread(), the state of
+    * every task is kept between the updates. So once the tasks are known
+    * the cost of an update depends on the number of new tasks, not on
+    * the total number of processes.
+    *
+    * The number of stat files kept open is limited by max_descriptors and
+    * by half of the descriptors that RLIMIT_NOFILE leaves to the process
+    * (recounted each update(), the sensors keep many sysfs attributes
+    * open as well). When an open() still fails with EMFILE all stat files
+    * are closed and the tasks are read with open(), read() and close()
+    * until the next update().
+    *
+    * The tasks are ranked by the cpu time they used since the previous
+    * update(), per cpu (the 'processor' field, the cpu the task last ran on). */
+  class ProcessActivity {
+    public:
+      /** @brief The ranked tasks of each logical cpu (indexed by its number). */
+      using Ranking = std::vector<std::vector<ProcessActivityTop>>;
+
+      /** @param top The number of tasks ranked for each cpu.
+        * @param max_descriptors The maximum number of stat files kept open
+        *                        (also limited by RLIMIT_NOFILE). */
+      explicit ProcessActivity(size_t top = 3, size_t max_descriptors = 512);
+      ~ProcessActivity();
+
+      ProcessActivity(const ProcessActivity&) = delete;
+      ProcessActivity& operator=(const ProcessActivity&) = delete;
+
+      /** @brief Read the stat files of all tasks and rank them.
+        * (The first call only reads the cpu time of the tasks.) */
+      void update();
+
+      /** @brief The tasks that used the most cpu time during the last interval
+        * and last ran on a logical cpu, highest first (at most 'top' entries). */
+      const std::vector<ProcessActivityTop>& top(unsigned long cpu) const;
+      /** @brief The ranked tasks of all cpus (see top()). */
+      inline const Ranking& ranking() const { return top_; }
+
+      /** @brief The number of known tasks. */
+      inline size_t tasks() const { return tasks_; }
+      /** @brief The number of stat files that are kept open. */
+      inline size_t descriptors() const { return descriptors_; }
+
+    private:
+      struct Task {
+        pid_t tid;
+        int fd { -1 };
+        uint64_t ticks { 0 };      /* utime + stime */
+        unsigned long processor { 0 };
+        std::string comm;
+        unsigned updates { 0 };    /* the number of updates it was seen in */
+      };
+      struct Process {
+        int fd { -1 };
+        long threads { 0 };
+        unsigned updates { 0 };
+        bool seen { false };
+        std::vector<Task> tasks;   /* sorted by tid */
+      };
+      /* The fields of a stat file */
+      struct Stat {
+        const char* comm;
+        size_t comm_size;
+        uint64_t ticks;
+        long threads;
+        unsigned long processor;
+      };
+      size_t top_size_;
+      size_t max_descriptors_;
+      /* The number of stat files that may be kept open during this update() */
+      size_t budget_ { 0 };
+      size_t descriptors_ { 0 };
+      size_t tasks_ { 0 };
+      DIR* proc_;
+      double clock_ticks_;
+      std::chrono::steady_clock::time_point time_;
+      std::unordered_map<pid_t, Process> processes_;
+      /* Indexed by logical cpu number */
+      Ranking top_;
+      /* (for the stat files and the path names) */
+      char buffer_[1024];
+      char path_[64];
+      /** @brief Read a stat file (with fd or by path if fd < 0, then keep it open if keep is true). */
+      bool read(int& fd, const char* path, bool keep, Stat& stat);
+      /** @brief List the tasks of a process. */
+      void list(pid_t pid, Process& process);
+      /** @brief Update a task and rank it. */
+      void account(pid_t pid, Task& task, const Stat& stat, double interval);
+      void close(int& fd);
+      /** @brief Close all stat files (when the process ran out of descriptors). */
+      void release();
+      /** @brief The number of descriptors the rest of the process leaves for the stat files. */
+      size_t available() const;
+      /** @brief Parse the fields of a stat file. */
+      static bool Parse(const char* s, size_t size, Stat& stat);
+  };
+
+} // ends namespace xxx
+
+#endif
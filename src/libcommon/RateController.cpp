@@ -0,0 +1,87 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/RateController.cpp
+ * @brief Adapt the sampling interval of the sensors to their rate of change (implementation).
+ */
+#include <algorithm>
+#include <cmath>
+
+#include "RateController.hpp"
+
+namespace {
+
+  /* The largest change of a value since the reference sample
+   * (there is no change if the number of values changed). */
+  template<typename T, typename F>
+  double largest_change(const std::vector<T>& values, const std::vector<double>& reference, F value) {
+    if (values.size() != reference.size()) return 0.;
+    double change = 0.;
+    for (size_t i = 0; i < values.size(); ++i)
+      change = std::max(change, std::fabs(value(values[i]) - reference[i]));
+    return change;
+  }
+
+  /* Make the values the reference sample. */
+  template<typename T, typename F>
+  void assign(const std::vector<T>& values, std::vector<double>& reference, F value) {
+    reference.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) reference[i] = value(values[i]);
+  }
+
+} // ends anonymous namespace
+
+xxx::RateController::RateController(
+    std::chrono::milliseconds min_interval,
+    std::chrono::milliseconds max_interval,
+    const Thresholds& thresholds)
+  : min_(std::max(min_interval, std::chrono::milliseconds(1))),
+    max_(std::max(min_, max_interval)),
+    interval_(min_),
+    thresholds_(thresholds) {
+}
+
+std::chrono::milliseconds xxx::RateController::update(
+    std::chrono::steady_clock::time_point time,
+    const std::vector<CpuActivityEntry>& load,
+    const std::vector<int>& temperature,
+    const std::vector<double>& power) {
+  auto load_value = [](const CpuActivityEntry& e) { return static_cast<double>(e.total); };
+  auto temperature_value = [](int t) { return static_cast<double>(t); };
+  auto power_value = [](double p) { return p; };
+  bool first = (time_ == std::chrono::steady_clock::time_point());
+  double seconds = std::chrono::duration<double>(time - time_).count();
+  /* (a change within less than a second is a rate of at least that change per second) */
+  double ratio = std::max({
+      largest_change(load, load_, load_value) / thresholds_.load,
+      largest_change(temperature, temperature_, temperature_value) / thresholds_.temperature,
+      largest_change(power, power_, power_value) / thresholds_.power }) / std::max(1., seconds);
+  bool settled = (seconds >= 1.);
+  if (first || settled) {
+    time_ = time;
+    assign(load, load_, load_value);
+    assign(temperature, temperature_, temperature_value);
+    assign(power, power_, power_value);
+  }
+  if (first || min_ == max_) return interval_;
+  if (ratio >= 1.) interval_ = min_;
+  else if (settled && ratio < .5) interval_ = std::min(interval_ * 2, max_);
+  return interval_;
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/RateController.hpp
+ * @brief Adapt the sampling interval of the sensors to their rate of change.
+ */
+#ifndef libcommon_RateController_hpp
+#define libcommon_RateController_hpp
+
+#include <chrono>
+#include <vector>
+
+#include "CpuActivity.hpp"
+
+namespace xxx {
+
+  /** @brief The rates of change that require the minimum interval of a RateController. */
+  struct RateThresholds {
+    double load { 20. };        /* % per second */
+    double temperature { 3. };  /* °C per second */
+    double power { 5. };        /* W per second */
+  };
+
+  /** @brief Chooses the interval until the next sample of the sensors.
+    *
+    * When the load, temperature or power of any cpu (or zone) changes
+    * faster than its threshold the interval drops to the minimum interval,
+    * when all of them change at less than half their threshold the interval
+    * is doubled (up to the maximum interval). Otherwise it is left alone.
+    *
+    * The rate is the change since a reference sample that is at least one
+    * second old divided by the time since that sample, so that the noise
+    * of a short interval (ie. the jiffy resolution of the load) is not
+    * mistaken for a spike. Before the reference is one second old, the
+    * interval only drops if the change is already above the threshold
+    * (of one second), and it is not increased.
+    * With equal minimum and maximum intervals the interval is fixed. */
+  class RateController {
+    public:
+      using Thresholds = RateThresholds;
+
+      /** @param min_interval The shortest interval.
+        * @param max_interval The longest interval (at least min_interval). */
+      explicit RateController(
+          std::chrono::milliseconds min_interval = std::chrono::milliseconds(500),
+          std::chrono::milliseconds max_interval = std::chrono::milliseconds(500),
+          const Thresholds& thresholds = Thresholds());
+
+      /** @brief Calculate the next interval from the values of a new sample.
+        * @returns The time until the next sample. */
+      std::chrono::milliseconds update(
+          std::chrono::steady_clock::time_point time,
+          const std::vector<CpuActivityEntry>& load,
+          const std::vector<int>& temperature,
+          const std::vector<double>& power);
+
+      /** @brief The current interval. */
+      inline std::chrono::milliseconds interval() const { return interval_; }
+      inline std::chrono::milliseconds min() const { return min_; }
+      inline std::chrono::milliseconds max() const { return max_; }
+      inline const Thresholds& thresholds() const { return thresholds_; }
+
+    private:
+      std::chrono::milliseconds min_;
+      std::chrono::milliseconds max_;
+      std::chrono::milliseconds interval_;
+      Thresholds thresholds_;
+      /* The reference sample */
+      std::chrono::steady_clock::time_point time_;
+      std::vector<double> load_;
+      std::vector<double> temperature_;
+      std::vector<double> power_;
+  };
+
+} // ends namespace xxx
+
+#endif
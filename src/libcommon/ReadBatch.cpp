@@ -0,0 +1,258 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/libcommon/ReadBatch.cpp
+ * @brief Read a batch of sysfs/procfs attributes using io_uring (or pread) (implementation).
+ */
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "ReadBatch.hpp"
+
+namespace xxx {
+
+  /*
+   * ReadBatch::Ring, a minimal io_uring (without liburing).
+   */
+
+  struct ReadBatch::Ring {
+    static constexpr unsigned Entries = 128;
+
+    int fd { -1 };
+    io_uring_params params {};
+    void* sq_ptr { MAP_FAILED };
+    size_t sq_size { 0 };
+    void* cq_ptr { MAP_FAILED };
+    size_t cq_size { 0 };
+    io_uring_sqe* sqes { static_cast<io_uring_sqe*>(MAP_FAILED) };
+    size_t sqes_size { 0 };
+
+    unsigned* sq_head; unsigned* sq_tail; unsigned* sq_mask; unsigned* sq_array;
+    unsigned* cq_head; unsigned* cq_tail; unsigned* cq_mask; io_uring_cqe* cqes;
+
+    /* The buffer registered with the kernel (for IORING_OP_READ_FIXED). */
+    const char* registered { nullptr };
+    size_t registered_size { 0 };
+
+    Ring();
+    ~Ring();
+    bool good() const { return fd >= 0; }
+    bool register_buffer(std::vector<char>& buffer);
+    void unregister_buffer();
+    int enter(unsigned to_submit, unsigned min_complete);
+  };
+
+  ReadBatch::Ring::Ring() {
+    fd = static_cast<int>(syscall(__NR_io_uring_setup, Entries, &params));
+    if (fd < 0) return;
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      if (cq_size > sq_size) sq_size = cq_size;
+      cq_size = sq_size;
+    }
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) { close(fd); fd = -1; return; }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      cq_ptr = sq_ptr;
+    }
+    else {
+      cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (cq_ptr == MAP_FAILED) { close(fd); fd = -1; return; }
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) { close(fd); fd = -1; return; }
+    auto* sq = static_cast<char*>(sq_ptr);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<char*>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  ReadBatch::Ring::~Ring() {
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+    if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+    if (fd >= 0) close(fd);
+  }
+
+  bool ReadBatch::Ring::register_buffer(std::vector<char>& buffer) {
+    if (registered == buffer.data() && registered_size == buffer.size())
+      return true;
+    unregister_buffer();
+    iovec iov { buffer.data(), buffer.size() };
+    /* This fails if the buffer exceeds RLIMIT_MEMLOCK,
+     * unregistered buffers (IORING_OP_READ) are used instead. */
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0)
+      return false;
+    registered = buffer.data();
+    registered_size = buffer.size();
+    return true;
+  }
+
+  void ReadBatch::Ring::unregister_buffer() {
+    if (registered) {
+      syscall(__NR_io_uring_register, fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+      registered = nullptr;
+      registered_size = 0;
+    }
+  }
+
+  int ReadBatch::Ring::enter(unsigned to_submit, unsigned min_complete) {
+    int rv;
+    do {
+      rv = static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+          min_complete, IORING_ENTER_GETEVENTS, nullptr, 0));
+    } while (rv < 0 && errno == EINTR);
+    return rv;
+  }
+
+  /*
+   * ReadBatch
+   */
+
+  ReadBatch::ReadBatch(bool use_io_uring) {
+    if (use_io_uring) {
+      ring_ = std::make_unique<Ring>();
+      if (!ring_->good()) ring_.reset();
+    }
+  }
+
+  ReadBatch::~ReadBatch() = default;
+
+  bool ReadBatch::uring() const {
+    return static_cast<bool>(ring_);
+  }
+
+  size_t ReadBatch::add(SysfsAttribute& attr, size_t size) {
+    requests_.push_back({ &attr, buffer_.size(), size, -ENODATA });
+    buffer_.resize(buffer_.size() + size);
+    return requests_.size() - 1;
+  }
+
+  void ReadBatch::clear() {
+    if (ring_) ring_->unregister_buffer();
+    requests_.clear();
+    buffer_.clear();
+  }
+
+  std::string_view ReadBatch::data(size_t slot) const {
+    const auto& request = requests_[slot];
+    if (request.result <= 0) return std::string_view();
+    return std::string_view(&buffer_[request.offset],
+        static_cast<size_t>(request.result));
+  }
+
+  void ReadBatch::submit_pread(Request& request) {
+    ssize_t rv = request.attr->read(&buffer_[request.offset], request.size);
+    request.result = (rv < 0) ? -errno : rv;
+  }
+
+  void ReadBatch::submit() {
+    if (!ring_) {
+      for (auto& request : requests_) submit_pread(request);
+      return;
+    }
+
+    Ring& ring = *ring_;
+    const bool fixed = ring.register_buffer(buffer_);
+    const unsigned entries = ring.params.sq_entries;
+    bool unsupported = false;
+    size_t next = 0;
+
+    while (next < requests_.size()) {
+      /* Queue (up to) a ring full of reads. */
+      unsigned tail = *ring.sq_tail;
+      unsigned queued = 0;
+      for (; next < requests_.size() && queued < entries; ++next) {
+        auto& request = requests_[next];
+        if (!request.attr->good()) {
+          /* Not open, let read() reopen it (if its device was removed). */
+          submit_pread(request);
+          continue;
+        }
+        unsigned index = tail & *ring.sq_mask;
+        io_uring_sqe& sqe = ring.sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe.fd = request.attr->fd();
+        sqe.off = 0;
+        sqe.addr = reinterpret_cast<uint64_t>(&buffer_[request.offset]);
+        sqe.len = static_cast<uint32_t>(request.size);
+        sqe.buf_index = 0;
+        sqe.user_data = next;
+        ring.sq_array[index] = index;
+        ++tail;
+        ++queued;
+      }
+      if (queued == 0) continue;
+      __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+      /* Submit them and wait for all of them to complete. */
+      if (ring.enter(queued, queued) < 0) {
+        /* The ring is unusable, fall back to pread() for good. */
+        ring_.reset();
+        for (auto& request : requests_) submit_pread(request);
+        return;
+      }
+
+      /* Collect the results. */
+      unsigned head = *ring.cq_head;
+      unsigned ctail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != ctail; ++head) {
+        const io_uring_cqe& cqe = ring.cqes[head & *ring.cq_mask];
+        auto& request = requests_[cqe.user_data];
+        request.result = cqe.res;
+      }
+      __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    /* Retry failed reads using pread(), this reopens attributes of
+     * hot-unplugged devices and handles kernels without IORING_OP_READ. */
+    for (auto& request : requests_) {
+      if (request.result < 0) {
+        ssize_t uring_result = request.result;
+        submit_pread(request);
+        if (request.result >= 0 &&
+            (uring_result == -EINVAL || uring_result == -EOPNOTSUPP))
+          unsupported = true;
+      }
+    }
+
+    /* This kernel does not support (fixed) reads using io_uring. */
+    if (unsupported) ring_.reset();
+  }
+
+} // ends namespace xxx
@@ -0,0 +1,96 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/ReadBatch.hpp
+ * @brief Read a batch of sysfs/procfs attributes using io_uring (or pread).
+ */
+#ifndef libcommon_ReadBatch_hpp
+#define libcommon_ReadBatch_hpp
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief Read a batch of sysfs/procfs attributes in a single sampling round.
+    *
+    * Sensors add() the attributes they need once, each attribute is assigned
+    * a slot in a single (preregistered) buffer. Calling submit() then reads
+    * all attributes, when available as a single io_uring submission, after
+    * which the sensors decode the data() of their slots.
+    *
+    * If io_uring is unavailable (old kernel, disabled by seccomp or sysctl)
+    * the attributes are read one at a time using pread().
+    * @note The SysfsAttribute instances passed to add() must not be moved
+    * or destroyed while they are part of the batch. */
+  class ReadBatch {
+    public:
+      /** @param use_io_uring Try to use io_uring, use pread() if false. */
+      explicit ReadBatch(bool use_io_uring = true);
+      ~ReadBatch();
+
+      ReadBatch(const ReadBatch&) = delete;
+      ReadBatch& operator=(const ReadBatch&) = delete;
+
+      /** @brief Add an attribute to the batch.
+        * @param attr The attribute to read.
+        * @param size The maximum number of bytes to read.
+        * @returns The slot number of the attribute. */
+      size_t add(SysfsAttribute& attr, size_t size = 32);
+
+      /** @brief Remove all attributes from the batch. */
+      void clear();
+
+      /** @brief Read all attributes in the batch. */
+      void submit();
+
+      /** @brief The data read for a slot by the last submit() (empty on error). */
+      std::string_view data(size_t slot) const;
+
+      /** @brief The number of slots in the batch. */
+      inline size_t size() const { return requests_.size(); }
+
+      /** @brief Is io_uring used to read the batch? */
+      bool uring() const;
+
+    private:
+      struct Request {
+        SysfsAttribute* attr;
+        size_t offset;   /* offset into buffer_ */
+        size_t size;     /* size of the slot in buffer_ */
+        ssize_t result;  /* bytes read or -errno */
+      };
+      struct Ring;
+
+      std::vector<Request> requests_;
+      std::vector<char> buffer_;
+      std::unique_ptr<Ring> ring_;
+
+      void submit_pread(Request& request);
+  };
+
+} // ends namespace xxx
+
+#endif
@@ -0,0 +1,428 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/RuleEngine.cpp
+ * @brief Evaluate threshold rules on the CpuSensors snapshots and dispatch actions (implementation).
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "RuleEngine.hpp"
+
+extern char** environ;
+
+namespace {
+
+  constexpr const char* PlatformProfile = "/sys/firmware/acpi/platform_profile";
+
+  /* Split a rule into words, a quoted string is a single word */
+  std::vector<std::string> split(const std::string& text) {
+    std::vector<std::string> words;
+    size_t i = 0;
+    while (i < text.size()) {
+      if (std::isspace(static_cast<unsigned char>(text[i]))) {
+        ++i;
+        continue;
+      }
+      std::string word;
+      if (text[i] == '"') {
+        size_t end = text.find('"', i + 1);
+        if (end == std::string::npos) throw std::runtime_error("unterminated quote");
+        word = text.substr(i + 1, end - i - 1);
+        i = end + 1;
+      }
+      else {
+        while (i < text.size() && !std::isspace(static_cast<unsigned char>(text[i]))) word += text[i++];
+      }
+      words.push_back(std::move(word));
+    }
+    return words;
+  }
+
+  double number(const std::string& word) {
+    char* end = nullptr;
+    double value = std::strtod(word.c_str(), &end);
+    if (word.empty() || *end != '\0') throw std::runtime_error("'" + word + "' is not a number");
+    return value;
+  }
+
+  unsigned count(const std::string& word) {
+    char* end = nullptr;
+    unsigned long value = std::strtoul(word.c_str(), &end, 10);
+    if (word.empty() || *end != '\0' || value == 0 || value > 1000000)
+      throw std::runtime_error("'" + word + "' is not a valid count");
+    return static_cast<unsigned>(value);
+  }
+
+  /* The ThrottleStatus bits by name (the log bit follows each status bit) */
+  const struct {
+    const char* name;
+    xxx::ThrottleStatus::Bit bit;
+  } status_bits[] = {
+    { "thermal", xxx::ThrottleStatus::THERMAL },
+    { "prochot", xxx::ThrottleStatus::PROCHOT },
+    { "critical", xxx::ThrottleStatus::CRITICAL },
+    { "threshold1", xxx::ThrottleStatus::THRESHOLD_1 },
+    { "threshold2", xxx::ThrottleStatus::THRESHOLD_2 },
+    { "power_limit", xxx::ThrottleStatus::POWER_LIMIT },
+    { "current_limit", xxx::ThrottleStatus::CURRENT_LIMIT },
+    { "cross_domain", xxx::ThrottleStatus::CROSS_DOMAIN }
+  };
+
+} // ends namespace
+
+xxx::RuleEngine::RuleEngine(const std::string& path)
+  : logger_([](const char* message) { std::fprintf(stderr, "%s\n", message); }) {
+  std::ifstream ifs(path);
+  if (!ifs.good()) throw std::runtime_error("Could not read '" + path + "'.");
+  compile(ifs, path);
+}
+
+xxx::RuleEngine::RuleEngine(std::istream& is, const std::string& name)
+  : logger_([](const char* message) { std::fprintf(stderr, "%s\n", message); }) {
+  compile(is, name);
+}
+
+xxx::RuleEngine::~RuleEngine() {
+  if (profile_fd_ >= 0) ::close(profile_fd_);
+}
+
+void xxx::RuleEngine::compile(std::istream& is, const std::string& name) {
+  std::string text;
+  unsigned line = 0;
+  while (std::getline(is, text)) {
+    ++line;
+    /* strip the comment and the surrounding white space */
+    bool quoted = false;
+    for (size_t i = 0; i < text.size(); ++i) {
+      if (text[i] == '"') quoted = !quoted;
+      else if (text[i] == '#' && !quoted) {
+        text.erase(i);
+        break;
+      }
+    }
+    text.erase(0, text.find_first_not_of(" \t\r"));
+    text.erase(text.find_last_not_of(" \t\r") + 1);
+    if (text.empty()) continue;
+    try {
+      rules_.push_back(Compile(text));
+      rules_.back().line = line;
+    }
+    catch (const std::runtime_error& e) {
+      throw std::runtime_error(name + ":" + std::to_string(line) + ": " + e.what());
+    }
+  }
+  /* (the rules do not move anymore, so argv can point into the arguments) */
+  bool have_status = false, have_profile = false;
+  for (auto& rule : rules_) {
+    have_status |= (rule.source == Rule::Source::Status);
+    have_profile |= (rule.action == Rule::Action::Profile);
+    if (rule.action != Rule::Action::Run) continue;
+    for (auto& argument : rule.arguments) rule.argv_.push_back(&argument[0]);
+    rule.argv_.push_back(nullptr);
+  }
+  if (have_status) status_ = std::make_unique<ThrottleStatus>();
+  if (have_profile) {
+    std::ifstream ifs(std::string(PlatformProfile) + "_choices");
+    std::string choices;
+    if (ifs.good()) std::getline(ifs, choices);
+    auto available = split(choices);
+    for (const auto& rule : rules_) {
+      if (rule.action != Rule::Action::Profile) continue;
+      for (const auto& profile : rule.arguments) {
+        if (std::find(available.begin(), available.end(), profile) == available.end())
+          throw std::runtime_error(name + ":" + std::to_string(rule.line) + ": the platform profile '"
+              + profile + "' is not available (" + (choices.empty() ? "none" : choices) + ")");
+      }
+    }
+    profile_fd_ = ::open(PlatformProfile, O_WRONLY | O_CLOEXEC);
+    if (profile_fd_ < 0)
+      throw std::runtime_error(std::string("Could not open '") + PlatformProfile + "': " + std::strerror(errno));
+  }
+}
+
+xxx::Rule xxx::RuleEngine::Compile(const std::string& text) {
+  using Type = CpuSensors::Channel::Type;
+  Rule rule {};
+  rule.text = text;
+  auto words = split(text);
+  auto arrow = std::find(words.begin(), words.end(), "=>");
+  if (arrow == words.end()) throw std::runtime_error("'=>' expected");
+  std::vector<std::string> condition(words.begin(), arrow);
+  std::vector<std::string> action(arrow + 1, words.end());
+  /* the condition */
+  size_t i = 0;
+  auto next = [&condition, &i](const char* what) -> const std::string& {
+    if (i >= condition.size()) throw std::runtime_error(std::string(what) + " expected");
+    return condition[i++];
+  };
+  const std::string& source = next("a channel type or 'status'");
+  if (source == "status") {
+    rule.source = Rule::Source::Status;
+    rule.selector = next("'cpuN', 'packageN' or '*'");
+    unsigned long id;
+    char c;
+    if (rule.selector == "*") rule.status_scope_ = 0;
+    else if (std::sscanf(rule.selector.c_str(), "cpu%lu%c", &id, &c) == 1) rule.status_scope_ = 1;
+    else if (std::sscanf(rule.selector.c_str(), "package%lu%c", &id, &c) == 1) rule.status_scope_ = 2;
+    else throw std::runtime_error("'" + rule.selector + "' is not 'cpuN', 'packageN' or '*'");
+    rule.status_id_ = (rule.status_scope_) ? id : 0;
+    std::string bit = next("a status bit");
+    bool log = bit.size() > 4 && bit.compare(bit.size() - 4, 4, "_log") == 0;
+    if (log) bit.erase(bit.size() - 4);
+    auto it = std::find_if(std::begin(status_bits), std::end(status_bits),
+        [&bit](const auto& b) { return bit == b.name; });
+    if (it == std::end(status_bits)) throw std::runtime_error("unknown status bit '" + bit + "'");
+    rule.bit = it->bit + (log ? 1 : 0);
+  }
+  else {
+    rule.source = Rule::Source::Channel;
+    bool found = false;
+    for (int t = 0; !found && t <= static_cast<int>(Type::Timeslices); ++t) {
+      rule.type = static_cast<Type>(t);
+      found = (source == CpuSensors::Name(rule.type));
+    }
+    if (!found) throw std::runtime_error("unknown channel type '" + source + "'");
+    rule.selector = next("a channel name or '*'");
+    if (i < condition.size() && condition[i] == "mean") {
+      ++i;
+      rule.window = Rule::Window::Mean;
+      rule.samples = count(next("a number of samples"));
+    }
+    const std::string& op = next("'>', '>=', '<' or '<='");
+    if (op == ">") rule.op = Rule::Op::Greater;
+    else if (op == ">=") rule.op = Rule::Op::GreaterEqual;
+    else if (op == "<") rule.op = Rule::Op::Less;
+    else if (op == "<=") rule.op = Rule::Op::LessEqual;
+    else throw std::runtime_error("'" + op + "' is not '>', '>=', '<' or '<='");
+    const std::string& value = next("a value");
+    if (value == "pl1" || value == "pl2" || value == "pl4") {
+      if (rule.type != Type::Power || rule.selector == "*")
+        throw std::runtime_error("'" + value + "' requires a power zone");
+      rule.limit = (value == "pl1") ? Rule::Limit::PL1
+          : ((value == "pl2") ? Rule::Limit::PL2 : Rule::Limit::PL4);
+    }
+    else rule.threshold = number(value);
+  }
+  /* the window */
+  if (i < condition.size()) {
+    if (condition[i++] != "for") throw std::runtime_error("'for' or '=>' expected");
+    if (rule.window == Rule::Window::Mean) throw std::runtime_error("'mean' cannot be combined with 'for'");
+    unsigned n = count(next("a number"));
+    const std::string& unit = next("'samples', 's' or 'ms'");
+    if (unit == "samples" || unit == "sample") {
+      rule.window = Rule::Window::Samples;
+      rule.samples = n;
+    }
+    else if (unit == "s" || unit == "ms") {
+      rule.window = Rule::Window::Duration;
+      rule.duration = std::chrono::milliseconds((unit == "s") ? n * 1000ull : n);
+    }
+    else throw std::runtime_error("'" + unit + "' is not 'samples', 's' or 'ms'");
+    if (i < condition.size()) throw std::runtime_error("'=>' expected after '" + unit + "'");
+  }
+  if (rule.window == Rule::Window::Mean) rule.ring_.resize(rule.samples);
+  /* the action */
+  if (action.empty()) throw std::runtime_error("'log', 'run' or 'profile' expected");
+  if (action[0] == "log") {
+    rule.action = Rule::Action::Log;
+    std::string message;
+    for (size_t n = 1; n < action.size(); ++n) message += ((n > 1) ? " " : "") + action[n];
+    rule.arguments.push_back(message.empty() ? text : message);
+  }
+  else if (action[0] == "run") {
+    rule.action = Rule::Action::Run;
+    if (action.size() < 2) throw std::runtime_error("a command expected");
+    rule.arguments.assign(action.begin() + 1, action.end());
+  }
+  else if (action[0] == "profile") {
+    rule.action = Rule::Action::Profile;
+    if (action.size() < 2 || action.size() > 3) throw std::runtime_error("one or two profile names expected");
+    rule.arguments.assign(action.begin() + 1, action.end());
+  }
+  else throw std::runtime_error("'" + action[0] + "' is not 'log', 'run' or 'profile'");
+  return rule;
+}
+
+void xxx::RuleEngine::bind(const std::vector<CpuSensors::Channel>& channels, const PowerCap::IntelRAPL& power) {
+  for (auto& rule : rules_) {
+    if (rule.source != Rule::Source::Channel) continue;
+    rule.channels_.clear();
+    for (const auto& channel : channels) {
+      if (channel.type == rule.type && (rule.selector == "*" || channel.name == rule.selector))
+        rule.channels_.push_back(channel);
+    }
+    if (rule.channels_.empty()) {
+      std::snprintf(message_, sizeof(message_), "rule at line %u: no %s channel '%s'",
+          rule.line, CpuSensors::Name(rule.type), rule.selector.c_str());
+      logger_(message_);
+    }
+    if (rule.limit == Rule::Limit::None) continue;
+    /* the power limit of the zone (the channel names are 'zone' and 'zone/sub-zone') */
+    /* (the constraints are long term, short term and peak power,
+     * those of the control type of the zone) */
+    unsigned constraint = (rule.limit == Rule::Limit::PL1) ? 0 : ((rule.limit == Rule::Limit::PL2) ? 1 : 2);
+    rule.bound_threshold_ = 0.;
+    for (const auto& zone : power) {
+      if (zone.name() == rule.selector)
+        rule.bound_threshold_ = zone.power_limit(zone.find(zone.control_type(), constraint));
+      for (const auto& sub_zone : zone)
+        if (zone.name() + "/" + sub_zone.name() == rule.selector)
+          rule.bound_threshold_ = sub_zone.power_limit(sub_zone.find(zone.control_type(), constraint));
+    }
+    if (rule.bound_threshold_ <= 0.) {
+      std::snprintf(message_, sizeof(message_), "rule at line %u: '%s' has no power limit %u",
+          rule.line, rule.selector.c_str(), (constraint == 2) ? 4u : constraint + 1);
+      logger_(message_);
+    }
+  }
+}
+
+bool xxx::RuleEngine::test(Rule& rule, const CpuSensors::Snapshot& snapshot) {
+  if (rule.source == Rule::Source::Status) {
+    bool set = false;
+    for (int package = 0; package < 2; ++package) {
+      if (rule.status_scope_ == (package ? 1u : 2u)) continue;
+      for (const auto& e : package ? status_->packages() : status_->cpus()) {
+        if (rule.status_scope_ != 0 && e.id != rule.status_id_) continue;
+        set |= e.valid && ((e.value >> rule.bit) & 1);
+      }
+    }
+    rule.value_ = set ? 1. : 0.;
+    return set;
+  }
+  if (rule.channels_.empty()) return false;
+  /* the highest value of the channels for '>', the lowest for '<' */
+  bool greater = (rule.op == Rule::Op::Greater || rule.op == Rule::Op::GreaterEqual);
+  double value = CpuSensors::value(snapshot, rule.channels_[0]);
+  for (size_t i = 1; i < rule.channels_.size(); ++i) {
+    double v = CpuSensors::value(snapshot, rule.channels_[i]);
+    value = greater ? std::max(value, v) : std::min(value, v);
+  }
+  if (rule.window == Rule::Window::Mean) {
+    /* a running sum over a ring buffer (recalculated on each wrap so it does not drift) */
+    if (rule.ring_size_ < rule.ring_.size()) ++rule.ring_size_;
+    else rule.ring_sum_ -= rule.ring_[rule.ring_pos_];
+    rule.ring_[rule.ring_pos_] = value;
+    rule.ring_sum_ += value;
+    if (++rule.ring_pos_ == rule.ring_.size()) {
+      rule.ring_pos_ = 0;
+      rule.ring_sum_ = 0.;
+      for (double v : rule.ring_) rule.ring_sum_ += v;
+    }
+    value = rule.ring_sum_ / static_cast<double>(rule.ring_size_);
+  }
+  rule.value_ = value;
+  if (rule.window == Rule::Window::Mean && rule.ring_size_ < rule.ring_.size()) return false;
+  double threshold = rule.threshold;
+  if (rule.limit != Rule::Limit::None) {
+    if (rule.bound_threshold_ <= 0.) return false;
+    threshold = rule.bound_threshold_;
+  }
+  switch (rule.op) {
+    case Rule::Op::Greater: return value > threshold;
+    case Rule::Op::GreaterEqual: return value >= threshold;
+    case Rule::Op::Less: return value < threshold;
+    case Rule::Op::LessEqual: return value <= threshold;
+  }
+  return false;
+}
+
+void xxx::RuleEngine::hotplug() {
+  if (status_) status_->hotplug();
+}
+
+void xxx::RuleEngine::evaluate(const CpuSensors::Snapshot& snapshot) {
+  if (status_) status_->update();
+  for (auto& rule : rules_) {
+    /* reap the command of the rule when it has finished */
+    if (rule.pid_ > 0 && ::waitpid(rule.pid_, nullptr, WNOHANG) != 0) rule.pid_ = -1;
+    bool held = test(rule, snapshot);
+    switch (rule.window) {
+      case Rule::Window::None:
+      case Rule::Window::Mean:
+        break;
+      case Rule::Window::Samples:
+        rule.count_ = held ? std::min(rule.count_ + 1, rule.samples) : 0;
+        held = (rule.count_ >= rule.samples);
+        break;
+      case Rule::Window::Duration:
+        if (!held) rule.count_ = 0;
+        else {
+          if (rule.count_ == 0) rule.since_ = snapshot.time;
+          rule.count_ = 1;
+          held = (snapshot.time - rule.since_ >= rule.duration);
+        }
+        break;
+    }
+    if (held != rule.active_) trigger(rule, held);
+  }
+}
+
+void xxx::RuleEngine::trigger(Rule& rule, bool active) {
+  rule.active_ = active;
+  switch (rule.action) {
+    case Rule::Action::Log:
+      std::snprintf(message_, sizeof(message_), "rule at line %u %s: %s (%.2f)",
+          rule.line, active ? "triggered" : "cleared", rule.arguments[0].c_str(), rule.value_);
+      logger_(message_);
+      break;
+    case Rule::Action::Run: {
+      if (!active) break;
+      if (rule.pid_ > 0) {
+        std::snprintf(message_, sizeof(message_), "rule at line %u: '%s' is still running",
+            rule.line, rule.argv_[0]);
+        logger_(message_);
+        break;
+      }
+      int error = ::posix_spawnp(&rule.pid_, rule.argv_[0], nullptr, nullptr, rule.argv_.data(), environ);
+      if (error != 0) {
+        rule.pid_ = -1;
+        std::snprintf(message_, sizeof(message_), "rule at line %u: could not run '%s': %s",
+            rule.line, rule.argv_[0], std::strerror(error));
+        logger_(message_);
+      }
+      break;
+    }
+    case Rule::Action::Profile: {
+      /* the second profile (if any) is restored when the rule is cleared */
+      if (!active && rule.arguments.size() < 2) break;
+      const std::string& profile = rule.arguments[active ? 0 : 1];
+      bool ok = ::pwrite(profile_fd_, profile.data(), profile.size(), 0)
+          == static_cast<ssize_t>(profile.size());
+      std::snprintf(message_, sizeof(message_), "rule at line %u %s: %s platform profile '%s'%s%s",
+          rule.line, active ? "triggered" : "cleared", ok ? "switched to" : "could not switch to",
+          profile.c_str(), ok ? "" : ": ", ok ? "" : std::strerror(errno));
+      logger_(message_);
+      break;
+    }
+  }
+}
@@ -0,0 +1,198 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/RuleEngine.hpp
+ * @brief Evaluate threshold rules on the CpuSensors snapshots and dispatch actions.
+ */
+#ifndef libcommon_RuleEngine_hpp
+#define libcommon_RuleEngine_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "CpuSensors.hpp"
+#include "PowerCap.hpp"
+#include "ThrottleStatus.hpp"
+
+namespace xxx {
+
+  /** @brief A compiled rule of a RuleEngine. */
+  struct Rule {
+    friend class RuleEngine;
+    public:
+      /** @brief What the condition tests. */
+      enum class Source { Channel, Status };
+      enum class Op { Greater, GreaterEqual, Less, LessEqual };
+      /** @brief How long the condition must hold. */
+      enum class Window { None, Samples, Duration, Mean };
+      /** @brief What to do when the rule triggers. */
+      enum class Action { Log, Run, Profile };
+      /** @brief Power limits that can be used as the threshold of a power condition. */
+      enum class Limit { None, PL1, PL2, PL4 };
+
+      std::string text;      /* the rule as written in the rules file */
+      unsigned line;         /* line number in the rules file */
+      Source source;
+      /* Channel: the channel type, name ('*' == any) and threshold */
+      CpuSensors::Channel::Type type;
+      std::string selector;
+      Op op;
+      double threshold;
+      Limit limit;
+      /* Status: the ThrottleStatus bit (selector 'cpuN', 'packageN' or '*') */
+      unsigned bit;
+      /* The window: N consecutive samples, a duration, or the mean of N samples */
+      Window window;
+      unsigned samples;
+      std::chrono::milliseconds duration;
+      /* The action and its arguments (log message, command line or profile names) */
+      Action action;
+      std::vector<std::string> arguments;
+
+      /** @brief Is the rule triggered (its condition held for the whole window)? */
+      inline bool active() const { return active_; }
+      /** @brief The value of the last evaluation (the mean for a Mean window). */
+      inline double value() const { return value_; }
+
+    private:
+      /* The channels that match the selector (bound to a layout) */
+      std::vector<CpuSensors::Channel> channels_;
+      /* Status: 0 == any, 1 == a cpu, 2 == a package (and its id) */
+      unsigned status_scope_ { 0 };
+      unsigned long status_id_ { 0 };
+      /* The threshold of a Limit (resolved when bound) */
+      double bound_threshold_ { 0. };
+      /* Window state: consecutive samples, start of the duration,
+       * and the ring buffer (and its sum) of a mean */
+      unsigned count_ { 0 };
+      std::chrono::steady_clock::time_point since_;
+      std::vector<double> ring_;
+      size_t ring_pos_ { 0 };
+      size_t ring_size_ { 0 };
+      double ring_sum_ { 0. };
+      bool active_ { false };
+      double value_ { 0. };
+      /* Run: the argv of the command and the pid of the running command */
+      std::vector<char*> argv_;
+      pid_t pid_ { -1 };
+  };
+
+  /** @brief Evaluate rules on every CpuSensors snapshot.
+    *
+    * A rules file holds a rule on each line ('#' starts a comment):
+    *
+    *     CONDITION [WINDOW] => ACTION
+    *
+    * Where CONDITION is either
+    *
+    *     TYPE CHANNEL [mean N] OP VALUE
+    *     status SELECTOR BIT
+    *
+    * TYPE is a channel type (see CpuSensors::Name(), ie. 'temperature'),
+    * CHANNEL the name of a channel (quoted when it contains spaces) or '*'
+    * for any channel of the type, OP is one of '>', '>=', '<' or '<=' and
+    * VALUE a number or, for power channels, 'pl1', 'pl2' or 'pl4' (the power
+    * limits of the RAPL zone, its constraints 0, 1 and 2). 'mean N' compares the mean of the last N samples.
+    * A status condition tests a ThrottleStatus bit ('thermal', 'prochot',
+    * 'critical', 'threshold1', 'threshold2', 'power_limit', 'current_limit'
+    * or 'cross_domain', append '_log' for the sticky log bit) of 'cpuN',
+    * 'packageN' or '*' (requires root privileges and the msr module).
+    *
+    * WINDOW is 'for N samples' or 'for N s' (or 'ms'), the condition must
+    * hold for N consecutive samples or for the duration. ACTION is one of
+    *
+    *     log [MESSAGE]             log when triggered and when cleared
+    *     run COMMAND [ARGUMENT]... run a command when triggered
+    *     profile NAME [CLEARED]    write NAME to the ACPI platform_profile
+    *                               when triggered (and CLEARED when cleared)
+    *
+    * For example:
+    *
+    *     temperature "Package id 0" > 90 for 5 samples => log
+    *     status package0 prochot_log => log PROCHOT was asserted
+    *     power package-0 > pl1 for 10 s => profile low-power balanced
+    *     stalls cpu > 0 => log
+    *
+    * A 'stalls' channel counts the PressureStall trigger events, the
+    * sampler thread of CpuSensors takes a sample right after such an event
+    * so the rule is evaluated without waiting for the sampling interval.
+    *
+    * The rules are compiled once, the state of each rule is constant in
+    * size (a counter, a time or a preallocated ring buffer) and evaluating
+    * the rules and dispatching the actions does not allocate memory. */
+  class RuleEngine {
+    public:
+      /** @brief A function that writes a log message (without newline). */
+      using Logger = std::function<void(const char*)>;
+
+      /** @brief Compile the rules of a rules file.
+        * @throws std::runtime_error if the file cannot be read or a rule is invalid. */
+      explicit RuleEngine(const std::string& path);
+      /** @brief Compile the rules read from a stream.
+        * @param name The name of the stream in error messages.
+        * @throws std::runtime_error if a rule is invalid. */
+      RuleEngine(std::istream& is, const std::string& name);
+      ~RuleEngine();
+
+      RuleEngine(const RuleEngine&) = delete;
+      RuleEngine& operator=(const RuleEngine&) = delete;
+
+      /** @brief Set the function that writes the log messages (default stderr). */
+      inline void setLogger(Logger logger) { logger_ = std::move(logger); }
+
+      /** @brief Bind the rules to the channels of a layout and read the power limits.
+        * @note Call this function again when the layout of the snapshots changes. */
+      void bind(const std::vector<CpuSensors::Channel>& channels, const PowerCap::IntelRAPL& power);
+
+      /** @brief Rescan the thermal status MSRs after a cpu was hotplugged. */
+      void hotplug();
+
+      /** @brief Evaluate all rules on a snapshot and dispatch their actions. */
+      void evaluate(const CpuSensors::Snapshot& snapshot);
+
+      inline const std::vector<Rule>& rules() const { return rules_; }
+
+    private:
+      std::vector<Rule> rules_;
+      Logger logger_;
+      /* The thermal status MSRs (only when there is a status rule) */
+      std::unique_ptr<ThrottleStatus> status_;
+      /* The ACPI platform_profile (only when there is a profile action) */
+      int profile_fd_ { -1 };
+      /* Buffer for the log messages */
+      char message_[512];
+
+      void compile(std::istream& is, const std::string& name);
+      static Rule Compile(const std::string& text);
+      /* The current value of the condition of a rule */
+      bool test(Rule& rule, const CpuSensors::Snapshot& snapshot);
+      void trigger(Rule& rule, bool active);
+  };
+
+} // ends namespace xxx
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/SensorHistory.cpp
+ * @brief A memory bounded, multi-resolution history of the CpuSensors channels (implementation).
+ */
+
+#include <algorithm>
+#include "SensorHistory.hpp"
+
+/*
+ * TimeSeries
+ */
+
+constexpr std::array<uint32_t, xxx::TimeSeries::TIER_COUNT> xxx::TimeSeries::BucketSize;
+
+xxx::TimeSeries::TimeSeries(const Capacity& capacity) {
+  for (size_t t = 0; t < TIER_COUNT; ++t)
+    ring_[t].points.resize(std::max<size_t>(capacity[t], 1));
+}
+
+void xxx::TimeSeries::Ring::push(const Point& p) {
+  points[head] = p;
+  if (++head == points.size()) head = 0;
+  if (count < points.size()) ++count;
+}
+
+void xxx::TimeSeries::append(uint64_t time_ms, float value) {
+  ring_[Raw].push({ time_ms, value, value, value });
+  for (size_t t = Second; t < TIER_COUNT; ++t) {
+    Bucket& b = bucket_[t];
+    uint64_t time = time_ms / BucketSize[t];
+    if (b.count && b.time != time) {
+      ring_[t].push({ b.time, b.min, b.max, static_cast<float>(b.sum / b.count) });
+      b.count = 0;
+    }
+    if (b.count == 0) {
+      b.time = time;
+      b.min = b.max = value;
+      b.sum = 0;
+    }
+    else {
+      b.min = std::min(b.min, value);
+      b.max = std::max(b.max, value);
+    }
+    b.sum += value;
+    ++b.count;
+  }
+}
+
+void xxx::TimeSeries::clear() {
+  for (auto& r : ring_) r.head = r.count = 0;
+  for (auto& b : bucket_) b.count = 0;
+}
+
+const xxx::TimeSeries::Point& xxx::TimeSeries::at(Tier tier, size_t i) const {
+  const Ring& r = ring_[tier];
+  size_t n = r.points.size();
+  return r.points[(r.head + n - r.count + i) % n];
+}
+
+void xxx::TimeSeries::copy(Tier tier, size_t count, std::vector<Point>& v) const {
+  size_t n = size(tier);
+  count = std::min(count, n);
+  v.clear();
+  for (size_t i = n - count; i < n; ++i)
+    v.push_back(at(tier, i));
+}
+
+xxx::TimeSeries::Point xxx::TimeSeries::summary(Tier tier, size_t count) const {
+  size_t n = size(tier);
+  count = std::min(count, n);
+  if (count == 0) return { 0, 0, 0, 0 };
+  Point s = at(tier, n - count);
+  double sum = 0;
+  for (size_t i = n - count; i < n; ++i) {
+    const Point& p = at(tier, i);
+    s.min = std::min(s.min, p.min);
+    s.max = std::max(s.max, p.max);
+    sum += p.mean;
+  }
+  s.mean = static_cast<float>(sum / count);
+  return s;
+}
+
+xxx::TimeSeries::Point xxx::TimeSeries::summary(Tier tier, std::chrono::milliseconds since) const {
+  /* (the points are in time order, count those that start at or after 'since') */
+  auto time = static_cast<uint64_t>(std::max<decltype(since.count())>(since.count(), 0)) / BucketSize[tier];
+  size_t n = size(tier);
+  size_t count = 0;
+  while (count < n && at(tier, n - count - 1).time >= time) ++count;
+  return summary(tier, count);
+}
+
+/*
+ * SensorHistory
+ */
+
+constexpr xxx::TimeSeries::Capacity xxx::SensorHistory::DefaultCapacity;
+
+xxx::SensorHistory::SensorHistory(
+    std::vector<CpuSensors::Channel> channels,
+    const TimeSeries::Capacity& capacity)
+  : channels_(std::move(channels)),
+    series_(channels_.size(), TimeSeries(capacity)),
+    capacity_(capacity) {
+}
+
+void xxx::SensorHistory::relayout(
+    const std::shared_ptr<const std::vector<CpuSensors::Channel>>& layout) {
+  std::vector<TimeSeries> series;
+  series.reserve(layout->size());
+  for (const auto& c : *layout) {
+    size_t i = CpuSensors::find(channels_, c);
+    if (i < series_.size()) series.push_back(std::move(series_[i]));
+    else series.emplace_back(capacity_);
+  }
+  channels_ = *layout;
+  series_.swap(series);
+  layout_ = layout;
+}
+
+void xxx::SensorHistory::append(const CpuSensors::Snapshot& snapshot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!started_) {
+    epoch_ = snapshot.time;
+    started_ = true;
+  }
+  if (snapshot.layout && snapshot.layout != layout_) relayout(snapshot.layout);
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(snapshot.time - epoch_).count();
+  auto time_ms = static_cast<uint64_t>(std::max<decltype(ms)>(ms, 0));
+  for (size_t i = 0; i < channels_.size(); ++i)
+    series_[i].append(time_ms, static_cast<float>(CpuSensors::value(snapshot, channels_[i])));
+}
+
+void xxx::SensorHistory::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& s : series_) s.clear();
+  started_ = false;
+}
+
+std::vector<xxx::CpuSensors::Channel> xxx::SensorHistory::channels() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return channels_;
+}
+
+size_t xxx::SensorHistory::memory() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t points = 0;
+  for (size_t t = 0; t < TimeSeries::TIER_COUNT; ++t)
+    for (const auto& s : series_)
+      points += s.capacity(static_cast<Tier>(t));
+  return points * sizeof(Point);
+}
+
+void xxx::SensorHistory::copy(size_t channel, Tier tier, size_t count, std::vector<Point>& v) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (channel < series_.size()) series_[channel].copy(tier, count, v);
+  else v.clear();
+}
+
+xxx::SensorHistory::Point xxx::SensorHistory::summary(size_t channel, Tier tier, size_t count) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (channel < series_.size()) return series_[channel].summary(tier, count);
+  return { 0, 0, 0, 0 };
+}
+
+bool xxx::SensorHistory::summary(const Layout& layout, const Period* periods, size_t n, std::vector<Point>& v) const {
+  v.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!started_ || !layout || layout != layout_) return false;
+  v.reserve(series_.size() * n);
+  for (const auto& s : series_) {
+    for (size_t p = 0; p < n; ++p) {
+      auto since = std::chrono::duration_cast<std::chrono::milliseconds>(periods[p].since - epoch_);
+      v.push_back(s.summary(periods[p].tier, since));
+    }
+  }
+  return true;
+}
+
+std::chrono::steady_clock::time_point xxx::SensorHistory::epoch() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return epoch_;
+}
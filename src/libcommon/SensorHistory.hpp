@@ -0,0 +1,201 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/SensorHistory.hpp
+ * @brief A memory bounded, multi-resolution history of the CpuSensors channels.
+ */
+#ifndef libcommon_SensorHistory_hpp
+#define libcommon_SensorHistory_hpp
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CpuSensors.hpp"
+
+namespace xxx {
+
+  /** @brief The history of a single value stored in three fixed capacity ring buffers (tiers).
+    *
+    * The Raw tier stores every sample, the Second and Minute tiers store
+    * the minimum, maximum and mean of all samples within one second or
+    * one minute. The downsampled tiers are updated incrementally by
+    * append(), a bucket is written to its ring when the first sample of
+    * the next bucket arrives.
+    * The memory used is sizeof(Point) * (sum of the capacities),
+    * independent of the number of appended samples. */
+  class TimeSeries {
+    public:
+      enum Tier : size_t { Raw, Second, Minute, TIER_COUNT };
+
+      /** @brief A single entry of a tier.
+        *
+        * 'time' is the start of the bucket in units of the tier (milliseconds
+        * for the Raw tier) relative to the epoch of the history, 64 bits so
+        * that it does not wrap in a long running process (32 bits of
+        * milliseconds wrap after 49.7 days).
+        * For the Raw tier min, max and mean are the sample value. */
+      struct Point {
+        uint64_t time;
+        float min;
+        float max;
+        float mean;
+      };
+
+      /** @brief The capacity of each tier (in number of points). */
+      using Capacity = std::array<size_t, TIER_COUNT>;
+
+      explicit TimeSeries(const Capacity& capacity);
+
+      /** @brief Add a sample.
+        * @param time_ms Time of the sample in milliseconds relative to the epoch of the history,
+        *                must not be smaller than the time of the previous sample. */
+      void append(uint64_t time_ms, float value);
+
+      /** @brief Remove all points. */
+      void clear();
+
+      /** @brief The number of points in a tier. */
+      inline size_t size(Tier tier) const { return ring_[tier].count; }
+      /** @brief The maximum number of points in a tier. */
+      inline size_t capacity(Tier tier) const { return ring_[tier].points.size(); }
+
+      /** @brief Get a point from a tier, 0 is the oldest point. */
+      const Point& at(Tier tier, size_t i) const;
+
+      /** @brief Copy the last (at most) count points of a tier into v (oldest first). */
+      void copy(Tier tier, size_t count, std::vector<Point>& v) const;
+
+      /** @brief Get the minimum, maximum and mean of the last (at most) count points of a tier.
+        * @returns A point with the time of the oldest point used, or all zero if the tier is empty. */
+      Point summary(Tier tier, size_t count) const;
+
+      /** @brief Get the minimum, maximum and mean of the points of a tier that start at or after a time.
+        *
+        * A bucket only exists for the seconds (minutes) that had a sample,
+        * so with a sampling interval above one second the last 60 points of
+        * the Second tier cover more than a minute, but these do not.
+        * @param since Relative to the epoch of the history. */
+      Point summary(Tier tier, std::chrono::milliseconds since) const;
+
+      /** @brief The size of the Second and Minute buckets in milliseconds. */
+      static constexpr std::array<uint32_t, TIER_COUNT> BucketSize { 1, 1000, 60000 };
+
+    private:
+      struct Ring {
+        std::vector<Point> points;
+        size_t head { 0 };   /* position of the next point */
+        size_t count { 0 };
+        void push(const Point&);
+      };
+      struct Bucket {
+        uint64_t time { 0 };
+        float min { 0 };
+        float max { 0 };
+        double sum { 0 };
+        uint32_t count { 0 };
+      };
+      std::array<Ring, TIER_COUNT> ring_;
+      std::array<Bucket, TIER_COUNT> bucket_;
+  };
+
+  /** @brief The history of every channel of a CpuSensors instance.
+    *
+    * Feed it from the sampler thread using CpuSensors::listen(), and read
+    * it from any other thread. All member functions are thread safe.
+    *
+    * When a snapshot has a new layout (cpus were hotplugged) the channels
+    * are matched by type and name: channels that remain keep their history. */
+  class SensorHistory {
+    public:
+      using Tier = TimeSeries::Tier;
+      using Point = TimeSeries::Point;
+      using Layout = std::shared_ptr<const std::vector<CpuSensors::Channel>>;
+
+      /** @brief The points of a tier that start at or after a time (see summary()). */
+      struct Period {
+        Tier tier;
+        std::chrono::steady_clock::time_point since;
+      };
+
+      /** @brief The default capacity: 60 samples (raw), 2 minutes of seconds and 1 hour of minutes.
+        *
+        * That is 5.6 KiB per channel, with about 15 channels per cpu a host
+        * with 256 cpus uses about 21 MiB. */
+      static constexpr TimeSeries::Capacity DefaultCapacity { 60, 120, 60 };
+
+      /** @param channels The channels to record (ie. CpuSensors::channels()).
+        * @param capacity The capacity of each tier. */
+      explicit SensorHistory(
+          std::vector<CpuSensors::Channel> channels,
+          const TimeSeries::Capacity& capacity = DefaultCapacity);
+
+      SensorHistory(const SensorHistory&) = delete;
+      SensorHistory& operator=(const SensorHistory&) = delete;
+
+      /** @brief Add the values of all channels from a snapshot. */
+      void append(const CpuSensors::Snapshot& snapshot);
+
+      /** @brief Remove all points and restart the epoch. */
+      void clear();
+
+      /** @brief The recorded channels. */
+      std::vector<CpuSensors::Channel> channels() const;
+
+      /** @brief The number of bytes used to store the points of all channels. */
+      size_t memory() const;
+
+      /** @brief Copy the last (at most) count points of a channel into v (oldest first). */
+      void copy(size_t channel, Tier tier, size_t count, std::vector<Point>& v) const;
+
+      /** @brief Get the minimum, maximum and mean of the last (at most) count points of a channel. */
+      Point summary(size_t channel, Tier tier, size_t count) const;
+
+      /** @brief Get the summaries of every channel of a layout over several periods.
+        *
+        * The channels are those of the history once it has appended a
+        * snapshot with that layout, so they are used by their index (without
+        * a lookup), and the lock is only taken once.
+        * @param layout The layout of the channels (see CpuSensors::Snapshot::layout).
+        * @param[out] v The summary of period p of channel i is v[i * n + p].
+        * @returns false (and an empty v) if the history does not have that layout (yet). */
+      bool summary(const Layout& layout, const Period* periods, size_t n, std::vector<Point>& v) const;
+
+      /** @brief The time of the first appended snapshot. */
+      std::chrono::steady_clock::time_point epoch() const;
+
+    private:
+      mutable std::mutex mutex_;
+      std::vector<CpuSensors::Channel> channels_;
+      std::vector<TimeSeries> series_;
+      TimeSeries::Capacity capacity_;
+      Layout layout_;
+      std::chrono::steady_clock::time_point epoch_;
+      bool started_ { false };
+      /** @brief Adopt a new layout, keeping the series of remaining channels. */
+      void relayout(const std::shared_ptr<const std::vector<CpuSensors::Channel>>& layout);
+  };
+
+} // ends namespace xxx
+
+#endif
@@ -0,0 +1,363 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/SensorRecording.cpp
+ * @brief Record the CpuSensors snapshots to a file and replay them (implementation).
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SensorRecording.hpp"
+
+namespace {
+
+  /* The scale of the stored values (power is stored in milliwatt,
+   * the idle residency, mis-prediction rates, pressure, run time and run-queue
+   * delay in tenths of a percent,
+   * the instructions per cycle and misses per 1000 instructions in 1/100) */
+  uint32_t scale(xxx::CpuSensors::Channel::Type type) {
+    using Type = xxx::CpuSensors::Channel::Type;
+    switch (type) {
+      case Type::Power: return 1000;
+      case Type::Idle:
+      case Type::IdleAbove:
+      case Type::IdleBelow:
+      case Type::Pressure:
+      case Type::RunTime:
+      case Type::RunDelay: return 10;
+      case Type::Ipc:
+      case Type::LlcMisses:
+      case Type::BranchMisses: return 100;
+      default: return 1;
+    }
+  }
+
+  template<typename T>
+  uint8_t* put(uint8_t* p, T value) {
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+  }
+
+  uint8_t* put_varint(uint8_t* p, uint64_t value) {
+    while (value >= 0x80) {
+      *p++ = static_cast<uint8_t>(value | 0x80);
+      value >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(value);
+    return p;
+  }
+
+  uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  }
+
+  int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  /* Bounds checked reading of a mapped recording */
+  struct Cursor {
+    const uint8_t* p;
+    const uint8_t* end;
+    template<typename T>
+    bool get(T& value) {
+      if (static_cast<size_t>(end - p) < sizeof(T)) return false;
+      std::memcpy(&value, p, sizeof(T));
+      p += sizeof(T);
+      return true;
+    }
+    bool get_varint(uint64_t& value) {
+      value = 0;
+      for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        value |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return true;
+      }
+      return false;
+    }
+  };
+
+  /* The size of a varint is at most 10 bytes */
+  constexpr size_t MaxVarint = 10;
+  constexpr size_t BlockHeader = 3 * sizeof(uint32_t);
+  /* The largest logical cpu number of a recorded topology (the kernel's NR_CPUS is at most 8192) */
+  constexpr uint32_t MaxLogicalCpu = 65535;
+
+} // ends namespace
+
+/*
+ * SensorRecorder
+ */
+
+xxx::SensorRecorder::SensorRecorder(
+    const std::string& path, std::vector<CpuSensors::Channel> channels,
+    const CpuTopology& topology)
+  : channels_(std::move(channels)),
+    source_(channels_),
+    times_(recording::BlockFrames),
+    values_(channels_.size() * recording::BlockFrames),
+    buffer_(BlockHeader + (channels_.size() + 1) * recording::BlockFrames * MaxVarint) {
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error(
+        "Could not create '" + path + "': " + std::strerror(errno));
+  }
+  /* write the header */
+  std::vector<uint8_t> header(
+      sizeof(recording::Magic) + 2 * sizeof(uint32_t) + sizeof(uint64_t));
+  for (const auto& c : channels_)
+    header.resize(header.size() + 1 + 2 * sizeof(uint32_t) + sizeof(uint16_t) + c.name.size());
+  auto cpus = topology.ids();
+  header.resize(header.size() + sizeof(uint32_t) + cpus.size() * 4 * sizeof(uint32_t));
+  auto start = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  uint8_t* p = header.data();
+  p = std::copy(std::begin(recording::Magic), std::end(recording::Magic), p);
+  p = put<uint32_t>(p, recording::Version);
+  p = put<uint32_t>(p, static_cast<uint32_t>(channels_.size()));
+  p = put<uint64_t>(p, static_cast<uint64_t>(start));
+  for (const auto& c : channels_) {
+    scale_.push_back(scale(c.type));
+    size_t name_size = std::min<size_t>(c.name.size(), UINT16_MAX);
+    p = put<uint8_t>(p, static_cast<uint8_t>(c.type));
+    p = put<uint32_t>(p, static_cast<uint32_t>(c.index));
+    p = put<uint32_t>(p, scale_.back());
+    p = put<uint16_t>(p, static_cast<uint16_t>(name_size));
+    p = std::copy(c.name.begin(), c.name.begin() + name_size, p);
+  }
+  p = put<uint32_t>(p, static_cast<uint32_t>(cpus.size()));
+  for (const auto& cpu : cpus) {
+    p = put<uint32_t>(p, static_cast<uint32_t>(cpu.logical));
+    p = put<uint32_t>(p, static_cast<uint32_t>(cpu.package));
+    p = put<uint32_t>(p, static_cast<uint32_t>(cpu.die));
+    p = put<uint32_t>(p, static_cast<uint32_t>(cpu.core));
+  }
+  write(header.data(), static_cast<size_t>(p - header.data()));
+  if (fd_ < 0) {
+    throw std::runtime_error(
+        "Could not write '" + path + "': " + std::strerror(errno));
+  }
+}
+
+xxx::SensorRecorder::~SensorRecorder() {
+  flush();
+  if (fd_ >= 0) ::close(fd_);
+}
+
+void xxx::SensorRecorder::append(const CpuSensors::Snapshot& snapshot) {
+  if (!started_) {
+    epoch_ = snapshot.time;
+    started_ = true;
+  }
+  if (snapshot.layout && snapshot.layout != layout_) {
+    for (size_t i = 0; i < channels_.size(); ++i) {
+      size_t j = CpuSensors::find(*snapshot.layout, channels_[i]);
+      source_[i].index = (j == SIZE_MAX) ? SIZE_MAX : (*snapshot.layout)[j].index;
+    }
+    layout_ = snapshot.layout;
+  }
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(snapshot.time - epoch_).count();
+  times_[pending_] = static_cast<uint64_t>(std::max<decltype(ms)>(ms, 0));
+  for (size_t i = 0; i < channels_.size(); ++i) {
+    values_[i * recording::BlockFrames + pending_] =
+        std::llround(CpuSensors::value(snapshot, source_[i]) * scale_[i]);
+  }
+  ++frames_;
+  if (++pending_ == recording::BlockFrames) flush();
+}
+
+void xxx::SensorRecorder::flush() {
+  if (pending_ == 0) return;
+  uint8_t* p = buffer_.data() + BlockHeader;
+  uint64_t time = times_[0];
+  p = put_varint(p, time);
+  for (uint32_t f = 1; f < pending_; ++f) {
+    p = put_varint(p, times_[f] - time);
+    time = times_[f];
+  }
+  for (size_t i = 0; i < channels_.size(); ++i) {
+    const int64_t* v = &values_[i * recording::BlockFrames];
+    int64_t previous = 0;
+    for (uint32_t f = 0; f < pending_; ++f) {
+      p = put_varint(p, zigzag(v[f] - previous));
+      previous = v[f];
+    }
+  }
+  size_t size = static_cast<size_t>(p - buffer_.data());
+  uint8_t* h = buffer_.data();
+  h = put<uint32_t>(h, recording::BlockMagic);
+  h = put<uint32_t>(h, pending_);
+  put<uint32_t>(h, static_cast<uint32_t>(size - BlockHeader));
+  pending_ = 0;
+  write(buffer_.data(), size);
+}
+
+void xxx::SensorRecorder::write(const uint8_t* data, size_t size) {
+  while (fd_ >= 0 && size > 0) {
+    ssize_t n = ::write(fd_, data, size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      ::close(fd_);
+      fd_ = -1;
+      break;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+/*
+ * SensorRecording
+ */
+
+xxx::SensorRecording::SensorRecording(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error(
+        "Could not open '" + path + "': " + std::strerror(errno));
+  }
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    length_ = static_cast<size_t>(st.st_size);
+    void* p = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) data_ = static_cast<const uint8_t*>(p);
+  }
+  ::close(fd);
+  /* parse the header */
+  Cursor c { data_, data_ + ((data_ != nullptr) ? length_ : 0) };
+  char magic[sizeof(recording::Magic)];
+  uint32_t version = 0, channels = 0;
+  uint64_t start = 0;
+  bool ok = c.get(magic)
+      && std::equal(std::begin(magic), std::end(magic), std::begin(recording::Magic))
+      && c.get(version) && version >= 1 && version <= recording::Version
+      && c.get(channels) && c.get(start);
+  std::vector<CpuSensors::Channel> layout;
+  for (uint32_t i = 0; ok && i < channels; ++i) {
+    uint8_t type;
+    uint32_t index, scale;
+    uint16_t name_size;
+    ok = c.get(type) && type <= static_cast<uint8_t>(CpuSensors::Channel::Type::Timeslices)
+        && c.get(index) && c.get(scale) && scale > 0
+        && c.get(name_size) && static_cast<size_t>(c.end - c.p) >= name_size;
+    if (!ok) break;
+    auto t = static_cast<CpuSensors::Channel::Type>(type);
+    layout.push_back({ t, index,
+        std::string(reinterpret_cast<const char*>(c.p), name_size), CpuSensors::Unit(t) });
+    scale_.push_back(scale);
+    c.p += name_size;
+  }
+  std::vector<CpuTopologyIds> cpus;
+  uint32_t cpu_count = 0;
+  if (ok && version >= 2) ok = c.get(cpu_count) && static_cast<size_t>(c.end - c.p) / (4 * sizeof(uint32_t)) >= cpu_count;
+  for (uint32_t i = 0; ok && i < cpu_count; ++i) {
+    uint32_t logical, package, die, core;
+    ok = c.get(logical) && logical <= MaxLogicalCpu
+        && c.get(package) && c.get(die) && c.get(core);
+    if (!ok) break;
+    cpus.push_back({ logical, package, die, core });
+  }
+  if (!ok) {
+    if (data_ != nullptr) ::munmap(const_cast<uint8_t*>(data_), length_);
+    throw std::runtime_error("'" + path + "' is not a Core Adjust recording.");
+  }
+  start_ = std::chrono::system_clock::time_point(std::chrono::milliseconds(start));
+  layout_ = std::make_shared<const std::vector<CpuSensors::Channel>>(std::move(layout));
+  topology_ = std::make_shared<const CpuTopology>(cpus);
+  rollup_ = CpuSensors::Map(*layout_, *topology_);
+  /* index the (complete) blocks */
+  uint32_t magic_block, frames, size;
+  while (c.get(magic_block) && magic_block == recording::BlockMagic
+      && c.get(frames) && c.get(size) && frames > 0 && frames <= recording::BlockFrames
+      && static_cast<size_t>(c.end - c.p) >= size) {
+    blocks_.push_back({ static_cast<size_t>(c.p - data_), size, frames_, frames });
+    frames_ += frames;
+    c.p += size;
+  }
+  times_.resize(recording::BlockFrames);
+  values_.resize(layout_->size() * recording::BlockFrames);
+}
+
+xxx::SensorRecording::~SensorRecording() {
+  if (data_ != nullptr) ::munmap(const_cast<uint8_t*>(data_), length_);
+}
+
+size_t xxx::SensorRecording::find(size_t frame) const {
+  auto it = std::upper_bound(blocks_.begin(), blocks_.end(), frame,
+      [](size_t f, const Block& b) { return f < b.first; });
+  return static_cast<size_t>(it - blocks_.begin()) - 1;
+}
+
+bool xxx::SensorRecording::decode(size_t block) {
+  if (block == cached_) return true;
+  cached_ = SIZE_MAX;
+  const Block& b = blocks_[block];
+  Cursor c { data_ + b.offset, data_ + b.offset + b.size };
+  uint64_t v;
+  if (!c.get_varint(v)) return false;
+  times_[0] = v;
+  for (uint32_t f = 1; f < b.frames; ++f) {
+    if (!c.get_varint(v)) return false;
+    times_[f] = times_[f - 1] + v;
+  }
+  for (size_t i = 0; i < layout_->size(); ++i) {
+    int64_t* values = &values_[i * recording::BlockFrames];
+    int64_t previous = 0;
+    for (uint32_t f = 0; f < b.frames; ++f) {
+      if (!c.get_varint(v)) return false;
+      previous += unzigzag(v);
+      values[f] = previous;
+    }
+  }
+  cached_ = block;
+  return true;
+}
+
+bool xxx::SensorRecording::read(size_t frame, CpuSensors::Snapshot& snapshot) {
+  if (frame >= frames_) return false;
+  size_t block = find(frame);
+  if (!decode(block)) return false;
+  size_t f = frame - blocks_[block].first;
+  snapshot.sequence = frame + 1;
+  snapshot.time = std::chrono::steady_clock::time_point(std::chrono::milliseconds(times_[f]));
+  snapshot.layout = layout_;
+  snapshot.topology = topology_;
+  const auto& channels = *layout_;
+  for (size_t i = 0; i < channels.size(); ++i) {
+    CpuSensors::assign(snapshot, channels[i],
+        static_cast<double>(values_[i * recording::BlockFrames + f]) / scale_[i]);
+  }
+  CpuSensors::Rollup(snapshot, rollup_, *topology_);
+  return true;
+}
+
+std::chrono::milliseconds xxx::SensorRecording::time(size_t frame) {
+  if (frame >= frames_) return std::chrono::milliseconds(0);
+  size_t block = find(frame);
+  if (!decode(block)) return std::chrono::milliseconds(0);
+  return std::chrono::milliseconds(times_[frame - blocks_[block].first]);
+}
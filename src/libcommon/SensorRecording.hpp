@@ -0,0 +1,192 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/SensorRecording.hpp
+ * @brief Record the CpuSensors snapshots to a file and replay them.
+ */
+#ifndef libcommon_SensorRecording_hpp
+#define libcommon_SensorRecording_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CpuSensors.hpp"
+
+namespace xxx {
+
+  /** @brief The layout of a recording file (all integers are little endian).
+    *
+    * Header:
+    *   char[8]  magic "CAREC\r\n\x1a"
+    *   uint32   version (2)
+    *   uint32   number of channels
+    *   uint64   start of the recording (milliseconds since the Unix epoch)
+    *   then for each channel:
+    *     uint8  type (CpuSensors::Channel::Type)
+    *     uint32 index
+    *     uint32 scale (the value is stored as round(value * scale))
+    *     uint16 length of the name, followed by the name
+    *   uint32   number of logical cpus in the topology (version 2)
+    *   then for each logical cpu:
+    *     uint32 logical cpu number
+    *     uint32 physical_package_id
+    *     uint32 die_id
+    *     uint32 core_id
+    *
+    * Followed by any number of blocks of (at most) BlockFrames frames:
+    *   uint32   magic "CBLK"
+    *   uint32   number of frames
+    *   uint32   size of the payload (bytes)
+    *   payload: the columns of the block, all values are varints:
+    *     time column: milliseconds since the start of the recording for the
+    *                  first frame, followed by the delta to the previous frame
+    *     one column per channel: the zigzag encoded first value, followed by
+    *                             the zigzag encoded delta to the previous value
+    *
+    * Each block can be decoded on its own and is written with a single write(),
+    * an incomplete last block (ie. after a crash) is ignored by the reader.
+    * A version 1 recording (without a topology) can still be replayed. */
+  namespace recording {
+    constexpr char Magic[8] = { 'C', 'A', 'R', 'E', 'C', '\r', '\n', '\x1a' };
+    constexpr uint32_t Version = 2;
+    constexpr uint32_t BlockMagic = 0x4b4c4243; /* "CBLK" */
+    constexpr uint32_t BlockFrames = 64;
+  }
+
+  /** @brief Appends CpuSensors snapshots to a recording file.
+    *
+    * All memory is allocated by the constructor, append() only encodes
+    * and writes a block once every BlockFrames snapshots.
+    *
+    * The recorded channels and topology are fixed, when a snapshot has a
+    * new layout (cpus were hotplugged) they are looked up by type and name
+    * and channels that are no longer present are recorded as 0. */
+  class SensorRecorder {
+    public:
+      /** @param path The file to create (an existing file is truncated).
+        * @param channels The channels to record (ie. CpuSensors::channels()).
+        * @param topology The cores and packages of the cpus (ie. CpuSensors::topology()).
+        * @throws std::runtime_error if the file could not be created. */
+      SensorRecorder(const std::string& path, std::vector<CpuSensors::Channel> channels,
+          const CpuTopology& topology);
+      /** @brief Writes the last (incomplete) block and closes the file. */
+      ~SensorRecorder();
+
+      SensorRecorder(const SensorRecorder&) = delete;
+      SensorRecorder& operator=(const SensorRecorder&) = delete;
+
+      /** @brief Add the values of all channels from a snapshot. */
+      void append(const CpuSensors::Snapshot& snapshot);
+
+      /** @brief Write the pending frames as a (short) block. */
+      void flush();
+
+      /** @brief false if a write to the file failed. */
+      inline bool good() const { return fd_ >= 0; }
+      /** @brief The number of recorded frames. */
+      inline uint64_t size() const { return frames_; }
+
+    private:
+      int fd_ { -1 };
+      std::vector<CpuSensors::Channel> channels_;
+      std::vector<uint32_t> scale_;
+      /* The recorded channels in the layout of the last snapshot */
+      std::vector<CpuSensors::Channel> source_;
+      std::shared_ptr<const std::vector<CpuSensors::Channel>> layout_;
+      std::chrono::steady_clock::time_point epoch_;
+      bool started_ { false };
+      uint64_t frames_ { 0 };
+      /* The pending frames, values_[channel * BlockFrames + frame] */
+      uint32_t pending_ { 0 };
+      std::vector<uint64_t> times_;
+      std::vector<int64_t> values_;
+      /* The encoded block */
+      std::vector<uint8_t> buffer_;
+      void write(const uint8_t* data, size_t size);
+  };
+
+  /** @brief A recording file that is mapped into memory for replay.
+    *
+    * Opening a recording only reads the header and the block headers,
+    * a block is decoded when a frame from it is read (the last decoded
+    * block is cached), so the file is never completely loaded into RAM.
+    *
+    * The frames are aggregated per core and per package using the
+    * recorded topology (not that of the host that replays them). */
+  class SensorRecording {
+    public:
+      /** @param path The recording to open.
+        * @throws std::runtime_error if the file could not be opened or is not a recording. */
+      explicit SensorRecording(const std::string& path);
+      ~SensorRecording();
+
+      SensorRecording(const SensorRecording&) = delete;
+      SensorRecording& operator=(const SensorRecording&) = delete;
+
+      /** @brief The recorded channels. */
+      inline const std::vector<CpuSensors::Channel>& channels() const { return *layout_; }
+      /** @brief The recorded topology (empty for a version 1 recording). */
+      inline std::shared_ptr<const CpuTopology> topology() const { return topology_; }
+      /** @brief The number of frames in the recording. */
+      inline size_t size() const { return frames_; }
+      /** @brief The (wall clock) time the recording was started. */
+      inline std::chrono::system_clock::time_point start() const { return start_; }
+
+      /** @brief Read a frame.
+        * @param frame The index of the frame.
+        * @param snapshot Receives the values of the frame and their rollups, its time is relative
+        *                 to the start of the recording (steady_clock epoch == start()),
+        *                 its layout and topology are those of the recording.
+        * @returns false if frame is out of range. */
+      bool read(size_t frame, CpuSensors::Snapshot& snapshot);
+
+      /** @brief The time of a frame relative to the start of the recording. */
+      std::chrono::milliseconds time(size_t frame);
+
+    private:
+      struct Block {
+        size_t offset;   /* offset of the payload */
+        size_t size;     /* size of the payload */
+        size_t first;    /* index of the first frame */
+        uint32_t frames;
+      };
+      const uint8_t* data_ { nullptr };
+      size_t length_ { 0 };
+      std::shared_ptr<const std::vector<CpuSensors::Channel>> layout_;
+      std::vector<uint32_t> scale_;
+      std::shared_ptr<const CpuTopology> topology_;
+      CpuSensors::RollupMap rollup_;
+      std::chrono::system_clock::time_point start_;
+      std::vector<Block> blocks_;
+      size_t frames_ { 0 };
+      /* The last decoded block */
+      size_t cached_ { SIZE_MAX };
+      std::vector<uint64_t> times_;
+      std::vector<int64_t> values_;
+      bool decode(size_t block);
+      size_t find(size_t frame) const;
+  };
+
+} // ends namespace xxx
+
+#endif
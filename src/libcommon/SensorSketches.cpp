@@ -0,0 +1,239 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/SensorSketches.cpp
+ * @brief Streaming percentile sketches of the CpuSensors channels (implementation).
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "SensorSketches.hpp"
+
+/*
+ * PercentileSketch
+ */
+
+constexpr size_t xxx::PercentileSketch::Buckets;
+
+size_t xxx::PercentileSketch::Index(double value) {
+  /* (also true for NaN) */
+  if (!(value >= std::ldexp(0.5, MinExponent))) return 0;
+  int exponent;
+  double mantissa = std::frexp(value, &exponent);  /* 0.5 <= mantissa < 1 */
+  if (exponent > MaxExponent) return Buckets - 1;
+  auto sub = static_cast<size_t>((mantissa - 0.5) * 2 * SubBuckets);
+  return 1 + static_cast<size_t>(exponent - MinExponent) * SubBuckets + std::min<size_t>(sub, SubBuckets - 1);
+}
+
+double xxx::PercentileSketch::Value(size_t index) {
+  if (index == 0) return 0.;
+  int exponent = MinExponent + static_cast<int>((index - 1) / SubBuckets);
+  double sub = static_cast<double>((index - 1) % SubBuckets);
+  return std::ldexp(0.5 + (sub + 0.5) / (2 * SubBuckets), exponent);
+}
+
+void xxx::PercentileSketch::add(double value) {
+  ++counts_[Index(value)];
+  if (count_ == 0) min_ = max_ = value;
+  else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+  sum_ += value;
+  ++count_;
+}
+
+void xxx::PercentileSketch::merge(const PercentileSketch& other) {
+  if (other.count_ == 0) return;
+  for (size_t i = 0; i < Buckets; ++i) counts_[i] += other.counts_[i];
+  if (count_ == 0) {
+    min_ = other.min_;
+    max_ = other.max_;
+  }
+  else {
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+  sum_ += other.sum_;
+  count_ += other.count_;
+}
+
+void xxx::PercentileSketch::reset() {
+  counts_.fill(0);
+  count_ = 0;
+  min_ = max_ = sum_ = 0.;
+}
+
+double xxx::PercentileSketch::quantile(double q) const {
+  double v;
+  quantiles(&q, &v, 1);
+  return v;
+}
+
+void xxx::PercentileSketch::quantiles(const double* q, double* v, size_t n) const {
+  size_t k = 0;
+  if (count_ == 0) {
+    for (; k < n; ++k) v[k] = 0.;
+    return;
+  }
+  /* the bucket that holds the sample of rank q * (count - 1) */
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < Buckets && k < n; ++i) {
+    cumulative += counts_[i];
+    while (k < n) {
+      double rank = std::clamp(q[k], 0., 1.) * static_cast<double>(count_ - 1);
+      if (static_cast<double>(cumulative) <= rank) break;
+      v[k++] = std::clamp(Value(i), min_, max_);
+    }
+  }
+  for (; k < n; ++k) v[k] = max_;
+}
+
+/*
+ * SensorSketches
+ */
+
+xxx::SensorSketches::SensorSketches(std::vector<CpuSensors::Channel> channels)
+  : channels_(std::move(channels)),
+    sketches_(channels_.size()) {
+  map();
+}
+
+void xxx::SensorSketches::relayout(
+    const std::shared_ptr<const std::vector<CpuSensors::Channel>>& layout) {
+  std::vector<PercentileSketch> sketches;
+  sketches.reserve(layout->size());
+  for (const auto& c : *layout) {
+    size_t i = CpuSensors::find(channels_, c);
+    sketches.push_back((i < sketches_.size()) ? sketches_[i] : PercentileSketch());
+  }
+  channels_ = *layout;
+  sketches_.swap(sketches);
+  layout_ = layout;
+}
+
+void xxx::SensorSketches::map() {
+  package_.assign(channels_.size(), SIZE_MAX);
+  merged_.assign(channels_.size(), false);
+  for (size_t i = 0; i < channels_.size(); ++i) {
+    const auto& c = channels_[i];
+    if (c.name.find('/') != std::string::npos) continue;
+    if (c.type == CpuSensors::Channel::Type::Load && c.index == 0) continue;
+    merged_[i] = true;
+    if (!topology_) continue;
+    /* 'cpuN', 'packageN', 'package-N' (RAPL), 'Package id N' or 'Core N (package N)' (coretemp),
+     * a core temperature without a package only has a known package on single package systems */
+    unsigned long id;
+    char end;
+    const char* name = c.name.c_str();
+    const char* suffix = std::strstr(name, " (package ");
+    if (std::sscanf(name, "cpu%lu%c", &id, &end) == 1)
+      package_[i] = topology_->cpu(id).package;
+    else if (std::sscanf(name, "package%lu%c", &id, &end) == 1
+        || std::sscanf(name, "package-%lu%c", &id, &end) == 1
+        || std::sscanf(name, "Package id %lu%c", &id, &end) == 1)
+      package_[i] = topology_->package(id);
+    else if (suffix && std::sscanf(suffix, " (package %lu)%c", &id, &end) == 1)
+      package_[i] = topology_->package(id);
+    else if (topology_->packages().size() == 1)
+      package_[i] = 0;
+  }
+}
+
+void xxx::SensorSketches::append(const CpuSensors::Snapshot& snapshot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!started_) {
+    since_ = snapshot.time;
+    started_ = true;
+  }
+  bool changed = false;
+  if (snapshot.layout && snapshot.layout != layout_) {
+    relayout(snapshot.layout);
+    changed = true;
+  }
+  if (snapshot.topology && snapshot.topology != topology_) {
+    topology_ = snapshot.topology;
+    changed = true;
+  }
+  if (changed) map();
+  for (size_t i = 0; i < channels_.size(); ++i)
+    sketches_[i].add(CpuSensors::value(snapshot, channels_[i]));
+}
+
+void xxx::SensorSketches::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& s : sketches_) s.reset();
+  started_ = false;
+}
+
+std::vector<xxx::CpuSensors::Channel> xxx::SensorSketches::channels() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return channels_;
+}
+
+bool xxx::SensorSketches::copy(size_t channel, PercentileSketch& sketch) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (channel < sketches_.size()) {
+    sketch = sketches_[channel];
+    return true;
+  }
+  sketch.reset();
+  return false;
+}
+
+bool xxx::SensorSketches::copy(const CpuSensors::Channel& channel, PercentileSketch& sketch) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t i = CpuSensors::find(channels_, channel);
+  if (i < sketches_.size()) {
+    sketch = sketches_[i];
+    return true;
+  }
+  sketch.reset();
+  return false;
+}
+
+bool xxx::SensorSketches::quantiles(const Layout& layout, const double* q, size_t n, std::vector<double>& v) const {
+  v.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!layout || layout != layout_) return false;
+  v.resize(sketches_.size() * n);
+  for (size_t i = 0; i < sketches_.size(); ++i)
+    sketches_[i].quantiles(q, v.data() + i * n, n);
+  return true;
+}
+
+size_t xxx::SensorSketches::merge(CpuSensors::Channel::Type type, size_t package, PercentileSketch& sketch) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t n = 0;
+  for (size_t i = 0; i < channels_.size(); ++i) {
+    if (channels_[i].type != type || !merged_[i]) continue;
+    if (package != SIZE_MAX && package_[i] != package) continue;
+    sketch.merge(sketches_[i]);
+    ++n;
+  }
+  return n;
+}
+
+std::chrono::steady_clock::time_point xxx::SensorSketches::since() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return since_;
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/SensorSketches.hpp
+ * @brief Streaming percentile sketches of the CpuSensors channels.
+ */
+#ifndef libcommon_SensorSketches_hpp
+#define libcommon_SensorSketches_hpp
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CpuSensors.hpp"
+
+namespace xxx {
+
+  /** @brief An HDR style histogram of a value that is used to estimate its percentiles.
+    *
+    * Each power of two between 2^-7 and 2^17 is divided into 64 linear
+    * buckets, so a percentile has a relative error below 0.8% (values
+    * below 2^-7, including zero and negative values, share a single
+    * bucket and values of 2^17 or more are counted in the last bucket).
+    * add() is O(1) and does not allocate, the memory used is fixed (6 KiB).
+    * Sketches with the same layout are merged by adding their buckets. */
+  class PercentileSketch {
+    public:
+      static constexpr int SubBuckets = 64;
+      static constexpr int MinExponent = -6;
+      static constexpr int MaxExponent = 17;
+      static constexpr size_t Buckets = 1 + (MaxExponent - MinExponent + 1) * SubBuckets;
+
+      PercentileSketch() { reset(); }
+
+      /** @brief Add a sample. */
+      void add(double value);
+
+      /** @brief Add the samples of another sketch. */
+      void merge(const PercentileSketch& other);
+
+      /** @brief Remove all samples. */
+      void reset();
+
+      inline uint64_t count() const { return count_; }
+      /** @brief The exact minimum, maximum and mean of the samples (or 0 if there are none). */
+      inline double min() const { return count_ ? min_ : 0.; }
+      inline double max() const { return count_ ? max_ : 0.; }
+      inline double mean() const { return count_ ? sum_ / static_cast<double>(count_) : 0.; }
+
+      /** @brief Estimate a percentile.
+        * @param q The quantile (0 ... 1), ie. 0.99 for the 99th percentile.
+        * @returns The estimate (limited to min() ... max()) or 0 if there are no samples. */
+      double quantile(double q) const;
+
+      /** @brief Estimate several percentiles in a single pass over the buckets.
+        * @param q The quantiles in ascending order.
+        * @param[out] v The estimates. */
+      void quantiles(const double* q, double* v, size_t n) const;
+
+    private:
+      std::array<uint32_t, Buckets> counts_;
+      uint64_t count_;
+      double min_;
+      double max_;
+      double sum_;
+      static size_t Index(double value);
+      /** @brief The value in the middle of a bucket. */
+      static double Value(size_t index);
+  };
+
+  /** @brief A PercentileSketch of every channel of a CpuSensors instance.
+    *
+    * Feed it from the sampler thread using CpuSensors::listen() (or call
+    * append() for each snapshot), and read it from any other thread.
+    * All member functions are thread safe.
+    *
+    * When a snapshot has a new layout (cpus were hotplugged) the channels
+    * are matched by type and name: channels that remain keep their samples.
+    *
+    * The sketches of a channel type are merged per package (or for all
+    * packages), ie. the frequency of all cpus of package 0. The aggregate
+    * load channel and the channels with a '/' in their name (power
+    * sub-zones, idle states, the cores of a throttle package) are not merged. */
+  class SensorSketches {
+    public:
+      using Layout = std::shared_ptr<const std::vector<CpuSensors::Channel>>;
+
+      /** @param channels The channels to sketch (ie. CpuSensors::channels()). */
+      explicit SensorSketches(std::vector<CpuSensors::Channel> channels);
+
+      SensorSketches(const SensorSketches&) = delete;
+      SensorSketches& operator=(const SensorSketches&) = delete;
+
+      /** @brief Add the values of all channels from a snapshot. */
+      void append(const CpuSensors::Snapshot& snapshot);
+
+      /** @brief Remove the samples of all channels. */
+      void reset();
+
+      /** @brief The sketched channels. */
+      std::vector<CpuSensors::Channel> channels() const;
+
+      /** @brief Copy the sketch of a channel (an index into channels()).
+        * @returns false (and an empty sketch) if there is no such channel. */
+      bool copy(size_t channel, PercentileSketch& sketch) const;
+
+      /** @brief Copy the sketch of a channel found by type and name. */
+      bool copy(const CpuSensors::Channel& channel, PercentileSketch& sketch) const;
+
+      /** @brief Estimate several percentiles of every channel of a layout.
+        *
+        * The channels are used by their index (see SensorHistory::summary()),
+        * the sketches are not copied and the lock is only taken once.
+        * @param layout The layout of the channels (see CpuSensors::Snapshot::layout).
+        * @param q The quantiles in ascending order.
+        * @param[out] v The estimate of quantile k of channel i is v[i * n + k].
+        * @returns false (and an empty v) if the sketches do not have that layout (yet). */
+      bool quantiles(const Layout& layout, const double* q, size_t n, std::vector<double>& v) const;
+
+      /** @brief Merge the sketches of a channel type into sketch.
+        * @param package The index of a package of the topology of the
+        * last snapshot (see CpuTopology::packages()), SIZE_MAX == all channels.
+        * @returns The number of merged channels. */
+      size_t merge(CpuSensors::Channel::Type type, size_t package, PercentileSketch& sketch) const;
+
+      /** @brief The time of the first sample after the construction or the last reset(). */
+      std::chrono::steady_clock::time_point since() const;
+
+    private:
+      mutable std::mutex mutex_;
+      std::vector<CpuSensors::Channel> channels_;
+      std::vector<PercentileSketch> sketches_;
+      /* The package of each channel (SIZE_MAX == unknown or not merged) */
+      std::vector<size_t> package_;
+      /* Should the channel be merged? */
+      std::vector<bool> merged_;
+      Layout layout_;
+      std::shared_ptr<const CpuTopology> topology_;
+      std::chrono::steady_clock::time_point since_;
+      bool started_ { false };
+      /** @brief Adopt a new layout, keeping the sketches of remaining channels. */
+      void relayout(const std::shared_ptr<const std::vector<CpuSensors::Channel>>& layout);
+      /** @brief Find the package of each channel in topology_. */
+      void map();
+  };
+
+} // ends namespace xxx
+
+#endif
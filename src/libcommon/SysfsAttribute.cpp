@@ -0,0 +1,95 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/libcommon/SysfsAttribute.cpp
+ * @brief Read sysfs/procfs attributes using a persistent file descriptor (implementation).
+ */
+#include <cerrno>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  SysfsAttribute::SysfsAttribute(std::string path)
+    : path_(std::move(path)) {
+    reopen();
+  }
+
+  SysfsAttribute::~SysfsAttribute() {
+    close();
+  }
+
+  SysfsAttribute::SysfsAttribute(SysfsAttribute&& other) noexcept
+    : path_(std::move(other.path_)),
+      fd_(other.fd_),
+      removed_(other.removed_) {
+    other.fd_ = -1;
+  }
+
+  SysfsAttribute& SysfsAttribute::operator=(SysfsAttribute&& other) noexcept {
+    if (this != &other) {
+      close();
+      path_ = std::move(other.path_);
+      fd_ = other.fd_;
+      removed_ = other.removed_;
+      other.fd_ = -1;
+    }
+    return *this;
+  }
+
+  void SysfsAttribute::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+  }
+
+  bool SysfsAttribute::reopen() {
+    close();
+    if (!path_.empty()) fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ >= 0) removed_ = false;
+    return fd_ >= 0;
+  }
+
+  ssize_t SysfsAttribute::read(char* buf, size_t n, off_t offset) {
+    if (fd_ < 0) {
+      /* (an attribute that never existed is not opened on every read) */
+      if (!removed_) {
+        errno = ENOENT;
+        return -1;
+      }
+      if (!reopen()) return -1;
+    }
+    ssize_t rv;
+    do {
+      rv = ::pread(fd_, buf, n, offset);
+    } while (rv < 0 && errno == EINTR);
+    if (rv < 0 && errno == ENODEV) {
+      /* The device is gone (hotplug), try to open it again. */
+      removed_ = true;
+      if (!reopen()) return -1;
+      rv = ::pread(fd_, buf, n, offset);
+    }
+    return rv;
+  }
+
+} // ends namespace xxx
@@ -0,0 +1,120 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/SysfsAttribute.hpp
+ * @brief Read sysfs/procfs attributes using a persistent file descriptor.
+ */
+#ifndef libcommon_SysfsAttribute_hpp
+#define libcommon_SysfsAttribute_hpp
+
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <sys/types.h>
+
+namespace xxx {
+
+  /** @brief A sysfs (or procfs) attribute that is opened once and read many times.
+    *
+    * The attribute is opened by the constructor and each read is a single
+    * pread() at offset 0 on that file descriptor, which makes the kernel
+    * regenerate the contents of the attribute.
+    * If the read fails with ENODEV (the device was removed, ie. a cpu was
+    * hot-unplugged), then the attribute is re-opened by that read and, until
+    * that succeeds, by the next reads.
+    * An attribute that could not be opened (ie. it does not exist on this
+    * kernel) is not opened again by read(), which fails without a syscall,
+    * use reopen() to try again. */
+  class SysfsAttribute {
+    public:
+      SysfsAttribute() = default;
+      explicit SysfsAttribute(std::string path);
+      ~SysfsAttribute();
+
+      SysfsAttribute(const SysfsAttribute&) = delete;
+      SysfsAttribute& operator=(const SysfsAttribute&) = delete;
+      SysfsAttribute(SysfsAttribute&&) noexcept;
+      SysfsAttribute& operator=(SysfsAttribute&&) noexcept;
+
+      /** @brief Is the attribute open? */
+      inline bool good() const { return fd_ >= 0; }
+      /** @brief The file descriptor of the attribute (or -1). */
+      inline int fd() const { return fd_; }
+      /** @brief The path of the attribute. */
+      inline const std::string& path() const { return path_; }
+
+      /** @brief (Re)open the attribute.
+        * @returns true if the attribute could be opened. */
+      bool reopen();
+
+      /** @brief Read the attribute.
+        * @param buf The buffer to read into.
+        * @param n The size of the buffer.
+        * @param offset The offset to read from (ie. the address of a MSR in /dev/cpu/N/msr).
+        * @returns The number of bytes read or -1 on error. */
+      ssize_t read(char* buf, size_t n, off_t offset = 0);
+
+      /** @brief Read the attribute and convert it into an integer value.
+        * @param value Receives the value.
+        * @returns true on success, value is not modified on failure. */
+      template<typename T>
+      bool read(T& value);
+
+      /** @brief Convert the (leading) text of an attribute into an integer value.
+        * @param text The text to convert, leading white-space is skipped.
+        * @param value Receives the value.
+        * @returns true on success, value is not modified on failure. */
+      template<typename T>
+      static bool Parse(std::string_view text, T& value);
+
+    private:
+      std::string path_;
+      int fd_ { -1 };
+      /* The device was removed (ENODEV), read() reopens the attribute */
+      bool removed_ { false };
+      void close();
+  };
+
+  template<typename T>
+  bool SysfsAttribute::read(T& value) {
+    static_assert(std::is_integral<T>::value, "SysfsAttribute::read(): integral type required");
+    char buf[32];
+    ssize_t n = read(&buf[0], sizeof(buf));
+    if (n <= 0) return false;
+    return Parse(std::string_view(&buf[0], static_cast<size_t>(n)), value);
+  }
+
+  template<typename T>
+  bool SysfsAttribute::Parse(std::string_view text, T& value) {
+    static_assert(std::is_integral<T>::value, "SysfsAttribute::Parse(): integral type required");
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+    while (first != last && (*first == ' ' || *first == '\t')) ++first;
+    T v;
+    auto result = std::from_chars(first, last, v);
+    if (result.ec != std::errc()) return false;
+    value = v;
+    return true;
+  }
+
+} // ends namespace xxx
+
+#endif
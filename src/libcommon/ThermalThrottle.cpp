@@ -0,0 +1,142 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/ThermalThrottle.cpp
+ * @brief Count thermal throttle events using /sys/devices/system/cpu/cpuN/thermal_throttle (implementation).
+ */
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include "CpuHotplug.hpp"
+#include "ThermalThrottle.hpp"
+
+xxx::ThermalThrottle::ThermalThrottle() {
+  std::vector<unsigned> online;
+  std::ifstream ifs("/sys/devices/system/cpu/online");
+  std::string list;
+  if (ifs.good()) std::getline(ifs, list);
+  CpuHotplug::ParseList(list, online);
+  hotplug(online);
+}
+
+void xxx::ThermalThrottle::hotplug(const std::vector<unsigned>& online) {
+  std::vector<ThermalThrottleEntry> cpus;
+  std::vector<ThermalThrottlePackage> packages;
+  for (unsigned cpu : online) {
+    std::string path("/sys/devices/system/cpu/cpu" + std::to_string(cpu));
+    auto it = std::find_if(cpus_.begin(), cpus_.end(),
+        [cpu](const auto& e) { return e.id == cpu; });
+    if (it != cpus_.end()) {
+      // the cpu stayed online, keep its counters
+      cpus.push_back(std::move(*it));
+    }
+    else {
+      ThermalThrottleEntry entry {};
+      entry.id = cpu;
+      entry.count_attr = SysfsAttribute(path + "/thermal_throttle/core_throttle_count");
+      if (!entry.count_attr.good()) continue; // no thermal_throttle (ie. not an Intel cpu)
+      entry.time_attr = SysfsAttribute(path + "/thermal_throttle/core_throttle_total_time_ms");
+      std::ifstream ifs(path + "/topology/physical_package_id");
+      if (ifs.good()) ifs >> entry.package;
+      entry.count_attr.read(entry.total_count);
+      entry.time_attr.read(entry.total_time_ms);
+      cpus.push_back(std::move(entry));
+    }
+    // The package counters are read using the first cpu of the package
+    unsigned long package = cpus.back().package;
+    if (std::any_of(packages.begin(), packages.end(),
+        [package](const auto& p) { return p.id == package; })) continue;
+    ThermalThrottlePackage p {};
+    auto ip = std::find_if(packages_.begin(), packages_.end(),
+        [package](const auto& e) { return e.id == package; });
+    if (ip != packages_.end()) {
+      /* keep the counters of the package */
+      p.count = ip->count;
+      p.time_ms = ip->time_ms;
+      p.total_count = ip->total_count;
+      p.total_time_ms = ip->total_time_ms;
+    }
+    p.id = package;
+    p.count_attr = SysfsAttribute(path + "/thermal_throttle/package_throttle_count");
+    p.time_attr = SysfsAttribute(path + "/thermal_throttle/package_throttle_total_time_ms");
+    if (ip == packages_.end()) {
+      p.count_attr.read(p.total_count);
+      p.time_attr.read(p.total_time_ms);
+    }
+    packages.push_back(std::move(p));
+  }
+  cpus_.swap(cpus);
+  packages_.swap(packages);
+  aggregate();
+}
+
+void xxx::ThermalThrottle::set(ThermalThrottleEntry& entry, uint64_t count, uint64_t time_ms) {
+  entry.count = (count > entry.total_count) ? count - entry.total_count : 0;
+  entry.time_ms = (time_ms > entry.total_time_ms) ? time_ms - entry.total_time_ms : 0;
+  entry.total_count = count;
+  entry.total_time_ms = time_ms;
+}
+
+void xxx::ThermalThrottle::aggregate() {
+  for (auto& p : packages_) {
+    p.core_count = 0;
+    p.core_time_ms = 0;
+    for (const auto& c : cpus_) {
+      if (c.package != p.id) continue;
+      p.core_count += c.count;
+      p.core_time_ms = std::max(p.core_time_ms, c.time_ms);
+    }
+  }
+}
+
+void xxx::ThermalThrottle::update() {
+  auto read = [](ThermalThrottleEntry& e) {
+    uint64_t count = e.total_count, time_ms = e.total_time_ms;
+    if (e.count_attr.good()) e.count_attr.read(count);
+    if (e.time_attr.good()) e.time_attr.read(time_ms);
+    set(e, count, time_ms);
+  };
+  for (auto& c : cpus_) read(c);
+  for (auto& p : packages_) read(p);
+  aggregate();
+}
+
+void xxx::ThermalThrottle::enqueue(ReadBatch& batch) {
+  /* (the attributes that are missing, ie. the throttle time on older kernels, are not read) */
+  auto add = [&batch](ThermalThrottleEntry& e) {
+    e.count_slot = e.count_attr.good() ? batch.add(e.count_attr) : SIZE_MAX;
+    e.time_slot = e.time_attr.good() ? batch.add(e.time_attr) : SIZE_MAX;
+  };
+  for (auto& c : cpus_) add(c);
+  for (auto& p : packages_) add(p);
+}
+
+void xxx::ThermalThrottle::update(const ReadBatch& batch) {
+  auto read = [&batch](ThermalThrottleEntry& e) {
+    uint64_t count = e.total_count, time_ms = e.total_time_ms;
+    if (e.count_slot != SIZE_MAX) SysfsAttribute::Parse(batch.data(e.count_slot), count);
+    if (e.time_slot != SIZE_MAX) SysfsAttribute::Parse(batch.data(e.time_slot), time_ms);
+    set(e, count, time_ms);
+  };
+  for (auto& c : cpus_) read(c);
+  for (auto& p : packages_) read(p);
+  aggregate();
+}
@@ -0,0 +1,101 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/ThermalThrottle.hpp
+ * @brief Count thermal throttle events using /sys/devices/system/cpu/cpuN/thermal_throttle.
+ */
+#ifndef libcommon_linux_sensors_ThermalThrottle_hpp
+#define libcommon_linux_sensors_ThermalThrottle_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "ReadBatch.hpp"
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief The throttle counters of a logical cpu (core_throttle_*)
+    * or of a physical package (package_throttle_*). */
+  struct ThermalThrottleEntry {
+    friend class ThermalThrottle;
+    public:
+      unsigned long id;        /* logical cpu number or physical package id */
+      uint64_t count;          /* throttle events during the last interval */
+      uint64_t time_ms;        /* time throttled during the last interval (ms) */
+      uint64_t total_count;    /* throttle events since boot */
+      uint64_t total_time_ms;  /* time throttled since boot (ms) */
+    private:
+      unsigned long package;   /* physical package id of a logical cpu */
+      SysfsAttribute count_attr;
+      SysfsAttribute time_attr;
+      /* ReadBatch slots of the attributes (SIZE_MAX == not open) */
+      size_t count_slot;
+      size_t time_slot;
+  };
+
+  /** @brief The throttle counters of a physical package
+    * and the aggregate of the counters of its logical cpus. */
+  struct ThermalThrottlePackage : public ThermalThrottleEntry {
+    uint64_t core_count;     /* sum of the core throttle events during the last interval */
+    uint64_t core_time_ms;   /* longest core throttle time during the last interval (ms) */
+  };
+
+  /** @brief Count the thermal throttle events that are counted by the kernel
+    * (the 'thermal_throttle' attributes of each logical cpu).
+    *
+    * The values are the deltas over the interval between two updates,
+    * no MSR access (or root privileges) is required. The package counters
+    * are read using the first online cpu of each package. */
+  class ThermalThrottle {
+    public:
+      ThermalThrottle();
+
+      /** @brief Update the counters. */
+      void update();
+      /** @brief Add the counter attributes to a ReadBatch. */
+      void enqueue(ReadBatch& batch);
+      /** @brief Update the counters from the data read by a ReadBatch. */
+      void update(const ReadBatch& batch);
+      /** @brief Adapt the cpus and packages to a new set of online cpus.
+        *
+        * The counters of cpus that stay online (and of packages that have
+        * an online cpu) are kept.
+        * @note Call enqueue() again after calling this function.
+        * @param online The (sorted) logical cpu numbers of the online cpus. */
+      void hotplug(const std::vector<unsigned>& online);
+
+      /** @brief The core throttle counters of each online logical cpu. */
+      inline const std::vector<ThermalThrottleEntry>& cpus() const { return cpus_; }
+      /** @brief The package throttle counters of each physical package. */
+      inline const std::vector<ThermalThrottlePackage>& packages() const { return packages_; }
+
+    private:
+      std::vector<ThermalThrottleEntry> cpus_;
+      std::vector<ThermalThrottlePackage> packages_;
+      /* Set the totals of an entry and calculate the deltas */
+      static void set(ThermalThrottleEntry& entry, uint64_t count, uint64_t time_ms);
+      /* Calculate the aggregate of the cpus of each package */
+      void aggregate();
+  };
+
+} // ends namespace xxx
+
+#endif
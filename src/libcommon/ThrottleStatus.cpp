@@ -0,0 +1,91 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/ThrottleStatus.cpp
+ * @brief Read the thermal (throttle) status MSRs using /dev/cpu/N/msr.
+ */
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <unistd.h>
+
+#include "ThrottleStatus.hpp"
+
+xxx::ThrottleStatus::ThrottleStatus() {
+  hotplug();
+}
+
+void xxx::ThrottleStatus::hotplug() {
+  std::vector<Entry> cpus, packages;
+  std::vector<SysfsAttribute> cpu_msr;
+  std::vector<unsigned long> package_cpu;
+  for (unsigned long cpu = 0; ; ++cpu) {
+    std::string path("/sys/devices/system/cpu/cpu");
+    path.append(std::to_string(cpu));
+    if (access(path.c_str(), F_OK) != 0) break; // no more cpus
+    // Skip offline cpus
+    std::ifstream ifs(path + "/online");
+    int online = 1;
+    if (ifs.good()) ifs >> online;
+    if (!online) continue;
+    // The package MSR is read using the first cpu of the package
+    std::ifstream ifs_id(path + "/topology/physical_package_id");
+    unsigned long package = 0;
+    if (ifs_id.good()) ifs_id >> package;
+    cpus.push_back({ cpu, 0, false });
+    // Keep the file descriptor of a cpu that was already online
+    auto it = std::find_if(cpus_.begin(), cpus_.end(),
+        [cpu](const Entry& e) { return e.id == cpu; });
+    if (it != cpus_.end())
+      cpu_msr.push_back(std::move(cpu_msr_[it - cpus_.begin()]));
+    else
+      cpu_msr.emplace_back("/dev/cpu/" + std::to_string(cpu) + "/msr");
+    if (std::none_of(packages.begin(), packages.end(),
+        [package](const Entry& e) { return e.id == package; })) {
+      packages.push_back({ package, 0, false });
+      package_cpu.push_back(cpu);
+    }
+  }
+  /* (the first cpu of a package may have changed, open its msr again) */
+  std::vector<SysfsAttribute> package_msr;
+  for (auto cpu : package_cpu)
+    package_msr.emplace_back("/dev/cpu/" + std::to_string(cpu) + "/msr");
+  /* (the msr of a cpu that went offline is closed here) */
+  cpus_ = std::move(cpus);
+  packages_ = std::move(packages);
+  cpu_msr_ = std::move(cpu_msr);
+  package_msr_ = std::move(package_msr);
+  update();
+}
+
+void xxx::ThrottleStatus::read(SysfsAttribute& msr, off_t address, Entry& entry) {
+  uint64_t value;
+  entry.valid = msr.read(reinterpret_cast<char*>(&value), sizeof(value), address)
+      == static_cast<ssize_t>(sizeof(value));
+  entry.value = entry.valid ? value : 0;
+}
+
+void xxx::ThrottleStatus::update() {
+  for (size_t i = 0; i < cpus_.size(); ++i)
+    read(cpu_msr_[i], IA32_THERM_STATUS, cpus_[i]);
+  for (size_t i = 0; i < packages_.size(); ++i)
+    read(package_msr_[i], IA32_PACKAGE_THERM_STATUS, packages_[i]);
+}
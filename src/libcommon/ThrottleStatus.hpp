@@ -0,0 +1,94 @@
+/*
+ * This file is part of 'Core Adjust'.
+ *
+ * Core Adjust - Adjust various settings of Intel Processors.
+ * Copyright (C) 2020, Alexander Bruines <alexander.bruines@gmail.com>
+ *
+ * Core Adjust is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Core Adjust is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Core Adjust. If not, see <https://www.gnu.org/licenses/>.
+ */
+/**
+ * @file src/libcommon/ThrottleStatus.hpp
+ * @brief Read the thermal (throttle) status MSRs using /dev/cpu/N/msr.
+ */
+#ifndef libcommon_linux_sensors_ThrottleStatus_hpp
+#define libcommon_linux_sensors_ThrottleStatus_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "SysfsAttribute.hpp"
+
+namespace xxx {
+
+  /** @brief Readout of IA32_THERM_STATUS (each logical cpu) and
+    * IA32_PACKAGE_THERM_STATUS (each physical package).
+    *
+    * The MSRs are read with a pread() on a persistent file descriptor of
+    * /dev/cpu/N/msr, which requires root privileges and the 'msr' kernel module.
+    * Entries for which the MSR could not be read are not valid. */
+  class ThrottleStatus {
+    public:
+      static constexpr off_t IA32_THERM_STATUS = 0x19c;
+      static constexpr off_t IA32_PACKAGE_THERM_STATUS = 0x1b1;
+
+      /** @brief The (read-only) status bits of both MSRs. */
+      enum Bit : unsigned {
+        THERMAL = 0,        /* Thermal (PROCHOT) throttling is active */
+        PROCHOT = 2,        /* PROCHOT# or FORCEPR# is asserted */
+        CRITICAL = 4,       /* Critical temperature */
+        THRESHOLD_1 = 6,    /* Temperature is above threshold #1 */
+        THRESHOLD_2 = 8,    /* Temperature is above threshold #2 */
+        POWER_LIMIT = 10,   /* Power limitation (PL1/PL2) is active */
+        CURRENT_LIMIT = 12, /* Current limitation (IccMax) is active (IA32_THERM_STATUS only) */
+        CROSS_DOMAIN = 14   /* Limited by another domain (IA32_THERM_STATUS only) */
+      };
+
+      struct Entry {
+        /** @brief Logical cpu number (cpus()) or physical package id (packages()). */
+        unsigned long id;
+        /** @brief The value of the MSR. */
+        uint64_t value;
+        /** @brief Was the MSR read successfully? */
+        bool valid;
+        /** @brief Get the value of a status bit. */
+        inline bool bit(Bit b) const { return (value >> b) & 1; }
+      };
+
+      ThrottleStatus();
+
+      /** @brief Read all MSRs. */
+      void update();
+      /** @brief Rescan the online cpus after a cpu was hotplugged.
+        *
+        * The MSRs of cpus that are still online are kept, those of
+        * offline cpus are closed and new cpus are added. The MSRs are
+        * read again, so cpus() and packages() are valid afterwards. */
+      void hotplug();
+
+      /** @brief IA32_THERM_STATUS of each (online) logical cpu. */
+      inline const std::vector<Entry>& cpus() const { return cpus_; }
+      /** @brief IA32_PACKAGE_THERM_STATUS of each physical package. */
+      inline const std::vector<Entry>& packages() const { return packages_; }
+
+    private:
+      std::vector<Entry> cpus_;
+      std::vector<Entry> packages_;
+      std::vector<SysfsAttribute> cpu_msr_;
+      std::vector<SysfsAttribute> package_msr_;
+      static void read(SysfsAttribute& msr, off_t address, Entry& entry);
+  };
+
+} // ends namespace xxx
+
+#endif